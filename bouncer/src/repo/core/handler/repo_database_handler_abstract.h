@@ -49,6 +49,13 @@ namespace repo{
 				*/
                                 uint64_t documentSizeLimit() { return maxDocumentSize; }
 
+				/**
+				* returns the maximum number of connections the handler holds
+				* i.e. the number of operations it can perform concurrently
+				* @return returns the maximum number of connections
+				*/
+				uint32_t connectionLimit() const { return maxConnections; }
+
 				///**
 				//* Generates a BSON object containing user credentials
 				//* @param username user name for authentication
@@ -428,10 +435,13 @@ namespace repo{
 				/**
 				* Default constructor
 				* @param size maximum size of documents(records) in bytes
+				* @param maxConnections maximum number of connections to the database
 				*/
-				AbstractDatabaseHandler(uint64_t size) :maxDocumentSize(size){};
+				AbstractDatabaseHandler(uint64_t size, uint32_t maxConnections = 1)
+					:maxDocumentSize(size), maxConnections(maxConnections){};
 
 				const uint64_t maxDocumentSize;
+				const uint32_t maxConnections;
 			};
 		}
 	}
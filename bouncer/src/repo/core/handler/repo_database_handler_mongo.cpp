@@ -52,7 +52,7 @@ MongoDatabaseHandler::MongoDatabaseHandler(
 	const std::string             &username,
 	const std::string             &password,
 	const bool                    &pwDigested) :
-	AbstractDatabaseHandler(MAX_MONGO_BSON_SIZE)
+	AbstractDatabaseHandler(MAX_MONGO_BSON_SIZE, maxConnections)
 {
 	mongo::client::initialize();
 	workerPool = new connectionPool::MongoConnectionPool(maxConnections, dbAddress, createAuthBSON(dbName, username, password, pwDigested));
@@ -63,7 +63,7 @@ MongoDatabaseHandler::MongoDatabaseHandler(
 	const uint32_t                &maxConnections,
 	const std::string             &dbName,
 	const repo::core::model::RepoBSON  *cred) :
-	AbstractDatabaseHandler(MAX_MONGO_BSON_SIZE)
+	AbstractDatabaseHandler(MAX_MONGO_BSON_SIZE, maxConnections)
 {
 	mongo::client::initialize();
 	workerPool = new connectionPool::MongoConnectionPool(maxConnections, dbAddress, (mongo::BSONObj*)cred);
@@ -17,6 +17,8 @@
 
 #include "repo_bson.h"
 
+#include <algorithm>
+#include <set>
 #include <mongo/client/dbclient.h>
 
 using namespace repo::core::model;
@@ -77,26 +79,90 @@ RepoBSON RepoBSON::cloneAndAddFields(
 
 RepoBSON RepoBSON::cloneAndShrink() const
 {
-	std::set<std::string> fields;
-	std::unordered_map< std::string, std::pair<std::string, std::vector<uint8_t>>> rawFiles(bigFiles.begin(), bigFiles.end());
+	//A limit of 0 moves every binary field out
+	return cloneAndShrink(0);
+}
+
+RepoBSON RepoBSON::cloneAndShrink(
+	const uint64_t &sizeLimit,
+	const RepoBSON &extraFields) const
+{
+	//Work out which binaries need to be stored externally before building anything,
+	//so the resulting bson is built exactly once.
+	std::vector<mongo::BSONElement> binaries;
+	mongo::BSONObjIterator it(*this);
+	while (it.more())
+	{
+		const mongo::BSONElement ele = it.next();
+		if (ele.type() == mongo::BinData && !extraFields.hasField(ele.fieldName()))
+			binaries.push_back(ele);
+	}
+
 	std::string uniqueIDStr = hasField(REPO_LABEL_ID) ? getUUIDField(REPO_LABEL_ID).toString() : repo::lib::RepoUUID::createUUID().toString();
 
-	getFieldNames(fields);
+	//Either every binary is moved out or none of them is
+	//Estimate is pessimistic: fields in extraFields replacing existing ones are counted twice
+	std::set<std::string> externalFields;
+	if (objsize() + extraFields.objsize() > sizeLimit)
+	{
+		for (const auto &ele : binaries)
+			externalFields.insert(ele.fieldName());
+	}
+
+	if (externalFields.empty() && extraFields.isEmpty())
+		return *this;
 
-	RepoBSON resultBson = *this;
+	auto rawFiles = bigFiles;
+	for (const auto &ele : binaries)
+	{
+		const std::string field = ele.fieldName();
+		if (externalFields.find(field) != externalFields.end())
+		{
+			int length;
+			const uint8_t *binData = (const uint8_t*)ele.binData(length);
+			rawFiles[field] = std::pair<std::string, std::vector<uint8_t>>(
+				uniqueIDStr + "_" + field, std::vector<uint8_t>(binData, binData + length));
+		}
+	}
 
-	for (const std::string &field : fields)
+	//Same layout as the mapping constructor over cloneAndAddFields():
+	//oversized files list, extra fields, then the remaining fields in order
+	mongo::BSONObjBuilder builder;
+	if (rawFiles.size())
 	{
-		if (getField(field).type() == ElementType::BINARY)
+		mongo::BSONObjBuilder filesBuilder;
+		for (const auto & pair : rawFiles)
 		{
-			std::string fileName = uniqueIDStr + "_" + field;
-			rawFiles[field] = std::pair<std::string, std::vector<uint8_t>>(fileName, std::vector<uint8_t>());
-			getBinaryFieldAsVector(field, rawFiles[field].second);
-			resultBson = resultBson.removeField(field);
+			//append field name :file name
+			filesBuilder << pair.first << pair.second.first;
 		}
+
+		if (hasField(REPO_LABEL_OVERSIZED_FILES))
+		{
+			filesBuilder.appendElementsUnique(getObjectField(REPO_LABEL_OVERSIZED_FILES));
+		}
+
+		builder.append(REPO_LABEL_OVERSIZED_FILES, filesBuilder.obj());
+	}
+	builder.appendElements(extraFields);
+
+	mongo::BSONObjIterator fieldIt(*this);
+	while (fieldIt.more())
+	{
+		const mongo::BSONElement ele = fieldIt.next();
+		const std::string field = ele.fieldName();
+		if (extraFields.hasField(field)
+			|| (rawFiles.size() && field == REPO_LABEL_OVERSIZED_FILES)
+			|| externalFields.find(field) != externalFields.end())
+			continue;
+
+		builder.append(ele);
 	}
 
-	return RepoBSON(resultBson, rawFiles);
+	//The oversized files list is already built, don't go through the mapping constructor
+	RepoBSON result(builder.obj());
+	result.bigFiles = rawFiles;
+	return result;
 }
 
 repo::lib::RepoUUID RepoBSON::getUUIDField(const std::string &label) const{
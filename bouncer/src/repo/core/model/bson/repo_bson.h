@@ -104,7 +104,7 @@ namespace repo {
 				void swap(RepoBSON otherCopy)
 				{
 					mongo::BSONObj::swap(otherCopy);
-					bigFiles = otherCopy.bigFiles;
+					bigFiles.swap(otherCopy.bigFiles);
 				}
 
 				/**
@@ -178,6 +178,31 @@ namespace repo {
 					return success;
 				}
 
+				/**
+				* Get the size of a binary field in bytes without copying it
+				* This also checks the bigFiles mapping
+				* @param field field name
+				* @return returns the size of the binary, 0 if it is not found
+				*/
+				uint64_t getBinaryFieldByteSize(const std::string &field) const
+				{
+					if (!hasField(field) || getField(field).type() == ElementType::STRING)
+					{
+						const auto &it = bigFiles.find(field);
+						return it == bigFiles.end() ? 0 : it->second.second.size();
+					}
+
+					RepoBSONElement bse = getField(field);
+					if (bse.type() == ElementType::BINARY)
+					{
+						int length;
+						bse.binData(length);
+						return length;
+					}
+
+					return 0;
+				}
+
 				/**
 				* Overload of getField function to retreve repo::lib::RepoUUID
 				* @param label name of the field
@@ -266,6 +291,19 @@ namespace repo {
 				*/
 				RepoBSON cloneAndShrink() const;
 
+				/**
+				* Clone the bson with the given fields added, moving every binary field
+				* to big file storage if the result would not fit within sizeLimit.
+				* The result has the same layout as cloneAndAddFields() followed by
+				* cloneAndShrink(), but the new bson is built in a single pass.
+				* @param sizeLimit maximum size of the resulting bson (in bytes)
+				* @param extraFields fields to add (replaces existing fields of the same name)
+				* @return returns the new bson
+				*/
+				RepoBSON cloneAndShrink(
+					const uint64_t &sizeLimit,
+					const RepoBSON &extraFields = RepoBSON()) const;
+
 				std::vector<uint8_t> getBigBinary(const std::string &key) const;
 
 				/**
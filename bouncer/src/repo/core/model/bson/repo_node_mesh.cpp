@@ -22,6 +22,7 @@
 #include "repo_node_mesh.h"
 
 #include "../../../lib/repo_log.h"
+#include "../../../lib/datastructure/repo_transform_kernel.h"
 #include "repo_bson_builder.h"
 using namespace repo::core::model;
 
@@ -53,36 +54,10 @@ RepoNode MeshNode::cloneAndApplyTransformation(
 	std::vector<repo::lib::RepoVector3D> newBbox;
 	if (vertices.size())
 	{
-		resultVertice.reserve(vertices.size());
-		for (const repo::lib::RepoVector3D &v : vertices)
-		{
-			resultVertice.push_back(matrix * v);
-			if (newBbox.size())
-			{
-				if (resultVertice.back().x < newBbox[0].x)
-					newBbox[0].x = resultVertice.back().x;
-
-				if (resultVertice.back().y < newBbox[0].y)
-					newBbox[0].y = resultVertice.back().y;
-
-				if (resultVertice.back().z < newBbox[0].z)
-					newBbox[0].z = resultVertice.back().z;
-
-				if (resultVertice.back().x > newBbox[1].x)
-					newBbox[1].x = resultVertice.back().x;
+		resultVertice.resize(vertices.size());
+		newBbox.resize(2);
+		repo::lib::transformPositions(matrix, vertices.data(), vertices.size(), resultVertice.data(), newBbox[0], newBbox[1]);
 
-				if (resultVertice.back().y > newBbox[1].y)
-					newBbox[1].y = resultVertice.back().y;
-
-				if (resultVertice.back().z > newBbox[1].z)
-					newBbox[1].z = resultVertice.back().z;
-			}
-			else
-			{
-				newBbox.push_back(resultVertice.back());
-				newBbox.push_back(resultVertice.back());
-			}
-		}
 		if (newBigFiles.find(REPO_NODE_MESH_LABEL_VERTICES) != newBigFiles.end())
 		{
 			const uint64_t verticesByteCount = resultVertice.size() * sizeof(repo::lib::RepoVector3D);
@@ -94,23 +69,10 @@ RepoNode MeshNode::cloneAndApplyTransformation(
 
 		if (normals.size())
 		{
-			auto matInverse = matrix.invert();
-			auto worldMat = matInverse.transpose();
-
 			std::vector<repo::lib::RepoVector3D> resultNormals;
-			resultNormals.reserve(normals.size());
-
-			auto data = worldMat.getData();
-			data[3] = data[7] = data[11] = 0;
+			resultNormals.resize(normals.size());
 
-			repo::lib::RepoMatrix multMat(data);
-
-			for (const repo::lib::RepoVector3D &v : normals)
-			{
-				auto transformedNormal = multMat * v;
-				transformedNormal.normalize();
-				resultNormals.push_back(transformedNormal);
-			}
+			repo::lib::transformNormals(repo::lib::getNormalMatrix(matrix), normals.data(), normals.size(), resultNormals.data());
 
 			if (newBigFiles.find(REPO_NODE_MESH_LABEL_NORMALS) != newBigFiles.end())
 			{
@@ -185,6 +147,23 @@ MeshNode MeshNode::cloneAndUpdateMeshMapping(
 	return MeshNode(builder.obj(), bigFiles);
 }
 
+MeshNode MeshNode::cloneAsStub() const
+{
+	RepoBSON stripped = *this;
+	for (const auto &label : { REPO_NODE_MESH_LABEL_VERTICES, REPO_NODE_MESH_LABEL_FACES,
+		REPO_NODE_MESH_LABEL_NORMALS, REPO_NODE_MESH_LABEL_COLORS, REPO_NODE_MESH_LABEL_UV_CHANNELS })
+	{
+		stripped = stripped.removeField(label);
+	}
+
+	RepoBSONBuilder builder;
+	builder.append(REPO_NODE_MESH_LABEL_STUB, true);
+	builder.appendElementsUnique(stripped);
+
+	//the big files are the buffers, they are not carried over
+	return MeshNode(builder.obj());
+}
+
 std::vector<repo::lib::RepoVector3D> MeshNode::getBoundingBox() const
 {
 	RepoBSON bbArr = getObjectField(REPO_NODE_MESH_LABEL_BOUNDING_BOX);
@@ -262,6 +241,33 @@ std::vector<repo::lib::RepoVector3D> MeshNode::getVertices() const
 	return vertices;
 }
 
+uint32_t MeshNode::getNumFaces() const
+{
+	if (hasField(REPO_NODE_MESH_LABEL_FACES_COUNT))
+		return getField(REPO_NODE_MESH_LABEL_FACES_COUNT).numberInt();
+
+	//Legacy node, count the faces from the serialised buffer
+	//([n1, v1, v2, ..., n2, v1, v2...])
+	uint32_t count = 0;
+	std::vector<uint32_t> serializedFaces = getFacesSerialized();
+	size_t index = 0;
+	while (index < serializedFaces.size())
+	{
+		index += serializedFaces[index] + 1;
+		++count;
+	}
+
+	return count;
+}
+
+uint32_t MeshNode::getNumVertices() const
+{
+	if (hasField(REPO_NODE_MESH_LABEL_VERTICES_COUNT))
+		return getField(REPO_NODE_MESH_LABEL_VERTICES_COUNT).numberInt();
+
+	return getBinaryFieldByteSize(REPO_NODE_MESH_LABEL_VERTICES) / sizeof(repo::lib::RepoVector3D);
+}
+
 uint32_t MeshNode::getMFormat() const
 {
 	/*
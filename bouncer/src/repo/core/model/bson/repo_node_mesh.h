@@ -58,6 +58,7 @@ namespace repo {
 #define REPO_NODE_MESH_LABEL_TRIANGLE_TO		        "t_to"
 #define REPO_NODE_MESH_LABEL_MATERIAL_ID		        "mat_id"
 #define REPO_NODE_MESH_LABEL_MERGE_MAP		        "m_map"
+#define REPO_NODE_MESH_LABEL_STUB			        "stub" //!< buffers released (in memory only)
 			//------------------------------------------------------------------------------
 
 
@@ -156,6 +157,15 @@ namespace repo {
 					const std::vector<repo_mesh_mapping_t> &vec,
 					const bool                             &overwrite = false);
 
+				/**
+				* Create a stub of the node: a copy without its buffers (vertices,
+				* faces, normals, colours and UV channels) flagged as a stub.
+				* The IDs, parents, bounding box, counts and mesh mapping are kept.
+				* Stubs stand for meshes stored elsewhere and are never committed.
+				* @return returns a new meshNode without any buffers
+				*/
+				MeshNode cloneAsStub() const;
+
 				/**
 				* --------- Convenience functions -----------
 				*/
@@ -180,6 +190,31 @@ namespace repo {
 
 				std::vector<repo_mesh_mapping_t> getMeshMapping() const;
 
+				/**
+				* Retrieve the number of faces within this mesh
+				* This does not require the faces to be decoded unless
+				* the node predates the faces count field.
+				* @return returns the number of faces
+				*/
+				uint32_t getNumFaces() const;
+
+				/**
+				* Retrieve the number of vertices within this mesh
+				* This does not require the vertices to be copied,
+				* nodes without a vertices count fall back on the binary size.
+				* @return returns the number of vertices
+				*/
+				uint32_t getNumVertices() const;
+
+				/**
+				* Check if the node is a stub (see cloneAsStub())
+				* @return returns true if the buffers of the mesh were released
+				*/
+				bool isStub() const
+				{
+					return hasField(REPO_NODE_MESH_LABEL_STUB);
+				}
+
 				/**
 				* Retrieve a vector of vertices from the bson object
 				*/
@@ -46,7 +46,7 @@ RepoNode TransformationNode::cloneAndApplyTransformation(
 	
 	auto currentTrans = getTransMatrix(false);
 	auto resultTrans = currentTrans * matrix;
-	auto resultData = resultTrans.getData();
+	const auto &resultData = resultTrans.getRawData();
 
 	RepoBSONBuilder rows;
 	for (uint32_t i = 0; i < 4; ++i)
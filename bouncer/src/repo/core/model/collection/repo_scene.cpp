@@ -742,7 +742,8 @@ bool RepoScene::commitNodes(
 	repo::core::handler::AbstractDatabaseHandler *handler,
 	const std::vector<repo::lib::RepoUUID> &nodesToCommit,
 	const GraphType &gType,
-	std::string &errMsg)
+	std::string &errMsg,
+	const RepoBSON &extraFields)
 {
 	bool success = true;
 
@@ -764,14 +765,21 @@ bool RepoScene::commitNodes(
 
 		const repo::lib::RepoUUID uniqueID = gType == GraphType::OPTIMIZED ? id : g.sharedIDtoUniqueID[id];
 		RepoNode *node = g.nodesByUniqueID[uniqueID];
-		if (node->objsize() > handler->documentSizeLimit())
+		if (!extraFields.isEmpty() || node->objsize() > handler->documentSizeLimit())
 		{
-			//Try to extract binary data out of the bson to shrink it.
-			RepoNode shrunkNode = node->cloneAndShrink();
+			//Add the extra fields and extract binary data out of the bson
+			//(only if needed to fit) in one go.
+			RepoNode shrunkNode = node->cloneAndShrink(handler->documentSizeLimit(), extraFields);
 			if (shrunkNode.objsize() > handler->documentSizeLimit())
 			{
 				success = false;
 				errMsg += "Node '" + node->getUniqueID().toString() + "' over 16MB in size is not committed.";
+				if (!extraFields.isEmpty())
+				{
+					//The node in memory still carries the extra fields, as the committed ones do
+					RepoNode extendedNode = node->cloneAndAddFields(&extraFields, false);
+					node->swap(extendedNode);
+				}
 			}
 			else
 			{
@@ -806,6 +814,38 @@ bool RepoScene::commitSceneChanges(
 	return success;
 }
 
+/**
+* Get the revisions a node of the stash graph was committed with.
+* Stash nodes shared between revisions store an array of revisions
+* @param node node of the stash graph
+* @return returns the revisions (empty if the node was never committed)
+*/
+static std::vector<repo::lib::RepoUUID> getStashRevisions(
+	const RepoNode *node)
+{
+	std::vector<repo::lib::RepoUUID> revs;
+	if (node->hasField(REPO_NODE_STASH_REF))
+	{
+		if (node->getField(REPO_NODE_STASH_REF).type() == ElementType::ARRAY)
+			revs = node->getUUIDFieldArray(REPO_NODE_STASH_REF);
+		else
+			revs.push_back(node->getUUIDField(REPO_NODE_STASH_REF));
+	}
+	return revs;
+}
+
+bool RepoScene::isSharedStashNode(
+	const RepoNode *node) const
+{
+	const repo::lib::RepoUUID rev = getRevisionID();
+	for (const auto &nodeRev : getStashRevisions(node))
+	{
+		if (nodeRev != rev)
+			return true;
+	}
+	return false;
+}
+
 bool RepoScene::commitStash(
 	repo::core::handler::AbstractDatabaseHandler *handler,
 	std::string &errMsg)
@@ -840,13 +880,43 @@ bool RepoScene::commitStash(
 		builder.append(REPO_NODE_STASH_REF, rev);
 		RepoBSON revID = builder.obj(); // this should be RepoBSON?
 
+		bool success = true;
 		for (auto &pair : stashGraph.nodesByUniqueID)
 		{
-			nodes.push_back(pair.first);
-			*pair.second = pair.second->cloneAndAddFields(&revID, false);
+			//Stubs stand for supermeshes committed as they were flushed out of memory
+			if (pair.second->getTypeAsEnum() == NodeType::MESH && ((MeshNode*)pair.second)->isStub())
+				continue;
+
+			auto revs = getStashRevisions(pair.second);
+			if (revs.empty())
+			{
+				nodes.push_back(pair.first);
+				continue;
+			}
+
+			//Nodes kept from the stash of another revision are already stored,
+			//the document is shared with this revision rather than copied
+			if (std::find(revs.begin(), revs.end(), rev) == revs.end())
+				revs.push_back(rev);
+
+			RepoBSONBuilder changeBuilder;
+			changeBuilder.appendArray(REPO_NODE_STASH_REF, revs);
+			auto parents = pair.second->getParentIDs();
+			if (parents.size())
+				changeBuilder.appendArray(REPO_NODE_LABEL_PARENTS, parents);
+			RepoBSON changes = changeBuilder.obj();
+
+			RepoBSONBuilder updateBuilder;
+			updateBuilder.append(REPO_NODE_LABEL_ID, pair.first);
+			updateBuilder.appendElements(changes);
+			success &= handler->upsertDocument(databaseName, projectName + "." + stashExt, updateBuilder.obj(), false, errMsg);
+
+			RepoNode sharedNode = pair.second->cloneAndAddFields(&changes, false);
+			pair.second->swap(sharedNode);
 		}
 
-		auto success = commitNodes(handler, nodes, GraphType::OPTIMIZED, errMsg);
+		//rev id is added as the nodes are serialised
+		success &= commitNodes(handler, nodes, GraphType::OPTIMIZED, errMsg, revID);
 
 		if (success)
 			updateRevisionStatus(handler, repo::core::model::RevisionNode::UploadStatus::COMPLETE);
@@ -964,13 +1034,7 @@ std::vector<repo::lib::RepoVector3D> RepoScene::getSceneBoundingBox() const
 	std::vector<repo::lib::RepoVector3D> bbox;
 	GraphType gType = stashGraph.rootNode ? GraphType::OPTIMIZED : GraphType::DEFAULT;
 
-	std::vector<float> identity = {
-		1, 0, 0, 0,
-		0, 1, 0, 0,
-		0, 0, 1, 0,
-		0, 0, 0, 1, };
-
-	getSceneBoundingBoxInternal(gType, gType == GraphType::OPTIMIZED ? stashGraph.rootNode : graph.rootNode, identity, bbox);
+	getSceneBoundingBoxInternal(gType, gType == GraphType::OPTIMIZED ? stashGraph.rootNode : graph.rootNode, repo::lib::RepoMatrix(), bbox);
 	return bbox;
 }
 
@@ -232,6 +232,10 @@ namespace repo{
 				* Commit the stash representation into the database
 				* This can only happen if there is a stash representation
 				* and the graph is already commited (i.e. there is a revision node)
+				* Nodes kept from the stash of another revision are not copied,
+				* their documents are shared with this revision
+				* Mesh stubs (see MeshNode::isStub()) are skipped, they are committed
+				* as their buffers are released
 				* @param errMsg error message if this failed
 				* @return returns true upon success
 				*/
@@ -239,6 +243,16 @@ namespace repo{
 					repo::core::handler::AbstractDatabaseHandler *handler,
 					std::string &errMsg);
 
+				/**
+				* Check if a node of the stash graph is shared with the stash of
+				* another revision (i.e. kept by an incremental stash update), in
+				* which case its web files were exported with that revision
+				* @param node node of the stash graph
+				* @return returns true if the node belongs to another revision too
+				*/
+				bool isSharedStashNode(
+					const RepoNode *node) const;
+
 				/**
 				* Get the branch ID of this scene graph
 				* @return returns the branch ID of this scene
@@ -938,13 +952,15 @@ namespace repo{
 				* @param nodesToCommit vector of uuids of nodes to commit
 				* @param graphType which graph did the nodes come from
 				* @param errMsg error message if this failed
+				* @param extraFields fields to add onto every node as it is committed
 				* @return returns true upon success
 				*/
 				bool commitNodes(
 					repo::core::handler::AbstractDatabaseHandler *handler,
 					const std::vector<repo::lib::RepoUUID> &nodesToCommit,
 					const GraphType &gType,
-					std::string &errMsg);
+					std::string &errMsg,
+					const RepoBSON &extraFields = RepoBSON());
 
 				/**
 				* Commit a project settings base on the
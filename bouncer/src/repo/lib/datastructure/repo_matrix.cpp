@@ -19,48 +19,60 @@
 #include "repo_matrix.h"
 #include <sstream>
 
+#if !defined(REPO_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define REPO_MATRIX_SSE
+#include <xmmintrin.h>
+#endif
+
 using namespace repo::lib;
 
 RepoMatrix::RepoMatrix()
+	: data(identityData()), affine(true)
 {
-	data = { 1, 0, 0, 0,
-		0, 1, 0, 0,
-		0, 0, 1, 0,
-		0, 0, 0, 1 };
 }
 
 RepoMatrix::RepoMatrix(const std::vector<float> &mat)
+	: data(identityData())
 {
-	data = { 1, 0, 0, 0,
-		0, 1, 0, 0,
-		0, 0, 1, 0,
-		0, 0, 0, 1 };
-
 	for (int i = 0; i < mat.size(); ++i)
 	{
 		if (i >= 16) break;
 		data[i] = mat[i];
 		
 	}	
+	affine = checkAffine(data);
 }		
 
 RepoMatrix::RepoMatrix(const std::vector<std::vector<float>> &mat)
+	: data(identityData())
 {
-
-	data = { 1, 0, 0, 0,
-		0, 1, 0, 0,
-		0, 0, 1, 0,
-		0, 0, 0, 1 };
-
 	int counter = 0;
 	for (const auto &row : mat)
 	{
 		for (const auto col : row)
+		{
+			if (counter >= 16) break;
 			data[counter++] = col;
+		}
 	}
-	if (data.size() > 16) data.resize(16);
+	affine = checkAffine(data);
 }
 
+RepoMatrix::RepoMatrix(const RepoMatrix &other)
+	: data(other.data), affine(other.affine), inverse(std::atomic_load(&other.inverse))
+{
+}
+
+RepoMatrix& RepoMatrix::operator=(const RepoMatrix &other)
+{
+	if (this != &other)
+	{
+		data = other.data;
+		affine = other.affine;
+		std::atomic_store(&inverse, std::atomic_load(&other.inverse));
+	}
+	return *this;
+}
 
 float RepoMatrix::determinant() const
 {
@@ -102,7 +114,7 @@ float RepoMatrix::determinant() const
 bool RepoMatrix::equals(const RepoMatrix &other) const
 {
 
-	auto otherData = other.getData();
+	const auto &otherData = other.data;
 	bool equal = true;
 	for (int i = 0; i < data.size(); ++i)
 	{
@@ -140,8 +152,13 @@ bool RepoMatrix::isIdentity(const float &eps) const
 
 RepoMatrix RepoMatrix::invert() const
 {
-	std::vector<float> result;
-	result.resize(16);
+	const auto cached = std::atomic_load(&inverse);
+	if (cached)
+	{
+		return RepoMatrix(*cached, checkAffine(*cached));
+	}
+
+	std::array<float, 16> result = { { 0 } };
 
 	const float det = determinant();
 	if (det == 0)
@@ -176,10 +193,12 @@ RepoMatrix RepoMatrix::invert() const
 		result[13] = inv_det * (a1 * (c2 * d3 - c3 * d2) + a2 * (c3 * d1 - c1 * d3) + a3 * (c1 * d2 - c2 * d1));
 		result[14] = -inv_det * (a1 * (b2 * d3 - b3 * d2) + a2 * (b3 * d1 - b1 * d3) + a3 * (b1 * d2 - b2 * d1));
 		result[15] = inv_det * (a1 * (b2 * c3 - b3 * c2) + a2 * (b3 * c1 - b1 * c3) + a3 * (b1 * c2 - b2 * c1));
-	}
 
+		//Concurrent callers may both compute the inverse, they get identical results
+		std::atomic_store(&inverse, std::make_shared<const std::array<float, 16>>(result));
+	}
 
-	return RepoMatrix(result);
+	return RepoMatrix(result, checkAffine(result));
 }
 
 std::string RepoMatrix::toString() const
@@ -199,7 +218,7 @@ std::string RepoMatrix::toString() const
 
 RepoMatrix RepoMatrix::transpose() const
 {
-	std::vector<float> result(data.begin(), data.end());
+	std::array<float, 16> result = data;
 
 
 	/*
@@ -223,5 +242,48 @@ RepoMatrix RepoMatrix::transpose() const
 	result[14] = data[11];
 
 
-	return RepoMatrix(result);
+	return RepoMatrix(result, checkAffine(result));
+}
+
+RepoMatrix repo::lib::operator*(const RepoMatrix &matrix1, const RepoMatrix &matrix2)
+{
+	std::array<float, 16> result;
+
+	const auto &mat1 = matrix1.data;
+	const auto &mat2 = matrix2.data;
+
+	//The product of 2 affine matrices is affine, the last row doesn't need computing
+	const bool affine = matrix1.affine && matrix2.affine;
+	const int nRows = affine ? 3 : 4;
+
+#ifdef REPO_MATRIX_SSE
+	const __m128 row0 = _mm_loadu_ps(&mat2[0]);
+	const __m128 row1 = _mm_loadu_ps(&mat2[4]);
+	const __m128 row2 = _mm_loadu_ps(&mat2[8]);
+	const __m128 row3 = _mm_loadu_ps(&mat2[12]);
+	for (int i = 0; i < nRows; ++i)
+	{
+		__m128 row = _mm_mul_ps(_mm_set1_ps(mat1[i * 4]), row0);
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(mat1[i * 4 + 1]), row1));
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(mat1[i * 4 + 2]), row2));
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(mat1[i * 4 + 3]), row3));
+		_mm_storeu_ps(&result[i * 4], row);
+	}
+#else
+	for (int i = 0; i < nRows; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			result[i * 4 + j] = mat1[i * 4] * mat2[j] + mat1[i * 4 + 1] * mat2[4 + j]
+				+ mat1[i * 4 + 2] * mat2[8 + j] + mat1[i * 4 + 3] * mat2[12 + j];
+		}
+	}
+#endif
+	if (affine)
+	{
+		result[12] = result[13] = result[14] = 0;
+		result[15] = 1;
+	}
+
+	return RepoMatrix(result, affine || RepoMatrix::checkAffine(result));
 }
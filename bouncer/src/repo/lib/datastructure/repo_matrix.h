@@ -19,6 +19,8 @@
 
 #include "repo_vector.h"
 #include "../repo_log.h" 
+#include <array>
+#include <memory>
 #include <string>
 
 namespace repo{
@@ -33,23 +35,74 @@ namespace repo{
 
 			RepoMatrix(const std::vector<std::vector<float>> &mat);
 
+			RepoMatrix(const RepoMatrix &other);
+
+			RepoMatrix& operator=(const RepoMatrix &other);
+
+			/**
+			* Get the data of a 4x4 identity matrix
+			* @return returns the identity matrix in row major
+			*/
+			static REPO_CONSTEXPR std::array<float, 16> identityData()
+			{
+				return{ { 1, 0, 0, 0,
+					0, 1, 0, 0,
+					0, 0, 1, 0,
+					0, 0, 0, 1 } };
+			}
+
 			float determinant() const;
 
 			bool equals(const RepoMatrix &other) const;
 
-			std::vector<float> getData() const { return data; }
+			std::vector<float> getData() const { return std::vector<float>(data.begin(), data.end()); }
+
+			/**
+			* Get the underlying data of the matrix without copying it
+			* @return returns a reference to the 16 floats of the matrix (row major)
+			*/
+			const std::array<float, 16>& getRawData() const { return data; }
 
+			/**
+			* Get the inverse of this matrix. The inverse is cached
+			* so subsequent calls on the same matrix (or its copies) are cheap.
+			* @return returns the inverse of this matrix
+			*/
 			RepoMatrix invert() const;
 
+			/**
+			* Check if the matrix is affine (last row is 0 0 0 1)
+			* @return returns true if the matrix is affine
+			*/
+			bool isAffine() const { return affine; }
+
 			bool isIdentity(const float &eps = 10e-5) const;
 
 			std::string toString() const;
 
 			RepoMatrix transpose() const;
 
+			friend REPO_API_EXPORT RepoMatrix operator*(const RepoMatrix &matrix1, const RepoMatrix &matrix2);
+
 		private:
-			std::vector<float> data;
-			  
+			/**
+			* Construct a matrix from its raw data
+			* @param mat data of the matrix (row major)
+			* @param affine if the given matrix is affine
+			*/
+			RepoMatrix(const std::array<float, 16> &mat, const bool &affine)
+				: data(mat), affine(affine) {}
+
+			static bool checkAffine(const std::array<float, 16> &mat)
+			{
+				return mat[12] == 0 && mat[13] == 0 && mat[14] == 0 && mat[15] == 1;
+			}
+
+			std::array<float, 16> data;
+			bool affine;
+
+			//Cached inverse (null until invert() is called), only accessed through std::atomic_load/store
+			mutable std::shared_ptr<const std::array<float, 16>> inverse;
 		};
 
 
@@ -63,7 +116,7 @@ namespace repo{
 		inline repo::lib::RepoVector3D operator*(const RepoMatrix &matrix, const repo::lib::RepoVector3D &vec)
 		{
 			repo::lib::RepoVector3D result;
-			auto mat = matrix.getData();
+			const auto &mat = matrix.getRawData();
 			/*
 			00 01 02 03
 			04 05 06 07
@@ -75,40 +128,28 @@ namespace repo{
 			result.y = mat[4] * vec.x + mat[5] * vec.y + mat[6] * vec.z + mat[7];
 			result.z = mat[8] * vec.x + mat[9] * vec.y + mat[10] * vec.z + mat[11];
 
-			float sig = 1e-5;
-
-			if (fabs(mat[12]) > sig || fabs(mat[13]) > sig || fabs(mat[14]) > sig || fabs(mat[15] - 1) > sig)
+			if (!matrix.isAffine())
 			{
-				repoWarning << "Potentially incorrect transformation : does not expect the last row to have values!";
+				float sig = 1e-5;
+
+				if (fabs(mat[12]) > sig || fabs(mat[13]) > sig || fabs(mat[14]) > sig || fabs(mat[15] - 1) > sig)
+				{
+					repoWarning << "Potentially incorrect transformation : does not expect the last row to have values!";
+				}
 			}
 
 			return result;
 		}
 
 
-		inline RepoMatrix operator*(const RepoMatrix &matrix1, const RepoMatrix &matrix2)
-		{
-			std::vector<float> result;
-			result.resize(16);
-
-			auto mat1 = matrix1.getData();
-			auto mat2 = matrix2.getData();
+		/**
+		* Matrix x matrix multiplication
+		* @param matrix1 left hand side
+		* @param matrix2 right hand side
+		* @return returns the product matrix1 x matrix2
+		*/
+		REPO_API_EXPORT RepoMatrix operator*(const RepoMatrix &matrix1, const RepoMatrix &matrix2);
 
-			for (int i = 0; i < 4; ++i)
-			{
-				for (int j = 0; j < 4; ++j)
-				{
-					size_t resultIdx = i * 4 + j;
-					result[resultIdx] = 0;
-					for (int k = 0; k < 4; ++k)
-					{
-						result[resultIdx] += mat1[i * 4 + k] * mat2[k * 4 + j];
-					}
-				}
-			}
-			return RepoMatrix(result);
-		}
-		
 		inline bool operator==(const RepoMatrix &matrix1, const RepoMatrix &matrix2)
 		{
 			return matrix1.equals(matrix2);
@@ -0,0 +1,189 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "repo_mesh_weld.h"
+#include "../repo_log.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace repo::lib;
+
+static bool withinTolerance(const float &a, const float &b, const float &tolerance)
+{
+	return std::fabs(a - b) <= tolerance;
+}
+
+/**
+* Get the grid cell a coordinate falls into. With no tolerance
+* the cell is the bit pattern of the value (-0 and 0 share a cell)
+*/
+static int64_t getCell(const float &value, const float &cellSize)
+{
+	if (cellSize <= 0)
+	{
+		const float normalised = value + 0.f;
+		uint32_t bits;
+		std::memcpy(&bits, &normalised, sizeof(bits));
+		return bits;
+	}
+	return (int64_t)std::floor((double)value / cellSize);
+}
+
+static uint64_t hashCell(const int64_t &x, const int64_t &y, const int64_t &z)
+{
+	return ((uint64_t)x * 73856093ULL) ^ ((uint64_t)y * 19349663ULL) ^ ((uint64_t)z * 83492791ULL);
+}
+
+size_t repo::lib::weldVertices(
+	std::vector<RepoVector3D>              &vertices,
+	std::vector<RepoVector3D>              &normals,
+	std::vector<std::vector<RepoVector2D>> &uvChannels,
+	std::vector<repo_color4d_t>            &colors,
+	std::vector<repo_face_t>               &faces,
+	const float                            &positionTolerance,
+	const float                            &normalTolerance,
+	const float                            &uvTolerance)
+{
+	const size_t nVertices = vertices.size();
+	if (!nVertices) return 0;
+
+	const bool hasNormals = normals.size();
+	const bool hasColors = colors.size();
+	if ((hasNormals && normals.size() != nVertices) || (hasColors && colors.size() != nVertices))
+	{
+		repoError << "Unable to weld vertices: number of normals/colors does not match the number of vertices";
+		return 0;
+	}
+	for (const auto &channel : uvChannels)
+	{
+		if (channel.size() != nVertices)
+		{
+			repoError << "Unable to weld vertices: number of uvs does not match the number of vertices";
+			return 0;
+		}
+	}
+	for (const auto &face : faces)
+	{
+		for (const auto &idx : face)
+		{
+			if (idx >= nVertices)
+			{
+				repoError << "Unable to weld vertices: face index " << idx << " is out of range";
+				return 0;
+			}
+		}
+	}
+
+	const float cellSize = positionTolerance > 0 ? positionTolerance : 0;
+	//With a tolerance a match may sit in a neighbouring cell
+	const int64_t searchRange = cellSize > 0 ? 1 : 0;
+
+	auto isMatch = [&](const size_t &kept, const size_t &idx) -> bool
+	{
+		if (!withinTolerance(vertices[kept].x, vertices[idx].x, cellSize)
+			|| !withinTolerance(vertices[kept].y, vertices[idx].y, cellSize)
+			|| !withinTolerance(vertices[kept].z, vertices[idx].z, cellSize))
+			return false;
+
+		if (hasNormals && (!withinTolerance(normals[kept].x, normals[idx].x, normalTolerance)
+			|| !withinTolerance(normals[kept].y, normals[idx].y, normalTolerance)
+			|| !withinTolerance(normals[kept].z, normals[idx].z, normalTolerance)))
+			return false;
+
+		for (const auto &channel : uvChannels)
+		{
+			if (!withinTolerance(channel[kept].x, channel[idx].x, uvTolerance)
+				|| !withinTolerance(channel[kept].y, channel[idx].y, uvTolerance))
+				return false;
+		}
+
+		return !hasColors || (colors[kept].r == colors[idx].r && colors[kept].g == colors[idx].g
+			&& colors[kept].b == colors[idx].b && colors[kept].a == colors[idx].a);
+	};
+
+	//Vertices are compacted in place, the kept ones are always at or before the one being processed
+	std::unordered_map<uint64_t, std::vector<uint32_t>> grid;
+	grid.reserve(nVertices);
+	std::vector<uint32_t> remap(nVertices);
+	size_t nKept = 0;
+	for (size_t i = 0; i < nVertices; ++i)
+	{
+		const int64_t cx = getCell(vertices[i].x, cellSize);
+		const int64_t cy = getCell(vertices[i].y, cellSize);
+		const int64_t cz = getCell(vertices[i].z, cellSize);
+
+		bool found = false;
+		for (int64_t dx = -searchRange; dx <= searchRange && !found; ++dx)
+		{
+			for (int64_t dy = -searchRange; dy <= searchRange && !found; ++dy)
+			{
+				for (int64_t dz = -searchRange; dz <= searchRange && !found; ++dz)
+				{
+					auto cellIt = grid.find(hashCell(cx + dx, cy + dy, cz + dz));
+					if (cellIt == grid.end()) continue;
+					for (const auto &kept : cellIt->second)
+					{
+						if (isMatch(kept, i))
+						{
+							remap[i] = kept;
+							found = true;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		if (!found)
+		{
+			if (nKept != i)
+			{
+				vertices[nKept] = vertices[i];
+				if (hasNormals)
+					normals[nKept] = normals[i];
+				if (hasColors)
+					colors[nKept] = colors[i];
+				for (auto &channel : uvChannels)
+					channel[nKept] = channel[i];
+			}
+			remap[i] = nKept;
+			grid[hashCell(cx, cy, cz)].push_back(nKept);
+			++nKept;
+		}
+	}
+
+	if (nKept == nVertices) return 0;
+
+	vertices.resize(nKept);
+	if (hasNormals)
+		normals.resize(nKept);
+	if (hasColors)
+		colors.resize(nKept);
+	for (auto &channel : uvChannels)
+		channel.resize(nKept);
+
+	for (auto &face : faces)
+	{
+		for (auto &idx : face)
+		{
+			idx = remap[idx];
+		}
+	}
+
+	return nVertices - nKept;
+}
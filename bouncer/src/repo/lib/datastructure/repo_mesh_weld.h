@@ -0,0 +1,62 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Vertex welding for mesh buffers.
+* Vertices with the same attributes (within the given tolerances) are merged
+* and the faces are re-indexed to use the merged vertices.
+*/
+
+#pragma once
+
+#include "repo_structs.h"
+#include "repo_vector.h"
+
+namespace repo{
+	namespace lib{
+
+		/**
+		* Merge duplicated vertices of a mesh, in place.
+		* Two vertices are merged if their positions, normals and uvs
+		* differ by no more than the given tolerances (per component)
+		* and their colours are identical. A tolerance of 0 only merges exact
+		* duplicates. The first occurrence of a vertex is kept, so the
+		* relative order of the remaining vertices is preserved.
+		* Normals, uvChannels and colors are optional (empty), but if
+		* present they must have one entry per vertex.
+		* Nothing is modified if the buffers are inconsistent.
+		* @param vertices vertex positions
+		* @param normals vertex normals
+		* @param uvChannels uv channels
+		* @param colors vertex colors
+		* @param faces faces to re-index
+		* @param positionTolerance maximum difference between positions
+		* @param normalTolerance maximum difference between normals
+		* @param uvTolerance maximum difference between uvs
+		* @return returns the number of vertices removed
+		*/
+		REPO_API_EXPORT size_t weldVertices(
+			std::vector<RepoVector3D>              &vertices,
+			std::vector<RepoVector3D>              &normals,
+			std::vector<std::vector<RepoVector2D>> &uvChannels,
+			std::vector<repo_color4d_t>            &colors,
+			std::vector<repo_face_t>               &faces,
+			const float                            &positionTolerance = 0,
+			const float                            &normalTolerance = 0,
+			const float                            &uvTolerance = 0);
+	}
+}
@@ -0,0 +1,417 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "repo_transform_kernel.h"
+
+#include <algorithm>
+
+#if !defined(REPO_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define REPO_TRANSFORM_SSE
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define REPO_TARGET_AVX
+#define REPO_TRANSFORM_AVX
+#elif defined(__GNUC__)
+#define REPO_TARGET_AVX __attribute__((target("avx")))
+#define REPO_TRANSFORM_AVX
+#endif
+#endif
+
+using namespace repo::lib;
+
+/*
+* NOTE: all implementations evaluate m0 * x + m1 * y + m2 * z + m3 in the same
+* order as operator*(RepoMatrix, RepoVector3D) so the results are identical
+* regardless of which implementation is picked.
+*/
+
+typedef void(*PositionKernel)(const float*, const RepoVector3D*, size_t, RepoVector3D*, RepoVector3D&, RepoVector3D&);
+typedef void(*NormalKernel)(const float*, const RepoVector3D*, size_t, RepoVector3D*);
+
+static inline RepoVector3D transformScalar(
+	const float        *mat,
+	const RepoVector3D &v)
+{
+	return RepoVector3D(
+		mat[0] * v.x + mat[1] * v.y + mat[2] * v.z + mat[3],
+		mat[4] * v.x + mat[5] * v.y + mat[6] * v.z + mat[7],
+		mat[8] * v.x + mat[9] * v.y + mat[10] * v.z + mat[11]);
+}
+
+#ifndef REPO_TRANSFORM_SSE
+//Fallback kernels, only used when no SIMD implementation is compiled in
+static void transformPositionsScalar(
+	const float        *mat,
+	const RepoVector3D *in,
+	size_t              count,
+	RepoVector3D       *out,
+	RepoVector3D       &bboxMin,
+	RepoVector3D       &bboxMax)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		out[i] = transformScalar(mat, in[i]);
+
+		bboxMin.x = std::min(bboxMin.x, out[i].x);
+		bboxMin.y = std::min(bboxMin.y, out[i].y);
+		bboxMin.z = std::min(bboxMin.z, out[i].z);
+		bboxMax.x = std::max(bboxMax.x, out[i].x);
+		bboxMax.y = std::max(bboxMax.y, out[i].y);
+		bboxMax.z = std::max(bboxMax.z, out[i].z);
+	}
+}
+
+static void transformNormalsScalar(
+	const float        *mat,
+	const RepoVector3D *in,
+	size_t              count,
+	RepoVector3D       *out)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		out[i] = transformScalar(mat, in[i]);
+		out[i].normalize();
+	}
+}
+#endif
+
+#ifdef REPO_TRANSFORM_SSE
+/*
+* SSE2: one vertex per iteration, the matrix columns are kept in registers
+* and the result is computed as c0 * x + c1 * y + c2 * z + c3
+*/
+
+static inline __m128 transformSSE(
+	const __m128 *cols,
+	const RepoVector3D &v)
+{
+	__m128 res = _mm_add_ps(_mm_mul_ps(cols[0], _mm_set1_ps(v.x)), _mm_mul_ps(cols[1], _mm_set1_ps(v.y)));
+	res = _mm_add_ps(res, _mm_mul_ps(cols[2], _mm_set1_ps(v.z)));
+	return _mm_add_ps(res, cols[3]);
+}
+
+static inline void storeSSE(
+	const __m128 &vec,
+	RepoVector3D &v)
+{
+	_mm_storel_pi((__m64*)&v.x, vec);
+	_mm_store_ss(&v.z, _mm_movehl_ps(vec, vec));
+}
+
+static void transformPositionsSSE(
+	const float        *mat,
+	const RepoVector3D *in,
+	size_t              count,
+	RepoVector3D       *out,
+	RepoVector3D       &bboxMin,
+	RepoVector3D       &bboxMax)
+{
+	const __m128 cols[4] = {
+		_mm_setr_ps(mat[0], mat[4], mat[8], mat[12]),
+		_mm_setr_ps(mat[1], mat[5], mat[9], mat[13]),
+		_mm_setr_ps(mat[2], mat[6], mat[10], mat[14]),
+		_mm_setr_ps(mat[3], mat[7], mat[11], mat[15]) };
+
+	__m128 vMin = _mm_setr_ps(bboxMin.x, bboxMin.y, bboxMin.z, 0);
+	__m128 vMax = _mm_setr_ps(bboxMax.x, bboxMax.y, bboxMax.z, 0);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const __m128 res = transformSSE(cols, in[i]);
+		vMin = _mm_min_ps(vMin, res);
+		vMax = _mm_max_ps(vMax, res);
+		storeSSE(res, out[i]);
+	}
+
+	storeSSE(vMin, bboxMin);
+	storeSSE(vMax, bboxMax);
+}
+
+static void transformNormalsSSE(
+	const float        *mat,
+	const RepoVector3D *in,
+	size_t              count,
+	RepoVector3D       *out)
+{
+	const __m128 cols[4] = {
+		_mm_setr_ps(mat[0], mat[4], mat[8], 0),
+		_mm_setr_ps(mat[1], mat[5], mat[9], 0),
+		_mm_setr_ps(mat[2], mat[6], mat[10], 0),
+		_mm_setr_ps(mat[3], mat[7], mat[11], 0) };
+	const __m128 zero = _mm_setzero_ps();
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		__m128 res = transformSSE(cols, in[i]);
+
+		//length = sqrt((x*x + y*y) + z*z), same order as RepoVector3D::normalize()
+		const __m128 sq = _mm_mul_ps(res, res);
+		__m128 len = _mm_add_ss(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 1, 1, 1)));
+		len = _mm_sqrt_ss(_mm_add_ss(len, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 2))));
+		len = _mm_shuffle_ps(len, len, _MM_SHUFFLE(0, 0, 0, 0));
+
+		//only normalise if length > 0
+		const __m128 mask = _mm_cmpgt_ps(len, zero);
+		const __m128 normalised = _mm_div_ps(res, len);
+		res = _mm_or_ps(_mm_and_ps(mask, normalised), _mm_andnot_ps(mask, res));
+
+		storeSSE(res, out[i]);
+	}
+}
+#endif
+
+#ifdef REPO_TRANSFORM_AVX
+/*
+* AVX: 8 vertices per iteration. The interleaved xyz data is shuffled into
+* 3 registers of x, y and z (the lane order is permuted, but it is restored
+* when interleaving the results back), then transformed in SoA form.
+*/
+
+REPO_TARGET_AVX static inline void loadSoA(
+	const RepoVector3D *in,
+	__m256 &x,
+	__m256 &y,
+	__m256 &z)
+{
+	const float *p = &in[0].x;
+	__m256 m03 = _mm256_castps128_ps256(_mm_loadu_ps(p));
+	__m256 m14 = _mm256_castps128_ps256(_mm_loadu_ps(p + 4));
+	__m256 m25 = _mm256_castps128_ps256(_mm_loadu_ps(p + 8));
+	m03 = _mm256_insertf128_ps(m03, _mm_loadu_ps(p + 12), 1);
+	m14 = _mm256_insertf128_ps(m14, _mm_loadu_ps(p + 16), 1);
+	m25 = _mm256_insertf128_ps(m25, _mm_loadu_ps(p + 20), 1);
+
+	const __m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+	const __m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+	x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+	y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+	z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+REPO_TARGET_AVX static inline void storeSoA(
+	const __m256 &x,
+	const __m256 &y,
+	const __m256 &z,
+	RepoVector3D *out)
+{
+	const __m256 rxy = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+	const __m256 ryz = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+	const __m256 rzx = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+	const __m256 r03 = _mm256_shuffle_ps(rxy, rzx, _MM_SHUFFLE(2, 0, 2, 0));
+	const __m256 r14 = _mm256_shuffle_ps(ryz, rxy, _MM_SHUFFLE(3, 1, 2, 0));
+	const __m256 r25 = _mm256_shuffle_ps(rzx, ryz, _MM_SHUFFLE(3, 1, 3, 1));
+
+	float *p = &out[0].x;
+	_mm_storeu_ps(p, _mm256_castps256_ps128(r03));
+	_mm_storeu_ps(p + 4, _mm256_castps256_ps128(r14));
+	_mm_storeu_ps(p + 8, _mm256_castps256_ps128(r25));
+	_mm_storeu_ps(p + 12, _mm256_extractf128_ps(r03, 1));
+	_mm_storeu_ps(p + 16, _mm256_extractf128_ps(r14, 1));
+	_mm_storeu_ps(p + 20, _mm256_extractf128_ps(r25, 1));
+}
+
+REPO_TARGET_AVX static inline __m256 dotRowAVX(
+	const __m256 *row,
+	const __m256 &x,
+	const __m256 &y,
+	const __m256 &z)
+{
+	__m256 res = _mm256_add_ps(_mm256_mul_ps(row[0], x), _mm256_mul_ps(row[1], y));
+	res = _mm256_add_ps(res, _mm256_mul_ps(row[2], z));
+	return _mm256_add_ps(res, row[3]);
+}
+
+REPO_TARGET_AVX static inline float reduceAVX(
+	const __m256 &vec,
+	const bool &isMin)
+{
+	float values[8];
+	_mm256_storeu_ps(values, vec);
+	return isMin ? *std::min_element(values, values + 8) : *std::max_element(values, values + 8);
+}
+
+REPO_TARGET_AVX static void transformPositionsAVX(
+	const float        *mat,
+	const RepoVector3D *in,
+	size_t              count,
+	RepoVector3D       *out,
+	RepoVector3D       &bboxMin,
+	RepoVector3D       &bboxMax)
+{
+	const size_t nBatches = count / 8;
+	if (nBatches)
+	{
+		__m256 rows[3][4];
+		for (int r = 0; r < 3; ++r)
+			for (int c = 0; c < 4; ++c)
+				rows[r][c] = _mm256_set1_ps(mat[r * 4 + c]);
+
+		__m256 minX = _mm256_set1_ps(bboxMin.x), minY = _mm256_set1_ps(bboxMin.y), minZ = _mm256_set1_ps(bboxMin.z);
+		__m256 maxX = _mm256_set1_ps(bboxMax.x), maxY = _mm256_set1_ps(bboxMax.y), maxZ = _mm256_set1_ps(bboxMax.z);
+
+		for (size_t batch = 0; batch < nBatches; ++batch)
+		{
+			__m256 x, y, z;
+			loadSoA(in + batch * 8, x, y, z);
+
+			const __m256 resX = dotRowAVX(rows[0], x, y, z);
+			const __m256 resY = dotRowAVX(rows[1], x, y, z);
+			const __m256 resZ = dotRowAVX(rows[2], x, y, z);
+
+			minX = _mm256_min_ps(minX, resX);
+			minY = _mm256_min_ps(minY, resY);
+			minZ = _mm256_min_ps(minZ, resZ);
+			maxX = _mm256_max_ps(maxX, resX);
+			maxY = _mm256_max_ps(maxY, resY);
+			maxZ = _mm256_max_ps(maxZ, resZ);
+
+			storeSoA(resX, resY, resZ, out + batch * 8);
+		}
+
+		bboxMin = RepoVector3D(reduceAVX(minX, true), reduceAVX(minY, true), reduceAVX(minZ, true));
+		bboxMax = RepoVector3D(reduceAVX(maxX, false), reduceAVX(maxY, false), reduceAVX(maxZ, false));
+		_mm256_zeroupper();
+	}
+
+	const size_t done = nBatches * 8;
+	transformPositionsSSE(mat, in + done, count - done, out + done, bboxMin, bboxMax);
+}
+
+REPO_TARGET_AVX static void transformNormalsAVX(
+	const float        *mat,
+	const RepoVector3D *in,
+	size_t              count,
+	RepoVector3D       *out)
+{
+	const size_t nBatches = count / 8;
+	if (nBatches)
+	{
+		__m256 rows[3][4];
+		for (int r = 0; r < 3; ++r)
+			for (int c = 0; c < 4; ++c)
+				rows[r][c] = _mm256_set1_ps(mat[r * 4 + c]);
+		const __m256 zero = _mm256_setzero_ps();
+
+		for (size_t batch = 0; batch < nBatches; ++batch)
+		{
+			__m256 x, y, z;
+			loadSoA(in + batch * 8, x, y, z);
+
+			__m256 resX = dotRowAVX(rows[0], x, y, z);
+			__m256 resY = dotRowAVX(rows[1], x, y, z);
+			__m256 resZ = dotRowAVX(rows[2], x, y, z);
+
+			//length = sqrt((x*x + y*y) + z*z), same order as RepoVector3D::normalize()
+			__m256 len = _mm256_add_ps(_mm256_mul_ps(resX, resX), _mm256_mul_ps(resY, resY));
+			len = _mm256_sqrt_ps(_mm256_add_ps(len, _mm256_mul_ps(resZ, resZ)));
+
+			//only normalise if length > 0
+			const __m256 mask = _mm256_cmp_ps(len, zero, _CMP_GT_OQ);
+			resX = _mm256_blendv_ps(resX, _mm256_div_ps(resX, len), mask);
+			resY = _mm256_blendv_ps(resY, _mm256_div_ps(resY, len), mask);
+			resZ = _mm256_blendv_ps(resZ, _mm256_div_ps(resZ, len), mask);
+
+			storeSoA(resX, resY, resZ, out + batch * 8);
+		}
+		_mm256_zeroupper();
+	}
+
+	const size_t done = nBatches * 8;
+	transformNormalsSSE(mat, in + done, count - done, out + done);
+}
+
+static bool cpuSupportsAVX()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	//Check the OS saves the YMM registers on context switch
+	return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#else
+	return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+static PositionKernel getPositionKernel()
+{
+#if defined(REPO_TRANSFORM_AVX)
+	static const PositionKernel kernel = cpuSupportsAVX() ? transformPositionsAVX : transformPositionsSSE;
+	return kernel;
+#elif defined(REPO_TRANSFORM_SSE)
+	return transformPositionsSSE;
+#else
+	return transformPositionsScalar;
+#endif
+}
+
+static NormalKernel getNormalKernel()
+{
+#if defined(REPO_TRANSFORM_AVX)
+	static const NormalKernel kernel = cpuSupportsAVX() ? transformNormalsAVX : transformNormalsSSE;
+	return kernel;
+#elif defined(REPO_TRANSFORM_SSE)
+	return transformNormalsSSE;
+#else
+	return transformNormalsScalar;
+#endif
+}
+
+void repo::lib::transformPositions(
+	const RepoMatrix   &matrix,
+	const RepoVector3D *in,
+	const size_t       &count,
+	RepoVector3D       *out,
+	RepoVector3D       &bboxMin,
+	RepoVector3D       &bboxMax)
+{
+	if (!count) return;
+
+	const auto &mat = matrix.getRawData();
+
+	const float sig = 1e-5;
+	if (!matrix.isAffine() && (fabs(mat[12]) > sig || fabs(mat[13]) > sig || fabs(mat[14]) > sig || fabs(mat[15] - 1) > sig))
+	{
+		repoWarning << "Potentially incorrect transformation : does not expect the last row to have values!";
+	}
+
+	//Seed the bounding box with the first vertex so the kernels only need to widen it.
+	bboxMin = bboxMax = transformScalar(mat.data(), in[0]);
+
+	getPositionKernel()(mat.data(), in, count, out, bboxMin, bboxMax);
+}
+
+void repo::lib::transformNormals(
+	const RepoMatrix   &normalMatrix,
+	const RepoVector3D *in,
+	const size_t       &count,
+	RepoVector3D       *out)
+{
+	if (!count) return;
+
+	getNormalKernel()(normalMatrix.getRawData().data(), in, count, out);
+}
+
+RepoMatrix repo::lib::getNormalMatrix(const RepoMatrix &matrix)
+{
+	auto data = matrix.invert().transpose().getData();
+	data[3] = data[7] = data[11] = 0;
+	return RepoMatrix(data);
+}
@@ -0,0 +1,79 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Batch transformation kernels for vertex buffers.
+* The implementation is picked at runtime (AVX, SSE2 or scalar) depending
+* on what the CPU supports. All implementations produce the same results as
+* the scalar RepoMatrix x RepoVector3D multiplication.
+* Define REPO_NO_SIMD at compile time to force the scalar implementation.
+*/
+
+#pragma once
+
+#include "repo_matrix.h"
+#include "repo_vector.h"
+
+namespace repo{
+	namespace lib{
+
+		/**
+		* Transform an array of positions by the given matrix and compute
+		* the axis aligned bounding box of the transformed positions.
+		* in and out may point to the same buffer.
+		* NOTE: this assumes matrix has row as fast dimension!
+		* @param matrix 4x4 transformation matrix
+		* @param in positions to transform
+		* @param count number of positions within in
+		* @param out buffer to write the results into (must hold count elements)
+		* @param bboxMin minimum corner of the resulting bounding box (untouched if count is 0)
+		* @param bboxMax maximum corner of the resulting bounding box (untouched if count is 0)
+		*/
+		REPO_API_EXPORT void transformPositions(
+			const RepoMatrix   &matrix,
+			const RepoVector3D *in,
+			const size_t       &count,
+			RepoVector3D       *out,
+			RepoVector3D       &bboxMin,
+			RepoVector3D       &bboxMax);
+
+		/**
+		* Transform an array of normals by the given matrix and normalise them.
+		* The matrix is used as is, use getNormalMatrix() to derive it from
+		* the transformation applied to the positions.
+		* in and out may point to the same buffer.
+		* @param normalMatrix 4x4 matrix to transform the normals with
+		* @param in normals to transform
+		* @param count number of normals within in
+		* @param out buffer to write the results into (must hold count elements)
+		*/
+		REPO_API_EXPORT void transformNormals(
+			const RepoMatrix   &normalMatrix,
+			const RepoVector3D *in,
+			const size_t       &count,
+			RepoVector3D       *out);
+
+		/**
+		* Get the matrix required to transform normals of a mesh
+		* transformed by the given matrix (i.e. the inverse transpose
+		* without translation)
+		* @param matrix transformation applied to the positions
+		* @return returns the normal matrix
+		*/
+		REPO_API_EXPORT RepoMatrix getNormalMatrix(const RepoMatrix &matrix);
+	}
+}
@@ -22,14 +22,134 @@
 #include "repo_uuid.h"
 using namespace repo::lib;
 
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <sstream>
 #include <boost/functional/hash.hpp>
-#include <boost/lexical_cast.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
-#include <boost/uuid/uuid_io.hpp>
 
 const std::string RepoUUID::defaultValue = "00000000-0000-0000-0000-000000000000";
 
+static const char hexDigits[] = "0123456789abcdef";
+
+//xoshiro256** state, every thread has its own generator
+static REPO_THREAD_LOCAL uint64_t prngState[4];
+static REPO_THREAD_LOCAL bool prngSeeded;
+
+static inline uint64_t splitMix64(uint64_t &seed)
+{
+	uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t rotateLeft(const uint64_t &x, const int &k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static void seedGenerator()
+{
+	//Every word of the state is drawn from random_device, so the whole
+	//256 bits of state are random rather than derived from a single seed
+	bool seeded = false;
+	try
+	{
+		std::random_device rd;
+		uint64_t combined = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			prngState[i] = ((uint64_t)rd() << 32) | (uint64_t)rd();
+			combined |= prngState[i];
+		}
+		//xoshiro must not start from an all zero state
+		seeded = combined != 0;
+	}
+	catch (...)
+	{
+		repoWarning << "std::random_device is unavailable, seeding the UUID generator from the clock only";
+	}
+
+	if (!seeded)
+	{
+		//Fall back on the time and the address of the thread local state to tell threads apart
+		uint64_t seed = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+		seed ^= (uint64_t)(uintptr_t)prngState;
+		for (int i = 0; i < 4; ++i)
+		{
+			prngState[i] = splitMix64(seed);
+		}
+	}
+	prngSeeded = true;
+}
+
+static inline uint64_t nextRandom()
+{
+	const uint64_t result = rotateLeft(prngState[1] * 5, 7) * 9;
+	const uint64_t t = prngState[1] << 17;
+
+	prngState[2] ^= prngState[0];
+	prngState[3] ^= prngState[1];
+	prngState[1] ^= prngState[2];
+	prngState[0] ^= prngState[3];
+	prngState[2] ^= t;
+	prngState[3] = rotateLeft(prngState[3], 45);
+
+	return result;
+}
+
+static inline int hexValue(const char &c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+/*
+* Parse the canonical representation of a UUID (8-4-4-4-12 hex digits,
+* optionally surrounded by braces) without going through boost.
+* Returns false if the string is not in this exact format.
+*/
+static bool parseCanonicalUUID(
+	const std::string &text,
+	boost::uuids::uuid &uuid)
+{
+	size_t start = 0, length = text.size();
+	if (length == 38 && text[0] == '{' && text[37] == '}')
+	{
+		start = 1;
+		length = 36;
+	}
+
+	if (length != 36)
+		return false;
+
+	const char *str = text.c_str() + start;
+	if (str[8] != '-' || str[13] != '-' || str[18] != '-' || str[23] != '-')
+		return false;
+
+	size_t pos = 0;
+	for (size_t i = 0; i < uuid.size(); ++i)
+	{
+		if (pos == 8 || pos == 13 || pos == 18 || pos == 23)
+			++pos;
+
+		const int high = hexValue(str[pos]);
+		const int low = hexValue(str[pos + 1]);
+		if (high < 0 || low < 0)
+			return false;
+
+		uuid.data[i] = (uint8_t)((high << 4) | low);
+		pos += 2;
+	}
+
+	return true;
+}
+
 /*!
 * Returns a valid uuid representation of a given string. If empty, returns
 * a randomly generated uuid. If the string is not a uuid representation,
@@ -49,7 +169,7 @@ static boost::uuids::uuid stringToUUID(
 	boost::uuids::uuid uuid;
 	if (text.empty())
 		return stringToUUID(RepoUUID::defaultValue);
-	else
+	else if (!parseCanonicalUUID(text, uuid))
 	{
 		try
 		{
@@ -79,17 +199,6 @@ static boost::uuids::uuid stringToUUID(
 	return uuid;
 }
 
-size_t RepoUUID::getHash() const
-{
-	return boost::hash<boost::uuids::uuid>()(id);
-}
-
-
-size_t RepoUUIDHasher::operator()(const RepoUUID& uid) const
-{
-	return uid.getHash();
-}
-
 RepoUUID::RepoUUID(const std::string &stringRep)
 	: id(stringToUUID(stringRep))
 {
@@ -116,13 +225,35 @@ RepoUUID RepoUUID::fromBSONElement(const repo::core::model::RepoBSONElement &ele
 
 RepoUUID RepoUUID::createUUID()
 {
-	static boost::uuids::random_generator gen;
-	return RepoUUID(gen());
+	if (!prngSeeded)
+		seedGenerator();
+
+	boost::uuids::uuid id;
+	const uint64_t high = nextRandom();
+	const uint64_t low = nextRandom();
+	memcpy(id.data, &high, sizeof(high));
+	memcpy(id.data + sizeof(high), &low, sizeof(low));
+
+	//RFC 4122 version 4 (random) and variant bits
+	id.data[6] = (id.data[6] & 0x0F) | 0x40;
+	id.data[8] = (id.data[8] & 0x3F) | 0x80;
+
+	return RepoUUID(id);
 }
 
 std::string RepoUUID::toString() const
 {
-	return boost::lexical_cast<std::string>(id);
+	std::string str(36, '-');
+	size_t pos = 0;
+	for (size_t i = 0; i < id.size(); ++i)
+	{
+		if (pos == 8 || pos == 13 || pos == 18 || pos == 23)
+			++pos;
+
+		str[pos++] = hexDigits[id.data[i] >> 4];
+		str[pos++] = hexDigits[id.data[i] & 0x0F];
+	}
+	return str;
 }
 
 RepoUUID& RepoUUID::operator =(const RepoUUID& uuid)
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <cstring>
 #include <boost/uuid/uuid.hpp>
 #include "../../core/model/bson/repo_bson_element.h"
 
@@ -34,6 +35,11 @@ namespace repo{
 
 			RepoUUID(const std::string &stringRep = defaultValue);
 
+			/**
+			* Generate a random (version 4) UUID
+			* This is thread safe, every thread owns its own generator.
+			* @return returns a newly generated UUID
+			*/
 			static RepoUUID createUUID();
 			static RepoUUID fromBSONElement(const repo::core::model::RepoBSONElement &ele);
 
@@ -43,7 +49,24 @@ namespace repo{
 			*/
 			std::vector<uint8_t> data() const { return std::vector<uint8_t>(std::begin(id.data), std::end(id.data));  }
 
-			size_t getHash() const;
+			/**
+			* Get a hash of the UUID. This folds the 128 bits
+			* of the UUID into a size_t, it is not stable
+			* across platforms and should not be persisted.
+			* @return returns the hash value
+			*/
+			size_t getHash() const
+			{
+				uint64_t high, low;
+				memcpy(&high, id.data, sizeof(high));
+				memcpy(&low, id.data + sizeof(high), sizeof(low));
+
+				uint64_t hash = high ^ (low * 0x9E3779B97F4A7C15ULL);
+				hash ^= hash >> 32;
+				hash *= 0xD6E8FEB86659FD93ULL;
+				hash ^= hash >> 32;
+				return (size_t)hash;
+			}
 
 			/**
 			* Converts a RepoUUID to string
@@ -100,7 +123,10 @@ namespace repo{
 
 		struct RepoUUIDHasher
 		{
-			std::size_t operator()(const RepoUUID& uid) const;
+			std::size_t operator()(const RepoUUID& uid) const
+			{
+				return uid.getHash();
+			}
 		};
 	}
 }
@@ -0,0 +1,263 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "repo_vertex_cache.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace repo::lib;
+
+//Scoring constants from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+static const float VCACHE_DECAY_POWER = 1.5f;
+static const float VCACHE_LAST_TRI_SCORE = 0.75f;
+static const float VCACHE_VALENCE_BOOST_SCALE = 2.0f;
+static const float VCACHE_VALENCE_BOOST_POWER = 0.5f;
+//Valences above this all get the same (negligible) boost
+static const uint32_t VCACHE_MAX_VALENCE = 64;
+
+template <typename T>
+static bool indicesInRange(
+	const T        *indices,
+	const size_t   &indexCount,
+	const size_t   &vertexCount)
+{
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		if (indices[i] >= vertexCount)
+			return false;
+	}
+	return true;
+}
+
+template <typename T>
+static bool optimiseTriangleOrder(
+	T              *indices,
+	const size_t   &indexCount,
+	const size_t   &vertexCount,
+	const uint32_t &cacheSize)
+{
+	const size_t triCount = indexCount / 3;
+	if (triCount < 2)
+		return true;
+	if (!indicesInRange(indices, triCount * 3, vertexCount) || cacheSize < 4)
+		return false;
+
+	//Score of a vertex by its position in the cache, and by its number of remaining triangles
+	std::vector<float> cacheScores(cacheSize);
+	for (uint32_t i = 0; i < cacheSize; ++i)
+	{
+		cacheScores[i] = i < 3 ? VCACHE_LAST_TRI_SCORE :
+			std::pow(1.0f - (float)(i - 3) / (cacheSize - 3), VCACHE_DECAY_POWER);
+	}
+	std::vector<float> valenceScores(VCACHE_MAX_VALENCE + 1);
+	valenceScores[0] = 0;
+	for (uint32_t i = 1; i <= VCACHE_MAX_VALENCE; ++i)
+		valenceScores[i] = VCACHE_VALENCE_BOOST_SCALE * std::pow((float)i, -VCACHE_VALENCE_BOOST_POWER);
+
+	//Triangles adjacent to every vertex, packed
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triCount * 3; ++i)
+		++adjacencyOffsets[indices[i] + 1];
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	std::vector<uint32_t> adjacency(triCount * 3);
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < triCount * 3; ++i)
+			adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	//Remaining triangles of every vertex, emitted ones are swapped to the back of its list
+	std::vector<uint32_t> valence(vertexCount);
+	std::vector<int32_t> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	auto scoreVertex = [&](const size_t &v)
+	{
+		if (!valence[v])
+			return -1.0f;
+		const float cacheScore = cachePosition[v] < 0 ? 0 : cacheScores[cachePosition[v]];
+		return cacheScore + valenceScores[std::min(valence[v], VCACHE_MAX_VALENCE)];
+	};
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		valence[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+		vertexScores[v] = scoreVertex(v);
+	}
+
+	auto scoreTriangle = [&](const size_t &t)
+	{
+		return vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	};
+
+	std::vector<T> ordered;
+	ordered.reserve(triCount * 3);
+
+	//The cache holds up to 3 extra entries while a triangle is being added
+	std::vector<uint32_t> cache, newCache;
+	cache.reserve(cacheSize + 3);
+	newCache.reserve(cacheSize + 3);
+
+	int64_t bestTri = -1;
+	float bestScore = -1;
+	for (size_t t = 0; t < triCount; ++t)
+	{
+		const float score = scoreTriangle(t);
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestTri = t;
+		}
+	}
+
+	std::vector<bool> emitted(triCount, false);
+	size_t nextUnemitted = 0;
+	while (bestTri >= 0)
+	{
+		const T *tri = &indices[bestTri * 3];
+		ordered.insert(ordered.end(), tri, tri + 3);
+		emitted[bestTri] = true;
+
+		//Move the triangle's vertices to the front of the cache and retire the triangle
+		newCache.clear();
+		for (size_t i = 0; i < 3; ++i)
+		{
+			const T v = tri[i];
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+				newCache.push_back(v);
+
+			uint32_t *adjBegin = &adjacency[adjacencyOffsets[v]];
+			uint32_t *adjEnd = adjBegin + valence[v];
+			uint32_t *found = std::find(adjBegin, adjEnd, (uint32_t)bestTri);
+			std::swap(*found, *(adjEnd - 1));
+			--valence[v];
+		}
+		for (const auto &v : cache)
+		{
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache.push_back(v);
+		}
+		for (size_t i = cacheSize; i < newCache.size(); ++i)
+		{
+			cachePosition[newCache[i]] = -1;
+			vertexScores[newCache[i]] = scoreVertex(newCache[i]);
+		}
+		if (newCache.size() > cacheSize)
+			newCache.resize(cacheSize);
+		cache.swap(newCache);
+
+		//Rescore the cached vertices, and pick the best triangle among their neighbours
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			cachePosition[cache[i]] = i;
+			vertexScores[cache[i]] = scoreVertex(cache[i]);
+		}
+
+		bestTri = -1;
+		bestScore = -1;
+		for (const auto &v : cache)
+		{
+			for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + valence[v]; ++a)
+			{
+				const uint32_t t = adjacency[a];
+				const float score = scoreTriangle(t);
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTri = t;
+				}
+			}
+		}
+
+		//Nothing left around the cache, restart from the next triangle not yet emitted
+		if (bestTri < 0)
+		{
+			while (nextUnemitted < triCount && emitted[nextUnemitted])
+				++nextUnemitted;
+			if (nextUnemitted < triCount)
+				bestTri = nextUnemitted;
+		}
+	}
+
+	std::copy(ordered.begin(), ordered.end(), indices);
+	return true;
+}
+
+template <typename T>
+static std::vector<uint32_t> optimiseVertexOrder(
+	T              *indices,
+	const size_t   &indexCount,
+	const size_t   &vertexCount)
+{
+	std::vector<uint32_t> newToOld;
+	if (!indicesInRange(indices, indexCount, vertexCount))
+		return newToOld;
+
+	newToOld.reserve(vertexCount);
+	std::vector<int32_t> oldToNew(vertexCount, -1);
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		if (oldToNew[indices[i]] < 0)
+		{
+			oldToNew[indices[i]] = newToOld.size();
+			newToOld.push_back(indices[i]);
+		}
+		indices[i] = oldToNew[indices[i]];
+	}
+
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		if (oldToNew[v] < 0)
+			newToOld.push_back(v);
+	}
+
+	return newToOld;
+}
+
+bool repo::lib::optimiseVertexCache(
+	uint16_t       *indices,
+	const size_t   &indexCount,
+	const size_t   &vertexCount,
+	const uint32_t &cacheSize)
+{
+	return optimiseTriangleOrder(indices, indexCount, vertexCount, cacheSize);
+}
+
+bool repo::lib::optimiseVertexCache(
+	uint32_t       *indices,
+	const size_t   &indexCount,
+	const size_t   &vertexCount,
+	const uint32_t &cacheSize)
+{
+	return optimiseTriangleOrder(indices, indexCount, vertexCount, cacheSize);
+}
+
+std::vector<uint32_t> repo::lib::optimiseVertexFetch(
+	uint16_t       *indices,
+	const size_t   &indexCount,
+	const size_t   &vertexCount)
+{
+	return optimiseVertexOrder(indices, indexCount, vertexCount);
+}
+
+std::vector<uint32_t> repo::lib::optimiseVertexFetch(
+	uint32_t       *indices,
+	const size_t   &indexCount,
+	const size_t   &vertexCount)
+{
+	return optimiseVertexOrder(indices, indexCount, vertexCount);
+}
@@ -0,0 +1,99 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Index buffer ordering for the GPU vertex caches.
+* Triangles are reordered so vertices are reused while they are still in the
+* post-transform cache (Forsyth's linear-speed algorithm), then vertices are
+* renumbered in order of first use so they are fetched sequentially.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../../repo_bouncer_global.h"
+
+namespace repo{
+	namespace lib{
+
+		/**
+		* Reorder the triangles of a triangle list, in place, to make the most
+		* of a post-transform vertex cache. Triangles are kept whole, with
+		* their winding.
+		* @param indices triangle list (3 indices per triangle)
+		* @param indexCount number of indices
+		* @param vertexCount number of vertices referenced (all indices must be below it)
+		* @param cacheSize size of the simulated cache
+		* @return returns false (leaving the indices untouched) if an index is out of range
+		*/
+		REPO_API_EXPORT bool optimiseVertexCache(
+			uint16_t       *indices,
+			const size_t   &indexCount,
+			const size_t   &vertexCount,
+			const uint32_t &cacheSize = 32);
+
+		REPO_API_EXPORT bool optimiseVertexCache(
+			uint32_t       *indices,
+			const size_t   &indexCount,
+			const size_t   &vertexCount,
+			const uint32_t &cacheSize = 32);
+
+		/**
+		* Renumber vertices in the order they are first used by the triangle
+		* list and rewrite the indices accordingly, in place.
+		* Vertices that are not referenced are placed after the others, in
+		* their original order.
+		* @param indices triangle list (3 indices per triangle)
+		* @param indexCount number of indices
+		* @param vertexCount number of vertices (all indices must be below it)
+		* @return returns the original index of every vertex in the new order,
+		*         empty (leaving the indices untouched) if an index is out of range
+		*/
+		REPO_API_EXPORT std::vector<uint32_t> optimiseVertexFetch(
+			uint16_t       *indices,
+			const size_t   &indexCount,
+			const size_t   &vertexCount);
+
+		REPO_API_EXPORT std::vector<uint32_t> optimiseVertexFetch(
+			uint32_t       *indices,
+			const size_t   &indexCount,
+			const size_t   &vertexCount);
+
+		/**
+		* Reorder a range of a vertex attribute buffer following the
+		* remapping returned by optimiseVertexFetch()
+		* @param attributes attribute buffer
+		* @param offset first element of the range
+		* @param newToOld original index (within the range) of every element in the new order
+		*/
+		template <typename T>
+		void remapVertexAttributes(
+			std::vector<T>              &attributes,
+			const size_t                &offset,
+			const std::vector<uint32_t> &newToOld)
+		{
+			if (offset + newToOld.size() > attributes.size())
+				return;
+			std::vector<T> original(attributes.begin() + offset, attributes.begin() + offset + newToOld.size());
+			for (size_t i = 0; i < newToOld.size(); ++i)
+				attributes[offset + i] = original[newToOld[i]];
+		}
+	}
+}
@@ -0,0 +1,144 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "repo_vertex_quantisation.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace repo::lib;
+
+static const float QUANT_MAX_UINT16 = 65535.0f;
+static const float QUANT_MAX_INT8 = 127.0f;
+
+static uint16_t quantiseComponent(
+	const float &value,
+	const float &min,
+	const float &scale)
+{
+	const float quantised = std::floor((value - min) / scale + 0.5f);
+	return (uint16_t)std::max(0.0f, std::min(quantised, QUANT_MAX_UINT16));
+}
+
+static float getScale(
+	const float &extent)
+{
+	return extent > 0 ? extent / QUANT_MAX_UINT16 : 1.0f;
+}
+
+std::vector<uint16_t> repo::lib::quantisePositions(
+	const RepoVector3D *positions,
+	const size_t       &count,
+	const bool         &uniformScale,
+	RepoVector3D       &min,
+	RepoVector3D       &scale)
+{
+	std::vector<uint16_t> quantised;
+	min = RepoVector3D();
+	scale = RepoVector3D(1, 1, 1);
+	if (!count)
+		return quantised;
+
+	min = positions[0];
+	RepoVector3D max = positions[0];
+	for (size_t i = 1; i < count; ++i)
+	{
+		min.x = std::min(min.x, positions[i].x); max.x = std::max(max.x, positions[i].x);
+		min.y = std::min(min.y, positions[i].y); max.y = std::max(max.y, positions[i].y);
+		min.z = std::min(min.z, positions[i].z); max.z = std::max(max.z, positions[i].z);
+	}
+
+	if (uniformScale)
+	{
+		const float extent = std::max(max.x - min.x, std::max(max.y - min.y, max.z - min.z));
+		scale.x = scale.y = scale.z = getScale(extent);
+	}
+	else
+	{
+		scale = { getScale(max.x - min.x), getScale(max.y - min.y), getScale(max.z - min.z) };
+	}
+
+	quantised.resize(count * 4);
+	for (size_t i = 0; i < count; ++i)
+	{
+		quantised[i * 4] = quantiseComponent(positions[i].x, min.x, scale.x);
+		quantised[i * 4 + 1] = quantiseComponent(positions[i].y, min.y, scale.y);
+		quantised[i * 4 + 2] = quantiseComponent(positions[i].z, min.z, scale.z);
+		quantised[i * 4 + 3] = 0;
+	}
+	return quantised;
+}
+
+std::vector<int8_t> repo::lib::quantiseNormals(
+	const RepoVector3D *normals,
+	const size_t       &count)
+{
+	std::vector<int8_t> quantised(count * 4);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const float components[] = { normals[i].x, normals[i].y, normals[i].z };
+		for (size_t j = 0; j < 3; ++j)
+		{
+			const float value = std::max(-1.0f, std::min(components[j], 1.0f));
+			quantised[i * 4 + j] = (int8_t)std::floor(value * QUANT_MAX_INT8 + 0.5f);
+		}
+		quantised[i * 4 + 3] = 0;
+	}
+	return quantised;
+}
+
+std::vector<uint16_t> repo::lib::quantiseUVs(
+	const RepoVector2D *uvs,
+	const size_t       &count,
+	RepoVector2D       &min,
+	RepoVector2D       &scale,
+	const bool         &unitRange)
+{
+	std::vector<uint16_t> quantised;
+	min = RepoVector2D();
+	scale = RepoVector2D(1, 1);
+	if (!count)
+		return quantised;
+
+	min = uvs[0];
+	RepoVector2D max = uvs[0];
+	for (size_t i = 1; i < count; ++i)
+	{
+		min.x = std::min(min.x, uvs[i].x); max.x = std::max(max.x, uvs[i].x);
+		min.y = std::min(min.y, uvs[i].y); max.y = std::max(max.y, uvs[i].y);
+	}
+
+	if (unitRange)
+	{
+		if (min.x < 0 || min.y < 0 || max.x > 1 || max.y > 1)
+			return quantised;
+		min = RepoVector2D();
+		scale = RepoVector2D(1 / QUANT_MAX_UINT16, 1 / QUANT_MAX_UINT16);
+	}
+	else
+	{
+		scale = RepoVector2D(getScale(max.x - min.x), getScale(max.y - min.y));
+	}
+
+	quantised.resize(count * 2);
+	for (size_t i = 0; i < count; ++i)
+	{
+		quantised[i * 2] = quantiseComponent(uvs[i].x, min.x, scale.x);
+		quantised[i * 2 + 1] = quantiseComponent(uvs[i].y, min.y, scale.y);
+	}
+	return quantised;
+}
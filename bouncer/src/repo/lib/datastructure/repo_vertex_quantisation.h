@@ -0,0 +1,87 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Quantisation of vertex attributes for the web exports.
+* Positions and UVs are stored as 16 bit integers relative to their bounding
+* box, a value is decoded as quantised * scale + min (per component).
+* Normals are stored as normalised signed bytes (value / 127).
+* Every element is padded to a multiple of 4 bytes, as glTF requires
+* vertex attributes to be 4 bytes aligned.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "repo_vector.h"
+
+namespace repo{
+	namespace lib{
+
+		/**
+		* Quantise positions to 16 bits per component over their bounding box.
+		* Each position takes 4 components (x, y, z, 0).
+		* An axis with no extent gets a scale of 1 (all its values are 0).
+		* @param positions positions to quantise
+		* @param count number of positions
+		* @param uniformScale use the scale of the largest axis on every axis,
+		*        so the decoding transform does not distort normals
+		* @param min minimum corner of the bounding box (output)
+		* @param scale decoding scale per axis (output)
+		* @return returns the quantised positions, 4 components per position
+		*/
+		REPO_API_EXPORT std::vector<uint16_t> quantisePositions(
+			const RepoVector3D *positions,
+			const size_t       &count,
+			const bool         &uniformScale,
+			RepoVector3D       &min,
+			RepoVector3D       &scale);
+
+		/**
+		* Quantise normals to normalised signed bytes.
+		* Each normal takes 4 components (x, y, z, 0).
+		* @param normals normals to quantise (expected to be unit length)
+		* @param count number of normals
+		* @return returns the quantised normals, 4 components per normal
+		*/
+		REPO_API_EXPORT std::vector<int8_t> quantiseNormals(
+			const RepoVector3D *normals,
+			const size_t       &count);
+
+		/**
+		* Quantise UVs to 16 bits per component.
+		* By default the UVs are quantised over their bounding box. With
+		* unitRange they are quantised over [0, 1], so they can be read as
+		* normalised unsigned shorts, and nothing is returned if a UV falls
+		* outside of that range.
+		* @param uvs uvs to quantise
+		* @param count number of uvs
+		* @param min minimum corner of the bounding box (output)
+		* @param scale decoding scale per axis (output)
+		* @param unitRange quantise over [0, 1] instead of the bounding box
+		* @return returns the quantised UVs, 2 components per UV
+		*/
+		REPO_API_EXPORT std::vector<uint16_t> quantiseUVs(
+			const RepoVector2D *uvs,
+			const size_t       &count,
+			RepoVector2D       &min,
+			RepoVector2D       &scale,
+			const bool         &unitRange = false);
+	}
+}
@@ -0,0 +1,280 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "repo_json_writer.h"
+
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "repo_log.h"
+
+using namespace repo::lib;
+
+JSONWriter::JSONWriter()
+	: pendingKey(false)
+{
+}
+
+JSONWriter::~JSONWriter()
+{
+}
+
+void JSONWriter::startObject()
+{
+	if (beginValue())
+	{
+		json += '{';
+		scopes.push_back({ true, true });
+	}
+}
+
+void JSONWriter::startObject(const std::string &label)
+{
+	addKey(label);
+	startObject();
+}
+
+void JSONWriter::endObject()
+{
+	endScope(true);
+}
+
+void JSONWriter::startArray()
+{
+	if (beginValue())
+	{
+		json += '[';
+		scopes.push_back({ false, true });
+	}
+}
+
+void JSONWriter::startArray(const std::string &label)
+{
+	addKey(label);
+	startArray();
+}
+
+void JSONWriter::endArray()
+{
+	endScope(false);
+}
+
+void JSONWriter::addKey(const std::string &label)
+{
+	if (scopes.empty() || !scopes.back().isObject || pendingKey)
+	{
+		repoError << "JSONWriter: unexpected member name " << label << ", it is not within an object or the previous member has no value.";
+		return;
+	}
+
+	if (!scopes.back().isEmpty)
+		json += ',';
+	scopes.back().isEmpty = false;
+
+	json += '"';
+	json += escape(label);
+	json += "\":";
+	pendingKey = true;
+}
+
+void JSONWriter::addValue(const std::string &value)
+{
+	if (beginValue())
+	{
+		json += '"';
+		json += escape(value);
+		json += '"';
+	}
+}
+
+void JSONWriter::addValue(const char *value)
+{
+	if (value)
+		addValue(std::string(value));
+	else
+		addNull();
+}
+
+void JSONWriter::addValue(const bool &value)
+{
+	if (beginValue())
+		json += value ? "true" : "false";
+}
+
+void JSONWriter::addValue(const float &value)
+{
+	if (beginValue())
+		json += formatNumber(value);
+}
+
+void JSONWriter::addValue(const double &value)
+{
+	if (beginValue())
+		json += formatNumber(value);
+}
+
+void JSONWriter::addNull()
+{
+	if (beginValue())
+		json += "null";
+}
+
+void JSONWriter::addRaw(const std::string &value)
+{
+	if (beginValue())
+		json += value.empty() ? "null" : value;
+}
+
+bool JSONWriter::beginValue()
+{
+	if (scopes.empty())
+	{
+		if (!json.empty())
+		{
+			repoError << "JSONWriter: the document already has a root value.";
+			return false;
+		}
+		return true;
+	}
+
+	if (scopes.back().isObject)
+	{
+		if (!pendingKey)
+		{
+			repoError << "JSONWriter: values within an object require a member name.";
+			return false;
+		}
+		pendingKey = false;
+	}
+	else
+	{
+		if (!scopes.back().isEmpty)
+			json += ',';
+		scopes.back().isEmpty = false;
+	}
+
+	return true;
+}
+
+void JSONWriter::endScope(const bool &isObject)
+{
+	if (scopes.empty() || scopes.back().isObject != isObject || pendingKey)
+	{
+		repoError << "JSONWriter: unexpected end of " << (isObject ? "object" : "array") << ".";
+		return;
+	}
+
+	json += isObject ? '}' : ']';
+	scopes.pop_back();
+}
+
+std::string JSONWriter::escape(const std::string &value)
+{
+	std::string escaped;
+	escaped.reserve(value.size());
+	for (const char &c : value)
+	{
+		switch (c)
+		{
+		case '"':
+			escaped += "\\\"";
+			break;
+		case '\\':
+			escaped += "\\\\";
+			break;
+		case '\b':
+			escaped += "\\b";
+			break;
+		case '\f':
+			escaped += "\\f";
+			break;
+		case '\n':
+			escaped += "\\n";
+			break;
+		case '\r':
+			escaped += "\\r";
+			break;
+		case '\t':
+			escaped += "\\t";
+			break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char code[7];
+				snprintf(code, sizeof(code), "\\u%04x", (unsigned int)(unsigned char)c);
+				escaped += code;
+			}
+			else
+			{
+				escaped += c;
+			}
+		}
+	}
+	return escaped;
+}
+
+/**
+* snprintf and strtod follow the numeric locale of the process, whose decimal
+* point may not be '.'. Numbers are formatted and read back in that locale,
+* then written with a '.' as JSON requires
+* @param number number formatted by snprintf
+* @return returns the number as JSON
+*/
+static std::string toJSONNumber(const char *number)
+{
+	std::string json(number);
+	const char *point = localeconv()->decimal_point;
+	if (point && *point && std::strcmp(point, "."))
+	{
+		const size_t pos = json.find(point);
+		if (pos != std::string::npos)
+			json.replace(pos, std::strlen(point), ".");
+	}
+	return json;
+}
+
+std::string JSONWriter::formatNumber(const float &value)
+{
+	if (!std::isfinite(value))
+		return "null";
+
+	//Most values are exact within 6 or 7 digits, 9 always reads back as the same float
+	char buffer[32];
+	for (int precision = 6; precision < 9; ++precision)
+	{
+		snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+		if (strtof(buffer, nullptr) == value)
+			return toJSONNumber(buffer);
+	}
+	snprintf(buffer, sizeof(buffer), "%.9g", value);
+	return toJSONNumber(buffer);
+}
+
+std::string JSONWriter::formatNumber(const double &value)
+{
+	if (!std::isfinite(value))
+		return "null";
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.15g", value);
+	if (strtod(buffer, nullptr) != value)
+		snprintf(buffer, sizeof(buffer), "%.17g", value);
+	return toJSONNumber(buffer);
+}
@@ -0,0 +1,215 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* A forward only JSON writer. Unlike PropertyTree, nothing is kept in memory
+* apart from the JSON text itself: values are written as they are given,
+* numbers and booleans keep their type and commas are inserted automatically.
+* Objects and arrays have to be written in document order, so producers that
+* fill several parts of a document at once should keep one writer per part
+* and stitch them together with addRaw().
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../repo_bouncer_global.h"
+
+namespace repo{
+	namespace lib{
+		class REPO_API_EXPORT JSONWriter
+		{
+		public:
+			JSONWriter();
+			~JSONWriter();
+
+			/**
+			* Open an object, as a value or an array element
+			*/
+			void startObject();
+
+			/**
+			* Open an object as the member of the current object
+			* @param label member name
+			*/
+			void startObject(const std::string &label);
+
+			/**
+			* Close the current object
+			*/
+			void endObject();
+
+			/**
+			* Open an array, as a value or an array element
+			*/
+			void startArray();
+
+			/**
+			* Open an array as the member of the current object
+			* @param label member name
+			*/
+			void startArray(const std::string &label);
+
+			/**
+			* Close the current array
+			*/
+			void endArray();
+
+			/**
+			* Write the name of the next member of the current object
+			* It has to be followed by a value, an object or an array
+			* @param label member name
+			*/
+			void addKey(const std::string &label);
+
+			/**
+			* Write a value (or an array element)
+			* Non finite floating point numbers are written as null
+			* @param value value to write
+			*/
+			void addValue(const std::string &value);
+			void addValue(const char *value);
+			void addValue(const bool &value);
+			void addValue(const float &value);
+			void addValue(const double &value);
+
+			template <typename T>
+			typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type
+				addValue(const T &value)
+			{
+				if (beginValue())
+					json += std::to_string(value);
+			}
+
+			/**
+			* Write an array of values
+			* @param values values to write
+			*/
+			template <typename T>
+			void addValue(const std::vector<T> &values)
+			{
+				startArray();
+				for (const auto &value : values)
+					addValue(value);
+				endArray();
+			}
+
+			/**
+			* Write null
+			*/
+			void addNull();
+
+			/**
+			* Write a member (name and value) into the current object
+			* @param label member name
+			* @param value value of the member
+			*/
+			template <typename T>
+			void addMember(
+				const std::string &label,
+				const T           &value)
+			{
+				addKey(label);
+				addValue(value);
+			}
+
+			/**
+			* Insert an already serialised JSON value (e.g. the content of another writer)
+			* @param json JSON text to insert, written as is
+			*/
+			void addRaw(const std::string &json);
+
+			/**
+			* Check if every object and array opened has been closed
+			* @return returns true if the writer holds a complete document
+			*/
+			bool isComplete() const
+			{
+				return scopes.empty() && !json.empty();
+			}
+
+			/**
+			* Check if nothing has been written yet
+			* @return returns true if the writer is empty
+			*/
+			bool isEmpty() const
+			{
+				return json.empty();
+			}
+
+			/**
+			* Get the JSON text written so far
+			* @return returns the JSON text
+			*/
+			const std::string& getString() const
+			{
+				return json;
+			}
+
+			/**
+			* Get the JSON text written so far as raw bytes
+			* @return returns the JSON text as a buffer
+			*/
+			std::vector<uint8_t> getBuffer() const
+			{
+				return std::vector<uint8_t>(json.begin(), json.end());
+			}
+
+			/**
+			* Escape a string so it can be written between quotes
+			* @param value string to escape
+			* @return returns the escaped string (without the quotes)
+			*/
+			static std::string escape(const std::string &value);
+
+			/**
+			* Format a number as the shortest text that reads back as the same value
+			* @param value number to format
+			* @return returns the formatted number, "null" if it is not finite
+			*/
+			static std::string formatNumber(const float &value);
+			static std::string formatNumber(const double &value);
+
+		private:
+			struct Scope
+			{
+				bool isObject;
+				bool isEmpty;
+			};
+
+			std::string json;
+			std::vector<Scope> scopes;
+			bool pendingKey;
+
+			/**
+			* Write the separator due before a value and check the value is legal here
+			* @return returns true if the value can be written
+			*/
+			bool beginValue();
+
+			/**
+			* Close the current scope if it is of the given type
+			* @param isObject true if an object is expected, false for an array
+			*/
+			void endScope(const bool &isObject);
+		};
+	}
+}
@@ -0,0 +1,66 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "repo_parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/thread.hpp>
+
+#include "../repo_bouncer_global.h"
+
+//Set on the threads running a parallelFor(), nested calls run on the calling thread
+//(zero initialised, MSVC 2013 only supports thread local PODs)
+static REPO_THREAD_LOCAL bool inParallelFor;
+
+uint32_t repo::lib::getDefaultThreadCount()
+{
+	//hardware_concurrency() returns 0 if it cannot be determined
+	return std::max(1u, boost::thread::hardware_concurrency());
+}
+
+void repo::lib::parallelFor(
+	const size_t                              &count,
+	const std::function<void(const size_t &)> &func,
+	const uint32_t                            &nThreads)
+{
+	const size_t nWorkers = inParallelFor ? 1 : std::min((size_t)std::max(1u, nThreads), count);
+	if (nWorkers <= 1)
+	{
+		for (size_t i = 0; i < count; ++i)
+			func(i);
+		return;
+	}
+
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		inParallelFor = true;
+		size_t i;
+		while ((i = next.fetch_add(1)) < count)
+			func(i);
+		inParallelFor = false;
+	};
+
+	//The calling thread is one of the workers
+	boost::thread_group threads;
+	for (size_t i = 1; i < nWorkers; ++i)
+		threads.create_thread(worker);
+
+	worker();
+	threads.join_all();
+}
@@ -0,0 +1,56 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Helpers to spread independent pieces of work across worker threads
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "../repo_bouncer_global.h"
+
+namespace repo{
+	namespace lib{
+
+		/**
+		* Get the number of worker threads to use by default
+		* @return returns the number of hardware threads (at least 1)
+		*/
+		REPO_API_EXPORT uint32_t getDefaultThreadCount();
+
+		/**
+		* Call func(i) for every i within [0, count), spread across nThreads threads.
+		* Indices are handed out one at a time, so the order in which they are
+		* processed is not defined. Returns once all of them are processed.
+		* If nThreads is 1 (or count is 1), everything runs on the calling thread.
+		* Calls made from within func (nested loops) also run on the calling
+		* thread, so the outer loop owns the workers.
+		* func must not throw.
+		* @param count number of work items
+		* @param func function to call on each index
+		* @param nThreads maximum number of threads to use
+		*/
+		REPO_API_EXPORT void parallelFor(
+			const size_t                              &count,
+			const std::function<void(const size_t &)> &func,
+			const uint32_t                            &nThreads = getDefaultThreadCount());
+	}
+}
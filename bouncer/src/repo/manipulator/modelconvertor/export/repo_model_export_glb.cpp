@@ -0,0 +1,1038 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Allows Export functionality from 3D Repo World to binary glTF 2.0 (GLB)
+*/
+
+#include "repo_model_export_glb.h"
+#include "repo_model_export_gltf.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../../../core/model/bson/repo_bson_factory.h"
+#include "../../../lib/repo_log.h"
+#include "../../../lib/datastructure/repo_vertex_quantisation.h"
+#include "../../modelutility/repo_mesh_map_reorganiser.h"
+#include "../../modelutility/spatialpartitioning/repo_spatial_partitioner_rdtree.h"
+
+using namespace repo::manipulator::modelconvertor;
+
+const static size_t GLB_MAX_VERTEX_LIMIT = 65535;
+
+static const uint32_t GLB_MAGIC = 0x46546C67; //"glTF"
+static const uint32_t GLB_VERSION = 2;
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A; //"JSON"
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942; //"BIN\0"
+static const size_t   GLB_ALIGNMENT = 4;
+
+static const std::string GLTF_LABEL_ACCESSORS = "accessors";
+static const std::string GLTF_LABEL_ALPHA_MODE = "alphaMode";
+static const std::string GLTF_LABEL_ASP_RATIO = "aspectRatio";
+static const std::string GLTF_LABEL_ASSET = "asset";
+static const std::string GLTF_LABEL_ATTRIBUTES = "attributes";
+static const std::string GLTF_LABEL_BASE_COLOR = "baseColorFactor";
+static const std::string GLTF_LABEL_BASE_COLOR_TEX = "baseColorTexture";
+static const std::string GLTF_LABEL_BUFFER = "buffer";
+static const std::string GLTF_LABEL_BUFFERS = "buffers";
+static const std::string GLTF_LABEL_BUFFER_VIEW = "bufferView";
+static const std::string GLTF_LABEL_BUFFER_VIEWS = "bufferViews";
+static const std::string GLTF_LABEL_BYTE_LENGTH = "byteLength";
+static const std::string GLTF_LABEL_BYTE_OFFSET = "byteOffset";
+static const std::string GLTF_LABEL_BYTE_STRIDE = "byteStride";
+static const std::string GLTF_LABEL_CAMERA = "camera";
+static const std::string GLTF_LABEL_CAMERAS = "cameras";
+static const std::string GLTF_LABEL_CHILDREN = "children";
+static const std::string GLTF_LABEL_COMP_TYPE = "componentType";
+static const std::string GLTF_LABEL_COUNT = "count";
+static const std::string GLTF_LABEL_DOUBLE_SIDED = "doubleSided";
+static const std::string GLTF_LABEL_EMISSIVE = "emissiveFactor";
+static const std::string GLTF_LABEL_EXTRA = "extras";
+static const std::string GLTF_LABEL_EXTENSIONS_REQUIRED = "extensionsRequired";
+static const std::string GLTF_LABEL_EXTENSIONS_USED = "extensionsUsed";
+static const std::string GLTF_LABEL_FAR_CP = "zfar";
+static const std::string GLTF_LABEL_FILTER_MAG = "magFilter";
+static const std::string GLTF_LABEL_FILTER_MIN = "minFilter";
+static const std::string GLTF_LABEL_FOV = "yfov";
+static const std::string GLTF_LABEL_GENERATOR = "generator";
+static const std::string GLTF_LABEL_IMAGES = "images";
+static const std::string GLTF_LABEL_INDEX = "index";
+static const std::string GLTF_LABEL_INDICES = "indices";
+static const std::string GLTF_LABEL_MATERIAL = "material";
+static const std::string GLTF_LABEL_MATERIALS = "materials";
+static const std::string GLTF_LABEL_MATRIX = "matrix";
+static const std::string GLTF_LABEL_MAX = "max";
+static const std::string GLTF_LABEL_MESH = "mesh";
+static const std::string GLTF_LABEL_MESHES = "meshes";
+static const std::string GLTF_LABEL_METALLIC = "metallicFactor";
+static const std::string GLTF_LABEL_MIME_TYPE = "mimeType";
+static const std::string GLTF_LABEL_MIN = "min";
+static const std::string GLTF_LABEL_NAME = "name";
+static const std::string GLTF_LABEL_NEAR_CP = "znear";
+static const std::string GLTF_LABEL_NODES = "nodes";
+static const std::string GLTF_LABEL_NORMAL = "NORMAL";
+static const std::string GLTF_LABEL_NORMALIZED = "normalized";
+static const std::string GLTF_LABEL_PBR = "pbrMetallicRoughness";
+static const std::string GLTF_LABEL_POSITION = "POSITION";
+static const std::string GLTF_LABEL_PRIMITIVE = "mode";
+static const std::string GLTF_LABEL_PRIMITIVES = "primitives";
+static const std::string GLTF_LABEL_ROUGHNESS = "roughnessFactor";
+static const std::string GLTF_LABEL_SAMPLER = "sampler";
+static const std::string GLTF_LABEL_SAMPLERS = "samplers";
+static const std::string GLTF_LABEL_SCENE = "scene";
+static const std::string GLTF_LABEL_SCENES = "scenes";
+static const std::string GLTF_LABEL_SOURCE = "source";
+static const std::string GLTF_LABEL_TARGET = "target";
+static const std::string GLTF_LABEL_TEXCOORD = "TEXCOORD";
+static const std::string GLTF_LABEL_TEXTURES = "textures";
+static const std::string GLTF_LABEL_TYPE = "type";
+static const std::string GLTF_LABEL_URI = "uri";
+static const std::string GLTF_LABEL_VERSION = "version";
+static const std::string GLTF_LABEL_WRAP_S = "wrapS";
+static const std::string GLTF_LABEL_WRAP_T = "wrapT";
+
+static const uint32_t GLTF_PRIM_TYPE_TRIANGLE = 4;
+static const uint32_t GLTF_PRIM_TYPE_ARRAY_BUFFER = 34962;
+static const uint32_t GLTF_PRIM_TYPE_ELEMENT_ARRAY_BUFFER = 34963;
+
+static const uint32_t GLTF_COMP_TYPE_BYTE = 5120;
+static const uint32_t GLTF_COMP_TYPE_USHORT = 5123;
+static const uint32_t GLTF_COMP_TYPE_UINT = 5125;
+static const uint32_t GLTF_COMP_TYPE_FLOAT = 5126;
+
+static const uint32_t GLTF_FILTER_TYPE_LINEAR = 9729;
+static const uint32_t GLTF_FILTER_TYPE_NEAREST_MIPMAP_LINEAR = 9987;
+static const uint32_t GLTF_WRAP_MODE_REPEAT = 10497;
+
+static const std::string GLTF_ALPHA_MODE_BLEND = "BLEND";
+static const std::string GLTF_CAM_TYPE_PERSPECTIVE = "perspective";
+static const std::string GLTF_MIME_JPEG = "image/jpeg";
+static const std::string GLTF_MIME_PNG = "image/png";
+static const std::string GLTF_TYPE_SCALAR = "SCALAR";
+static const std::string GLTF_TYPE_VEC2 = "VEC2";
+static const std::string GLTF_TYPE_VEC3 = "VEC3";
+
+static const std::string GLTF_VERSION = "2.0";
+
+static const std::string GLTF_EXT_MESH_QUANTIZATION = "KHR_mesh_quantization";
+
+//Quantised attributes are padded to 4 bytes per vertex
+static const size_t GLB_QUANT_POSITION_STRIDE = 4 * sizeof(uint16_t);
+static const size_t GLB_QUANT_NORMAL_STRIDE = 4 * sizeof(int8_t);
+static const size_t GLB_QUANT_UV_STRIDE = 2 * sizeof(uint16_t);
+
+//Custom attributes must start with an underscore in glTF 2.0
+static const std::string REPO_GLTF_LABEL_IDMAP = "_IDMAP";
+static const std::string REPO_GLTF_LABEL_REF_ID = "refID";
+static const std::string REPO_GLTF_LABEL_LOD = "lodRef";
+static const std::string REPO_LABEL_PHONG = "phong";
+
+static void appendUInt32(
+	std::vector<uint8_t> &buffer,
+	const uint32_t       &value)
+{
+	//GLB is little endian, so are all the platforms we build on
+	const uint8_t *raw = (const uint8_t*)&value;
+	buffer.insert(buffer.end(), raw, raw + sizeof(value));
+}
+
+static size_t alignSize(const size_t &size)
+{
+	return (size + GLB_ALIGNMENT - 1) / GLB_ALIGNMENT * GLB_ALIGNMENT;
+}
+
+GLBModelExport::GLBModelExport(
+	const repo::core::model::RepoScene *scene,
+	const WebExportOptions             &options,
+	WebExportSink                      *sink
+	) : WebModelExport(scene, options, sink)
+{
+	if (convertSuccess)
+	{
+		//We only need a GLB representation if there are meshes or cameras
+		if (scene->getAllMeshes(gType).size() || scene->getAllCameras(gType).size())
+			convertSuccess = generateContainer();
+	}
+	else
+	{
+		repoError << "Failed to export to GLB: null pointer to scene!";
+	}
+}
+
+GLBModelExport::~GLBModelExport()
+{
+}
+
+uint32_t GLBModelExport::addAccessor(
+	const uint32_t                 &bufferView,
+	const size_t                   &offset,
+	const uint32_t                 &componentType,
+	const size_t                   &count,
+	const std::string              &type,
+	const std::string              &refId,
+	const std::vector<float>       &min,
+	const std::vector<float>       &max,
+	const std::vector<uint32_t>    &lod,
+	const bool                     &normalized)
+{
+	const uint32_t index = startArrayObject(accessors);
+	repo::lib::JSONWriter &accessor = accessors.writer;
+	accessor.addMember(GLTF_LABEL_BUFFER_VIEW, bufferView);
+	accessor.addMember(GLTF_LABEL_BYTE_OFFSET, offset);
+	accessor.addMember(GLTF_LABEL_COMP_TYPE, componentType);
+	if (normalized)
+		accessor.addMember(GLTF_LABEL_NORMALIZED, true);
+	accessor.addMember(GLTF_LABEL_COUNT, count);
+	accessor.addMember(GLTF_LABEL_TYPE, type);
+	if (min.size())
+		accessor.addMember(GLTF_LABEL_MIN, min);
+	if (max.size())
+		accessor.addMember(GLTF_LABEL_MAX, max);
+
+	if (!refId.empty() || lod.size())
+	{
+		accessor.startObject(GLTF_LABEL_EXTRA);
+		if (!refId.empty())
+			accessor.addMember(REPO_GLTF_LABEL_REF_ID, refId);
+		if (lod.size())
+			accessor.addMember(REPO_GLTF_LABEL_LOD, lod);
+		accessor.endObject();
+	}
+
+	accessor.endObject();
+	return index;
+}
+
+uint32_t GLBModelExport::addBufferView(
+	const uint8_t                  *data,
+	const size_t                   &byteLength,
+	const uint32_t                 &target,
+	const size_t                   &byteStride)
+{
+	//Every view starts on a 4 bytes boundary so any component type can be read in place
+	const size_t offset = alignSize(binBuffer.size());
+	binBuffer.resize(offset + byteLength);
+	if (byteLength)
+		memcpy(&binBuffer[offset], data, byteLength);
+
+	const uint32_t index = startArrayObject(bufferViews);
+	repo::lib::JSONWriter &bufferView = bufferViews.writer;
+	bufferView.addMember(GLTF_LABEL_BUFFER, 0);
+	bufferView.addMember(GLTF_LABEL_BYTE_OFFSET, offset);
+	bufferView.addMember(GLTF_LABEL_BYTE_LENGTH, byteLength);
+	if (byteStride)
+		bufferView.addMember(GLTF_LABEL_BYTE_STRIDE, byteStride);
+	if (target)
+		bufferView.addMember(GLTF_LABEL_TARGET, target);
+	bufferView.endObject();
+
+	return index;
+}
+
+template <typename T>
+void GLBModelExport::addMeshSplits(
+	const repo::core::model::MeshNode                       *node,
+	const std::vector<repo::lib::RepoVector3D>              &vertices,
+	const std::vector<repo::lib::RepoVector3D>              &normals,
+	const std::vector<std::vector<repo::lib::RepoVector2D>> &UVs,
+	const std::vector<T>                                    &faces,
+	const std::vector<std::vector<float>>                   &idMapBuf,
+	const std::vector<std::vector<repo_mesh_mapping_t>>     &matMap,
+	const std::vector<repo_mesh_mapping_t>                  &splits,
+	const std::vector<std::vector<std::vector<uint32_t>>>   &lods)
+{
+	const std::string meshUUID = node->getUniqueID().toString();
+	const uint32_t indexComponentType = sizeof(T) == sizeof(uint32_t) ? GLTF_COMP_TYPE_UINT : GLTF_COMP_TYPE_USHORT;
+
+	for (size_t i = 0; i < splits.size(); ++i)
+	{
+		const size_t vStart = splits[i].vertFrom;
+		const size_t vCount = splits[i].vertTo - splits[i].vertFrom;
+		const size_t fStart = splits[i].triFrom;
+		const size_t fCount = splits[i].triTo - splits[i].triFrom;
+
+		if (!vCount || !fCount)
+			continue;
+
+		if (idMapBuf.size() > i && idMapBuf[i].size() != vCount)
+		{
+			repoError << "Mismatched nvertices (" << vCount << ") != idmapbuf ( " << idMapBuf[i].size() << "). Skipping...";
+			continue;
+		}
+
+		//One view per attribute per split, shared by all the sub meshes' accessors
+		std::vector<uint16_t> qVertices;
+		std::vector<float> decodeMatrix;
+		uint32_t posView;
+		int64_t normView = -1;
+		if (options.quantiseAttributes)
+		{
+			//A uniform scale keeps the decoding matrix from distorting the normals
+			repo::lib::RepoVector3D qMin, qScale;
+			qVertices = repo::lib::quantisePositions(&vertices[vStart], vCount, true, qMin, qScale);
+			decodeMatrix = {
+				qScale.x, 0, 0, 0,
+				0, qScale.y, 0, 0,
+				0, 0, qScale.z, 0,
+				qMin.x, qMin.y, qMin.z, 1 };
+			posView = addBufferView((const uint8_t*)qVertices.data(), vCount * GLB_QUANT_POSITION_STRIDE,
+				GLTF_PRIM_TYPE_ARRAY_BUFFER, GLB_QUANT_POSITION_STRIDE);
+			if (normals.size())
+			{
+				auto qNormals = repo::lib::quantiseNormals(&normals[vStart], vCount);
+				normView = addBufferView((const uint8_t*)qNormals.data(), vCount * GLB_QUANT_NORMAL_STRIDE,
+					GLTF_PRIM_TYPE_ARRAY_BUFFER, GLB_QUANT_NORMAL_STRIDE);
+			}
+		}
+		else
+		{
+			posView = addBufferView(&vertices[vStart], vCount, GLTF_PRIM_TYPE_ARRAY_BUFFER, true);
+			if (normals.size())
+				normView = addBufferView(&normals[vStart], vCount, GLTF_PRIM_TYPE_ARRAY_BUFFER, true);
+		}
+		const uint32_t faceView = addBufferView(&faces[fStart * 3], fCount * 3, GLTF_PRIM_TYPE_ELEMENT_ARRAY_BUFFER, false);
+		const int64_t idMapView = idMapBuf.size() > i ? (int64_t)addBufferView(idMapBuf[i].data(), vCount, GLTF_PRIM_TYPE_ARRAY_BUFFER, true) : -1;
+		std::vector<uint32_t> uvViews;
+		std::vector<bool> quantisedUVs;
+		for (const auto &channel : UVs)
+		{
+			//Normalised UVs have to lie within [0, 1], tiled textures stay as floats
+			std::vector<uint16_t> qUVs;
+			if (options.quantiseAttributes)
+			{
+				repo::lib::RepoVector2D uvMin, uvScale;
+				qUVs = repo::lib::quantiseUVs(&channel[vStart], vCount, uvMin, uvScale, true);
+			}
+
+			if (qUVs.size())
+			{
+				uvViews.push_back(addBufferView((const uint8_t*)qUVs.data(), vCount * GLB_QUANT_UV_STRIDE,
+					GLTF_PRIM_TYPE_ARRAY_BUFFER, GLB_QUANT_UV_STRIDE));
+			}
+			else
+			{
+				uvViews.push_back(addBufferView(&channel[vStart], vCount, GLTF_PRIM_TYPE_ARRAY_BUFFER, true));
+			}
+			quantisedUVs.push_back(!qUVs.empty());
+		}
+
+		meshIndices[node->getUniqueID()].push_back(startArrayObject(meshes));
+		meshDecodeMatrices.push_back(decodeMatrix);
+		repo::lib::JSONWriter &meshTree = meshes.writer;
+		meshTree.addMember(GLTF_LABEL_NAME, splits.size() > 1 ? meshUUID + "_" + std::to_string(i) : meshUUID);
+
+		meshTree.startArray(GLTF_LABEL_PRIMITIVES);
+		for (size_t j = 0; j < matMap[i].size(); ++j)
+		{
+			addPrimitive(meshTree, matMap[i][j], vertices, vStart, fStart, posView, normView,
+				faceView, indexComponentType, idMapView, uvViews,
+				lods[i][j], qVertices, quantisedUVs);
+		}
+		meshTree.endArray();
+
+		meshTree.startObject(GLTF_LABEL_EXTRA);
+		meshTree.addMember(REPO_GLTF_LABEL_REF_ID, meshUUID);
+		meshTree.endObject();
+		meshTree.endObject();
+	}
+}
+
+uint32_t GLBModelExport::addNode(
+	const repo::core::model::RepoNode *node)
+{
+	std::vector<uint32_t> children;
+
+	for (const auto &child : scene->getChildrenAsNodes(gType, node->getSharedID()))
+	{
+		switch (child->getTypeAsEnum())
+		{
+		case repo::core::model::NodeType::TRANSFORMATION:
+			children.push_back(addNode(child));
+			break;
+		case repo::core::model::NodeType::MESH:
+		{
+			//A glTF 2.0 node holds a single mesh, so every split gets its own node
+			auto meshIt = meshIndices.find(child->getUniqueID());
+			if (meshIt != meshIndices.end())
+			{
+				for (const auto &meshIdx : meshIt->second)
+				{
+					children.push_back(startArrayObject(nodes));
+					nodes.writer.addMember(GLTF_LABEL_MESH, meshIdx);
+					//Quantised positions are brought back into model space by the node
+					if (meshDecodeMatrices[meshIdx].size())
+						nodes.writer.addMember(GLTF_LABEL_MATRIX, meshDecodeMatrices[meshIdx]);
+					nodes.writer.endObject();
+				}
+			}
+		}
+		break;
+		case repo::core::model::NodeType::CAMERA:
+		{
+			auto camIt = cameraIndices.find(child->getUniqueID());
+			if (camIt != cameraIndices.end())
+			{
+				children.push_back(startArrayObject(nodes));
+				nodes.writer.addMember(GLTF_LABEL_CAMERA, camIt->second);
+				nodes.writer.endObject();
+			}
+		}
+		break;
+		}
+	}
+
+	//The node is only written once its sub graph is, as children have to be indexed first
+	const uint32_t index = startArrayObject(nodes);
+	repo::lib::JSONWriter &nodeTree = nodes.writer;
+	std::string name = node->getName();
+	if (!name.empty())
+		nodeTree.addMember(GLTF_LABEL_NAME, name);
+	nodeTree.startObject(GLTF_LABEL_EXTRA);
+	nodeTree.addMember(REPO_GLTF_LABEL_REF_ID, node->getUniqueID().toString());
+	nodeTree.endObject();
+
+	if (node->getTypeAsEnum() == repo::core::model::NodeType::TRANSFORMATION)
+	{
+		const repo::core::model::TransformationNode *transNode = (const repo::core::model::TransformationNode*) node;
+		if (!transNode->isIdentity())
+		{
+			nodeTree.addMember(GLTF_LABEL_MATRIX, transNode->getTransMatrix(false).getData());
+		}
+	}
+
+	if (children.size())
+		nodeTree.addMember(GLTF_LABEL_CHILDREN, children);
+	nodeTree.endObject();
+
+	return index;
+}
+
+void GLBModelExport::addPrimitive(
+	repo::lib::JSONWriter                      &primitives,
+	const repo_mesh_mapping_t                  &mapping,
+	const std::vector<repo::lib::RepoVector3D> &vertices,
+	const size_t                               &vertStart,
+	const size_t                               &triStart,
+	const uint32_t                             &posView,
+	const int64_t                              &normView,
+	const uint32_t                             &faceView,
+	const uint32_t                             &indexComponentType,
+	const int64_t                              &idMapView,
+	const std::vector<uint32_t>                &uvViews,
+	const std::vector<uint32_t>                &lod,
+	const std::vector<uint16_t>                &quantisedVertices,
+	const std::vector<bool>                    &quantisedUVs)
+{
+	const std::string subMeshID = mapping.mesh_id.toString();
+	const size_t vCount = mapping.vertTo - mapping.vertFrom;
+	const size_t vOffset = mapping.vertFrom - vertStart;
+	const bool quantised = !quantisedVertices.empty();
+
+	primitives.startObject();
+	auto matIt = materialIndices.find(mapping.material_id);
+	if (matIt != materialIndices.end())
+		primitives.addMember(GLTF_LABEL_MATERIAL, matIt->second);
+	primitives.addMember(GLTF_LABEL_PRIMITIVE, GLTF_PRIM_TYPE_TRIANGLE);
+
+	const size_t indexSize = indexComponentType == GLTF_COMP_TYPE_UINT ? sizeof(uint32_t) : sizeof(uint16_t);
+	primitives.addMember(GLTF_LABEL_INDICES, addAccessor(faceView,
+		(mapping.triFrom - triStart) * 3 * indexSize, indexComponentType,
+		(mapping.triTo - mapping.triFrom) * 3, GLTF_TYPE_SCALAR, subMeshID,
+		std::vector<float>(), std::vector<float>(), lod));
+
+	//POSITION is the only attribute glTF 2.0 requires bounds for
+	std::vector<float> min, max;
+	if (vCount && quantised)
+	{
+		//Bounds are in the quantised space of the accessor
+		min = { 65535, 65535, 65535 };
+		max = { 0, 0, 0 };
+		for (size_t i = vOffset * 4; i < (vOffset + vCount) * 4; i += 4)
+		{
+			for (size_t j = 0; j < 3; ++j)
+			{
+				min[j] = std::min(min[j], (float)quantisedVertices[i + j]);
+				max[j] = std::max(max[j], (float)quantisedVertices[i + j]);
+			}
+		}
+	}
+	else if (vCount)
+	{
+		const repo::lib::RepoVector3D &first = vertices[mapping.vertFrom];
+		min = { first.x, first.y, first.z };
+		max = min;
+		for (int32_t i = mapping.vertFrom + 1; i < mapping.vertTo; ++i)
+		{
+			const repo::lib::RepoVector3D &v = vertices[i];
+			min[0] = std::min(min[0], v.x); max[0] = std::max(max[0], v.x);
+			min[1] = std::min(min[1], v.y); max[1] = std::max(max[1], v.y);
+			min[2] = std::min(min[2], v.z); max[2] = std::max(max[2], v.z);
+		}
+	}
+
+	primitives.startObject(GLTF_LABEL_ATTRIBUTES);
+	if (quantised)
+	{
+		primitives.addMember(GLTF_LABEL_POSITION, addAccessor(posView,
+			vOffset * GLB_QUANT_POSITION_STRIDE, GLTF_COMP_TYPE_USHORT, vCount, GLTF_TYPE_VEC3, subMeshID, min, max));
+	}
+	else
+	{
+		primitives.addMember(GLTF_LABEL_POSITION, addAccessor(posView,
+			vOffset * sizeof(repo::lib::RepoVector3D), GLTF_COMP_TYPE_FLOAT, vCount, GLTF_TYPE_VEC3, subMeshID, min, max));
+	}
+
+	if (normView >= 0 && quantised)
+	{
+		primitives.addMember(GLTF_LABEL_NORMAL, addAccessor(normView,
+			vOffset * GLB_QUANT_NORMAL_STRIDE, GLTF_COMP_TYPE_BYTE, vCount, GLTF_TYPE_VEC3, subMeshID,
+			std::vector<float>(), std::vector<float>(), std::vector<uint32_t>(), true));
+	}
+	else if (normView >= 0)
+	{
+		primitives.addMember(GLTF_LABEL_NORMAL, addAccessor(normView,
+			vOffset * sizeof(repo::lib::RepoVector3D), GLTF_COMP_TYPE_FLOAT, vCount, GLTF_TYPE_VEC3, subMeshID));
+	}
+
+	if (idMapView >= 0)
+	{
+		primitives.addMember(REPO_GLTF_LABEL_IDMAP, addAccessor(idMapView,
+			vOffset * sizeof(float), GLTF_COMP_TYPE_FLOAT, vCount, GLTF_TYPE_SCALAR, subMeshID));
+	}
+
+	for (size_t iUV = 0; iUV < uvViews.size(); ++iUV)
+	{
+		const std::string label = GLTF_LABEL_TEXCOORD + "_" + std::to_string(iUV);
+		if (quantisedUVs[iUV])
+		{
+			primitives.addMember(label, addAccessor(uvViews[iUV],
+				vOffset * GLB_QUANT_UV_STRIDE, GLTF_COMP_TYPE_USHORT, vCount, GLTF_TYPE_VEC2, subMeshID,
+				std::vector<float>(), std::vector<float>(), std::vector<uint32_t>(), true));
+		}
+		else
+		{
+			primitives.addMember(label, addAccessor(uvViews[iUV],
+				vOffset * sizeof(repo::lib::RepoVector2D), GLTF_COMP_TYPE_FLOAT, vCount, GLTF_TYPE_VEC2, subMeshID));
+		}
+	}
+
+	primitives.endObject();
+
+	primitives.startObject(GLTF_LABEL_EXTRA);
+	primitives.addMember(REPO_GLTF_LABEL_REF_ID, subMeshID);
+	primitives.endObject();
+	primitives.endObject();
+}
+
+bool GLBModelExport::generateContainer()
+{
+	if (!scene)
+	{
+		//Sanity check, shouldn't be calling this function with nullptr anyway
+		repoError << "Nullptr to scene";
+		return false;
+	}
+
+	repo::core::model::RepoNode* root = scene->getRoot(gType);
+	if (!root)
+	{
+		repoError << "Failed to export to GLB: scene has no root node";
+		return false;
+	}
+
+	populateWithTextures();
+	populateWithMaterials();
+	populateWithCameras();
+	if (!populateWithMeshes())
+	{
+		repoError << "Failed to split Meshes";
+		return false;
+	}
+	const uint32_t rootIdx = addNode(root);
+
+	repo::lib::JSONWriter tree;
+	tree.startObject();
+
+	std::stringstream ss;
+	ss << "3D Repo Bouncer v" << BOUNCER_VMAJOR << "." << BOUNCER_VMINOR;
+	tree.startObject(GLTF_LABEL_ASSET);
+	tree.addMember(GLTF_LABEL_GENERATOR, ss.str());
+	tree.addMember(GLTF_LABEL_VERSION, GLTF_VERSION);
+	tree.endObject();
+
+	if (options.quantiseAttributes && meshes.size)
+	{
+		//Integer positions cannot be read without the extension
+		tree.addMember(GLTF_LABEL_EXTENSIONS_USED, std::vector<std::string>({ GLTF_EXT_MESH_QUANTIZATION }));
+		tree.addMember(GLTF_LABEL_EXTENSIONS_REQUIRED, std::vector<std::string>({ GLTF_EXT_MESH_QUANTIZATION }));
+	}
+
+	const std::string jsonFilePrefix = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/";
+	const std::string jsonFileName = jsonFilePrefix + "revision/" + scene->getRevisionID().toString() + "/partitioning.json";
+	repo::lib::JSONWriter &partitioning = jsonTrees[jsonFileName];
+	partitioning = repo::lib::JSONWriter();
+	generateSpatialPartitioning(partitioning);
+
+	tree.addMember(GLTF_LABEL_SCENE, 0);
+	tree.startArray(GLTF_LABEL_SCENES);
+	tree.startObject();
+	tree.addMember(GLTF_LABEL_NODES, std::vector<uint32_t>({ rootIdx }));
+	tree.startObject(GLTF_LABEL_EXTRA);
+	tree.startObject("partitioning");
+	tree.addMember(GLTF_LABEL_URI, "/api" + jsonFileName);
+	tree.endObject();
+	tree.endObject();
+	tree.endObject();
+	tree.endArray();
+
+	//glTF 2.0 does not allow empty arrays, writeArray skips them
+	writeArray(tree, GLTF_LABEL_NODES, nodes);
+	writeArray(tree, GLTF_LABEL_MESHES, meshes);
+	writeArray(tree, GLTF_LABEL_ACCESSORS, accessors);
+	writeArray(tree, GLTF_LABEL_MATERIALS, materials);
+	writeArray(tree, GLTF_LABEL_CAMERAS, cameras);
+	if (textures.size)
+	{
+		tree.startArray(GLTF_LABEL_SAMPLERS);
+		tree.startObject();
+		tree.addMember(GLTF_LABEL_FILTER_MAG, GLTF_FILTER_TYPE_LINEAR);
+		tree.addMember(GLTF_LABEL_FILTER_MIN, GLTF_FILTER_TYPE_NEAREST_MIPMAP_LINEAR);
+		tree.addMember(GLTF_LABEL_WRAP_S, GLTF_WRAP_MODE_REPEAT);
+		tree.addMember(GLTF_LABEL_WRAP_T, GLTF_WRAP_MODE_REPEAT);
+		tree.endObject();
+		tree.endArray();
+		writeArray(tree, GLTF_LABEL_TEXTURES, textures);
+		writeArray(tree, GLTF_LABEL_IMAGES, images);
+	}
+	if (bufferViews.size)
+	{
+		writeArray(tree, GLTF_LABEL_BUFFER_VIEWS, bufferViews);
+		//A buffer without uri refers to the BIN chunk of the container
+		tree.startArray(GLTF_LABEL_BUFFERS);
+		tree.startObject();
+		tree.addMember(GLTF_LABEL_BYTE_LENGTH, binBuffer.size());
+		tree.endObject();
+		tree.endArray();
+	}
+	tree.endObject();
+
+	const std::string fname = jsonFilePrefix + "revision/" + scene->getRevisionID().toString() + ".glb";
+	auto container = packContainer(tree.getString(), binBuffer);
+
+	//The intermediate document is no longer needed once it is packed
+	std::vector<uint8_t>().swap(binBuffer);
+	accessors = bufferViews = cameras = images = materials = meshes = nodes = textures = json_array_t();
+	std::vector<std::vector<float>>().swap(meshDecodeMatrices);
+
+	if (sink)
+		return sink->addFile(WebFileType::GEOMETRY, fname, std::move(container));
+	glbFiles[fname].swap(container);
+	return true;
+}
+
+void GLBModelExport::generateSpatialPartitioning(
+	repo::lib::JSONWriter &writer)
+{
+	repo::manipulator::modelutility::RDTreeSpatialPartitioner rdTreePartitioner(scene);
+	rdTreePartitioner.generateJSONForPartitioning(writer);
+}
+
+repo_web_buffers_t GLBModelExport::getAllFilesExportedAsBuffer() const
+{
+	return{ glbFiles, getJSONFilesAsBuffer() };
+}
+
+bool GLBModelExport::exportGeoFilesToSink(WebExportSink &target)
+{
+	bool success = true;
+	for (auto &file : glbFiles)
+	{
+		success &= target.addFile(WebFileType::GEOMETRY, file.first, std::move(file.second));
+	}
+	glbFiles.clear();
+	return success;
+}
+
+repo_mesh_mapping_t GLBModelExport::getWholeMeshMapping(
+	const repo::core::model::MeshNode      *node,
+	const std::vector<repo_mesh_mapping_t> &mappings,
+	const size_t                           &vCount,
+	const size_t                           &fCount) const
+{
+	repo_mesh_mapping_t mapping;
+	if (mappings.size())
+	{
+		mapping.material_id = mappings[0].material_id;
+		mapping.mesh_id = mappings[0].mesh_id;
+	}
+	else
+	{
+		auto children = scene->getChildrenNodesFiltered(gType, node->getSharedID(), repo::core::model::NodeType::MATERIAL);
+		if (children.size())
+			mapping.material_id = children[0]->getUniqueID();
+		mapping.mesh_id = node->getUniqueID();
+	}
+	auto bbox = node->getBoundingBox();
+	mapping.min = bbox[0];
+	mapping.max = bbox[1];
+	mapping.vertFrom = 0;
+	mapping.vertTo = vCount;
+	mapping.triFrom = 0;
+	mapping.triTo = fCount;
+	return mapping;
+}
+
+std::vector<uint8_t> GLBModelExport::packContainer(
+	const std::string          &json,
+	const std::vector<uint8_t> &bin)
+{
+	const size_t jsonLength = alignSize(json.size());
+	const size_t binLength = alignSize(bin.size());
+	const size_t chunkHeaderSize = 2 * sizeof(uint32_t);
+	const size_t headerSize = 3 * sizeof(uint32_t);
+	const size_t totalLength = headerSize + chunkHeaderSize + jsonLength + (bin.size() ? chunkHeaderSize + binLength : 0);
+
+	std::vector<uint8_t> container;
+	container.reserve(totalLength);
+
+	appendUInt32(container, GLB_MAGIC);
+	appendUInt32(container, GLB_VERSION);
+	appendUInt32(container, totalLength);
+
+	appendUInt32(container, jsonLength);
+	appendUInt32(container, GLB_CHUNK_JSON);
+	container.insert(container.end(), json.begin(), json.end());
+	container.resize(container.size() + jsonLength - json.size(), ' ');
+
+	//The BIN chunk is optional, it is omitted if there is no binary data
+	if (bin.size())
+	{
+		appendUInt32(container, binLength);
+		appendUInt32(container, GLB_CHUNK_BIN);
+		container.insert(container.end(), bin.begin(), bin.end());
+		container.resize(container.size() + binLength - bin.size(), 0);
+	}
+
+	return container;
+}
+
+uint32_t GLBModelExport::startArrayObject(
+	json_array_t &array)
+{
+	if (!array.size)
+		array.writer.startArray();
+	array.writer.startObject();
+	return array.size++;
+}
+
+void GLBModelExport::writeArray(
+	repo::lib::JSONWriter &document,
+	const std::string     &label,
+	json_array_t          &array)
+{
+	if (array.size)
+	{
+		array.writer.endArray();
+		document.addKey(label);
+		document.addRaw(array.writer.getString());
+	}
+}
+
+void GLBModelExport::populateWithCameras()
+{
+	for (const auto &cam : scene->getAllCameras(gType))
+	{
+		const repo::core::model::CameraNode *node = (const repo::core::model::CameraNode *)cam;
+		cameraIndices[node->getUniqueID()] = startArrayObject(cameras);
+		repo::lib::JSONWriter &camera = cameras.writer;
+		//All our viewpoints are perspective
+		camera.addMember(GLTF_LABEL_TYPE, GLTF_CAM_TYPE_PERSPECTIVE);
+		std::string name = node->getName();
+		if (!name.empty())
+			camera.addMember(GLTF_LABEL_NAME, name);
+
+		camera.startObject(GLTF_CAM_TYPE_PERSPECTIVE);
+		camera.addMember(GLTF_LABEL_ASP_RATIO, node->getAspectRatio());
+		camera.addMember(GLTF_LABEL_FOV, node->getFieldOfView());
+		camera.addMember(GLTF_LABEL_FAR_CP, node->getFarClippingPlane());
+		camera.addMember(GLTF_LABEL_NEAR_CP, node->getNearClippingPlane());
+		camera.endObject();
+		camera.endObject();
+	}
+}
+
+void GLBModelExport::populateWithMaterials()
+{
+	for (const auto &mat : scene->getAllMaterials(gType))
+	{
+		const repo::core::model::MaterialNode *node = (const repo::core::model::MaterialNode *)mat;
+		repo_material_t matStruct = node->getMaterialStruct();
+		materialIndices[node->getUniqueID()] = startArrayObject(materials);
+		repo::lib::JSONWriter &material = materials.writer;
+
+		std::string matName = node->getName();
+		if (!matName.empty())
+			material.addMember(GLTF_LABEL_NAME, matName);
+
+		const bool hasOpacity = matStruct.opacity == matStruct.opacity;
+		std::vector<float> baseColor = matStruct.diffuse.size() >= 3 ?
+			std::vector<float>(matStruct.diffuse.begin(), matStruct.diffuse.begin() + 3) : std::vector<float>(3, 1.0f);
+		baseColor.push_back(hasOpacity ? matStruct.opacity : 1.0f);
+		material.startObject(GLTF_LABEL_PBR);
+		material.addMember(GLTF_LABEL_BASE_COLOR, baseColor);
+		//Our materials are Phong, approximate them as dielectrics
+		material.addMember(GLTF_LABEL_METALLIC, 0);
+		material.addMember(GLTF_LABEL_ROUGHNESS, 1);
+
+		//should only ever have 1 texture to a material
+		auto childrenNodes = scene->getChildrenNodesFiltered(gType, node->getSharedID(), repo::core::model::NodeType::TEXTURE);
+		if (childrenNodes.size())
+		{
+			auto texIt = textureIndices.find(childrenNodes[0]->getUniqueID());
+			if (texIt != textureIndices.end())
+			{
+				material.startObject(GLTF_LABEL_BASE_COLOR_TEX);
+				material.addMember(GLTF_LABEL_INDEX, texIt->second);
+				material.endObject();
+			}
+		}
+		material.endObject();
+
+		if (matStruct.emissive.size() >= 3)
+			material.addMember(GLTF_LABEL_EMISSIVE, std::vector<float>(matStruct.emissive.begin(), matStruct.emissive.begin() + 3));
+
+		if (hasOpacity && matStruct.opacity < 1)
+			material.addMember(GLTF_LABEL_ALPHA_MODE, GLTF_ALPHA_MODE_BLEND);
+
+		if (matStruct.isTwoSided)
+			material.addMember(GLTF_LABEL_DOUBLE_SIDED, true);
+
+		//Keep the original Phong values for viewers that render them directly
+		material.startObject(GLTF_LABEL_EXTRA);
+		material.startObject(REPO_LABEL_PHONG);
+		if (matStruct.ambient.size())
+			material.addMember("ambient", matStruct.ambient);
+		if (matStruct.diffuse.size())
+			material.addMember("diffuse", matStruct.diffuse);
+		if (matStruct.specular.size())
+			material.addMember("specular", matStruct.specular);
+		if (matStruct.emissive.size())
+			material.addMember("emissive", matStruct.emissive);
+		if (matStruct.shininess == matStruct.shininess)
+			material.addMember("shininess", matStruct.shininess);
+		if (hasOpacity)
+			material.addMember("transparency", 1.0f - matStruct.opacity);
+		material.endObject();
+		material.endObject();
+
+		material.endObject();
+	}
+}
+
+bool GLBModelExport::populateWithMeshes()
+{
+	for (const auto &mesh : scene->getAllMeshes(gType))
+	{
+		const repo::core::model::MeshNode *node = (const repo::core::model::MeshNode *)mesh;
+		const std::vector<repo_mesh_mapping_t> mappings = node->getMeshMapping();
+
+		//Instanced geometry (a mesh under multiple transformations) has one mapping per
+		//instance, all covering the whole mesh. It is exported once and referenced by every node
+		const bool isInstanced = node->getParentIDs().size() > 1;
+
+		std::vector<repo::lib::RepoVector3D> vertices, normals;
+		std::vector<std::vector<repo::lib::RepoVector2D>> UVs;
+		std::vector<std::vector<float>> idMapBuf;
+		std::vector<std::vector<repo_mesh_mapping_t>> matMap;
+		std::vector<repo_mesh_mapping_t> splits;
+
+		if (options.useUInt32Indices)
+		{
+			//Meshes are never split, every sub mesh of a multipart mesh is a primitive of the same glTF mesh
+			vertices = node->getVertices();
+			normals = node->getNormals();
+			UVs = node->getUVChannelsSeparated();
+
+			std::vector<uint32_t> faces;
+			for (const auto &face : node->getFaces())
+			{
+				if (face.size() == 3)
+					faces.insert(faces.end(), face.begin(), face.end());
+				else
+					repoError << "Error during GLB export: found non triangulated face. This may not visualise correctly.";
+			}
+
+			if (!vertices.size() || !faces.size())
+			{
+				repoWarning << "Mesh " << node->getUniqueID() << " has no vertices or faces. Skipping...";
+				continue;
+			}
+
+			splits = { getWholeMeshMapping(node, mappings, vertices.size(), faces.size() / 3) };
+			if (mappings.size() > 1 && !isInstanced)
+			{
+				//Faces are indexed relative to their sub mesh, the ID map gives the sub mesh of every vertex
+				matMap = { mappings };
+				idMapBuf = { std::vector<float>(vertices.size(), 0) };
+				for (size_t i = 0; i < mappings.size(); ++i)
+				{
+					std::fill(idMapBuf[0].begin() + mappings[i].vertFrom, idMapBuf[0].begin() + mappings[i].vertTo, i);
+					//Mappings store signed ranges, they are never negative here
+					const size_t triFrom = (size_t)mappings[i].triFrom, triTo = (size_t)mappings[i].triTo;
+					const uint32_t vertFrom = (uint32_t)mappings[i].vertFrom, vertTo = (uint32_t)mappings[i].vertTo;
+					for (size_t j = triFrom * 3; j < triTo * 3; ++j)
+					{
+						if (faces[j] < vertFrom || faces[j] >= vertTo)
+						{
+							repoError << "Face of sub mesh " << mappings[i].mesh_id << " refers to a vertex outside of it";
+							return false;
+						}
+						faces[j] -= vertFrom;
+					}
+				}
+			}
+			else
+			{
+				matMap = { splits };
+			}
+
+			auto lods = GLTFModelExport::reorderFaces(faces, vertices, matMap);
+			if (options.optimiseVertexCache)
+				GLTFModelExport::optimiseVertexCache(faces, matMap, lods, vertices, normals, UVs, idMapBuf);
+			addMeshSplits(node, vertices, normals, UVs, faces, idMapBuf, matMap, splits, lods);
+			continue;
+		}
+
+		std::vector<uint16_t> faces;
+		if ((mappings.size() > 1 && !isInstanced) || node->getNumVertices() > GLB_MAX_VERTEX_LIMIT)
+		{
+			//Multipart mesh or a mesh too big for 16bit indices, split it into sub meshes
+			repo::manipulator::modelutility::MeshMapReorganiser reSplitter(node, GLB_MAX_VERTEX_LIMIT);
+			repo::core::model::MeshNode splitMesh = reSplitter.getRemappedMesh();
+			if (splitMesh.isEmpty())
+			{
+				repoError << "Failed to generate remappings for mesh: " << node->getUniqueID();
+				return false;
+			}
+
+			faces = reSplitter.getSerialisedFaces();
+			idMapBuf = reSplitter.getIDMapArrays();
+			matMap = reSplitter.getMappingsPerSubMesh();
+			splits = splitMesh.getMeshMapping();
+			vertices = splitMesh.getVertices();
+			normals = splitMesh.getNormals();
+			UVs = splitMesh.getUVChannelsSeparated();
+
+			if (!vertices.size())
+			{
+				repoError << "Mesh " << node->getUniqueID() << " has no vertices after remapping!";
+				return false;
+			}
+
+			if (!faces.size())
+			{
+				//If there is no faces, just ignore this.
+				repoWarning << "Mesh has no faces after remapping. Skipping...";
+				continue;
+			}
+
+			if (!GLTFModelExport::reIndexFaces(matMap, faces))
+				return false;
+
+			//ID maps of subsequent splits count from their first sub mesh
+			size_t offset = 0;
+			for (size_t i = 0; i < idMapBuf.size(); ++i)
+			{
+				if (offset > 0)
+				{
+					for (auto &id : idMapBuf[i])
+						id -= offset;
+				}
+				offset += matMap[i].size();
+			}
+		}
+		else
+		{
+			vertices = node->getVertices();
+			normals = node->getNormals();
+			UVs = node->getUVChannelsSeparated();
+			faces = GLTFModelExport::serialiseFaces(node->getFaces());
+
+			if (!vertices.size() || !faces.size())
+			{
+				repoWarning << "Mesh " << node->getUniqueID() << " has no vertices or faces. Skipping...";
+				continue;
+			}
+
+			splits = { getWholeMeshMapping(node, mappings, vertices.size(), faces.size() / 3) };
+			matMap = { splits };
+		}
+
+		auto lods = GLTFModelExport::reorderFaces(faces, vertices, matMap);
+		if (options.optimiseVertexCache)
+			GLTFModelExport::optimiseVertexCache(faces, matMap, lods, vertices, normals, UVs, idMapBuf);
+		addMeshSplits(node, vertices, normals, UVs, faces, idMapBuf, matMap, splits, lods);
+	}
+
+	return true;
+}
+
+void GLBModelExport::populateWithTextures()
+{
+	for (const auto &texture : scene->getAllTextures(gType))
+	{
+		const repo::core::model::TextureNode *node = (const repo::core::model::TextureNode *)texture;
+
+		std::string ext = node->getFileExtension();
+		if (!ext.empty() && ext[0] == '.')
+			ext = ext.substr(1);
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+		std::string mimeType;
+		if (ext == "png")
+			mimeType = GLTF_MIME_PNG;
+		else if (ext == "jpg" || ext == "jpeg")
+			mimeType = GLTF_MIME_JPEG;
+		else
+		{
+			//glTF 2.0 only supports PNG and JPEG images
+			repoWarning << "Texture " << node->getName() << " is of an unsupported format (" << ext << "), skipping...";
+			continue;
+		}
+
+		const std::vector<char> data = node->getRawData();
+		if (!data.size())
+		{
+			repoWarning << "Texture " << node->getName() << " has no data, skipping...";
+			continue;
+		}
+
+		const uint32_t bufferView = addBufferView((const uint8_t*)data.data(), data.size(), 0);
+		const uint32_t imageIdx = startArrayObject(images);
+		images.writer.addMember(GLTF_LABEL_BUFFER_VIEW, bufferView);
+		images.writer.addMember(GLTF_LABEL_MIME_TYPE, mimeType);
+		images.writer.addMember(GLTF_LABEL_NAME, node->getName());
+		images.writer.endObject();
+
+		textureIndices[node->getUniqueID()] = startArrayObject(textures);
+		textures.writer.addMember(GLTF_LABEL_SAMPLER, 0);
+		textures.writer.addMember(GLTF_LABEL_SOURCE, imageIdx);
+		textures.writer.addMember(GLTF_LABEL_NAME, node->getName());
+		textures.writer.endObject();
+	}
+}
@@ -0,0 +1,295 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Allows Export functionality from 3D Repo World to binary glTF 2.0 (GLB)
+*/
+
+#pragma once
+
+#include <string>
+
+#include "repo_model_export_web.h"
+#include "../../../lib/repo_json_writer.h"
+#include "../../../core/model/collection/repo_scene.h"
+#include "../../../core/model/bson/repo_node_mesh.h"
+
+namespace repo{
+	namespace manipulator{
+		namespace modelconvertor{
+			class GLBModelExport : public WebModelExport
+			{
+			public:
+				/**
+				* Default Constructor, export model with default settings
+				* The whole scene is written into a single GLB container
+				* @param scene repo scene to convert
+				* @param options export options
+				* @param sink if given, files are handed over to it as soon as they are complete
+				*/
+				GLBModelExport(
+					const repo::core::model::RepoScene *scene,
+					const WebExportOptions             &options = WebExportOptions(),
+					WebExportSink                      *sink = nullptr);
+
+				/**
+				* Default Destructor
+				*/
+				virtual ~GLBModelExport();
+
+				/**
+				* Export all necessary files as buffers
+				* @return returns a repo_web_buffers_t containing all files needed for this
+				*          model to be rendered
+				*/
+				repo_web_buffers_t getAllFilesExportedAsBuffer() const;
+
+				/**
+				* Pack a JSON document and a binary buffer into a GLB container
+				* The JSON chunk is padded with spaces and the binary chunk with
+				* zeros so both chunks are 4 bytes aligned
+				* @param json glTF JSON document
+				* @param bin binary buffer referred to by the document
+				* @return returns the GLB container
+				*/
+				static std::vector<uint8_t> packContainer(
+					const std::string          &json,
+					const std::vector<uint8_t> &bin);
+
+			protected:
+				/**
+				* Hand the GLB container over to a sink
+				* @param target destination of the files
+				* @return returns true if the sink accepted every file
+				*/
+				bool exportGeoFilesToSink(WebExportSink &target);
+
+			private:
+				/**
+				* A top level array of the document, written as its objects are added
+				*/
+				struct json_array_t
+				{
+					repo::lib::JSONWriter writer;
+					uint32_t size;
+
+					json_array_t() : size(0) {}
+				};
+
+				std::unordered_map<std::string, std::vector<uint8_t>> glbFiles;
+				std::vector<uint8_t> binBuffer;
+				json_array_t accessors, bufferViews, cameras,
+					images, materials, meshes, nodes, textures;
+				std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> cameraIndices,
+					materialIndices, textureIndices;
+				std::unordered_map<repo::lib::RepoUUID, std::vector<uint32_t>, repo::lib::RepoUUIDHasher> meshIndices;
+				//dequantisation matrix of every mesh, by mesh index (empty if the mesh is not quantised)
+				std::vector<std::vector<float>> meshDecodeMatrices;
+
+				/**
+				* Add an accessor into the document
+				* @param bufferView index of the buffer view the accessor reads from
+				* @param offset offset within the buffer view in bytes
+				* @param componentType component type of the accessor
+				* @param count number of elements
+				* @param type element type (SCALAR, VEC2...)
+				* @param refId sub mesh ID this accessor belongs to
+				* @param min minimum value of this array (optional)
+				* @param max maximum value of this array (optional)
+				* @param lod level of detail offsets (optional)
+				* @param normalized integer components are read as normalised values
+				* @return returns the index of the accessor
+				*/
+				uint32_t addAccessor(
+					const uint32_t                 &bufferView,
+					const size_t                   &offset,
+					const uint32_t                 &componentType,
+					const size_t                   &count,
+					const std::string              &type,
+					const std::string              &refId,
+					const std::vector<float>       &min = std::vector<float>(),
+					const std::vector<float>       &max = std::vector<float>(),
+					const std::vector<uint32_t>    &lod = std::vector<uint32_t>(),
+					const bool                     &normalized = false);
+
+				/**
+				* Append data into the binary buffer and declare a buffer view for it
+				* The data is placed at a 4 bytes aligned offset
+				* @param data data to append
+				* @param byteLength length of the data in bytes
+				* @param target buffer target (array/element array buffer), 0 for none
+				* @param byteStride stride between vertex attributes, 0 for tightly packed
+				* @return returns the index of the buffer view
+				*/
+				uint32_t addBufferView(
+					const uint8_t                  *data,
+					const size_t                   &byteLength,
+					const uint32_t                 &target,
+					const size_t                   &byteStride = 0);
+
+				template <typename T>
+				uint32_t addBufferView(
+					const T                        *data,
+					const size_t                   &count,
+					const uint32_t                 &target,
+					const bool                     &isVertexAttribute)
+				{
+					return addBufferView((const uint8_t*)data, count * sizeof(T), target, isVertexAttribute ? sizeof(T) : 0);
+				}
+
+				/**
+				* Add a primitive covering a sub mesh into the given primitive list
+				* All buffer views given are expected to start at the same vertex/face
+				* @param primitives writer of the primitive list to add to
+				* @param mapping sub mesh to add
+				* @param vertices vertices of the mesh split
+				* @param vertStart first vertex covered by the buffer views
+				* @param triStart first face covered by the buffer views
+				* @param posView buffer view of positions
+				* @param normView buffer view of normals (-1 if none)
+				* @param faceView buffer view of faces
+				* @param indexComponentType component type of the faces (16 or 32 bit)
+				* @param idMapView buffer view of the ID map (-1 if none)
+				* @param uvViews buffer views of the UV channels
+				* @param lod level of detail offsets of the sub mesh
+				* @param quantisedVertices quantised vertices of the mesh split, if the
+				*        attributes are quantised (empty otherwise)
+				* @param quantisedUVs whether each UV channel is quantised
+				*/
+				void addPrimitive(
+					repo::lib::JSONWriter                      &primitives,
+					const repo_mesh_mapping_t                  &mapping,
+					const std::vector<repo::lib::RepoVector3D> &vertices,
+					const size_t                               &vertStart,
+					const size_t                               &triStart,
+					const uint32_t                             &posView,
+					const int64_t                              &normView,
+					const uint32_t                             &faceView,
+					const uint32_t                             &indexComponentType,
+					const int64_t                              &idMapView,
+					const std::vector<uint32_t>                &uvViews,
+					const std::vector<uint32_t>                &lod,
+					const std::vector<uint16_t>                &quantisedVertices,
+					const std::vector<bool>                    &quantisedUVs);
+
+				/**
+				* Add the splits of a mesh into the document, one glTF mesh per split
+				* with a primitive per sub mesh
+				* @param node mesh node the splits belong to
+				* @param vertices vertices of all splits
+				* @param normals normals of all splits (can be empty)
+				* @param UVs uv channels of all splits (can be empty)
+				* @param faces faces, indexed relative to their sub mesh
+				* @param idMapBuf ID map of every split (can be empty)
+				* @param matMap sub meshes of every split
+				* @param splits splits of the mesh
+				* @param lods level of detail offsets per split, per sub mesh
+				*/
+				template <typename T>
+				void addMeshSplits(
+					const repo::core::model::MeshNode                       *node,
+					const std::vector<repo::lib::RepoVector3D>              &vertices,
+					const std::vector<repo::lib::RepoVector3D>              &normals,
+					const std::vector<std::vector<repo::lib::RepoVector2D>> &UVs,
+					const std::vector<T>                                    &faces,
+					const std::vector<std::vector<float>>                   &idMapBuf,
+					const std::vector<std::vector<repo_mesh_mapping_t>>     &matMap,
+					const std::vector<repo_mesh_mapping_t>                  &splits,
+					const std::vector<std::vector<std::vector<uint32_t>>>   &lods);
+
+				/**
+				* Add a node (and its sub graph) into the document
+				* @param node transformation to add
+				* @return returns the index of the node
+				*/
+				uint32_t addNode(
+					const repo::core::model::RepoNode *node);
+
+				/**
+				* Construct the GLB container of the scene
+				* @return returns true upon success
+				*/
+				bool generateContainer();
+
+				/**
+				* Generate the JSON document representing the spatial partitioning
+				* @param writer writer to write the document into
+				*/
+				void generateSpatialPartitioning(
+					repo::lib::JSONWriter &writer);
+
+				/**
+				* Get a mapping covering the whole of a mesh
+				* @param node mesh node
+				* @param mappings mappings of the mesh node
+				* @param vCount number of vertices
+				* @param fCount number of faces
+				* @return returns the mapping
+				*/
+				repo_mesh_mapping_t getWholeMeshMapping(
+					const repo::core::model::MeshNode      *node,
+					const std::vector<repo_mesh_mapping_t> &mappings,
+					const size_t                           &vCount,
+					const size_t                           &fCount) const;
+
+				/**
+				* Start a new object at the end of a top level array
+				* @param array array to add to
+				* @return returns the index of the new object
+				*/
+				static uint32_t startArrayObject(
+					json_array_t &array);
+
+				/**
+				* Close a top level array and write it into the document
+				* Nothing is written if the array is empty
+				* @param document writer of the document
+				* @param label name of the array
+				* @param array array to write
+				*/
+				static void writeArray(
+					repo::lib::JSONWriter &document,
+					const std::string     &label,
+					json_array_t          &array);
+
+				/**
+				* Populate the document with the cameras within the scene
+				*/
+				void populateWithCameras();
+
+				/**
+				* Populate the document with the materials within the scene
+				* This requires the textures to have been populated
+				*/
+				void populateWithMaterials();
+
+				/**
+				* Populate the document with the meshes within the scene
+				* This requires the materials to have been populated
+				* @return returns true upon success
+				*/
+				bool populateWithMeshes();
+
+				/**
+				* Populate the document with the textures within the scene
+				* Images are embedded into the binary buffer
+				*/
+				void populateWithTextures();
+			};
+		} //namespace modelconvertor
+	} //namespace manipulator
+} //namespace repo
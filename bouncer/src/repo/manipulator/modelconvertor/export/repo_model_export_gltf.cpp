@@ -21,10 +21,13 @@
 
 #include "repo_model_export_gltf.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include "../../../core/model/bson/repo_bson_factory.h"
 #include "../../../lib/repo_log.h"
+#include "../../../lib/repo_parallel.h"
+#include "../../../lib/datastructure/repo_vertex_cache.h"
 #include "../../modelutility/repo_mesh_map_reorganiser.h"
 #include "../../modelutility/spatialpartitioning/repo_spatial_partitioner_rdtree.h"
 #include "auxiliary/x3dom_constants.h"
@@ -188,15 +191,43 @@ static const std::string REPO_GLTF_LABEL_REF_ID = "refID";
 static const std::string REPO_GLTF_LABEL_LOD = "lodRef";
 static const std::string REPO_LABEL_X3D_MATERIAL = "x3dmaterial";
 
+/**
+* Format values as a space separated list, as x3dom expects for material colours
+*/
+static std::string toSpaceSeparatedString(const std::vector<float> &values)
+{
+	std::string result;
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		if (i)
+			result += " ";
+		result += repo::lib::JSONWriter::formatNumber(values[i]);
+	}
+	return result;
+}
+
 GLTFModelExport::GLTFModelExport(
-	const repo::core::model::RepoScene *scene
-	) : WebModelExport(scene)
+	const repo::core::model::RepoScene *scene,
+	const WebExportOptions             &options,
+	WebExportSink                      *sink
+	) : WebModelExport(scene, options, sink)
 {
 	if (convertSuccess)
 	{
-		//We only need a GLTF representation if there are meshes or cameras
-		if (scene->getAllMeshes(gType).size() || scene->getAllCameras(gType).size())
+		if (options.quantiseAttributes)
+			repoWarning << "Quantised attributes are not supported by the glTF 1.0 export, they will be written as floats.";
+
+		if (options.useUInt32Indices)
+		{
+			//Meshes would still be split, which is what the caller asked to avoid
+			repoError << "32 bit indices are not supported by the glTF 1.0 export, use the GLB export instead.";
+			convertSuccess = false;
+		}
+		else if (scene->getAllMeshes(gType).size() || scene->getAllCameras(gType).size())
+		{
+			//We only need a GLTF representation if there are meshes or cameras
 			convertSuccess = generateTreeRepresentation();
+		}
 	}
 	else
 	{
@@ -211,12 +242,11 @@ GLTFModelExport::~GLTFModelExport()
 void GLTFModelExport::addAccessors(
 	const std::string              &accName,
 	const std::string              &buffViewName,
-	repo::lib::PropertyTree        &tree,
 	const std::vector<uint16_t>    &faces,
 	const uint32_t                 &addrFrom,
 	const uint32_t                 &addrTo,
 	const std::string              &refId,
-	const std::vector<uint16_t>    &lod,
+	const std::vector<uint32_t>    &lod,
 	const size_t                   &offset)
 {
 	std::vector<float> min, max;
@@ -232,7 +262,7 @@ void GLTFModelExport::addAccessors(
 		if (min[0] > faces[i]) min[0] = faces[i];
 		if (max[0] < faces[i]) max[0] = faces[i];
 	}
-	addAccessors(accName, buffViewName, tree, endFaceIdx - startFaceIdx,
+	addAccessors(accName, buffViewName, endFaceIdx - startFaceIdx,
 		(startFaceIdx - offset * 3) * sizeof(*faces.data()), 0, GLTF_COMP_TYPE_USHORT,
 		GLTF_TYPE_SCALAR, min, max, refId, lod);
 }
@@ -240,7 +270,6 @@ void GLTFModelExport::addAccessors(
 void GLTFModelExport::addAccessors(
 	const std::string              &accName,
 	const std::string              &buffViewName,
-	repo::lib::PropertyTree        &tree,
 	const std::vector<float>       &data,
 	const uint32_t                 &addrFrom,
 	const uint32_t                 &addrTo,
@@ -265,7 +294,7 @@ void GLTFModelExport::addAccessors(
 		if (min[0] > data[i]) min[0] = data[i];
 		if (max[0] < data[i]) max[0] = data[i];
 	}
-	addAccessors(accName, buffViewName, tree, addrTo - addrFrom,
+	addAccessors(accName, buffViewName, addrTo - addrFrom,
 		(addrFrom - offset) * sizeof(*data.data()), sizeof(*data.data()), GLTF_COMP_TYPE_FLOAT,
 		GLTF_TYPE_SCALAR, min, max, refId);
 }
@@ -273,7 +302,6 @@ void GLTFModelExport::addAccessors(
 void GLTFModelExport::addAccessors(
 	const std::string                  &accName,
 	const std::string                  &buffViewName,
-	repo::lib::PropertyTree            &tree,
 	const std::vector<repo::lib::RepoVector2D> &buffer,
 	const uint32_t                     &addrFrom,
 	const uint32_t                     &addrTo,
@@ -303,7 +331,7 @@ void GLTFModelExport::addAccessors(
 				max[1] = buffer[i].y;
 		}
 	}
-	addAccessors(accName, buffViewName, tree, addrTo - addrFrom,
+	addAccessors(accName, buffViewName, addrTo - addrFrom,
 		(addrFrom - offset) * sizeof(*buffer.data()), sizeof(*buffer.data()),
 		GLTF_COMP_TYPE_FLOAT, GLTF_TYPE_VEC2, min, max, refId);
 }
@@ -311,7 +339,6 @@ void GLTFModelExport::addAccessors(
 void GLTFModelExport::addAccessors(
 	const std::string                &accName,
 	const std::string                &buffViewName,
-	repo::lib::PropertyTree          &tree,
 	const std::vector<repo::lib::RepoVector3D> &buffer,
 	const uint32_t                   &addrFrom,
 	const uint32_t                   &addrTo,
@@ -347,7 +374,7 @@ void GLTFModelExport::addAccessors(
 				max[2] = buffer[i].z;
 		}
 	}
-	addAccessors(accName, buffViewName, tree, addrTo - addrFrom,
+	addAccessors(accName, buffViewName, addrTo - addrFrom,
 		(addrFrom - offset) * sizeof(*buffer.data()), sizeof(*buffer.data()),
 		GLTF_COMP_TYPE_FLOAT, GLTF_TYPE_VEC3, min, max, refId);
 }
@@ -355,7 +382,6 @@ void GLTFModelExport::addAccessors(
 void GLTFModelExport::addAccessors(
 	const std::string              &accName,
 	const std::string              &buffViewName,
-	repo::lib::PropertyTree        &tree,
 	const size_t                   &count,
 	const size_t                   &offset,
 	const size_t                   &stride,
@@ -364,105 +390,107 @@ void GLTFModelExport::addAccessors(
 	const std::vector<float>       &min,
 	const std::vector<float>       &max,
 	const std::string              &refId,
-	const std::vector<uint16_t>    &lod)
+	const std::vector<uint32_t>    &lod)
 {
 	//declare accessor
-	std::string accLabel = GLTF_LABEL_ACCESSORS + "." + GLTF_PREFIX_ACCESSORS + "_" + accName;
-	tree.addToTree(accLabel + "." + GLTF_LABEL_BUFFER_VIEW, GLTF_PREFIX_BUFFER_VIEWS + "_" + buffViewName);
-	tree.addToTree(accLabel + "." + GLTF_LABEL_BYTE_OFFSET, offset);
-	tree.addToTree(accLabel + "." + GLTF_LABEL_BYTE_STRIDE, stride);
-	tree.addToTree(accLabel + "." + GLTF_LABEL_COMP_TYPE, componentType);
-	tree.addToTree(accLabel + "." + GLTF_LABEL_COUNT, count);
+	repo::lib::JSONWriter &writer = startSectionObject(GLTF_LABEL_ACCESSORS, GLTF_PREFIX_ACCESSORS + "_" + accName);
+	writer.addMember(GLTF_LABEL_BUFFER_VIEW, GLTF_PREFIX_BUFFER_VIEWS + "_" + buffViewName);
+	writer.addMember(GLTF_LABEL_BYTE_OFFSET, offset);
+	writer.addMember(GLTF_LABEL_BYTE_STRIDE, stride);
+	writer.addMember(GLTF_LABEL_COMP_TYPE, componentType);
+	writer.addMember(GLTF_LABEL_COUNT, count);
 	if (min.size())
 	{
-		tree.addToTree(accLabel + "." + GLTF_LABEL_MIN, min);
+		writer.addMember(GLTF_LABEL_MIN, min);
 	}
 	if (max.size())
 	{
-		tree.addToTree(accLabel + "." + GLTF_LABEL_MAX, max);
+		writer.addMember(GLTF_LABEL_MAX, max);
 	}
-	tree.addToTree(accLabel + "." + GLTF_LABEL_TYPE, bufferType);
+	writer.addMember(GLTF_LABEL_TYPE, bufferType);
 
-	if (!refId.empty())
-	{
-		tree.addToTree(accLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_GLTF_LABEL_REF_ID, refId);
-	}
-	if (lod.size())
+	if (!refId.empty() || lod.size())
 	{
-		tree.addToTree(accLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_GLTF_LABEL_LOD, lod);
+		writer.startObject(GLTF_LABEL_EXTRA);
+		if (!refId.empty())
+		{
+			writer.addMember(REPO_GLTF_LABEL_REF_ID, refId);
+		}
+		if (lod.size())
+		{
+			writer.addMember(REPO_GLTF_LABEL_LOD, lod);
+		}
+		writer.endObject();
 	}
+	writer.endObject();
 }
 
 void GLTFModelExport::addBufferView(
 	const std::string              &name,
 	const std::string              &fileName,
-	repo::lib::PropertyTree        &tree,
 	const std::vector<uint16_t>    &buffer,
 	const size_t                   &offset,
 	const size_t                   &count,
 	const std::string              &refId)
 {
-	addBufferView(name, fileName, tree, count * 3 * sizeof(*buffer.data()), offset, GLTF_PRIM_TYPE_ELEMENT_ARRAY_BUFFER, refId);
+	addBufferView(name, fileName, count * 3 * sizeof(*buffer.data()), offset, GLTF_PRIM_TYPE_ELEMENT_ARRAY_BUFFER, refId);
 }
 
 void GLTFModelExport::addBufferView(
 	const std::string              &name,
 	const std::string              &fileName,
-	repo::lib::PropertyTree        &tree,
 	const std::vector<float>       &buffer,
 	const size_t                   &offset,
 	const size_t                   &count,
 	const std::string              &refId)
 {
-	addBufferView(name, fileName, tree, count * sizeof(*buffer.data()), offset, GLTF_PRIM_TYPE_ARRAY_BUFFER, refId);
+	addBufferView(name, fileName, count * sizeof(*buffer.data()), offset, GLTF_PRIM_TYPE_ARRAY_BUFFER, refId);
 }
 
 void GLTFModelExport::addBufferView(
 	const std::string                   &name,
 	const std::string                   &fileName,
-	repo::lib::PropertyTree             &tree,
 	const std::vector<repo::lib::RepoVector3D>    &buffer,
 	const size_t                        &offset,
 	const size_t                        &count,
 	const std::string                   &refId)
 {
-	addBufferView(name, fileName, tree, count * sizeof(*buffer.data()), offset, GLTF_PRIM_TYPE_ARRAY_BUFFER, refId);
+	addBufferView(name, fileName, count * sizeof(*buffer.data()), offset, GLTF_PRIM_TYPE_ARRAY_BUFFER, refId);
 }
 
 void GLTFModelExport::addBufferView(
 	const std::string                   &name,
 	const std::string                   &fileName,
-	repo::lib::PropertyTree             &tree,
 	const std::vector<repo::lib::RepoVector2D>  &buffer,
 	const size_t                        &offset,
 	const size_t                        &count,
 	const std::string                   &refId)
 {
-	addBufferView(name, fileName, tree, count * sizeof(*buffer.data()), offset, GLTF_PRIM_TYPE_ARRAY_BUFFER, refId);
+	addBufferView(name, fileName, count * sizeof(*buffer.data()), offset, GLTF_PRIM_TYPE_ARRAY_BUFFER, refId);
 }
 
 void GLTFModelExport::addBufferView(
 	const std::string              &name,
 	const std::string              &fileName,
-	repo::lib::PropertyTree        &tree,
 	const size_t                   &byteLength,
 	const size_t                   &offset,
 	const uint32_t                 &bufferTarget,
 	const std::string              &refId)
 {
-	std::string bufferViewName = GLTF_PREFIX_BUFFER_VIEWS + "_" + name;
-
 	//declare buffer view
-	std::string bufferViewLabel = GLTF_LABEL_BUFFER_VIEWS + "." + bufferViewName;
-	tree.addToTree(bufferViewLabel + "." + GLTF_LABEL_BUFFER, fileName);
-	tree.addToTree(bufferViewLabel + "." + GLTF_LABEL_BYTE_LENGTH, byteLength);
-	tree.addToTree(bufferViewLabel + "." + GLTF_LABEL_BYTE_OFFSET, offset);
-	tree.addToTree(bufferViewLabel + "." + GLTF_LABEL_TARGET, bufferTarget);
+	repo::lib::JSONWriter &writer = startSectionObject(GLTF_LABEL_BUFFER_VIEWS, GLTF_PREFIX_BUFFER_VIEWS + "_" + name);
+	writer.addMember(GLTF_LABEL_BUFFER, fileName);
+	writer.addMember(GLTF_LABEL_BYTE_LENGTH, byteLength);
+	writer.addMember(GLTF_LABEL_BYTE_OFFSET, offset);
+	writer.addMember(GLTF_LABEL_TARGET, bufferTarget);
 
 	if (!refId.empty())
 	{
-		tree.addToTree(bufferViewLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_GLTF_LABEL_REF_ID, refId);
+		writer.startObject(GLTF_LABEL_EXTRA);
+		writer.addMember(REPO_GLTF_LABEL_REF_ID, refId);
+		writer.endObject();
 	}
+	writer.endObject();
 }
 size_t GLTFModelExport::addToDataBuffer(
 	const std::string              &bufferName,
@@ -484,27 +512,38 @@ size_t GLTFModelExport::addToDataBuffer(
 	return offset;
 }
 
+repo::lib::JSONWriter& GLTFModelExport::startSectionObject(
+	const std::string &section,
+	const std::string &name)
+{
+	repo::lib::JSONWriter &writer = sections[section];
+	if (writer.isEmpty())
+		writer.startObject();
+	writer.startObject(name);
+	return writer;
+}
+
 bool GLTFModelExport::constructScene(
-	repo::lib::PropertyTree &tree)
+	repo::lib::JSONWriter &tree)
 {
 	repo::core::model::RepoNode* root = scene->getRoot(gType);
 	bool success = false;
 	if (scene && root)
 	{
 		std::string sceneName = "defaultScene";
-		tree.addToTree(GLTF_LABEL_SCENE, sceneName);
+		tree.addMember(GLTF_LABEL_SCENE, sceneName);
+		tree.startObject(GLTF_LABEL_SCENES);
+		tree.startObject(sceneName);
 		std::vector<std::string> treeNodes = { root->getUniqueID().toString() };
-		tree.addToTree(GLTF_LABEL_SCENES + ".defaultScene." + GLTF_LABEL_NODES, treeNodes);
+		tree.addMember(GLTF_LABEL_NODES, treeNodes);
 
-		auto splitMeshes = populateWithMeshes(tree);
+		auto splitMeshes = populateWithMeshes();
 		if (success = splitMeshes.size())
 		{
-			populateWithNodes(tree, splitMeshes);
-			populateWithMaterials(tree);
-			populateWithTextures(tree);
-			populateWithCameras(tree);
-
-			repo::lib::PropertyTree spatialPartTree = generateSpatialPartitioning();
+			populateWithNodes(splitMeshes);
+			populateWithMaterials();
+			populateWithTextures();
+			populateWithCameras();
 
 #ifdef DEBUG
 			std::string jsonFilePrefix = "/";
@@ -512,23 +551,32 @@ bool GLTFModelExport::constructScene(
 			std::string jsonFilePrefix = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/";
 #endif
 			std::string jsonFileName = jsonFilePrefix + "revision/" + scene->getRevisionID().toString() + "/partitioning.json";
-			tree.addToTree(GLTF_LABEL_SCENES + ".defaultScene." + GLTF_LABEL_EXTRA + ".partitioning." + GLTF_LABEL_URI, "/api" + jsonFileName);
-
-			jsonTrees[jsonFileName] = spatialPartTree;
+			tree.startObject(GLTF_LABEL_EXTRA);
+			tree.startObject("partitioning");
+			tree.addMember(GLTF_LABEL_URI, "/api" + jsonFileName);
+			tree.endObject();
+			tree.endObject();
+
+			repo::lib::JSONWriter &spatialPartTree = jsonTrees[jsonFileName];
+			spatialPartTree = repo::lib::JSONWriter();
+			generateSpatialPartitioning(spatialPartTree);
 		}
 		else
 		{
 			repoError << "Failed to split Meshes";
 		}
+		tree.endObject();
+		tree.endObject();
 	}
 	return success;
 }
 
-repo::lib::PropertyTree GLTFModelExport::generateSpatialPartitioning()
+void GLTFModelExport::generateSpatialPartitioning(
+	repo::lib::JSONWriter &writer)
 {
 	//TODO: We could take in a spatial partitioner in the constructor to allow flexibility
 	repo::manipulator::modelutility::RDTreeSpatialPartitioner rdTreePartitioner(scene);
-	return rdTreePartitioner.generatePropertyTreeForPartitioning();
+	rdTreePartitioner.generateJSONForPartitioning(writer);
 }
 
 bool GLTFModelExport::generateTreeRepresentation()
@@ -541,19 +589,34 @@ bool GLTFModelExport::generateTreeRepresentation()
 		return false;
 	}
 
-	repo::lib::PropertyTree tree;
+	std::string fname = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/revision/" + scene->getRevisionID().toString() + ".gltf";
+	repo::lib::JSONWriter &tree = trees[fname];
+	tree = repo::lib::JSONWriter();
+	sections.clear();
+
+	tree.startObject();
 
 	std::stringstream ss;
 	ss << "3D Repo Bouncer v" << BOUNCER_VMAJOR << "." << BOUNCER_VMINOR;
-	tree.addToTree(GLTF_LABEL_ASSET + "." + GLTF_LABEL_GENERATOR, ss.str());
-	tree.addToTree(GLTF_LABEL_ASSET + "." + GLTF_LABEL_VERSION, GLTF_VERSION);
+	tree.startObject(GLTF_LABEL_ASSET);
+	tree.addMember(GLTF_LABEL_GENERATOR, ss.str());
+	tree.addMember(GLTF_LABEL_VERSION, GLTF_VERSION);
+	tree.endObject();
 	//FIXME: SHADER- Premultiplied alpha?
 
 	success = constructScene(tree);
-	writeBuffers(tree);
+	writeBuffers();
 
-	std::string fname = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/revision/" + scene->getRevisionID().toString() + ".gltf";
-	trees[fname] = tree;
+	//every section is a complete object by now, append them to the document
+	for (auto &section : sections)
+	{
+		section.second.endObject();
+		tree.addKey(section.first);
+		tree.addRaw(section.second.getString());
+	}
+	sections.clear();
+
+	tree.endObject();
 
 	return success;
 }
@@ -563,31 +626,69 @@ repo_web_buffers_t GLTFModelExport::getAllFilesExportedAsBuffer() const
 	return{ getGLTFFilesAsBuffer(), getJSONFilesAsBuffer() };
 }
 
+bool GLTFModelExport::addDataBufferToSink(
+	WebExportSink     &target,
+	const std::string &bufferName)
+{
+	auto bufferIt = fullDataBuffer.find(bufferName);
+	if (bufferIt == fullDataBuffer.end())
+		return true;
+
+	std::string bufferFilePrefix = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/";
+	streamedBufferSizes[bufferName] = bufferIt->second.size();
+	bool success = sharedBuffers.count(bufferName)
+		|| target.addFile(WebFileType::GEOMETRY, bufferFilePrefix + bufferName + ".bin", std::move(bufferIt->second));
+	fullDataBuffer.erase(bufferIt);
+	return success;
+}
+
+bool GLTFModelExport::exportGeoFilesToSink(WebExportSink &target)
+{
+	bool success = true;
+	for (const auto &pair : trees)
+	{
+		if (pair.second.isComplete())
+		{
+			success &= target.addFile(WebFileType::GEOMETRY, pair.first, pair.second.getBuffer());
+		}
+		else
+		{
+			repoError << "Failed to write " << pair.first << " into the sink: JSON document is empty or incomplete.";
+			success = false;
+		}
+	}
+	trees.clear();
+
+	std::vector<std::string> bufferNames;
+	for (const auto &pair : fullDataBuffer)
+		bufferNames.push_back(pair.first);
+	for (const auto &bufferName : bufferNames)
+		success &= addDataBufferToSink(target, bufferName);
+
+	return success;
+}
+
 std::unordered_map<std::string, std::vector<uint8_t>> GLTFModelExport::getGLTFFilesAsBuffer() const
 {
 	std::unordered_map<std::string, std::vector<uint8_t>> files;
 	//GLTF files
 	for (const auto &pair : trees)
 	{
-		std::stringstream ss;
-		pair.second.write_json(ss);
-		std::string jsonString = ss.str();
-		if (!jsonString.empty())
+		if (pair.second.isComplete())
 		{
-			files[pair.first] = std::vector<uint8_t>();
-			size_t byteLength = jsonString.size() * sizeof(*jsonString.data());
-			files[pair.first].resize(byteLength);
-			memcpy(files[pair.first].data(), jsonString.data(), byteLength);
+			files[pair.first] = pair.second.getBuffer();
 		}
 		else
 		{
-			repoError << "Failed to write " << pair.first << " into the buffer: JSON string is empty.";
+			repoError << "Failed to write " << pair.first << " into the buffer: JSON document is empty or incomplete.";
 		}
 	}
 
 	//bin files
 	for (const auto &pair : fullDataBuffer)
 	{
+		if (sharedBuffers.count(pair.first))
+			continue;
 		std::string bufferFilePrefix = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/";
 		std::string fileName = bufferFilePrefix + pair.first + ".bin";
 		if (pair.second.size())
@@ -671,7 +772,7 @@ bool GLTFModelExport::reIndexFaces(
 
 void GLTFModelExport::processNodeChildren(
 	const repo::core::model::RepoNode                            *node,
-	repo::lib::PropertyTree                                      &tree,
+	repo::lib::JSONWriter                                        &writer,
 	const std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> &subMeshCounts
 	)
 {
@@ -708,43 +809,42 @@ void GLTFModelExport::processNodeChildren(
 			break;
 		}
 	}
-	std::string prefix = GLTF_LABEL_NODES + "." + node->getUniqueID().toString() + ".";
 	//Add the children arrays into the node
 	if (trans.size())
-		tree.addToTree(prefix + GLTF_LABEL_CHILDREN, trans);
+		writer.addMember(GLTF_LABEL_CHILDREN, trans);
 	if (meshes.size())
-		tree.addToTree(prefix + GLTF_LABEL_MESHES, meshes);
+		writer.addMember(GLTF_LABEL_MESHES, meshes);
 	if (cameras.size())
-		tree.addToTree(prefix + GLTF_LABEL_CAMERAS, cameras);
+		writer.addMember(GLTF_LABEL_CAMERAS, cameras);
 }
 
-void GLTFModelExport::populateWithCameras(
-	repo::lib::PropertyTree           &tree)
+void GLTFModelExport::populateWithCameras()
 {
 	repo::core::model::RepoNodeSet cameras = scene->getAllCameras(gType);
 	for (const auto &cam : cameras)
 	{
 		const repo::core::model::CameraNode *node = (const repo::core::model::CameraNode *)cam;
-		const std::string label = GLTF_LABEL_CAMERAS + "." + node->getUniqueID().toString();
+		repo::lib::JSONWriter &writer = startSectionObject(GLTF_LABEL_CAMERAS, node->getUniqueID().toString());
 		//All our viewpoints are perspective..?
-		tree.addToTree(label + "." + GLTF_LABEL_TYPE, GLTF_CAM_TYPE_PERSPECTIVE);
+		writer.addMember(GLTF_LABEL_TYPE, GLTF_CAM_TYPE_PERSPECTIVE);
 		std::string name = node->getName();
 		if (!name.empty())
-			tree.addToTree(label + "." + GLTF_LABEL_NAME, name);
+			writer.addMember(GLTF_LABEL_NAME, name);
 
-		const std::string perspectLabel = label + "." + GLTF_CAM_TYPE_PERSPECTIVE;
+		writer.startObject(GLTF_CAM_TYPE_PERSPECTIVE);
+		writer.addMember(GLTF_LABEL_ASP_RATIO, node->getAspectRatio());
+		writer.addMember(GLTF_LABEL_FOV, node->getFieldOfView());
+		writer.addMember(GLTF_LABEL_FAR_CP, node->getFarClippingPlane());
+		writer.addMember(GLTF_LABEL_NEAR_CP, node->getNearClippingPlane());
+		writer.endObject();
 
-		tree.addToTree(perspectLabel + "." + GLTF_LABEL_ASP_RATIO, node->getAspectRatio());
-		tree.addToTree(perspectLabel + "." + GLTF_LABEL_FOV, node->getFieldOfView());
-		tree.addToTree(perspectLabel + "." + GLTF_LABEL_FAR_CP, node->getFarClippingPlane());
-		tree.addToTree(perspectLabel + "." + GLTF_LABEL_NEAR_CP, node->getNearClippingPlane());
+		writer.endObject();
 	}
 }
 
-void GLTFModelExport::populateWithMaterials(
-	repo::lib::PropertyTree           &tree)
+void GLTFModelExport::populateWithMaterials()
 {
-	writeDefaultTechnique(tree);
+	writeDefaultTechnique();
 
 	repo::core::model::RepoNodeSet mats = scene->getAllMaterials(gType);
 
@@ -752,15 +852,18 @@ void GLTFModelExport::populateWithMaterials(
 	{
 		const repo::core::model::MaterialNode *node = (const repo::core::model::MaterialNode *)mat;
 		repo_material_t matStruct = node->getMaterialStruct();
-		std::string matLabel = GLTF_LABEL_MATERIALS + "." + node->getUniqueID().toString();
-		tree.addToTree(matLabel + "." + GLTF_LABEL_TECHNIQUE, REPO_GLTF_DEFAULT_TECHNIQUE);
 
-		std::string valuesLabel = matLabel + "." + GLTF_LABEL_VALUES;
+		//values of the default technique, and the x3dom representation of the material
+		repo::lib::JSONWriter values, x3dMaterial;
+		values.startObject();
+		x3dMaterial.startObject();
+		bool hasX3DMaterial = false;
+
 		if (matStruct.ambient.size())
 		{
 			//default technique takes on a 4d vector, we store 3d vectors
 			matStruct.ambient.push_back(1);
-			tree.addToTree(valuesLabel + "." + GLTF_LABEL_AMBIENT, matStruct.ambient);
+			values.addMember(GLTF_LABEL_AMBIENT, matStruct.ambient);
 		}
 
 		//find if there are any diffuse texture within the model, add it onto the material if so
@@ -768,159 +871,275 @@ void GLTFModelExport::populateWithMaterials(
 		if (childrenNodes.size())
 		{
 			//should only ever have 1 texture to a material
-			tree.addToTree(valuesLabel + "." + GLTF_LABEL_DIFFUSE, childrenNodes[0]->getUniqueID().toString());
+			values.addMember(GLTF_LABEL_DIFFUSE, childrenNodes[0]->getUniqueID().toString());
 		}
 		else if (matStruct.diffuse.size())
 		{
-			tree.addToTree(matLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_LABEL_X3D_MATERIAL + "." + X3D_ATTR_COL_DIFFUSE, matStruct.diffuse, false);
+			hasX3DMaterial = true;
+			x3dMaterial.addMember(X3D_ATTR_COL_DIFFUSE, toSpaceSeparatedString(matStruct.diffuse));
 			if (matStruct.isTwoSided)
-				tree.addToTree(matLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_LABEL_X3D_MATERIAL + "." + X3D_ATTR_COL_BK_DIFFUSE, matStruct.diffuse, false);
+				x3dMaterial.addMember(X3D_ATTR_COL_BK_DIFFUSE, toSpaceSeparatedString(matStruct.diffuse));
 			//default technique takes on a 4d vector, we store 3d vectors
 			matStruct.diffuse.push_back(1);
-			tree.addToTree(valuesLabel + "." + GLTF_LABEL_DIFFUSE, matStruct.diffuse);
+			values.addMember(GLTF_LABEL_DIFFUSE, matStruct.diffuse);
 		}
 
 		if (matStruct.emissive.size())
 		{
-			tree.addToTree(matLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_LABEL_X3D_MATERIAL + "." + X3D_ATTR_COL_EMISSIVE, matStruct.emissive, false);
+			hasX3DMaterial = true;
+			x3dMaterial.addMember(X3D_ATTR_COL_EMISSIVE, toSpaceSeparatedString(matStruct.emissive));
 			if (matStruct.isTwoSided)
-				tree.addToTree(matLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_LABEL_X3D_MATERIAL + "." + X3D_ATTR_COL_BK_EMISSIVE, matStruct.emissive, false);
+				x3dMaterial.addMember(X3D_ATTR_COL_BK_EMISSIVE, toSpaceSeparatedString(matStruct.emissive));
 			//default technique takes on a 4d vector, we store 3d vectors
 			matStruct.emissive.push_back(1);
-			tree.addToTree(valuesLabel + "." + GLTF_LABEL_EMISSIVE, matStruct.emissive);
+			values.addMember(GLTF_LABEL_EMISSIVE, matStruct.emissive);
 		}
 		if (matStruct.specular.size())
 		{
-			tree.addToTree(matLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_LABEL_X3D_MATERIAL + "." + X3D_ATTR_COL_SPECULAR, matStruct.specular, false);
+			hasX3DMaterial = true;
+			x3dMaterial.addMember(X3D_ATTR_COL_SPECULAR, toSpaceSeparatedString(matStruct.specular));
 			if (matStruct.isTwoSided)
-				tree.addToTree(matLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_LABEL_X3D_MATERIAL + "." + X3D_ATTR_COL_BK_SPECULAR, matStruct.specular, false);
+				x3dMaterial.addMember(X3D_ATTR_COL_BK_SPECULAR, toSpaceSeparatedString(matStruct.specular));
 			//default technique takes on a 4d vector, we store 3d vectors
 			matStruct.specular.push_back(1);
-			tree.addToTree(valuesLabel + "." + GLTF_LABEL_SPECULAR, matStruct.specular);
+			values.addMember(GLTF_LABEL_SPECULAR, matStruct.specular);
 		}
 
 		if (matStruct.shininess == matStruct.shininess)
 		{
-			tree.addToTree(matLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_LABEL_X3D_MATERIAL + "." + X3D_ATTR_SHININESS, matStruct.shininess);
+			hasX3DMaterial = true;
+			x3dMaterial.addMember(X3D_ATTR_SHININESS, matStruct.shininess);
 			if (matStruct.isTwoSided)
-				tree.addToTree(matLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_LABEL_X3D_MATERIAL + "." + X3D_ATTR_BK_SHININESS, matStruct.shininess);
-			tree.addToTree(valuesLabel + "." + GLTF_LABEL_SHININESS, matStruct.shininess);
+				x3dMaterial.addMember(X3D_ATTR_BK_SHININESS, matStruct.shininess);
+			values.addMember(GLTF_LABEL_SHININESS, matStruct.shininess);
 		}
 
 		if (matStruct.opacity == matStruct.opacity)
 		{
+			hasX3DMaterial = true;
 			float transparency = 1.0 - matStruct.opacity;
-			tree.addToTree(matLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_LABEL_X3D_MATERIAL + "." + X3D_ATTR_TRANSPARENCY, transparency);
+			x3dMaterial.addMember(X3D_ATTR_TRANSPARENCY, transparency);
 			if (matStruct.isTwoSided)
-				tree.addToTree(matLabel + "." + GLTF_LABEL_EXTRA + "." + REPO_LABEL_X3D_MATERIAL + "." + X3D_ATTR_BK_TRANSPARENCY, transparency);
-			tree.addToTree(valuesLabel + "." + GLTF_LABEL_TRANSPARENCY, transparency);
+				x3dMaterial.addMember(X3D_ATTR_BK_TRANSPARENCY, transparency);
+			values.addMember(GLTF_LABEL_TRANSPARENCY, transparency);
 		}
 
 		if (matStruct.isTwoSided)
-			tree.addToTree(valuesLabel + "." + GLTF_LABEL_TWO_SIDED, "true");
+			values.addMember(GLTF_LABEL_TWO_SIDED, "true");
+
+		values.endObject();
+		x3dMaterial.endObject();
+
+		repo::lib::JSONWriter &writer = startSectionObject(GLTF_LABEL_MATERIALS, node->getUniqueID().toString());
+		writer.addMember(GLTF_LABEL_TECHNIQUE, REPO_GLTF_DEFAULT_TECHNIQUE);
+		writer.addKey(GLTF_LABEL_VALUES);
+		writer.addRaw(values.getString());
+		if (hasX3DMaterial)
+		{
+			writer.startObject(GLTF_LABEL_EXTRA);
+			writer.addKey(REPO_LABEL_X3D_MATERIAL);
+			writer.addRaw(x3dMaterial.getString());
+			writer.endObject();
+		}
 
 		std::string matName = node->getName();
 		if (!matName.empty())
-			tree.addToTree(matLabel + "." + GLTF_LABEL_NAME, matName);
+			writer.addMember(GLTF_LABEL_NAME, matName);
+		writer.endObject();
 	}
 }
 
-std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> GLTFModelExport::populateWithMeshes(
-	repo::lib::PropertyTree           &tree)
+bool GLTFModelExport::prepareMeshBuffers(
+	const repo::core::model::MeshNode *node,
+	gltf_mesh_buffers_t               &buffers) const
 {
-	repo::core::model::RepoNodeSet meshes = scene->getAllMeshes(gType);
-	std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> splitSizes;
-	for (const auto &mesh : meshes)
+	const std::vector<repo_mesh_mapping_t> mappings = node->getMeshMapping();
+
+	std::vector<repo::lib::RepoVector3D> &vertices = buffers.vertices;
+	std::vector<std::vector<repo_mesh_mapping_t>> &matMap = buffers.matMap;
+
+	//Instanced geometry (a mesh under multiple transformations) has one mapping per
+	//instance, all covering the whole mesh. It is exported once and referenced by every node
+	const bool isInstanced = node->getParentIDs().size() > 1;
+
+	if (buffers.isSplit = (mappings.size() > 1 && !isInstanced) || node->getNumVertices() > GLTF_MAX_VERTEX_LIMIT)
 	{
-		const repo::core::model::MeshNode *node = (const repo::core::model::MeshNode *)mesh;
-		const std::vector<repo_mesh_mapping_t> mappings = node->getMeshMapping();
+		//This is a multipart mesh node, the mesh may be too big for
+		//webGL, split the mesh into sub meshes
+		repo::manipulator::modelutility::MeshMapReorganiser reSplitter(node, GLTF_MAX_VERTEX_LIMIT);
 
-		std::string meshUUID = node->getUniqueID().toString();
+		repo::core::model::MeshNode splitMesh = reSplitter.getRemappedMesh();
+		if (splitMesh.isEmpty())
+		{
+			repoError << "Failed to generate remappings for mesh: " << node->getUniqueID();
+			return false;
+		}
+		buffers.faces = reSplitter.getSerialisedFaces();
+		buffers.idMapBuf = reSplitter.getIDMapArrays();
+		matMap = reSplitter.getMappingsPerSubMesh();
 
-		std::vector<repo::lib::RepoVector3D> normals;
-		std::vector<repo::lib::RepoVector3D> vertices = node->getVertices();
-		std::vector<std::vector<repo::lib::RepoVector2D>> UVs;
+		buffers.normals = splitMesh.getNormals();
+		vertices = splitMesh.getVertices();
+		buffers.splits = splitMesh.getMeshMapping();
 
-		if (mappings.size() > 1 || vertices.size() > GLTF_MAX_VERTEX_LIMIT)
+		if (!vertices.size())
 		{
-			//This is a multipart mesh node, the mesh may be too big for
-			//webGL, split the mesh into sub meshes
-			std::string bufferFileName = mesh->getUniqueID().toString();
-			repo::manipulator::modelutility::MeshMapReorganiser *reSplitter =
-				new repo::manipulator::modelutility::MeshMapReorganiser(node, GLTF_MAX_VERTEX_LIMIT);
-
-			repo::core::model::MeshNode splitMesh = reSplitter->getRemappedMesh();
-			if (splitMesh.isEmpty())
-			{
-				repoError << "Failed to generate remappings for mesh: " << mesh->getUniqueID();
-				splitSizes.clear();
-				delete reSplitter;
-				return splitSizes;
-			}
-			std::vector<uint16_t> newFaces = reSplitter->getSerialisedFaces();
-			std::vector<std::vector<float>> idMapBuf = reSplitter->getIDMapArrays();
-			std::vector<std::vector<repo_mesh_mapping_t>> matMap = reSplitter->getMappingsPerSubMesh();
+			repoError << "Mesh " << node->getUniqueID() << " has no vertices after remapping!";
+			return false;
+		}
 
-			delete reSplitter;
+		if (!buffers.faces.size())
+		{
+			//If there is no faces, just ignore this.
+			repoWarning << "Mesh has no faces after remapping. Skipping...";
+			buffers.isEmpty = true;
+			return true;
+		}
+		repoTrace << "Reindexing Faces...";
+		//reindex the face buffer also check validity of the indices
+		if (!reIndexFaces(matMap, buffers.faces))
+			return false;
+	}
+	else
+	{
+		buffers.normals = node->getNormals();
+		vertices = node->getVertices();
+		buffers.UVs = node->getUVChannelsSeparated();
 
-			auto normals = splitMesh.getNormals();
-			auto vertices = splitMesh.getVertices();
+		auto faces = node->getFaces();
+		buffers.faces = serialiseFaces(faces);
+		buffers.nFaces = faces.size();
 
-			if (!vertices.size())
+		const bool hasMapping = mappings.size();
+		if (hasMapping)
+		{
+			buffers.hasMat = true;
+			buffers.matID = mappings[0].material_id;
+		}
+		else
+		{
+			auto children = scene->getChildrenNodesFiltered(gType, node->getSharedID(), repo::core::model::NodeType::MATERIAL);
+			if (children.size())
 			{
-				repoError << "Mesh " << mesh->getUniqueID() << " has no vertices after remapping!";
-				splitSizes.clear();
-				return splitSizes;
+				buffers.hasMat = true;
+				buffers.matID = children[0]->getUniqueID();
 			}
+		}
 
-			if (!newFaces.size())
-			{
-				//If there is no faces, just ignore this.
-				repoWarning << "Mesh has no faces after remapping. Skipping...";
-				continue;
-			}
-			repoTrace << "Reindexing Faces...";
-			//reindex the face buffer also check validity of the indices
-			if (!reIndexFaces(matMap, newFaces))
+		matMap.resize(1);
+		matMap[0].resize(1);
+		matMap[0][0].material_id = buffers.matID;
+		matMap[0][0].mesh_id = hasMapping ? mappings[0].mesh_id : node->getUniqueID();
+		if (isInstanced)
+		{
+			for (const auto &mapping : mappings)
+				buffers.instanceIDs.push_back(mapping.mesh_id.toString());
+		}
+		auto bbox = node->getBoundingBox();
+		matMap[0][0].max = bbox[1];
+		matMap[0][0].min = bbox[0];
+		matMap[0][0].triFrom = 0;
+		matMap[0][0].triTo = faces.size();
+		matMap[0][0].vertFrom = 0;
+		matMap[0][0].vertTo = vertices.size();
+	}
+
+	repoTrace << "Reordering Faces...";
+	buffers.lods = reorderFaces(buffers.faces, vertices, matMap);
+	if (options.optimiseVertexCache)
+	{
+		repoTrace << "Optimising Faces for the vertex cache...";
+		optimiseVertexCache(buffers.faces, matMap, buffers.lods, vertices, buffers.normals, buffers.UVs, buffers.idMapBuf);
+	}
+#if defined(DEBUG) && defined(LODLIMIT)
+	for (size_t i = 0; i < matMap.size(); ++i)
+		for (size_t j = 0; j < matMap[i].size(); ++j)
+		{
+			repo_mesh_mapping_t mapping = matMap[i][j];
+			size_t maxBits = 16;
+			const float maxQuant = pow(2, maxBits) - 1;
+			const size_t vCount = mapping.vertTo - mapping.vertFrom;
+			uint32_t dim = pow(2, (maxBits - lodLimit));
+			uint32_t shift = maxBits - lodLimit;
+			repo::lib::RepoVector3D *vRaw = &vertices[mapping.vertFrom];
+			repo::lib::RepoVector3D bboxMin = mapping.min;
+			repo::lib::RepoVector3D bboxSize = { mapping.max.x - bboxMin.x, mapping.max.y - bboxMin.y, mapping.max.z - bboxMin.z };
+			for (size_t vertId = 0; vertId < vCount; ++vertId)
 			{
-				splitSizes.clear();
-				return splitSizes;
+				uint32_t vertXNormal = floorf(((vRaw[vertId].x - bboxMin.x) / bboxSize.x) * maxQuant + 0.5);
+				uint32_t vertYNormal = floorf(((vRaw[vertId].y - bboxMin.y) / bboxSize.y) * maxQuant + 0.5);
+				uint32_t vertZNormal = floorf(((vRaw[vertId].z - bboxMin.z) / bboxSize.z) * maxQuant + 0.5);
+
+				uint32_t vertX = (vertXNormal >> shift) << shift;
+				uint32_t vertY = (vertYNormal >> shift) << shift;
+				uint32_t vertZ = (vertZNormal >> shift) << shift;
+
+				vRaw[vertId].x = ((float)vertX) / maxQuant * bboxSize.x + bboxMin.x;
+				vRaw[vertId].y = ((float)vertY) / maxQuant * bboxSize.y + bboxMin.y;
+				vRaw[vertId].z = ((float)vertZ) / maxQuant * bboxSize.z + bboxMin.z;
 			}
-			repoTrace << "Reordering Faces...";
-			auto lods = reorderFaces(newFaces, vertices, matMap);
-#if defined(DEBUG) && defined(LODLIMIT)
-			for (size_t i = 0; i < matMap.size(); ++i)
-				for (size_t j = 0; j < matMap[i].size(); ++j)
-				{
-					repo_mesh_mapping_t mapping = matMap[i][j];
-					size_t maxBits = 16;
-					const float maxQuant = pow(2, maxBits) - 1;
-					const size_t vCount = mapping.vertTo - mapping.vertFrom;
-					uint32_t dim = pow(2, (maxBits - lodLimit));
-					uint32_t shift = maxBits - lodLimit;
-					repo::lib::RepoVector3D *vRaw = &vertices[mapping.vertFrom];
-					repo::lib::RepoVector3D bboxMin = mapping.min;
-					repo::lib::RepoVector3D bboxSize = { mapping.max.x - bboxMin.x, mapping.max.y - bboxMin.y, mapping.max.z - bboxMin.z };
-					for (size_t vertId = 0; vertId < vCount; ++vertId)
-					{
-						uint32_t vertXNormal = floorf(((vRaw[vertId].x - bboxMin.x) / bboxSize.x) * maxQuant + 0.5);
-						uint32_t vertYNormal = floorf(((vRaw[vertId].y - bboxMin.y) / bboxSize.y) * maxQuant + 0.5);
-						uint32_t vertZNormal = floorf(((vRaw[vertId].z - bboxMin.z) / bboxSize.z) * maxQuant + 0.5);
-
-						uint32_t vertX = (vertXNormal >> shift) << shift;
-						uint32_t vertY = (vertYNormal >> shift) << shift;
-						uint32_t vertZ = (vertZNormal >> shift) << shift;
-
-						//						repoDebug << "Before: (" << vRaw[vertId].x << "," << vRaw[vertId].y << ", " << vRaw[vertId].z << ")";
-						vRaw[vertId].x = ((float)vertX) / maxQuant * bboxSize.x + bboxMin.x;
-						vRaw[vertId].y = ((float)vertY) / maxQuant * bboxSize.y + bboxMin.y;
-						vRaw[vertId].z = ((float)vertZ) / maxQuant * bboxSize.z + bboxMin.z;
-						//					repoDebug << "After: (" << vRaw[vertId].x << "," << vRaw[vertId].y << ", " << vRaw[vertId].z << ")";
-					}
-				}
+		}
 #endif
+	return true;
+}
+
+std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> GLTFModelExport::populateWithMeshes()
+{
+	repo::core::model::RepoNodeSet meshes = scene->getAllMeshes(gType);
+	std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> splitSizes;
 
-			auto newMappings = splitMesh.getMeshMapping();
+	//Meshes are prepared independently of each other, then written into the
+	//document in the order of the node set so the output does not depend on scheduling.
+	//When streaming to a sink, meshes are prepared a batch at a time to bound the memory used
+	const std::vector<repo::core::model::RepoNode*> meshNodes(meshes.begin(), meshes.end());
+	const size_t batchSize = sink ? repo::lib::getDefaultThreadCount() : meshNodes.size();
+	std::vector<gltf_mesh_buffers_t> meshBuffers;
+	std::vector<char> prepared;
+
+	for (size_t meshIdx = 0; meshIdx < meshNodes.size(); ++meshIdx)
+	{
+		const size_t batchIdx = meshIdx % batchSize;
+		if (!batchIdx)
+		{
+			const size_t batchCount = std::min(batchSize, meshNodes.size() - meshIdx);
+			meshBuffers.clear();
+			meshBuffers.resize(batchCount);
+			prepared.assign(batchCount, false);
+			repo::lib::parallelFor(batchCount, [&](const size_t &i)
+			{
+				prepared[i] = prepareMeshBuffers((const repo::core::model::MeshNode *)meshNodes[meshIdx + i], meshBuffers[i]);
+			});
+		}
+
+		const repo::core::model::MeshNode *node = (const repo::core::model::MeshNode *)meshNodes[meshIdx];
+		if (!prepared[batchIdx])
+		{
+			splitSizes.clear();
+			return splitSizes;
+		}
+
+		gltf_mesh_buffers_t &buffers = meshBuffers[batchIdx];
+		if (buffers.isEmpty)
+			continue;
+
+		std::string meshUUID = node->getUniqueID().toString();
+
+		std::vector<repo::lib::RepoVector3D> &normals = buffers.normals;
+		std::vector<repo::lib::RepoVector3D> &vertices = buffers.vertices;
+		std::vector<std::vector<repo::lib::RepoVector2D>> &UVs = buffers.UVs;
+		std::vector<std::vector<std::vector<uint32_t>>> &lods = buffers.lods;
+
+		if (buffers.isSplit)
+		{
+			std::string bufferFileName = meshUUID;
+			//The data buffer is named after the supermesh, a supermesh shared with the stash
+			//of an earlier revision has its buffer stored already (it still needs laying out)
+			if (gType == repo::core::model::RepoScene::GraphType::OPTIMIZED && scene->isSharedStashNode(node))
+				sharedBuffers.insert(bufferFileName);
+			std::vector<uint16_t> &newFaces = buffers.faces;
+			std::vector<std::vector<float>> &idMapBuf = buffers.idMapBuf;
+			std::vector<std::vector<repo_mesh_mapping_t>> &matMap = buffers.matMap;
+			const std::vector<repo_mesh_mapping_t> &newMappings = buffers.splits;
 
 			splitSizes[node->getUniqueID()] = newMappings.size();
 
@@ -959,7 +1178,8 @@ std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> GLT
 				std::string meshId = meshUUID + "_" + std::to_string(i);
 				std::string label = GLTF_LABEL_MESHES + "." + meshId;
 				repoTrace << "Generatinng GLTF entry for mapping : " << label;
-				std::vector<repo::lib::PropertyTree> primitives;
+				repo::lib::JSONWriter &meshWriter = startSectionObject(GLTF_LABEL_MESHES, meshId);
+				meshWriter.startArray(GLTF_LABEL_PRIMITIVES);
 				size_t count = 0;
 
 				std::string faceBufferName = meshId + "_" + GLTF_SUFFIX_FACES;
@@ -971,21 +1191,21 @@ std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> GLT
 				size_t fcount = newMappings[i].triTo - newMappings[i].triFrom;
 
 				//for each mesh we need to add a bufferView for each buffer
-				addBufferView(normBufferName, bufferFileName, tree, normals, nStart, vcount, meshId);
+				addBufferView(normBufferName, bufferFileName, normals, nStart, vcount, meshId);
 				nStart += vcount * sizeof(repo::lib::RepoVector3D);
 
-				addBufferView(posBufferName, bufferFileName, tree, vertices, vStart, vcount, meshId);
+				addBufferView(posBufferName, bufferFileName, vertices, vStart, vcount, meshId);
 				vStart += vcount * sizeof(repo::lib::RepoVector3D);
 
-				addBufferView(faceBufferName, bufferFileName, tree, newFaces, fStart, fcount, meshId);
+				addBufferView(faceBufferName, bufferFileName, newFaces, fStart, fcount, meshId);
 				fStart += fcount * 3 * sizeof(uint16_t); //faces are triangulated
 
-				addBufferView(idBufferName, bufferFileName, tree, idMapBuf[i], idMapStart[i], vcount, meshId);
+				addBufferView(idBufferName, bufferFileName, idMapBuf[i], idMapStart[i], vcount, meshId);
 
 				for (size_t iUV = 0; iUV < UVs.size(); ++iUV)
 				{
 					std::string uvBufferName = meshId + "_" + GLTF_SUFFIX_TEX_COORD + "_" + std::to_string(iUV);
-					addBufferView(uvBufferName, bufferFileName, tree, UVs[iUV], uvStart[iUV], vcount, meshId);
+					addBufferView(uvBufferName, bufferFileName, UVs[iUV], uvStart[iUV], vcount, meshId);
 					uvStart[iUV] += vcount*sizeof(repo::lib::RepoVector2D);
 				}
 
@@ -1004,45 +1224,46 @@ std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> GLT
 				{
 					std::string subMeshID = meshMap.mesh_id.toString();
 
-					primitives.push_back(repo::lib::PropertyTree());
-					primitives.back().addToTree(GLTF_LABEL_MATERIAL, meshMap.material_id.toString());
-					primitives.back().addToTree(GLTF_LABEL_PRIMITIVE, GLTF_PRIM_TYPE_TRIANGLE);
+					meshWriter.startObject();
+					meshWriter.addMember(GLTF_LABEL_MATERIAL, meshMap.material_id.toString());
+					meshWriter.addMember(GLTF_LABEL_PRIMITIVE, GLTF_PRIM_TYPE_TRIANGLE);
 
 					std::string subMeshName = meshId + "_m" + std::to_string(count++);
 
 					if (newFaces.size())
 					{
 						std::string accessorName = subMeshName + "_" + GLTF_SUFFIX_FACES;
-						primitives.back().addToTree(GLTF_LABEL_INDICES, GLTF_PREFIX_ACCESSORS + "_" + accessorName);
-						std::vector<uint16_t> lodVec = *lodIterator;
+						meshWriter.addMember(GLTF_LABEL_INDICES, GLTF_PREFIX_ACCESSORS + "_" + accessorName);
+						std::vector<uint32_t> lodVec = *lodIterator;
 #if defined(DEBUG) && defined(LODLIMIT)
 						size_t triTo = meshMap.triFrom + (lodVec.size() < lodLimit ? lodVec.back() : lodVec[lodLimit - 1]) / 3;
 #else
 						size_t triTo = meshMap.triTo;
 #endif
-						addAccessors(accessorName, faceBufferName, tree, newFaces, meshMap.triFrom, triTo, subMeshID, *lodIterator, subMeshOffset_f);
+						addAccessors(accessorName, faceBufferName, newFaces, meshMap.triFrom, triTo, subMeshID, *lodIterator, subMeshOffset_f);
 					}
 					++lodIterator;
 
+					meshWriter.startObject(GLTF_LABEL_ATTRIBUTES);
 					if (normals.size())
 					{
 						std::string accessorName = subMeshName + "_" + GLTF_SUFFIX_NORMALS;
-						primitives.back().addToTree(GLTF_LABEL_ATTRIBUTES + "." + GLTF_LABEL_NORMAL, GLTF_PREFIX_ACCESSORS + "_" + accessorName);
-						addAccessors(accessorName, normBufferName, tree, normals, meshMap.vertFrom, meshMap.vertTo, subMeshID, subMeshOffset_v);
+						meshWriter.addMember(GLTF_LABEL_NORMAL, GLTF_PREFIX_ACCESSORS + "_" + accessorName);
+						addAccessors(accessorName, normBufferName, normals, meshMap.vertFrom, meshMap.vertTo, subMeshID, subMeshOffset_v);
 					}
 
 					if (vertices.size())
 					{
 						std::string accessorName = subMeshName + "_" + GLTF_SUFFIX_POSITION;
-						primitives.back().addToTree(GLTF_LABEL_ATTRIBUTES + "." + GLTF_LABEL_POSITION, GLTF_PREFIX_ACCESSORS + "_" + accessorName);
-						addAccessors(accessorName, posBufferName, tree, vertices, meshMap.vertFrom, meshMap.vertTo, subMeshID, subMeshOffset_v);
+						meshWriter.addMember(GLTF_LABEL_POSITION, GLTF_PREFIX_ACCESSORS + "_" + accessorName);
+						addAccessors(accessorName, posBufferName, vertices, meshMap.vertFrom, meshMap.vertTo, subMeshID, subMeshOffset_v);
 					}
 
 					if (idMapBuf[i].size())
 					{
 						std::string accessorName = subMeshName + "_" + GLTF_SUFFIX_IDMAP;
-						primitives.back().addToTree(GLTF_LABEL_ATTRIBUTES + "." + REPO_GLTF_LABEL_IDMAP, GLTF_PREFIX_ACCESSORS + "_" + accessorName);
-						addAccessors(accessorName, idBufferName, tree, idMapBuf[i], meshMap.vertFrom, meshMap.vertTo, subMeshID, subMeshOffset_v);
+						meshWriter.addMember(REPO_GLTF_LABEL_IDMAP, GLTF_PREFIX_ACCESSORS + "_" + accessorName);
+						addAccessors(accessorName, idBufferName, idMapBuf[i], meshMap.vertFrom, meshMap.vertTo, subMeshID, subMeshOffset_v);
 					}
 
 					if (UVs.size())
@@ -1051,102 +1272,50 @@ std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> GLT
 						{
 							std::string accessorName = subMeshName + "_" + GLTF_SUFFIX_TEX_COORD + "_" + std::to_string(iUV);
 							std::string uvBufferName = meshId + "_" + GLTF_SUFFIX_TEX_COORD + "_" + std::to_string(iUV);
-							primitives.back().addToTree(GLTF_LABEL_ATTRIBUTES + "." + GLTF_LABEL_TEXCOORD + "_" + std::to_string(iUV),
+							meshWriter.addMember(GLTF_LABEL_TEXCOORD + "_" + std::to_string(iUV),
 								GLTF_PREFIX_ACCESSORS + "_" + accessorName);
-							addAccessors(accessorName, uvBufferName, tree, UVs[iUV], meshMap.vertFrom, meshMap.vertTo, subMeshID, subMeshOffset_v);
+							addAccessors(accessorName, uvBufferName, UVs[iUV], meshMap.vertFrom, meshMap.vertTo, subMeshID, subMeshOffset_v);
 						}
 					}
-					primitives.back().addToTree(GLTF_LABEL_EXTRA + "." + REPO_GLTF_LABEL_REF_ID, subMeshID);
+					meshWriter.endObject();
+
+					meshWriter.startObject(GLTF_LABEL_EXTRA);
+					meshWriter.addMember(REPO_GLTF_LABEL_REF_ID, subMeshID);
+					meshWriter.endObject();
+					meshWriter.endObject();
 				}
-				tree.addArrayObjects(label + "." + GLTF_LABEL_PRIMITIVES, primitives);
+				meshWriter.endArray();
+				meshWriter.endObject();
+			}
+
+			//The buffer of a split mesh is complete once all its splits are written
+			if (sink && !addDataBufferToSink(*sink, bufferFileName))
+			{
+				splitSizes.clear();
+				return splitSizes;
 			}
 		}
 		else
 		{
-			normals = node->getNormals();
-			vertices = node->getVertices();
-			UVs = node->getUVChannelsSeparated();
-
 			splitSizes[node->getUniqueID()] = 1;
 
-			bool hasMapping = mappings.size();
-			std::string meshId = (hasMapping ? mappings[0].mesh_id : node->getUniqueID()).toString();
-			std::string label = GLTF_LABEL_MESHES + "." + node->getUniqueID().toString();
+			const std::vector<uint16_t> &sFaces = buffers.faces;
+			const size_t nFaces = buffers.nFaces;
+			const bool hasMat = buffers.hasMat;
+			const repo::lib::RepoUUID &matID = buffers.matID;
+			std::string meshId = buffers.matMap[0][0].mesh_id.toString();
+			std::string label = GLTF_LABEL_MESHES + "." + meshUUID;
 
 			repoTrace << "Generatinng GLTF entry for : " << label;
+			repo::lib::JSONWriter &meshWriter = startSectionObject(GLTF_LABEL_MESHES, meshUUID);
 			std::string name = node->getName();
 			if (!name.empty())
-				tree.addToTree(label + "." + GLTF_LABEL_NAME, node->getName());
-
-			auto faces = node->getFaces();
-			std::vector<uint16_t> sFaces = serialiseFaces(faces);
-
-			bool hasMat = false;
-			repo::lib::RepoUUID matID;
-			if (hasMapping)
-			{
-				hasMat = true;
-				matID = mappings[0].material_id;
-			}
-			else
-			{
-				auto children = scene->getChildrenNodesFiltered(gType, node->getSharedID(), repo::core::model::NodeType::MATERIAL);
-				if (children.size())
-				{
-					hasMat = true;
-					matID = children[0]->getUniqueID();
-				}
-			}
+				meshWriter.addMember(GLTF_LABEL_NAME, node->getName());
 
-			std::vector < std::vector<repo_mesh_mapping_t>> matMap;
-			matMap.resize(1);
-			matMap[0].resize(1);
-			matMap[0][0].material_id = matID;
-			matMap[0][0].mesh_id = hasMapping ? mappings[0].mesh_id : node->getUniqueID();
-			auto bbox = node->getBoundingBox();
-			matMap[0][0].max = bbox[1];
-			matMap[0][0].min = bbox[0];
-			matMap[0][0].triFrom = 0;
-			matMap[0][0].triTo = faces.size();
-			matMap[0][0].vertFrom = 0;
-			matMap[0][0].vertTo = vertices.size();
-
-			auto lods = reorderFaces(sFaces, vertices, matMap);
-#if defined(DEBUG) && defined(LODLIMIT)
-			for (size_t i = 0; i < matMap.size(); ++i)
-				for (size_t j = 0; j < matMap[i].size(); ++j)
-				{
-					repo_mesh_mapping_t mapping = matMap[i][j];
-					size_t maxBits = 16;
-					const float maxQuant = pow(2, maxBits) - 1;
-					const size_t vCount = mapping.vertTo - mapping.vertFrom;
-					uint32_t dim = pow(2, (maxBits - lodLimit));
-					uint32_t shift = maxBits - lodLimit;
-					repo::lib::RepoVector3D *vRaw = &vertices[mapping.vertFrom];
-					repo::lib::RepoVector3D bboxMin = mapping.min;
-					repo::lib::RepoVector3D bboxSize = { mapping.max.x - bboxMin.x, mapping.max.y - bboxMin.y, mapping.max.z - bboxMin.z };
-					for (size_t vertId = 0; vertId < vCount; ++vertId)
-					{
-						uint32_t vertXNormal = floorf(((vRaw[vertId].x - bboxMin.x) / bboxSize.x) * maxQuant + 0.5);
-						uint32_t vertYNormal = floorf(((vRaw[vertId].y - bboxMin.y) / bboxSize.y) * maxQuant + 0.5);
-						uint32_t vertZNormal = floorf(((vRaw[vertId].z - bboxMin.z) / bboxSize.z) * maxQuant + 0.5);
-
-						uint32_t vertX = (vertXNormal >> shift) << shift;
-						uint32_t vertY = (vertYNormal >> shift) << shift;
-						uint32_t vertZ = (vertZNormal >> shift) << shift;
-
-						//						repoDebug << "Before: (" << vRaw[vertId].x << "," << vRaw[vertId].y << ", " << vRaw[vertId].z << ")";
-						vRaw[vertId].x = ((float)vertX) / maxQuant * bboxSize.x + bboxMin.x;
-						vRaw[vertId].y = ((float)vertY) / maxQuant * bboxSize.y + bboxMin.y;
-						vRaw[vertId].z = ((float)vertZ) / maxQuant * bboxSize.z + bboxMin.z;
-						//					repoDebug << "After: (" << vRaw[vertId].x << "," << vRaw[vertId].y << ", " << vRaw[vertId].z << ")";
-					}
-				}
-#endif
 			std::string bufferFileName = scene->getRevisionID().toString();
 
 			size_t vStart = addToDataBuffer(bufferFileName, vertices);
-			size_t nStart = addToDataBuffer(bufferFileName, vertices);
+			size_t nStart = addToDataBuffer(bufferFileName, normals);
 			size_t fStart = addToDataBuffer(bufferFileName, sFaces);
 
 			std::string faceBufferName = meshId + "_" + GLTF_SUFFIX_FACES;
@@ -1154,105 +1323,111 @@ std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> GLT
 			std::string posBufferName = meshId + "_" + GLTF_SUFFIX_POSITION;
 
 			//for each mesh we need to add a bufferView for each buffer
-			addBufferView(normBufferName, bufferFileName, tree, normals, nStart, normals.size(), meshId);
-			addBufferView(posBufferName, bufferFileName, tree, vertices, vStart, vertices.size(), meshId);
-			addBufferView(faceBufferName, bufferFileName, tree, sFaces, fStart, faces.size(), meshId);
+			addBufferView(normBufferName, bufferFileName, normals, nStart, normals.size(), meshId);
+			addBufferView(posBufferName, bufferFileName, vertices, vStart, vertices.size(), meshId);
+			addBufferView(faceBufferName, bufferFileName, sFaces, fStart, nFaces, meshId);
 
 			for (size_t i = 0; i < UVs.size(); ++i)
 			{
 				size_t uvStart = addToDataBuffer(bufferFileName, UVs[i]);
 				std::string uvBufferName = meshId + "_" + GLTF_SUFFIX_TEX_COORD + "_" + std::to_string(i);
-				addBufferView(uvBufferName, bufferFileName, tree, UVs[i], uvStart, UVs[i].size(), meshId);
+				addBufferView(uvBufferName, bufferFileName, UVs[i], uvStart, UVs[i].size(), meshId);
 			}
 
-			std::vector<repo::lib::PropertyTree> primitives;
-			primitives.push_back(repo::lib::PropertyTree());
+			meshWriter.startArray(GLTF_LABEL_PRIMITIVES);
+			meshWriter.startObject();
 
 			std::string binFileName = scene->getRevisionID().toString();
 
 			if (hasMat)
 			{
-				primitives[0].addToTree(GLTF_LABEL_MATERIAL, matID.toString());
-				primitives[0].addToTree(GLTF_LABEL_PRIMITIVE, GLTF_PRIM_TYPE_TRIANGLE);
+				meshWriter.addMember(GLTF_LABEL_MATERIAL, matID.toString());
+				meshWriter.addMember(GLTF_LABEL_PRIMITIVE, GLTF_PRIM_TYPE_TRIANGLE);
 
-				if (faces.size())
+				if (nFaces)
 				{
 					std::string bufferName = meshId + "_" + GLTF_SUFFIX_FACES;
-					primitives[0].addToTree(GLTF_LABEL_INDICES, GLTF_PREFIX_ACCESSORS + "_" + bufferName);
-#if defined(DEBUG) && defined(LODLIMIT)
-					size_t triTo = (lods[0][0].size() < lodLimit ? lods[0][0].back() : lods[0][0][lodLimit - 1]) / 3;
-#else
-					size_t triTo = faces.size();
-#endif
-					addAccessors(bufferName, faceBufferName, tree, sFaces, 0, faces.size(), meshId);
+					meshWriter.addMember(GLTF_LABEL_INDICES, GLTF_PREFIX_ACCESSORS + "_" + bufferName);
+					addAccessors(bufferName, faceBufferName, sFaces, 0, nFaces, meshId);
 				}
 
 				//attributes
-				auto normals = node->getNormals();
+				meshWriter.startObject(GLTF_LABEL_ATTRIBUTES);
 				if (normals.size())
 				{
 					std::string bufferName = meshId + "_" + GLTF_SUFFIX_NORMALS;
-					primitives[0].addToTree(GLTF_LABEL_ATTRIBUTES + "." + GLTF_LABEL_NORMAL, GLTF_PREFIX_ACCESSORS + "_" + bufferName);
-					addAccessors(bufferName, normBufferName, tree, normals, 0, normals.size(), meshId);
+					meshWriter.addMember(GLTF_LABEL_NORMAL, GLTF_PREFIX_ACCESSORS + "_" + bufferName);
+					addAccessors(bufferName, normBufferName, normals, 0, normals.size(), meshId);
 				}
-				auto vertices = node->getVertices();
 				if (vertices.size())
 				{
 					std::string bufferName = meshId + "_" + GLTF_SUFFIX_POSITION;
-					primitives[0].addToTree(GLTF_LABEL_ATTRIBUTES + "." + GLTF_LABEL_POSITION, GLTF_PREFIX_ACCESSORS + "_" + bufferName);
-					addAccessors(bufferName, posBufferName, tree, vertices, 0, vertices.size(), meshId);
+					meshWriter.addMember(GLTF_LABEL_POSITION, GLTF_PREFIX_ACCESSORS + "_" + bufferName);
+					addAccessors(bufferName, posBufferName, vertices, 0, vertices.size(), meshId);
 				}
 
-				auto UVs = node->getUVChannelsSeparated();
 				if (UVs.size())
 				{
 					for (uint32_t i = 0; i < UVs.size(); ++i)
 					{
 						std::string bufferName = meshId + "_" + GLTF_SUFFIX_TEX_COORD + "_" + std::to_string(i);
-						primitives[0].addToTree(GLTF_LABEL_ATTRIBUTES + "." + GLTF_LABEL_TEXCOORD + "_" + std::to_string(i),
+						meshWriter.addMember(GLTF_LABEL_TEXCOORD + "_" + std::to_string(i),
 							GLTF_PREFIX_ACCESSORS + "_" + bufferName);
-						addAccessors(bufferName, bufferName, tree, UVs[i], 0, UVs[i].size(), meshId);
+						addAccessors(bufferName, bufferName, UVs[i], 0, UVs[i].size(), meshId);
 					}
 				}
+				meshWriter.endObject();
 			}
 
-			tree.addArrayObjects(label + "." + GLTF_LABEL_PRIMITIVES, primitives);
+			//Buffers are named after the first instance, list every instance this mesh stands for
+			if (buffers.instanceIDs.size())
+			{
+				meshWriter.startObject(GLTF_LABEL_EXTRA);
+				meshWriter.addMember(REPO_GLTF_LABEL_REF_ID, buffers.instanceIDs);
+				meshWriter.endObject();
+			}
+
+			meshWriter.endObject();
+			meshWriter.endArray();
+			meshWriter.endObject();
 		}
+
+		//Everything is copied into the document and the data buffers by now
+		buffers = gltf_mesh_buffers_t();
 	}
 	return splitSizes;
 }
 
-void GLTFModelExport::populateWithTextures(
-	repo::lib::PropertyTree           &tree)
+void GLTFModelExport::populateWithTextures()
 {
 	repo::core::model::RepoNodeSet textures = scene->getAllTextures(gType);
 
-	writeDefaultSampler(tree);
+	writeDefaultSampler();
 
 	for (const auto &texture : textures)
 	{
 		const repo::core::model::TextureNode *node = (const repo::core::model::TextureNode *)texture;
 		const std::string textureID = node->getUniqueID().toString();
-		const std::string label = GLTF_LABEL_TEXTURES + "." + textureID;
 		const std::string imageName = GLTF_PREFIX_TEXTURE + "_" + textureID;
-		tree.addToTree(label + "." + GLTF_LABEL_FORMAT, GLTF_FORMAT_RGBA);
-		tree.addToTree(label + "." + GLTF_LABEL_INTERNAL_FORMAT, GLTF_FORMAT_RGBA);
-		tree.addToTree(label + "." + GLTF_LABEL_SOURCE, imageName);
-		tree.addToTree(label + "." + GLTF_LABEL_SAMPLER, REPO_GLTF_DEFAULT_SAMPLER);
-		tree.addToTree(label + "." + GLTF_LABEL_TARGET, GLTF_TYPE_TEXTURE_2D);
-		tree.addToTree(label + "." + GLTF_LABEL_TYPE, GLTF_TYPE_UNSIGNED_BYTES);
-		tree.addToTree(label + "." + GLTF_LABEL_NAME, node->getName());
-
-		const std::string imageLabel = GLTF_LABEL_IMAGES + "." + imageName;
-
+		repo::lib::JSONWriter &textureWriter = startSectionObject(GLTF_LABEL_TEXTURES, textureID);
+		textureWriter.addMember(GLTF_LABEL_FORMAT, GLTF_FORMAT_RGBA);
+		textureWriter.addMember(GLTF_LABEL_INTERNAL_FORMAT, GLTF_FORMAT_RGBA);
+		textureWriter.addMember(GLTF_LABEL_SOURCE, imageName);
+		textureWriter.addMember(GLTF_LABEL_SAMPLER, REPO_GLTF_DEFAULT_SAMPLER);
+		textureWriter.addMember(GLTF_LABEL_TARGET, GLTF_TYPE_TEXTURE_2D);
+		textureWriter.addMember(GLTF_LABEL_TYPE, GLTF_TYPE_UNSIGNED_BYTES);
+		textureWriter.addMember(GLTF_LABEL_NAME, node->getName());
+		textureWriter.endObject();
+
+		repo::lib::JSONWriter &imageWriter = startSectionObject(GLTF_LABEL_IMAGES, imageName);
 		//FIXME: this should be an api or something to drag the image out
-		tree.addToTree(imageLabel + "." + GLTF_LABEL_URI, node->getName());
-		tree.addToTree(imageLabel + "." + GLTF_LABEL_NAME, node->getName());
+		imageWriter.addMember(GLTF_LABEL_URI, node->getName());
+		imageWriter.addMember(GLTF_LABEL_NAME, node->getName());
+		imageWriter.endObject();
 	}
 }
 
 void GLTFModelExport::populateWithNodes(
-	repo::lib::PropertyTree          &tree,
 	const std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> &subMeshCounts)
 {
 	repo::core::model::RepoNodeSet trans = scene->getAllTransformations(gType);
@@ -1260,76 +1435,110 @@ void GLTFModelExport::populateWithNodes(
 	{
 		const repo::core::model::TransformationNode *node = (const repo::core::model::TransformationNode *)tran;
 		//add to list of nodes
-		std::string label = GLTF_LABEL_NODES + "." + node->getUniqueID().toString();
+		repo::lib::JSONWriter &writer = startSectionObject(GLTF_LABEL_NODES, node->getUniqueID().toString());
 		std::string name = node->getName();
 		if (!name.empty())
-			tree.addToTree(label + "." + GLTF_LABEL_NAME, node->getName());
+			writer.addMember(GLTF_LABEL_NAME, node->getName());
 		const repo::core::model::TransformationNode *transNode = (const repo::core::model::TransformationNode*) node;
 		if (!transNode->isIdentity())
 		{
-			tree.addToTree(label + "." + GLTF_LABEL_MATRIX, transNode->getTransMatrix(false).getData());
+			writer.addMember(GLTF_LABEL_MATRIX, transNode->getTransMatrix(false).getData());
 		}
-		processNodeChildren(node, tree, subMeshCounts);
+		processNodeChildren(node, writer, subMeshCounts);
+		writer.endObject();
 	}
 }
 
-std::vector<std::vector<std::vector<uint16_t>>> GLTFModelExport::reorderFaces(
-	std::vector<uint16_t>                         &faces,
-	const std::vector<repo::lib::RepoVector3D>                    &vertices,
+template <typename T>
+static std::vector<std::vector<std::vector<uint32_t>>> reorderAllFaces(
+	std::vector<T>                                      &faces,
+	const std::vector<repo::lib::RepoVector3D>          &vertices,
 	const std::vector<std::vector<repo_mesh_mapping_t>> &mapping)
 {
-	std::vector<std::vector<std::vector<uint16_t>>> lods;
+	std::vector<std::vector<std::vector<uint32_t>>> lods(mapping.size());
+	std::vector<std::pair<size_t, size_t>> subMeshes;
 	for (size_t i = 0; i < mapping.size(); ++i)
 	{
-		lods.resize(lods.size() + 1);
-		lods.back().clear();
+		lods[i].resize(mapping[i].size());
 		for (size_t j = 0; j < mapping[i].size(); ++j)
-		{
-			lods[i].resize(lods[i].size() + 1);
-			lods[i].back().clear();
-			std::vector<uint16_t> newFaces = reorderFaces(faces, vertices, mapping[i][j], lods[i].back());
-			std::copy(newFaces.begin(), newFaces.end(), faces.begin() + mapping[i][j].triFrom * 3);
-		}
+			subMeshes.push_back({ i, j });
 	}
+
+	//Sub meshes cover disjoint ranges of the face buffer, so they can be reordered concurrently
+	repo::lib::parallelFor(subMeshes.size(), [&](const size_t &idx)
+	{
+		const repo_mesh_mapping_t &subMesh = mapping[subMeshes[idx].first][subMeshes[idx].second];
+		std::vector<T> newFaces = GLTFModelExport::reorderFaces(faces, vertices, subMesh, lods[subMeshes[idx].first][subMeshes[idx].second]);
+		std::copy(newFaces.begin(), newFaces.end(), faces.begin() + subMesh.triFrom * 3);
+	});
+
 	return lods;
 }
 
-std::vector<uint16_t> GLTFModelExport::reorderFaces(
-	const std::vector<uint16_t>      &faces,
+/**
+* Quantise a coordinate relative to the bounding box of its sub mesh
+* (evaluated as ((value - min) / size) * maxQuant, in this order, so the
+* levels of detail do not change)
+* @param value coordinate to quantise
+* @param min minimum of the bounding box on this axis
+* @param size size of the bounding box on this axis
+* @param maxQuant largest quantised value
+* @return returns the quantised coordinate, 0 on a flat axis
+*/
+static uint32_t quantise(
+	const float &value,
+	const float &min,
+	const float &size,
+	const float &maxQuant)
+{
+	if (!(size > 0))
+		return 0;
+	const float quantised = floorf(((value - min) / size) * maxQuant + 0.5);
+	return (uint32_t)std::max(0.0f, std::min(quantised, maxQuant));
+}
+
+template <typename T>
+static std::vector<T> reorderSubMeshFaces(
+	const std::vector<T>                       &faces,
 	const std::vector<repo::lib::RepoVector3D> &vertices,
-	const repo_mesh_mapping_t        &mapping,
-	std::vector<uint16_t>      &lods) const
+	const repo_mesh_mapping_t                  &mapping,
+	std::vector<uint32_t>                      &lods)
 {
 	const uint32_t maxBits = 16;
 	const float maxQuant = pow(2, maxBits) - 1;
+	const uint32_t shift = maxBits - lodLimit;
 
 	const repo::lib::RepoVector3D *vRaw = &vertices[mapping.vertFrom];
-	const uint16_t      *fRaw = &faces[mapping.triFrom * 3];
+	const T             *fRaw = &faces[mapping.triFrom * 3];
 
 	const size_t vCount = mapping.vertTo - mapping.vertFrom;
 	const size_t fCount = mapping.triTo - mapping.triFrom;
 
-	//use int32_t because we need to represent all values in uint16_t and also -1
-	std::vector<int32_t> vertexMap;
-	vertexMap.resize(vCount);
-
-	//Instantiate with -1s
-	std::fill(vertexMap.begin(), vertexMap.end(), -1);
-
-	std::vector<bool> validFaces;
-	validFaces.resize(fCount);
-
-	//Instantiate with false
-	std::fill(validFaces.begin(), validFaces.end(), false);
-
-	std::vector<uint16_t> reOrderedFaces;
+	std::vector<T> reOrderedFaces;
 	reOrderedFaces.reserve(fCount * 3);
 
 	repo::lib::RepoVector3D bboxMin = mapping.min;
 	repo::lib::RepoVector3D bboxSize = { mapping.max.x - bboxMin.x, mapping.max.y - bboxMin.y, mapping.max.z - bboxMin.z };
 
-	std::vector<uint32_t> quantIndex;
-	quantIndex.resize(vCount);
+	/**
+	* The quantised position of a vertex is the same on every level of detail,
+	* only the way its components are combined into a cell index changes.
+	* So quantise once here and derive the index of each level with shifts
+	*/
+	std::vector<uint32_t> quantX(vCount), quantY(vCount), quantZ(vCount);
+	for (size_t vertId = 0; vertId < vCount; ++vertId)
+	{
+		quantX[vertId] = (quantise(vRaw[vertId].x, bboxMin.x, bboxSize.x, maxQuant) >> shift) << shift;
+		quantY[vertId] = (quantise(vRaw[vertId].y, bboxMin.y, bboxSize.y, maxQuant) >> shift) << shift;
+		quantZ[vertId] = (quantise(vRaw[vertId].z, bboxMin.z, bboxSize.z, maxQuant) >> shift) << shift;
+	}
+
+	//Faces not yet added by a previous level of detail, in their original order
+	std::vector<uint32_t> pendingFaces(fCount);
+	for (size_t triIdx = 0; triIdx < fCount; ++triIdx)
+		pendingFaces[triIdx] = triIdx;
+
+	std::vector<uint32_t> quantIndex(vCount);
 	/**
 	* Every level of detail, we need to identify the quantized vertices
 	* see which face should be degenerated.
@@ -1337,53 +1546,42 @@ std::vector<uint16_t> GLTFModelExport::reorderFaces(
 	*/
 	for (uint32_t lod = 0; lod < maxBits; ++lod)
 	{
-		uint32_t dim = pow(2, (maxBits - lod));
-		uint32_t shift = maxBits - lodLimit;
-
-		// For all non mapped vertices compute quantization
+		//index = x + y * dim + z * dim * dim with dim = 2^(maxBits - lod), wrapping at 32 bits
+		const uint32_t dimBits = maxBits - lod;
 		for (size_t vertId = 0; vertId < vCount; ++vertId)
 		{
-			if (vertexMap[vertId] == -1)
-			{
-				uint32_t vertXNormal = floorf(((vRaw[vertId].x - bboxMin.x) / bboxSize.x) * maxQuant + 0.5);
-				uint32_t vertYNormal = floorf(((vRaw[vertId].y - bboxMin.y) / bboxSize.y) * maxQuant + 0.5);
-				uint32_t vertZNormal = floorf(((vRaw[vertId].z - bboxMin.z) / bboxSize.z) * maxQuant + 0.5);
-
-				uint32_t vertX = (vertXNormal >> shift) << shift;
-				uint32_t vertY = (vertYNormal >> shift) << shift;
-				uint32_t vertZ = (vertZNormal >> shift) << shift;
-
-				quantIndex[vertId] = vertX + vertY * dim + vertZ * dim * dim;
-			}
+			quantIndex[vertId] = (uint32_t)(quantX[vertId]
+				+ ((uint64_t)quantY[vertId] << dimBits)
+				+ ((uint64_t)quantZ[vertId] << (2 * dimBits)));
 		}
 
 		//check if any faces appear in this quantization
-		for (size_t triIdx = 0; triIdx < fCount; ++triIdx)
+		size_t nPending = 0;
+		for (const auto &triIdx : pendingFaces)
 		{
 			size_t startIdx = triIdx * 3;
-			//If this face has not been added from previous LODs
-			if (!validFaces[triIdx])
-			{
-				//the face should not be rendered if more than 1 vertex fall into the same quantized region
-				uint32_t currQuantX = quantIndex[fRaw[startIdx]];
-				uint32_t currQuantY = quantIndex[fRaw[startIdx + 1]];
-				uint32_t currQuantZ = quantIndex[fRaw[startIdx + 2]];
-
-				if (currQuantX != currQuantY && currQuantX != currQuantY && currQuantY != currQuantZ || lod == maxBits - 1)
-				{
-					//Add this face to the new face buffer
-					reOrderedFaces.push_back(fRaw[startIdx]);
-					reOrderedFaces.push_back(fRaw[startIdx + 1]);
-					reOrderedFaces.push_back(fRaw[startIdx + 2]);
+			//the face should not be rendered if more than 1 vertex fall into the same quantized region
+			uint32_t currQuantX = quantIndex[fRaw[startIdx]];
+			uint32_t currQuantY = quantIndex[fRaw[startIdx + 1]];
+			uint32_t currQuantZ = quantIndex[fRaw[startIdx + 2]];
 
-					validFaces[triIdx] = true;
-				}
+			if (currQuantX != currQuantY && currQuantX != currQuantY && currQuantY != currQuantZ || lod == maxBits - 1)
+			{
+				//Add this face to the new face buffer
+				reOrderedFaces.push_back(fRaw[startIdx]);
+				reOrderedFaces.push_back(fRaw[startIdx + 1]);
+				reOrderedFaces.push_back(fRaw[startIdx + 2]);
+			}
+			else
+			{
+				pendingFaces[nPending++] = triIdx;
 			}
 		}
+		pendingFaces.resize(nPending);
 
 		lods.push_back(reOrderedFaces.size());
 
-		if (reOrderedFaces.size() == fCount * 3)
+		if (pendingFaces.empty())
 			break;
 	}
 
@@ -1396,8 +1594,130 @@ std::vector<uint16_t> GLTFModelExport::reorderFaces(
 	return reOrderedFaces;
 }
 
+template <typename T>
+static void optimiseAllVertexCaches(
+	std::vector<T>                                        &faces,
+	const std::vector<std::vector<repo_mesh_mapping_t>>   &mapping,
+	const std::vector<std::vector<std::vector<uint32_t>>> &lods,
+	std::vector<repo::lib::RepoVector3D>                  &vertices,
+	std::vector<repo::lib::RepoVector3D>                  &normals,
+	std::vector<std::vector<repo::lib::RepoVector2D>>     &uvChannels,
+	std::vector<std::vector<float>>                       &idMaps)
+{
+	std::vector<std::pair<size_t, size_t>> subMeshes;
+	for (size_t i = 0; i < mapping.size(); ++i)
+	{
+		for (size_t j = 0; j < mapping[i].size(); ++j)
+			subMeshes.push_back({ i, j });
+	}
+
+	//Sub meshes own disjoint ranges of faces and vertices
+	repo::lib::parallelFor(subMeshes.size(), [&](const size_t &idx)
+	{
+		const size_t i = subMeshes[idx].first;
+		const size_t j = subMeshes[idx].second;
+		const repo_mesh_mapping_t &subMesh = mapping[i][j];
+		const size_t vCount = subMesh.vertTo - subMesh.vertFrom;
+		const size_t nIndices = (subMesh.triTo - subMesh.triFrom) * 3;
+		if (!nIndices)
+			return;
+		T *fRaw = &faces[subMesh.triFrom * 3];
+
+		//Faces are only reordered within a LOD band, so every LOD remains a prefix of the faces
+		size_t bandStart = 0;
+		if (lods.size() > i && lods[i].size() > j)
+		{
+			for (const auto &lodEnd : lods[i][j])
+			{
+				const size_t bandEnd = std::min((size_t)lodEnd, nIndices);
+				if (bandEnd > bandStart)
+				{
+					repo::lib::optimiseVertexCache(fRaw + bandStart, bandEnd - bandStart, vCount);
+					bandStart = bandEnd;
+				}
+			}
+		}
+		if (bandStart < nIndices)
+			repo::lib::optimiseVertexCache(fRaw + bandStart, nIndices - bandStart, vCount);
+
+		auto newToOld = repo::lib::optimiseVertexFetch(fRaw, nIndices, vCount);
+		if (newToOld.empty())
+		{
+			repoError << "Faces of sub mesh " << subMesh.mesh_id << " are out of its vertex range, vertices are left as they are";
+			return;
+		}
+
+		repo::lib::remapVertexAttributes(vertices, subMesh.vertFrom, newToOld);
+		if (normals.size())
+			repo::lib::remapVertexAttributes(normals, subMesh.vertFrom, newToOld);
+		for (auto &channel : uvChannels)
+			repo::lib::remapVertexAttributes(channel, subMesh.vertFrom, newToOld);
+		//ID maps are per split
+		if (idMaps.size() > i)
+			repo::lib::remapVertexAttributes(idMaps[i], subMesh.vertFrom - mapping[i].front().vertFrom, newToOld);
+	});
+}
+
+std::vector<std::vector<std::vector<uint32_t>>> GLTFModelExport::reorderFaces(
+	std::vector<uint16_t>                               &faces,
+	const std::vector<repo::lib::RepoVector3D>          &vertices,
+	const std::vector<std::vector<repo_mesh_mapping_t>> &mapping)
+{
+	return reorderAllFaces(faces, vertices, mapping);
+}
+
+std::vector<std::vector<std::vector<uint32_t>>> GLTFModelExport::reorderFaces(
+	std::vector<uint32_t>                               &faces,
+	const std::vector<repo::lib::RepoVector3D>          &vertices,
+	const std::vector<std::vector<repo_mesh_mapping_t>> &mapping)
+{
+	return reorderAllFaces(faces, vertices, mapping);
+}
+
+std::vector<uint16_t> GLTFModelExport::reorderFaces(
+	const std::vector<uint16_t>                &faces,
+	const std::vector<repo::lib::RepoVector3D> &vertices,
+	const repo_mesh_mapping_t                  &mapping,
+	std::vector<uint32_t>                      &lods)
+{
+	return reorderSubMeshFaces(faces, vertices, mapping, lods);
+}
+
+std::vector<uint32_t> GLTFModelExport::reorderFaces(
+	const std::vector<uint32_t>                &faces,
+	const std::vector<repo::lib::RepoVector3D> &vertices,
+	const repo_mesh_mapping_t                  &mapping,
+	std::vector<uint32_t>                      &lods)
+{
+	return reorderSubMeshFaces(faces, vertices, mapping, lods);
+}
+
+void GLTFModelExport::optimiseVertexCache(
+	std::vector<uint16_t>                                 &faces,
+	const std::vector<std::vector<repo_mesh_mapping_t>>   &mapping,
+	const std::vector<std::vector<std::vector<uint32_t>>> &lods,
+	std::vector<repo::lib::RepoVector3D>                  &vertices,
+	std::vector<repo::lib::RepoVector3D>                  &normals,
+	std::vector<std::vector<repo::lib::RepoVector2D>>     &uvChannels,
+	std::vector<std::vector<float>>                       &idMaps)
+{
+	optimiseAllVertexCaches(faces, mapping, lods, vertices, normals, uvChannels, idMaps);
+}
+
+void GLTFModelExport::optimiseVertexCache(
+	std::vector<uint32_t>                                 &faces,
+	const std::vector<std::vector<repo_mesh_mapping_t>>   &mapping,
+	const std::vector<std::vector<std::vector<uint32_t>>> &lods,
+	std::vector<repo::lib::RepoVector3D>                  &vertices,
+	std::vector<repo::lib::RepoVector3D>                  &normals,
+	std::vector<std::vector<repo::lib::RepoVector2D>>     &uvChannels,
+	std::vector<std::vector<float>>                       &idMaps)
+{
+	optimiseAllVertexCaches(faces, mapping, lods, vertices, normals, uvChannels, idMaps);
+}
+
 std::vector<uint16_t> GLTFModelExport::serialiseFaces(
-	const std::vector<repo_face_t> &faces) const
+	const std::vector<repo_face_t> &faces)
 {
 	std::vector<uint16_t> sFaces;
 
@@ -1418,112 +1738,158 @@ std::vector<uint16_t> GLTFModelExport::serialiseFaces(
 	return sFaces;
 }
 
-void GLTFModelExport::writeBuffers(
-	repo::lib::PropertyTree &tree)
+void GLTFModelExport::writeBuffers()
 {
+	//Buffers already handed over to the sink are declared with the size they had
+	std::map<std::string, size_t> bufferSizes(streamedBufferSizes.begin(), streamedBufferSizes.end());
 	for (const auto &pair : fullDataBuffer)
+		bufferSizes[pair.first] = pair.second.size() * sizeof(*pair.second.data());
+
+	for (const auto &pair : bufferSizes)
 	{
 #ifdef DEBUG
 		std::string bufferFilePrefix = "/";
 #else
 		std::string bufferFilePrefix = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/";
 #endif
-		std::string bufferLabel = GLTF_LABEL_BUFFERS + "." + pair.first;
-		tree.addToTree(bufferLabel + "." + GLTF_LABEL_BYTE_LENGTH, pair.second.size()  * sizeof(*pair.second.data()));
-		tree.addToTree(bufferLabel + "." + GLTF_LABEL_TYPE, GLTF_ARRAY_BUFFER);
-		tree.addToTree(bufferLabel + "." + GLTF_LABEL_URI, "/api" + bufferFilePrefix + pair.first + ".bin");
+		repo::lib::JSONWriter &writer = startSectionObject(GLTF_LABEL_BUFFERS, pair.first);
+		writer.addMember(GLTF_LABEL_BYTE_LENGTH, pair.second);
+		writer.addMember(GLTF_LABEL_TYPE, GLTF_ARRAY_BUFFER);
+		writer.addMember(GLTF_LABEL_URI, "/api" + bufferFilePrefix + pair.first + ".bin");
+		writer.endObject();
 	}
 }
 
-void GLTFModelExport::writeDefaultSampler(
-	repo::lib::PropertyTree &tree)
+void GLTFModelExport::writeDefaultSampler()
 {
-	const std::string label = GLTF_LABEL_SAMPLERS + "." + REPO_GLTF_DEFAULT_SAMPLER;
-	tree.addToTree(label + "." + GLTF_LABEL_FILTER_MAG, GLTF_FILTER_TYPE_LINEAR);
-	tree.addToTree(label + "." + GLTF_LABEL_FILTER_MIN, GLTF_FILTER_TYPE_NEAREST_MIPMAP_LINEAR);
-	tree.addToTree(label + "." + GLTF_LABEL_WRAP_S, GLTF_WRAP_MODE_REPEAT);
-	tree.addToTree(label + "." + GLTF_LABEL_WRAP_T, GLTF_WRAP_MODE_REPEAT);
+	repo::lib::JSONWriter &writer = startSectionObject(GLTF_LABEL_SAMPLERS, REPO_GLTF_DEFAULT_SAMPLER);
+	writer.addMember(GLTF_LABEL_FILTER_MAG, GLTF_FILTER_TYPE_LINEAR);
+	writer.addMember(GLTF_LABEL_FILTER_MIN, GLTF_FILTER_TYPE_NEAREST_MIPMAP_LINEAR);
+	writer.addMember(GLTF_LABEL_WRAP_S, GLTF_WRAP_MODE_REPEAT);
+	writer.addMember(GLTF_LABEL_WRAP_T, GLTF_WRAP_MODE_REPEAT);
+	writer.endObject();
 }
 
-void GLTFModelExport::writeDefaultTechnique(
-	repo::lib::PropertyTree &tree)
+void GLTFModelExport::writeDefaultTechnique()
 {
 	//========== DEFAULT TECHNIQUE =========
-	const std::string label = GLTF_LABEL_TECHNIQUES + "." + REPO_GLTF_DEFAULT_TECHNIQUE;
-	const std::string paramlabel = label + "." + GLTF_LABEL_PARAMETERS;
-
-	tree.addToTree(paramlabel + ".modelViewMatrix." + GLTF_LABEL_SEMANTIC, "MODELVIEW");
-	tree.addToTree(paramlabel + ".modelViewMatrix." + GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_MAT4);
-
-	tree.addToTree(paramlabel + ".normal." + GLTF_LABEL_SEMANTIC, GLTF_LABEL_NORMAL);
-	tree.addToTree(paramlabel + ".normal." + GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC3);
-
-	tree.addToTree(paramlabel + ".normalMatrix." + GLTF_LABEL_SEMANTIC, "MODELVIEWINVERSETRANSPOSE");
-	tree.addToTree(paramlabel + ".normalMatrix." + GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_MAT4);
-
-	tree.addToTree(paramlabel + ".position." + GLTF_LABEL_SEMANTIC, GLTF_LABEL_POSITION);
-	tree.addToTree(paramlabel + ".position." + GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC3);
-
-	tree.addToTree(paramlabel + ".texcoord0." + GLTF_LABEL_SEMANTIC, GLTF_LABEL_TEXCOORD + "_0");
-	tree.addToTree(paramlabel + ".texcoord0." + GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC2);
-
-	tree.addToTree(paramlabel + ".projectionMatrix." + GLTF_LABEL_SEMANTIC, "PROJECTION");
-	tree.addToTree(paramlabel + ".projectionMatrix." + GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_MAT4);
-
-	tree.addToTree(paramlabel + "." + GLTF_LABEL_SHININESS + "." + GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT);
-	tree.addToTree(paramlabel + "." + GLTF_LABEL_SHININESS + "." + GLTF_LABEL_VALUE, REPO_GLTF_DEFAULT_SHININESS);
-	tree.addToTree(paramlabel + "." + GLTF_LABEL_DIFFUSE + "." + GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC4);
-	tree.addToTree(paramlabel + "." + GLTF_LABEL_SPECULAR + "." + GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC4);
-	tree.addToTree(paramlabel + "." + GLTF_LABEL_SPECULAR + "." + GLTF_LABEL_VALUE, REPO_GLTF_DEFAULT_SPECULAR);
-
-	tree.addToTree(label + "." + GLTF_LABEL_PROGRAM, REPO_GLTF_DEFAULT_PROGRAM);
-
-	const std::string stateslabel = label + "." + GLTF_LABEL_STATES;
+	repo::lib::JSONWriter &technique = startSectionObject(GLTF_LABEL_TECHNIQUES, REPO_GLTF_DEFAULT_TECHNIQUE);
+	technique.startObject(GLTF_LABEL_PARAMETERS);
+
+	technique.startObject("modelViewMatrix");
+	technique.addMember(GLTF_LABEL_SEMANTIC, "MODELVIEW");
+	technique.addMember(GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_MAT4);
+	technique.endObject();
+
+	technique.startObject("normal");
+	technique.addMember(GLTF_LABEL_SEMANTIC, GLTF_LABEL_NORMAL);
+	technique.addMember(GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC3);
+	technique.endObject();
+
+	technique.startObject("normalMatrix");
+	technique.addMember(GLTF_LABEL_SEMANTIC, "MODELVIEWINVERSETRANSPOSE");
+	technique.addMember(GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_MAT4);
+	technique.endObject();
+
+	technique.startObject("position");
+	technique.addMember(GLTF_LABEL_SEMANTIC, GLTF_LABEL_POSITION);
+	technique.addMember(GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC3);
+	technique.endObject();
+
+	technique.startObject("texcoord0");
+	technique.addMember(GLTF_LABEL_SEMANTIC, GLTF_LABEL_TEXCOORD + "_0");
+	technique.addMember(GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC2);
+	technique.endObject();
+
+	technique.startObject("projectionMatrix");
+	technique.addMember(GLTF_LABEL_SEMANTIC, "PROJECTION");
+	technique.addMember(GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_MAT4);
+	technique.endObject();
+
+	technique.startObject(GLTF_LABEL_SHININESS);
+	technique.addMember(GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT);
+	technique.addMember(GLTF_LABEL_VALUE, REPO_GLTF_DEFAULT_SHININESS);
+	technique.endObject();
+
+	technique.startObject(GLTF_LABEL_DIFFUSE);
+	technique.addMember(GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC4);
+	technique.endObject();
+
+	technique.startObject(GLTF_LABEL_SPECULAR);
+	technique.addMember(GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC4);
+	technique.addMember(GLTF_LABEL_VALUE, REPO_GLTF_DEFAULT_SPECULAR);
+	technique.endObject();
+
+	technique.endObject();
+
+	technique.addMember(GLTF_LABEL_PROGRAM, REPO_GLTF_DEFAULT_PROGRAM);
+
+	technique.startObject(GLTF_LABEL_STATES);
 	std::vector<uint32_t> states = { GLTF_STATE_DEPTH_TEST, GLTF_STATE_CULL_FACE };
-	tree.addToTree(stateslabel + "." + GLTF_LABEL_ENABLE, states);
-
-	const std::string uniformLabel = label + "." + GLTF_LABEL_UNIFORMS;
-
-	tree.addToTree(uniformLabel + ".u_diffuse", GLTF_LABEL_DIFFUSE);
-	tree.addToTree(uniformLabel + ".modelViewMatrix", "modelViewMatrix");
-	tree.addToTree(uniformLabel + ".normalMatrix", "normalMatrix");
-	tree.addToTree(uniformLabel + ".projectionMatrix", "projectionMatrix");
-	tree.addToTree(uniformLabel + ".u_shininess", GLTF_LABEL_SHININESS);
-	tree.addToTree(uniformLabel + ".u_specular", GLTF_LABEL_SPECULAR);
-
-	const std::string attriLabel = label + "." + GLTF_LABEL_ATTRIBUTES;
-	tree.addToTree(attriLabel + ".normal", "normal");
-	tree.addToTree(attriLabel + ".position", "position");
-	tree.addToTree(attriLabel + ".a_texcoord0", "texcoord0");
-
-	const std::string extraLabel = label + "." + GLTF_LABEL_EXTRA;
-	tree.addToTree(extraLabel + ".varyings.v_normal." + GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC3);
+	technique.addMember(GLTF_LABEL_ENABLE, states);
+	technique.endObject();
+
+	technique.startObject(GLTF_LABEL_UNIFORMS);
+	technique.addMember("u_diffuse", GLTF_LABEL_DIFFUSE);
+	technique.addMember("modelViewMatrix", "modelViewMatrix");
+	technique.addMember("normalMatrix", "normalMatrix");
+	technique.addMember("projectionMatrix", "projectionMatrix");
+	technique.addMember("u_shininess", GLTF_LABEL_SHININESS);
+	technique.addMember("u_specular", GLTF_LABEL_SPECULAR);
+	technique.endObject();
+
+	technique.startObject(GLTF_LABEL_ATTRIBUTES);
+	technique.addMember("normal", "normal");
+	technique.addMember("position", "position");
+	technique.addMember("a_texcoord0", "texcoord0");
+	technique.endObject();
+
+	technique.startObject(GLTF_LABEL_EXTRA);
+	technique.startObject("varyings");
+	technique.startObject("v_normal");
+	technique.addMember(GLTF_LABEL_TYPE, GLTF_COMP_TYPE_FLOAT_VEC3);
+	technique.endObject();
+	technique.endObject();
+	technique.endObject();
+
+	technique.endObject();
 
 	//========== DEFAULT PROGRAM =========
-	const std::string programLabel = GLTF_LABEL_PROGRAMS + "." + REPO_GLTF_DEFAULT_PROGRAM;
+	repo::lib::JSONWriter &program = startSectionObject(GLTF_LABEL_PROGRAMS, REPO_GLTF_DEFAULT_PROGRAM);
 	std::vector<std::string> programAttributes = { "normal", "position" };
-	tree.addToTree(programLabel + "." + GLTF_LABEL_ATTRIBUTES, programAttributes);
-	tree.addToTree(programLabel + "." + GLTF_LABEL_SHADER_FRAG, REPO_GLTF_DEFAULT_SHADER_FRAG);
-	tree.addToTree(programLabel + "." + GLTF_LABEL_SHADER_VERT, REPO_GLTF_DEFAULT_SHADER_VERT);
+	program.addMember(GLTF_LABEL_ATTRIBUTES, programAttributes);
+	program.addMember(GLTF_LABEL_SHADER_FRAG, REPO_GLTF_DEFAULT_SHADER_FRAG);
+	program.addMember(GLTF_LABEL_SHADER_VERT, REPO_GLTF_DEFAULT_SHADER_VERT);
+	program.endObject();
 
 	//========== DEFAULT SHADERS =========
-	tree.addToTree(GLTF_LABEL_SHADERS + "." + REPO_GLTF_DEFAULT_SHADER_FRAG + "." + GLTF_LABEL_TYPE, GLTF_SHADER_TYPE_FRAGMENT);
-	tree.addToTree(GLTF_LABEL_SHADERS + "." + REPO_GLTF_DEFAULT_SHADER_FRAG + "." + GLTF_LABEL_URI, REPO_GLTF_DEFAULT_SHADER_FRAG_URI);
+	repo::lib::JSONWriter &fragShader = startSectionObject(GLTF_LABEL_SHADERS, REPO_GLTF_DEFAULT_SHADER_FRAG);
+	fragShader.addMember(GLTF_LABEL_TYPE, GLTF_SHADER_TYPE_FRAGMENT);
+	fragShader.addMember(GLTF_LABEL_URI, REPO_GLTF_DEFAULT_SHADER_FRAG_URI);
 	//x3d shader
-	std::string x3dShaderFragLabel = GLTF_LABEL_SHADERS + "." + REPO_GLTF_DEFAULT_SHADER_FRAG + "." + GLTF_LABEL_EXTRA + ".x3domShaderFunction";
-	tree.addToTree(x3dShaderFragLabel + "." + GLTF_LABEL_URI, REPO_GLTF_DEFAULT_X3DSHADER_FRAG_URI);
-	tree.addToTree(x3dShaderFragLabel + "." + GLTF_LABEL_NAME, "x3dmain");
+	fragShader.startObject(GLTF_LABEL_EXTRA);
+	fragShader.startObject("x3domShaderFunction");
+	fragShader.addMember(GLTF_LABEL_URI, REPO_GLTF_DEFAULT_X3DSHADER_FRAG_URI);
+	fragShader.addMember(GLTF_LABEL_NAME, "x3dmain");
 	std::vector<std::string> fragParameters = { "v_normal", "u_diffuse", "u_specular", "u_shininess" };
-	tree.addToTree(x3dShaderFragLabel + "." + GLTF_LABEL_PARAMETERS, fragParameters);
-	tree.addToTree(x3dShaderFragLabel + "." + "returns", "gl_FragColor");
-
-	tree.addToTree(GLTF_LABEL_SHADERS + "." + REPO_GLTF_DEFAULT_SHADER_VERT + "." + GLTF_LABEL_TYPE, GLTF_SHADER_TYPE_VERTEX);
-	tree.addToTree(GLTF_LABEL_SHADERS + "." + REPO_GLTF_DEFAULT_SHADER_VERT + "." + GLTF_LABEL_URI, REPO_GLTF_DEFAULT_SHADER_VERT_URI);
+	fragShader.addMember(GLTF_LABEL_PARAMETERS, fragParameters);
+	fragShader.addMember("returns", "gl_FragColor");
+	fragShader.endObject();
+	fragShader.endObject();
+	fragShader.endObject();
+
+	repo::lib::JSONWriter &vertShader = startSectionObject(GLTF_LABEL_SHADERS, REPO_GLTF_DEFAULT_SHADER_VERT);
+	vertShader.addMember(GLTF_LABEL_TYPE, GLTF_SHADER_TYPE_VERTEX);
+	vertShader.addMember(GLTF_LABEL_URI, REPO_GLTF_DEFAULT_SHADER_VERT_URI);
 	//x3d shader
-	std::string x3dShaderVertLabel = GLTF_LABEL_SHADERS + "." + REPO_GLTF_DEFAULT_SHADER_VERT + "." + GLTF_LABEL_EXTRA + ".x3domShaderFunction";
-	tree.addToTree(x3dShaderVertLabel + "." + GLTF_LABEL_URI, REPO_GLTF_DEFAULT_X3DSHADER_VERT_URI);
-	tree.addToTree(x3dShaderVertLabel + "." + GLTF_LABEL_NAME, "x3dmain");
+	vertShader.startObject(GLTF_LABEL_EXTRA);
+	vertShader.startObject("x3domShaderFunction");
+	vertShader.addMember(GLTF_LABEL_URI, REPO_GLTF_DEFAULT_X3DSHADER_VERT_URI);
+	vertShader.addMember(GLTF_LABEL_NAME, "x3dmain");
 	std::vector<std::string> vertParameters = { "position", "normal", "v_normal", "normalMatrix", "modelViewMatrix", "projectionMatrix" };
-	tree.addToTree(x3dShaderVertLabel + "." + GLTF_LABEL_PARAMETERS, vertParameters);
-	tree.addToTree(x3dShaderVertLabel + "." + "returns", "gl_Position");
-}
\ No newline at end of file
+	vertShader.addMember(GLTF_LABEL_PARAMETERS, vertParameters);
+	vertShader.addMember("returns", "gl_Position");
+	vertShader.endObject();
+	vertShader.endObject();
+	vertShader.endObject();
+}
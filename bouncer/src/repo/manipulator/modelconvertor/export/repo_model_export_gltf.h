@@ -21,11 +21,14 @@
 
 #pragma once
 
+#include <map>
 #include <string>
+#include <unordered_set>
 
 #include "repo_model_export_web.h"
-#include "../../../lib/repo_property_tree.h"
+#include "../../../lib/repo_json_writer.h"
 #include "../../../core/model/collection/repo_scene.h"
+#include "../../../core/model/bson/repo_node_mesh.h"
 
 namespace repo{
 	namespace manipulator{
@@ -36,8 +39,13 @@ namespace repo{
 				/**
 				* Default Constructor, export model with default settings
 				* @param scene repo scene to convert
+				* @param options export options
+				* @param sink if given, files are handed over to it as soon as they are complete
 				*/
-				GLTFModelExport(const repo::core::model::RepoScene *scene);
+				GLTFModelExport(
+					const repo::core::model::RepoScene *scene,
+					const WebExportOptions             &options = WebExportOptions(),
+					WebExportSink                      *sink = nullptr);
 
 				/**
 				* Default Destructor
@@ -51,24 +59,145 @@ namespace repo{
 				*/
 				repo_web_buffers_t getAllFilesExportedAsBuffer() const;
 
+				/**
+				* Reindex the given faces base on the given information
+				* @param matMap materialMapping as reference
+				* @param faces the faces to remap
+				*/
+				static bool reIndexFaces(
+					const std::vector<std::vector<repo_mesh_mapping_t>> &matMap,
+					std::vector<uint16_t>                               &faces);
+
+				/**
+				* Reorder the faces of every sub mesh base on quantization
+				* Sub meshes are reordered concurrently
+				* @param faces faces array to reOrder (reordered in place)
+				* @param vertices reference vertices
+				* @param mapping sub meshes of every mesh split
+				* @return returns the LOD offsets per split, per sub mesh (32 bits whatever the
+				*         index type, they count indices and can exceed 65535)
+				*/
+				static std::vector<std::vector<std::vector<uint32_t>>> reorderFaces(
+					std::vector<uint16_t>                               &faces,
+					const std::vector<repo::lib::RepoVector3D>                    &vertices,
+					const std::vector<std::vector<repo_mesh_mapping_t>> &mapping);
+
+				static std::vector<std::vector<std::vector<uint32_t>>> reorderFaces(
+					std::vector<uint32_t>                               &faces,
+					const std::vector<repo::lib::RepoVector3D>          &vertices,
+					const std::vector<std::vector<repo_mesh_mapping_t>> &mapping);
+
+				/**
+				* Reorder a certain chunk of faces base on quantization
+				* @param faces faces array to reOrder
+				* @param vertices reference vertices
+				* @param mapping mapping detailing which chunk of face to reorder
+				* @return returns the reordered version of the faces
+				*/
+				static std::vector<uint16_t> reorderFaces(
+					const std::vector<uint16_t>      &faces,
+					const std::vector<repo::lib::RepoVector3D> &vertices,
+					const repo_mesh_mapping_t        &mapping,
+					std::vector<uint32_t>      &lods);
+
+				static std::vector<uint32_t> reorderFaces(
+					const std::vector<uint32_t>                &faces,
+					const std::vector<repo::lib::RepoVector3D> &vertices,
+					const repo_mesh_mapping_t                  &mapping,
+					std::vector<uint32_t>                      &lods);
+
+				/**
+				* Reorder the faces of every sub mesh for the vertex cache, within each
+				* level of detail so the LOD offsets still apply, then reorder the
+				* vertices of every sub mesh in the order they are used
+				* Sub meshes are processed concurrently
+				* @param faces faces indexed relative to their sub mesh (reordered in place)
+				* @param mapping sub meshes of every mesh split
+				* @param lods LOD offsets per split, per sub mesh (as given by reorderFaces())
+				* @param vertices vertices (reordered in place)
+				* @param normals normals (reordered in place, can be empty)
+				* @param uvChannels uv channels (reordered in place, can be empty)
+				* @param idMaps ID map of every split (reordered in place, can be empty)
+				*/
+				static void optimiseVertexCache(
+					std::vector<uint16_t>                                 &faces,
+					const std::vector<std::vector<repo_mesh_mapping_t>>   &mapping,
+					const std::vector<std::vector<std::vector<uint32_t>>> &lods,
+					std::vector<repo::lib::RepoVector3D>                  &vertices,
+					std::vector<repo::lib::RepoVector3D>                  &normals,
+					std::vector<std::vector<repo::lib::RepoVector2D>>     &uvChannels,
+					std::vector<std::vector<float>>                       &idMaps);
+
+				static void optimiseVertexCache(
+					std::vector<uint32_t>                                 &faces,
+					const std::vector<std::vector<repo_mesh_mapping_t>>   &mapping,
+					const std::vector<std::vector<std::vector<uint32_t>>> &lods,
+					std::vector<repo::lib::RepoVector3D>                  &vertices,
+					std::vector<repo::lib::RepoVector3D>                  &normals,
+					std::vector<std::vector<repo::lib::RepoVector2D>>     &uvChannels,
+					std::vector<std::vector<float>>                       &idMaps);
+
+				/**
+				* Flatten triangulated faces into an index buffer
+				* @param faces faces to serialise
+				* @return returns the serialised faces
+				*/
+				static std::vector<uint16_t> serialiseFaces(
+					const std::vector<repo_face_t> &faces);
+
+			protected:
+				/**
+				* Hand the glTF documents and the data buffers over to a sink
+				* @param target destination of the files
+				* @return returns true if the sink accepted every file
+				*/
+				bool exportGeoFilesToSink(WebExportSink &target);
+
 			private:
 				std::unordered_map<std::string, std::vector<uint8_t>> fullDataBuffer;
+				//byte length of the data buffers already handed over to the sink
+				std::unordered_map<std::string, size_t> streamedBufferSizes;
+				//data buffers of supermeshes shared with an earlier revision, which are not exported again
+				std::unordered_set<std::string> sharedBuffers;
+				//top level objects of the document (accessors, meshes...), by label
+				std::map<std::string, repo::lib::JSONWriter> sections;
+
+				/**
+				* Geometry of a mesh, ready to be written into the document
+				*/
+				struct gltf_mesh_buffers_t
+				{
+					std::vector<repo::lib::RepoVector3D> vertices, normals;
+					std::vector<std::vector<repo::lib::RepoVector2D>> UVs;
+					std::vector<uint16_t> faces;
+					std::vector<std::vector<float>> idMapBuf;
+					//sub meshes of every split, and their LOD offsets
+					std::vector<std::vector<repo_mesh_mapping_t>> matMap;
+					std::vector<std::vector<std::vector<uint32_t>>> lods;
+					//mappings of the remapped mesh (split meshes only)
+					std::vector<repo_mesh_mapping_t> splits;
+					//original mesh IDs of every instance (instanced geometry only)
+					std::vector<std::string> instanceIDs;
+					size_t nFaces;
+					repo::lib::RepoUUID matID;
+					bool hasMat, isSplit, isEmpty;
+
+					gltf_mesh_buffers_t() : nFaces(0), hasMat(false), isSplit(false), isEmpty(false) {}
+				};
 
 				void addAccessors(
 					const std::string              &accName,
 					const std::string              &buffViewName,
-					repo::lib::PropertyTree        &tree,
 					const std::vector<uint16_t>    &faces,
 					const uint32_t                 &addrFrom,
 					const uint32_t                 &addrTo,
 					const std::string              &refId = std::string(),
-					const std::vector<uint16_t>    &lod = std::vector<uint16_t>(),
+					const std::vector<uint32_t>    &lod = std::vector<uint32_t>(),
 					const size_t                   &offset = 0);
 
 				void addAccessors(
 					const std::string              &accName,
 					const std::string              &buffViewName,
-					repo::lib::PropertyTree        &tree,
 					const std::vector<float>       &data,
 					const uint32_t                 &addrFrom,
 					const uint32_t                 &addrTo,
@@ -78,7 +207,6 @@ namespace repo{
 				void addAccessors(
 					const std::string                  &accName,
 					const std::string                  &buffViewName,
-					repo::lib::PropertyTree            &tree,
 					const std::vector<repo::lib::RepoVector2D> &buffer,
 					const uint32_t                     &addrFrom,
 					const uint32_t                     &addrTo,
@@ -88,7 +216,6 @@ namespace repo{
 				void addAccessors(
 					const std::string                &accName,
 					const std::string                &buffViewName,
-					repo::lib::PropertyTree          &tree,
 					const std::vector<repo::lib::RepoVector3D> &buffer,
 					const uint32_t                   &addrFrom,
 					const uint32_t                   &addrTo,
@@ -99,7 +226,6 @@ namespace repo{
 				* Add an accessor to a bufferview
 				* @param accName name of accessor
 				* @param buffViewName name of buffer
-				* @param tree tree to add the properties in
 				* @param count count of elements (if it's a vector of 3 floats, 1 count is 3 floats)
 				* @param offset offset to the starting position of the accessor in bytes
 				* @param stride stride of each element in bytes
@@ -111,7 +237,6 @@ namespace repo{
 				void addAccessors(
 					const std::string              &accName,
 					const std::string              &buffViewName,
-					repo::lib::PropertyTree        &tree,
 					const size_t                   &count,
 					const size_t                   &offset,
 					const size_t                   &stride,
@@ -120,7 +245,7 @@ namespace repo{
 					const std::vector<float>       &min,
 					const std::vector<float>       &max,
 					const std::string              &refId = std::string(),
-					const std::vector<uint16_t>    &lod = std::vector<uint16_t>());
+					const std::vector<uint32_t>    &lod = std::vector<uint32_t>());
 
 				/**
 				* Add a buffer view into a buffer,
@@ -128,13 +253,11 @@ namespace repo{
 				* binary file (buffer)
 				* @param name name of the buffer
 				* @param fileName name of binary file
-				* @param tree tree to insert header info into
 				* @param buffer buffer to export
 				*/
 				void addBufferView(
 					const std::string                   &name,
 					const std::string                   &fileName,
-					repo::lib::PropertyTree             &tree,
 					const std::vector<uint16_t>         &buffer,
 					const size_t                        &offset,
 					const size_t                        &count,
@@ -144,7 +267,6 @@ namespace repo{
 				void addBufferView(
 					const std::string                   &name,
 					const std::string                   &fileName,
-					repo::lib::PropertyTree             &tree,
 					const std::vector<float>            &buffer,
 					const size_t                        &offset,
 					const size_t                        &count,
@@ -153,7 +275,6 @@ namespace repo{
 				void addBufferView(
 					const std::string                   &name,
 					const std::string                   &fileName,
-					repo::lib::PropertyTree             &tree,
 					const std::vector<repo::lib::RepoVector3D>    &buffer,
 					const size_t                        &offset,
 					const size_t                        &count,
@@ -163,7 +284,6 @@ namespace repo{
 				void addBufferView(
 					const std::string                   &name,
 					const std::string                   &fileName,
-					repo::lib::PropertyTree             &tree,
 					const std::vector<repo::lib::RepoVector2D>  &buffer,
 					const size_t                        &offset,
 					const size_t                        &count,
@@ -176,13 +296,11 @@ namespace repo{
 				* binary file (buffer)
 				* @param name name of the buffer
 				* @param fileName name of binary file
-				* @param tree tree to insert header info into
 				* @param buffer buffer to export
 				*/
 				void addBufferView(
 					const std::string                   &name,
 					const std::string                   &fileName,
-					repo::lib::PropertyTree             &tree,
 					const size_t						&byteLength,
 					const size_t                        &offset,
 					const uint32_t						&bufferTarget,
@@ -211,13 +329,25 @@ namespace repo{
 					return addToDataBuffer(bufferName, (uint8_t*)buffer.data(), buffer.size() * sizeof(T));
 				}
 
+				/**
+				* Open a named object within a top level section of the document
+				* (e.g. a mesh within "meshes"). The caller writes its members
+				* and closes it with endObject()
+				* @param section label of the section
+				* @param name name of the object
+				* @return returns the writer of the section
+				*/
+				repo::lib::JSONWriter& startSectionObject(
+					const std::string &section,
+					const std::string &name);
+
 				/**
 				* Construct JSON document about the scene
-				* @param tree tree to place the info
+				* @param tree writer to place the info in, within the document object
 				* @return returns true upon success
 				*/
 				bool constructScene(
-					repo::lib::PropertyTree &tree);
+					repo::lib::JSONWriter &tree);
 
 				/**
 				* Create a tree representation for the graph
@@ -227,10 +357,11 @@ namespace repo{
 				bool generateTreeRepresentation();
 
 				/**
-				* Generate a property tree representing the spatial partitioning
-				* @return return a property tree with adequate entries
+				* Write the spatial partitioning into the given writer
+				* @param writer writer to write into
 				*/
-				repo::lib::PropertyTree generateSpatialPartitioning();
+				void generateSpatialPartitioning(
+					repo::lib::JSONWriter &writer);
 
 				/**
 				* Return the GLTF file as raw bytes buffer
@@ -238,114 +369,93 @@ namespace repo{
 				*/
 				std::unordered_map<std::string, std::vector<uint8_t>> getGLTFFilesAsBuffer() const;
 
-				/**
-				* Reindex the given faces base on the given information
-				* @param matMap materialMapping as reference
-				* @param faces the faces to remap
-				*/
-				bool reIndexFaces(
-					const std::vector<std::vector<repo_mesh_mapping_t>> &matMap,
-					std::vector<uint16_t>                               &faces);
-
 				/**
 				* Process children of nodes(Transformation)
 				* Recurse call of populateWithNode() if there is a transformation as child
 				* and also property lists (meshes/cameras)
 				* @param node node in question
+				* @param writer writer with the object of the node open
+				* @param subMeshCounts number of sub meshes per mesh
 				*/
 				void processNodeChildren(
 					const repo::core::model::RepoNode *node,
-					repo::lib::PropertyTree          &tree,
+					repo::lib::JSONWriter             &writer,
 					const std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> &subMeshCounts
 					);
 
 				/**
-				* Populate the given tree with the cameras within the scene
-				* @param tree tree to populate
+				* Hand a data buffer over to a sink and release it
+				* @param target destination of the file
+				* @param bufferName name of the data buffer
+				* @return returns true if the sink accepted the file
 				*/
-				void populateWithCameras(
-					repo::lib::PropertyTree          &tree);
+				bool addDataBufferToSink(
+					WebExportSink     &target,
+					const std::string &bufferName);
 
 				/**
-				* Populate the given tree with the materials within the scene
-				* @param tree tree to populate
+				* Populate the document with the cameras within the scene
 				*/
-				void populateWithMaterials(
-					repo::lib::PropertyTree          &tree);
+				void populateWithCameras();
 
 				/**
-				* @param tree tree to populate
+				* Populate the document with the materials within the scene
 				*/
-				std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher>
-					populateWithMeshes(
-					repo::lib::PropertyTree           &tree);
+				void populateWithMaterials();
 
 				/**
-				* Populate the given tree with the textures within the scene
-				* @param tree tree to populate
+				* Populate the document with the meshes within the scene
+				* Meshes are prepared concurrently and written in a deterministic order
+				* @return returns the number of sub meshes per mesh
 				*/
-				void populateWithTextures(
-					repo::lib::PropertyTree          &tree);
+				std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher>
+					populateWithMeshes();
 
 				/**
-				* Populate the given tree with transformations
-				* @param tree tree to populate
+				* Split, reindex and reorder the geometry of a mesh
+				* Does not touch the document, so meshes can be prepared concurrently
+				* @param node mesh to prepare
+				* @param buffers geometry of the mesh (output)
+				* @return returns false if the mesh cannot be exported
 				*/
-				void populateWithNodes(
-					repo::lib::PropertyTree          &tree,
-					const std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> &subMeshCounts);
-
-				std::vector<std::vector<std::vector<uint16_t>>> reorderFaces(
-					std::vector<uint16_t>                               &faces,
-					const std::vector<repo::lib::RepoVector3D>                    &vertices,
-					const std::vector<std::vector<repo_mesh_mapping_t>> &mapping);
+				bool prepareMeshBuffers(
+					const repo::core::model::MeshNode *node,
+					gltf_mesh_buffers_t               &buffers) const;
 
 				/**
-				* Reorder a certain chunk of faces base on quantization
-				* @param faces faces array to reOrder
-				* @param vertices reference vertices
-				* @param mapping mapping detailing which chunk of face to reorder
-				* @return returns the reordered version of the faces
+				* Populate the document with the textures within the scene
 				*/
-				std::vector<uint16_t> reorderFaces(
-					const std::vector<uint16_t>      &faces,
-					const std::vector<repo::lib::RepoVector3D> &vertices,
-					const repo_mesh_mapping_t        &mapping,
-					std::vector<uint16_t>      &lods) const;
+				void populateWithTextures();
 
-				std::vector<uint16_t> serialiseFaces(
-					const std::vector<repo_face_t> &faces) const;
+				/**
+				* Populate the document with transformations
+				* @param subMeshCounts number of sub meshes per mesh
+				*/
+				void populateWithNodes(
+					const std::unordered_map<repo::lib::RepoUUID, uint32_t, repo::lib::RepoUUIDHasher> &subMeshCounts);
 
 				/**
-				* write buffered binary files into the tree
-				* @param tree tree to write into
+				* write buffered binary files into the document
 				*/
-				void writeBuffers(
-					repo::lib::PropertyTree &tree);
+				void writeBuffers();
 
 				/**
 				* Write the default sampler into the
-				* property tree. Unless specified, all textures
+				* document. Unless specified, all textures
 				* will be using this sampler
 				* Note: there is currently no way to specify
 				* your own specific sampler
-				* @param tree tree to write into
 				*/
-				void writeDefaultSampler(
-					repo::lib::PropertyTree &tree
-					);
+				void writeDefaultSampler();
 
 				/**
 				* Write the default shading technique into the
-				* property tree. Unless specified, all materials
+				* document. Unless specified, all materials
 				* will be rendered using this technique
 				* Note: there is currently no way to specify
 				* your own specific technique/shader
-				* @param tree tree to write into
 				*/
-				void writeDefaultTechnique(
-					repo::lib::PropertyTree &tree
-					);
+				void writeDefaultTechnique();
 			};
 		} //namespace modelconvertor
 	} //namespace manipulator
@@ -20,8 +20,13 @@
 */
 
 #include "repo_model_export_src.h"
+
+#include <algorithm>
+
 #include "../../../core/model/bson/repo_bson_factory.h"
 #include "../../../lib/repo_log.h"
+#include "../../../lib/repo_parallel.h"
+#include "../../../lib/datastructure/repo_vertex_quantisation.h"
 #include "../../modelutility/repo_mesh_map_reorganiser.h"
 
 using namespace repo::manipulator::modelconvertor;
@@ -29,6 +34,7 @@ using namespace repo::manipulator::modelconvertor;
 const static uint32_t SRC_MAGIC_BIT = 23;
 const static uint32_t SRC_VERSION = 42;
 const static size_t SRC_MAX_VERTEX_LIMIT = 65535;
+const static size_t SRC_X3DOM_BYTE = 5120;
 const static size_t SRC_X3DOM_FLOAT = 5126;
 const static size_t SRC_X3DOM_USHORT = 5123;
 const static size_t SRC_X3DOM_TRIANGLE = 4;
@@ -99,14 +105,45 @@ const static std::string MP_LABEL_NAME = "name";
 const static std::string MP_LABEL_NUM_IDs = "numberOfIDs";
 const static std::string MP_LABEL_USAGE = "usage";
 
+/**
+* Format values as a space separated list, as x3dom expects for colours and bounding boxes
+*/
+static std::string toSpaceSeparatedString(const std::vector<float> &values)
+{
+	std::string result;
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		if (i)
+			result += " ";
+		result += repo::lib::JSONWriter::formatNumber(values[i]);
+	}
+	return result;
+}
+
+static std::string toSpaceSeparatedString(const repo::lib::RepoVector3D &value)
+{
+	return toSpaceSeparatedString(std::vector<float>({ value.x, value.y, value.z }));
+}
+
 SRCModelExport::SRCModelExport(
-	const repo::core::model::RepoScene *scene
-	) : WebModelExport(scene)
+	const repo::core::model::RepoScene *scene,
+	const WebExportOptions             &options,
+	WebExportSink                      *sink
+	) : WebModelExport(scene, options, sink)
 {
 	//Considering all newly imported models should have a stash graph, we only need to support stash graph?
 	if (convertSuccess)
 	{
-		if (gType == repo::core::model::RepoScene::GraphType::OPTIMIZED)
+		if (options.optimiseVertexCache)
+			repoWarning << "Vertex cache optimisation is not supported by the SRC export, faces will be written in their original order.";
+
+		if (options.useUInt32Indices)
+		{
+			//Meshes would still be split, which is what the caller asked to avoid
+			repoError << "32 bit indices are not supported by the SRC export, use the GLB export instead.";
+			convertSuccess = false;
+		}
+		else if (gType == repo::core::model::RepoScene::GraphType::OPTIMIZED)
 		{
 			convertSuccess = generateTreeRepresentation();
 		}
@@ -125,48 +162,53 @@ SRCModelExport::~SRCModelExport()
 {
 }
 
-std::unordered_map<std::string, std::vector<uint8_t>> SRCModelExport::getSRCFilesAsBuffer() const
+/**
+* Put the header and the data of an SRC file together
+*/
+static std::vector<uint8_t> packSRCFile(
+	const std::string          &jsonStr,
+	const std::vector<uint8_t> &data)
 {
-	std::unordered_map < std::string, std::vector<uint8_t> > fileBuffers;
+	std::vector<uint8_t> buffer;
 
-	for (const auto &treePair : trees)
-	{
-		std::vector<uint8_t> buffer;
-		std::string fName = treePair.first;
-
-		std::stringstream ss;
-		treePair.second.write_json(ss);
-		std::string jsonStr = ss.str();
+	//one char is one byte, 12bytes for Magic Bit(4), SRC Version (4), Header Length(4)
+	size_t jsonByteSize = jsonStr.size()*sizeof(*jsonStr.c_str());
+	size_t headerSize = 12 + jsonByteSize;
 
-		//one char is one byte, 12bytes for Magic Bit(4), SRC Version (4), Header Length(4)
-		size_t jsonByteSize = jsonStr.size()*sizeof(*jsonStr.c_str());
-		size_t headerSize = 12 + jsonByteSize;
+	size_t buffPtr = 0; //BufferPointer in bytes
 
-		size_t buffPtr = 0; //BufferPointer in bytes
+	buffer.reserve(headerSize + data.size());
+	buffer.resize(headerSize);
 
-		buffer.resize(headerSize);
+	uint32_t* bufferAsUInt = (uint32_t*)buffer.data();
 
-		uint32_t* bufferAsUInt = (uint32_t*)buffer.data();
+	//Header ints
+	bufferAsUInt[0] = SRC_MAGIC_BIT;
+	bufferAsUInt[1] = SRC_VERSION;
+	bufferAsUInt[2] = jsonByteSize;
 
-		//Header ints
-		bufferAsUInt[0] = SRC_MAGIC_BIT;
-		bufferAsUInt[1] = SRC_VERSION;
-		bufferAsUInt[2] = jsonByteSize;
+	buffPtr += 3 * sizeof(uint32_t);
 
-		buffPtr += 3 * sizeof(uint32_t);
+	//write json
+	memcpy(&buffer[buffPtr], jsonStr.c_str(), jsonByteSize);
 
-		//write json
-		memcpy(&buffer[buffPtr], jsonStr.c_str(), jsonByteSize);
+	//Add data buffer to the full buffer
+	buffer.insert(buffer.end(), data.begin(), data.end());
+	return buffer;
+}
 
-		buffPtr += jsonByteSize;
+std::unordered_map<std::string, std::vector<uint8_t>> SRCModelExport::getSRCFilesAsBuffer() const
+{
+	std::unordered_map < std::string, std::vector<uint8_t> > fileBuffers;
 
+	for (const auto &treePair : trees)
+	{
+		std::string fName = treePair.first;
 		const auto fdIt = fullDataBuffer.find(fName);
 
 		if (fdIt != fullDataBuffer.end())
 		{
-			//Add data buffer to the full buffer
-			buffer.insert(buffer.end(), fdIt->second.begin(), fdIt->second.end());
-			fileBuffers[fName] = buffer;
+			fileBuffers[fName] = packSRCFile(treePair.second.getString(), fdIt->second);
 		}
 		else
 		{
@@ -182,6 +224,27 @@ repo_web_buffers_t SRCModelExport::getAllFilesExportedAsBuffer() const
 	return{ getSRCFilesAsBuffer(), getJSONFilesAsBuffer() };
 }
 
+bool SRCModelExport::exportGeoFilesToSink(WebExportSink &target)
+{
+	bool success = true;
+	for (const auto &treePair : trees)
+	{
+		const auto fdIt = fullDataBuffer.find(treePair.first);
+		if (fdIt != fullDataBuffer.end())
+		{
+			success &= target.addFile(WebFileType::GEOMETRY, treePair.first, packSRCFile(treePair.second.getString(), fdIt->second));
+			fullDataBuffer.erase(fdIt);
+		}
+		else
+		{
+			repoError << " Failed to find data buffer for " << treePair.first;
+			success = false;
+		}
+	}
+	trees.clear();
+	return success;
+}
+
 bool SRCModelExport::generateJSONMapping(
 	const repo::core::model::MeshNode  *mesh,
 	const repo::core::model::RepoScene *scene,
@@ -190,48 +253,53 @@ bool SRCModelExport::generateJSONMapping(
 	bool success;
 	if (success = mesh)
 	{
-		repo::lib::PropertyTree jsonTree;
+		std::string jsonFileName = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/" + mesh->getUniqueID().toString() + ".json.mpc";
+		repo::lib::JSONWriter &jsonTree = jsonTrees[jsonFileName];
+		jsonTree = repo::lib::JSONWriter();
+
 		std::vector<repo_mesh_mapping_t> mappings = mesh->getMeshMapping();
 		std::sort(mappings.begin(), mappings.end(),
 			[](repo_mesh_mapping_t const& a, repo_mesh_mapping_t const& b) { return a.vertFrom < b.vertFrom; });
 
 		size_t mappingLength = mappings.size();
 
-		jsonTree.addToTree(MP_LABEL_NUM_IDs, mappingLength);
-		jsonTree.addToTree(MP_LABEL_MAX_GEO_COUNT, mappingLength);
+		jsonTree.startObject();
+		jsonTree.addMember(MP_LABEL_NUM_IDs, mappingLength);
+		jsonTree.addMember(MP_LABEL_MAX_GEO_COUNT, mappingLength);
 
 		std::vector<repo::core::model::RepoNode*> matChild =
 			scene->getChildrenNodesFiltered(gType, mesh->getSharedID(), repo::core::model::NodeType::MATERIAL);
 
-		std::vector <repo::lib::PropertyTree> matChildrenTrees;
+		jsonTree.startArray(MP_LABEL_APPEARANCE);
 		for (size_t i = 0; i < matChild.size(); ++i)
 		{
-			repo::lib::PropertyTree matTree;
 			const repo::core::model::MaterialNode *matNode = (const repo::core::model::MaterialNode *) matChild[i];
-			matTree.addToTree(MP_LABEL_NAME, matNode->getUniqueID().toString());
+			jsonTree.startObject();
+			jsonTree.addMember(MP_LABEL_NAME, matNode->getUniqueID().toString());
 			repo_material_t matStruct = matNode->getMaterialStruct();
 
+			jsonTree.startObject(MP_LABEL_MATERIAL);
 			if (matStruct.diffuse.size())
-				matTree.addToTree(MP_LABEL_MATERIAL + "." + MP_LABEL_MAT_DIFFUSE, matStruct.diffuse, false);
+				jsonTree.addMember(MP_LABEL_MAT_DIFFUSE, toSpaceSeparatedString(matStruct.diffuse));
 
 			if (matStruct.emissive.size())
-				matTree.addToTree(MP_LABEL_MATERIAL + "." + MP_LABEL_MAT_EMISSIVE, matStruct.emissive, false);
+				jsonTree.addMember(MP_LABEL_MAT_EMISSIVE, toSpaceSeparatedString(matStruct.emissive));
 
 			if (matStruct.shininess == matStruct.shininess)
-				matTree.addToTree(MP_LABEL_MATERIAL + "." + MP_LABEL_MAT_SHININESS, matStruct.shininess);
+				jsonTree.addMember(MP_LABEL_MAT_SHININESS, matStruct.shininess);
 
 			if (matStruct.specular.size())
-				matTree.addToTree(MP_LABEL_MATERIAL + "." + MP_LABEL_MAT_SPECULAR, matStruct.specular, false);
+				jsonTree.addMember(MP_LABEL_MAT_SPECULAR, toSpaceSeparatedString(matStruct.specular));
 
 			if (matStruct.opacity == matStruct.opacity)
-				matTree.addToTree(MP_LABEL_MATERIAL + "." + MP_LABEL_MAT_TRANSPARENCY, 1.0 - matStruct.opacity);
+				jsonTree.addMember(MP_LABEL_MAT_TRANSPARENCY, 1.0 - matStruct.opacity);
+			jsonTree.endObject();
 
-			matChildrenTrees.push_back(matTree);
+			jsonTree.endObject();
 		}
+		jsonTree.endArray();
 
-		jsonTree.addArrayObjects(MP_LABEL_APPEARANCE, matChildrenTrees);
-
-		std::vector<repo::lib::PropertyTree> mappingTrees;
+		jsonTree.startArray(MP_LABEL_MAPPING);
 		std::string meshUID = mesh->getUniqueID().toString();
 		//Could get the mesh split function to pass a mapping out so we don't do this again.
 		for (size_t i = 0; i < mappingLength; ++i)
@@ -241,16 +309,13 @@ bool SRCModelExport::generateJSONMapping(
 			{
 				for (const uint32_t &subMeshID : mapIt->second)
 				{
-					repo::lib::PropertyTree mappingTree;
-
-					mappingTree.addToTree(MP_LABEL_NAME, mappings[i].mesh_id.toString());
-					mappingTree.addToTree(MP_LABEL_APPEARANCE, mappings[i].material_id.toString());
-					mappingTree.addToTree(MP_LABEL_MIN, mappings[i].min);
-					mappingTree.addToTree(MP_LABEL_MAX, mappings[i].max);
-					std::vector<std::string> usageArr = { meshUID + "_" + std::to_string(subMeshID) };
-					mappingTree.addToTree(MP_LABEL_USAGE, usageArr);
-
-					mappingTrees.push_back(mappingTree);
+					jsonTree.startObject();
+					jsonTree.addMember(MP_LABEL_NAME, mappings[i].mesh_id.toString());
+					jsonTree.addMember(MP_LABEL_APPEARANCE, mappings[i].material_id.toString());
+					jsonTree.addMember(MP_LABEL_MIN, toSpaceSeparatedString(mappings[i].min));
+					jsonTree.addMember(MP_LABEL_MAX, toSpaceSeparatedString(mappings[i].max));
+					jsonTree.addMember(MP_LABEL_USAGE, std::vector<std::string>({ meshUID + "_" + std::to_string(subMeshID) }));
+					jsonTree.endObject();
 				}
 			}
 			else
@@ -258,12 +323,8 @@ bool SRCModelExport::generateJSONMapping(
 				repoError << "Failed to find split mapping for id: " << mappings[i].mesh_id;
 			}
 		}
-
-		jsonTree.addArrayObjects(MP_LABEL_MAPPING, mappingTrees);
-
-		std::string jsonFileName = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/" + mesh->getUniqueID().toString() + ".json.mpc";
-
-		jsonTrees[jsonFileName] = jsonTree;
+		jsonTree.endArray();
+		jsonTree.endObject();
 	}
 	else
 	{
@@ -273,6 +334,51 @@ bool SRCModelExport::generateJSONMapping(
 	return success;
 }
 
+bool SRCModelExport::generateMeshFile(
+	const repo::core::model::RepoNode *node,
+	const size_t                      &idx,
+	src_mesh_file_t                   &file) const
+{
+	auto mesh = dynamic_cast<const repo::core::model::MeshNode*>(node);
+	if (!mesh)
+	{
+		repoError << "Failed to cast a Repo Node of type mesh into a MeshNode(" << node->getUniqueID() << ").";
+		return false;
+	}
+	std::string textureID = scene->getTextureIDForMesh(gType, mesh->getSharedID());
+
+	repo::manipulator::modelutility::MeshMapReorganiser reSplitter(mesh, SRC_MAX_VERTEX_LIMIT);
+	repo::core::model::MeshNode splittedMesh = reSplitter.getRemappedMesh();
+	if (splittedMesh.isEmpty())
+	{
+		repoError << "Failed to generate a remapped mesh for mesh with ID : " << mesh->getUniqueID();
+		return false;
+	}
+
+	std::vector<uint16_t> facebuf = reSplitter.getSerialisedFaces();
+	std::vector<std::vector<float>> idMapBuf = reSplitter.getIDMapArrays();
+	file.splitMapping = reSplitter.getSplitMapping();
+
+	std::string ext = ".src";
+	//requires a separate x3d file if it is a multipart mesh
+	if (file.isMultipart = mesh->getMeshMapping().size() > 1)
+	{
+		ext += ".mpc";
+	}
+
+	if (!textureID.empty())
+	{
+		ext += "?tex_uuid=" + textureID;
+	}
+
+	if (!addMeshToExport(splittedMesh, idx, facebuf, idMapBuf, ext, file))
+	{
+		repoError << "Failed to export mesh " << splittedMesh.getUniqueID() << " into SRC format.";
+		return false;
+	}
+	return true;
+}
+
 bool SRCModelExport::generateTreeRepresentation(
 	)
 {
@@ -280,59 +386,76 @@ bool SRCModelExport::generateTreeRepresentation(
 	if (success = scene->hasRoot(gType))
 	{
 		auto meshes = scene->getAllMeshes(gType);
-		size_t index = 0;
-		//Every mesh is a new SRC file
-		fullDataBuffer.reserve(meshes.size());
-		for (const repo::core::model::RepoNode* node : meshes)
+		for (const auto &mesh : meshes)
 		{
-			auto mesh = dynamic_cast<const repo::core::model::MeshNode*>(node);
-			if (!mesh)
+			//SRC files carry no transformations, so instances would all be drawn in the same place
+			if (mesh->getParentIDs().size() > 1)
 			{
-				repoError << "Failed to cast a Repo Node of type mesh into a MeshNode(" << node->getUniqueID() << "). Skipping...";
+				repoError << "The stash graph contains instanced geometry (mesh " << mesh->getUniqueID()
+					<< "), which cannot be exported to SRC. Regenerate the stash graph without instancing.";
+				return false;
 			}
-			std::string textureID = scene->getTextureIDForMesh(gType, mesh->getSharedID());
+		}
+
+		//Every mesh is a new SRC file. They are generated concurrently, then added
+		//in the order of the node set so the output does not depend on scheduling.
+		//When streaming to a sink, files are generated a batch at a time and handed
+		//over as soon as they are added, to bound the memory used
+		std::vector<repo::core::model::RepoNode*> meshNodes;
+		for (const auto &mesh : meshes)
+		{
+			//Supermeshes shared with the stash of an earlier revision were exported with it,
+			//their files are named after the supermesh so they are referenced as they are
+			if (gType == repo::core::model::RepoScene::GraphType::OPTIMIZED && scene->isSharedStashNode(mesh))
+				continue;
+			meshNodes.push_back(mesh);
+		}
+		if (meshNodes.size() < meshes.size())
+		{
+			repoInfo << "Reusing the SRC files of " << meshes.size() - meshNodes.size() << " supermeshes of a previous revision";
+		}
 
-			repo::manipulator::modelutility::MeshMapReorganiser *reSplitter =
-				new repo::manipulator::modelutility::MeshMapReorganiser(mesh, SRC_MAX_VERTEX_LIMIT);
-			repo::core::model::MeshNode splittedMesh = reSplitter->getRemappedMesh();
-			if (success = !(splittedMesh.isEmpty()))
+		const size_t batchSize = sink ? repo::lib::getDefaultThreadCount() : meshNodes.size();
+		std::vector<src_mesh_file_t> files;
+		std::vector<char> generated;
+
+		if (!sink)
+			fullDataBuffer.reserve(meshNodes.size());
+		for (size_t i = 0; i < meshNodes.size(); ++i)
+		{
+			const size_t batchIdx = i % batchSize;
+			if (!batchIdx)
 			{
-				std::vector<uint16_t> facebuf = reSplitter->getSerialisedFaces();
-				std::vector<std::vector<float>> idMapBuf = reSplitter->getIDMapArrays();
-				std::unordered_map<repo::lib::RepoUUID, std::vector<uint32_t>, repo::lib::RepoUUIDHasher> splitMapping = reSplitter->getSplitMapping();
-				delete reSplitter;
-
-				std::string ext = ".src";
-				bool sepX3d; //requires a separate x3d file if it is a multipart mesh
-				if (sepX3d = mesh->getMeshMapping().size() > 1)
+				const size_t batchCount = std::min(batchSize, meshNodes.size() - i);
+				files.clear();
+				files.resize(batchCount);
+				generated.assign(batchCount, false);
+				repo::lib::parallelFor(batchCount, [&](const size_t &j)
 				{
-					ext += ".mpc";
-				}
+					generated[j] = generateMeshFile(meshNodes[i + j], i + j, files[j]);
+				});
+			}
 
-				if (!textureID.empty())
-				{
-					ext += "?tex_uuid=" + textureID;
-				}
+			src_mesh_file_t &file = files[batchIdx];
+			if (!(success = generated[batchIdx]))
+				break;
 
-				if (success = addMeshToExport(splittedMesh, index, facebuf, idMapBuf, ext))
-				{
-					++index;
-					if (sepX3d)
-					{
-						success &= generateJSONMapping(mesh, scene, splitMapping);
-					}
-				}
-				else
-				{
-					repoError << "Failed to export mesh " << splittedMesh.getUniqueID() << " into SRC format.";
-					break;
-				}
+			if (sink)
+			{
+				success = sink->addFile(WebFileType::GEOMETRY, file.fileName, packSRCFile(file.header.getString(), file.data));
 			}
 			else
 			{
-				repoError << "Failed to generate a remapped mesh for mesh with ID : " << mesh->getUniqueID();
-				break;
+				trees[file.fileName] = file.header;
+				fullDataBuffer[file.fileName].swap(file.data);
+			}
+			if (file.isMultipart)
+			{
+				success &= generateJSONMapping((const repo::core::model::MeshNode*)meshNodes[i], scene, file.splitMapping);
 			}
+			file = src_mesh_file_t();
+			if (!success)
+				break;
 		}
 	}
 
@@ -344,8 +467,9 @@ bool SRCModelExport::addMeshToExport(
 	const size_t                           &idx,
 	const std::vector<uint16_t>            &faceBuf,
 	const std::vector<std::vector<float>>  &idMapBuf,
-	const std::string                      &fileExt
-	)
+	const std::string                      &fileExt,
+	src_mesh_file_t                        &file
+	) const
 {
 	std::vector<repo_mesh_mapping_t> mapping = mesh.getMeshMapping();
 
@@ -359,14 +483,55 @@ bool SRCModelExport::addMeshToExport(
 		return false;
 	}
 
+	size_t nSubMeshes = mapping.size();
+
+	//Quantised attributes are decoded as (value + decodeOffset) * decodeScale, per sub mesh
+	const bool quantise = options.quantiseAttributes;
+	std::vector<uint16_t> qVertices, qUVs;
+	std::vector<int8_t> qNormals;
+	std::vector<repo::lib::RepoVector3D> vertexMin(nSubMeshes), vertexScale(nSubMeshes);
+	std::vector<repo::lib::RepoVector2D> uvMin(nSubMeshes), uvScale(nSubMeshes);
+	if (quantise)
+	{
+		qNormals = repo::lib::quantiseNormals(normals.data(), normals.size());
+		qVertices.reserve(vertices.size() * 4);
+		if (uvs.size())
+			qUVs.reserve(vertices.size() * 2);
+		for (size_t subMeshIdx = 0; subMeshIdx < nSubMeshes; ++subMeshIdx)
+		{
+			const size_t vFrom = mapping[subMeshIdx].vertFrom;
+			const size_t vCount = mapping[subMeshIdx].vertTo - vFrom;
+			auto subMeshVertices = repo::lib::quantisePositions(&vertices[vFrom], vCount, false,
+				vertexMin[subMeshIdx], vertexScale[subMeshIdx]);
+			qVertices.insert(qVertices.end(), subMeshVertices.begin(), subMeshVertices.end());
+			if (uvs.size())
+			{
+				//Only the first channel is referenced by the header
+				auto subMeshUVs = repo::lib::quantiseUVs(&uvs[vFrom], vCount, uvMin[subMeshIdx], uvScale[subMeshIdx]);
+				qUVs.insert(qUVs.end(), subMeshUVs.begin(), subMeshUVs.end());
+			}
+		}
+	}
+
+	const size_t vertexStride = quantise ? 4 * sizeof(*qVertices.data()) : sizeof(*vertices.data());
+	const size_t normalStride = quantise ? 4 * sizeof(*qNormals.data()) : sizeof(*normals.data());
+	const size_t uvStride = quantise ? 2 * sizeof(*qUVs.data()) : sizeof(*uvs.data());
+
+	const uint8_t *vertexData = quantise ? (const uint8_t*)qVertices.data() : (const uint8_t*)vertices.data();
+	const uint8_t *normalData = quantise ? (const uint8_t*)qNormals.data() : (const uint8_t*)normals.data();
+	const uint8_t *uvData = quantise ? (const uint8_t*)qUVs.data() : (const uint8_t*)uvs.data();
+	const size_t vertexByteSize = vertices.size() * vertexStride;
+	const size_t normalByteSize = normals.size() * normalStride;
+	const size_t uvByteSize = (quantise ? qUVs.size() / 2 : uvs.size()) * uvStride;
+
 	//Define starting position of buffers
 	size_t bufPos = 0; //In bytes
 	size_t vertexWritePosition = bufPos;
 
-	bufPos += vertices.size()*sizeof(*vertices.data());
+	bufPos += vertexByteSize;
 
 	size_t normalWritePosition = bufPos;
-	bufPos += normals.size()*sizeof(*normals.data());
+	bufPos += normalByteSize;
 
 	size_t facesWritePosition = bufPos;
 	bufPos += faceBuf.size() * sizeof(*faceBuf.data());
@@ -375,11 +540,17 @@ bool SRCModelExport::addMeshToExport(
 	bufPos += vertices.size() * sizeof(float); //idMap array is of floats
 
 	size_t uvWritePosition = bufPos;
-	size_t nSubMeshes = mapping.size();
 
 	std::string meshId = mesh.getUniqueID().toString();
 
-	repo::lib::PropertyTree tree;
+	//Each section of the header is written on its own and put together once all sub meshes are done
+	repo::lib::JSONWriter attributeViews, indexViews, bufferChunks, bufferViews, meshes;
+	attributeViews.startObject();
+	indexViews.startObject();
+	bufferChunks.startObject();
+	bufferViews.startObject();
+	meshes.startObject();
+
 	size_t lastV = 0, lastF = 0;
 	repoTrace << "Looping Through submeshes (#submeshes : " << nSubMeshes << ")";
 	for (size_t subMeshIdx = 0; subMeshIdx < nSubMeshes; ++subMeshIdx)
@@ -416,9 +587,6 @@ bool SRCModelExport::addMeshToExport(
 
 		std::string meshID = meshId + "_" + std::to_string(subMeshIdx);
 
-		std::string srcAccessors_AttributeViews = SRC_LABEL_ACCESSORS + "." + SRC_LABEL_ACCESSORS_ATTR_VIEWS;
-		std::string srcMesh_MeshID = SRC_LABEL_MESHES + "." + meshID + ".";
-
 		size_t vCount = mapping[subMeshIdx].vertTo - mapping[subMeshIdx].vertFrom;
 		size_t fCount = mapping[subMeshIdx].triTo - mapping[subMeshIdx].triFrom;
 
@@ -433,160 +601,184 @@ bool SRCModelExport::addMeshToExport(
 			return false;
 		}
 
+		meshes.startObject(meshID);
+		meshes.startObject(SRC_LABEL_ATTRS);
+
 		// SRC Header for this mesh
 		if (vertices.size())
 		{
-			std::string srcAccessors_AttrViews_positionAttrView = srcAccessors_AttributeViews + "." + positionAttributeView + ".";
-			tree.addToTree(srcAccessors_AttrViews_positionAttrView + SRC_LABEL_BUFFVIEW, positionBufferView);
-			tree.addToTree(srcAccessors_AttrViews_positionAttrView + SRC_LABEL_BYTE_OFFSET, 0);
-			tree.addToTree(srcAccessors_AttrViews_positionAttrView + SRC_LABEL_BYTE_STRIDE, 12);
-			tree.addToTree(srcAccessors_AttrViews_positionAttrView + SRC_LABEL_COMP_TYPE, SRC_X3DOM_FLOAT);
-			tree.addToTree(srcAccessors_AttrViews_positionAttrView + SRC_LABEL_TYPE, SRC_VECTOR_3D);
-			tree.addToTree(srcAccessors_AttrViews_positionAttrView + SRC_LABEL_COUNT, vCount);
-
-			std::vector<uint32_t> offsetArr = { 0, 0, 0 };
-			std::vector<uint32_t> scaleArr = { 1, 1, 1 };
-			tree.addToTree(srcAccessors_AttrViews_positionAttrView + SRC_LABEL_DECODE_OFFSET, offsetArr);
-			tree.addToTree(srcAccessors_AttrViews_positionAttrView + SRC_LABEL_DECODE_SCALE, scaleArr);
+			attributeViews.startObject(positionAttributeView);
+			attributeViews.addMember(SRC_LABEL_BUFFVIEW, positionBufferView);
+			attributeViews.addMember(SRC_LABEL_BYTE_OFFSET, 0);
+			attributeViews.addMember(SRC_LABEL_BYTE_STRIDE, vertexStride);
+			attributeViews.addMember(SRC_LABEL_COMP_TYPE, quantise ? SRC_X3DOM_USHORT : SRC_X3DOM_FLOAT);
+			attributeViews.addMember(SRC_LABEL_TYPE, SRC_VECTOR_3D);
+			attributeViews.addMember(SRC_LABEL_COUNT, vCount);
+			if (quantise)
+			{
+				const repo::lib::RepoVector3D &min = vertexMin[subMeshIdx];
+				const repo::lib::RepoVector3D &scale = vertexScale[subMeshIdx];
+				attributeViews.addMember(SRC_LABEL_DECODE_OFFSET, std::vector<float>({ min.x / scale.x, min.y / scale.y, min.z / scale.z }));
+				attributeViews.addMember(SRC_LABEL_DECODE_SCALE, std::vector<float>({ scale.x, scale.y, scale.z }));
+			}
+			else
+			{
+				attributeViews.addMember(SRC_LABEL_DECODE_OFFSET, std::vector<uint32_t>({ 0, 0, 0 }));
+				attributeViews.addMember(SRC_LABEL_DECODE_SCALE, std::vector<uint32_t>({ 1, 1, 1 }));
+			}
+			attributeViews.endObject();
 
-			std::string srcBufferChunks_positionBufferChunks = SRC_LABEL_BUFFER_CHUNKS + "." + positionBufferChunk + ".";
-			size_t verticeBufferLength = vCount * sizeof(*vertices.data());
+			size_t verticeBufferLength = vCount * vertexStride;
 
-			tree.addToTree(srcBufferChunks_positionBufferChunks + SRC_LABEL_BYTE_OFFSET, vertexWritePosition);
-			tree.addToTree(srcBufferChunks_positionBufferChunks + SRC_LABEL_BYTE_LENGTH, verticeBufferLength);
+			bufferChunks.startObject(positionBufferChunk);
+			bufferChunks.addMember(SRC_LABEL_BYTE_OFFSET, vertexWritePosition);
+			bufferChunks.addMember(SRC_LABEL_BYTE_LENGTH, verticeBufferLength);
+			bufferChunks.endObject();
 
 			vertexWritePosition += verticeBufferLength;
 
-			std::string srcBufferViews_positionBufferView = SRC_LABEL_BUFF_VIEWS + "." + positionBufferView + ".";
-
-			std::vector<std::string> chunksArray = { positionBufferChunk };
-			tree.addToTree(srcBufferViews_positionBufferView + SRC_LABEL_CHUNKS, chunksArray);
+			bufferViews.startObject(positionBufferView);
+			bufferViews.addMember(SRC_LABEL_CHUNKS, std::vector<std::string>({ positionBufferChunk }));
+			bufferViews.endObject();
 
-			tree.addToTree(srcMesh_MeshID + SRC_LABEL_ATTRS + "." + SRC_LABEL_POSITION, positionAttributeView);
+			meshes.addMember(SRC_LABEL_POSITION, positionAttributeView);
 		}
 
 		//Normal Attribute View
 		if (normals.size())
 		{
-			std::string srcAccessors_AttrViews_normalAttrView = srcAccessors_AttributeViews + "." + normalAttributeView + ".";
-			tree.addToTree(srcAccessors_AttrViews_normalAttrView + SRC_LABEL_BUFFVIEW, normalBufferView);
-			tree.addToTree(srcAccessors_AttrViews_normalAttrView + SRC_LABEL_BYTE_OFFSET, 0);
-			tree.addToTree(srcAccessors_AttrViews_normalAttrView + SRC_LABEL_BYTE_STRIDE, 12);
-			tree.addToTree(srcAccessors_AttrViews_normalAttrView + SRC_LABEL_COMP_TYPE, SRC_X3DOM_FLOAT);
-			tree.addToTree(srcAccessors_AttrViews_normalAttrView + SRC_LABEL_TYPE, SRC_VECTOR_3D);
-			tree.addToTree(srcAccessors_AttrViews_normalAttrView + SRC_LABEL_COUNT, vCount);
-
-			std::vector<uint32_t> offsetArr = { 0, 0, 0 };
-			std::vector<uint32_t> scaleArr = { 1, 1, 1 };
-			tree.addToTree(srcAccessors_AttrViews_normalAttrView + SRC_LABEL_DECODE_OFFSET, offsetArr);
-			tree.addToTree(srcAccessors_AttrViews_normalAttrView + SRC_LABEL_DECODE_SCALE, scaleArr);
+			attributeViews.startObject(normalAttributeView);
+			attributeViews.addMember(SRC_LABEL_BUFFVIEW, normalBufferView);
+			attributeViews.addMember(SRC_LABEL_BYTE_OFFSET, 0);
+			attributeViews.addMember(SRC_LABEL_BYTE_STRIDE, normalStride);
+			attributeViews.addMember(SRC_LABEL_COMP_TYPE, quantise ? SRC_X3DOM_BYTE : SRC_X3DOM_FLOAT);
+			attributeViews.addMember(SRC_LABEL_TYPE, SRC_VECTOR_3D);
+			attributeViews.addMember(SRC_LABEL_COUNT, vCount);
+			attributeViews.addMember(SRC_LABEL_DECODE_OFFSET, std::vector<uint32_t>({ 0, 0, 0 }));
+			if (quantise)
+			{
+				const float scale = 1.0f / 127.0f;
+				attributeViews.addMember(SRC_LABEL_DECODE_SCALE, std::vector<float>({ scale, scale, scale }));
+			}
+			else
+			{
+				attributeViews.addMember(SRC_LABEL_DECODE_SCALE, std::vector<uint32_t>({ 1, 1, 1 }));
+			}
+			attributeViews.endObject();
 
-			std::string srcBufferChunks_positionBufferChunks = SRC_LABEL_BUFFER_CHUNKS + "." + normalBufferChunk + ".";
-			size_t verticeBufferLength = vCount * sizeof(*normals.data());
+			size_t verticeBufferLength = vCount * normalStride;
 
-			tree.addToTree(srcBufferChunks_positionBufferChunks + SRC_LABEL_BYTE_OFFSET, normalWritePosition);
-			tree.addToTree(srcBufferChunks_positionBufferChunks + SRC_LABEL_BYTE_LENGTH, verticeBufferLength);
+			bufferChunks.startObject(normalBufferChunk);
+			bufferChunks.addMember(SRC_LABEL_BYTE_OFFSET, normalWritePosition);
+			bufferChunks.addMember(SRC_LABEL_BYTE_LENGTH, verticeBufferLength);
+			bufferChunks.endObject();
 
 			normalWritePosition += verticeBufferLength;
 
-			std::string srcBufferViews_normalBufferView = SRC_LABEL_BUFF_VIEWS + "." + normalBufferView + ".";
-
-			std::vector<std::string> chunksArray = { normalBufferChunk };
-			tree.addToTree(srcBufferViews_normalBufferView + SRC_LABEL_CHUNKS, chunksArray);
+			bufferViews.startObject(normalBufferView);
+			bufferViews.addMember(SRC_LABEL_CHUNKS, std::vector<std::string>({ normalBufferChunk }));
+			bufferViews.endObject();
 
-			tree.addToTree(srcMesh_MeshID + SRC_LABEL_ATTRS + "." + SRC_LABEL_NORMAL, normalAttributeView);
+			meshes.addMember(SRC_LABEL_NORMAL, normalAttributeView);
 		}
 
-		// Index View
-		if (faceBuf.size())
+		if (idMapBuf.size() && idMapBuf[subMeshIdx].size())
 		{
-			std::string srcAccessors_indexViews = SRC_LABEL_ACCESSORS + "." + SRC_LABEL_INDEX_VIEWS + "." + indexView + ".";
+			attributeViews.startObject(idMapAttributeView);
+			attributeViews.addMember(SRC_LABEL_BUFFVIEW, idMapBufferView);
+			attributeViews.addMember(SRC_LABEL_BYTE_OFFSET, 0);
+			attributeViews.addMember(SRC_LABEL_BYTE_STRIDE, 4);
+			attributeViews.addMember(SRC_LABEL_COMP_TYPE, SRC_X3DOM_FLOAT);
+			attributeViews.addMember(SRC_LABEL_TYPE, SRC_SCALAR);
+			attributeViews.addMember(SRC_LABEL_COUNT, vCount);
+			attributeViews.addMember(SRC_LABEL_DECODE_OFFSET, std::vector<uint32_t>({ 0 }));
+			attributeViews.addMember(SRC_LABEL_DECODE_SCALE, std::vector<uint32_t>({ 1 }));
+			attributeViews.endObject();
 
-			tree.addToTree(srcAccessors_indexViews + SRC_LABEL_BUFFVIEW, indexBufferView);
-			tree.addToTree(srcAccessors_indexViews + SRC_LABEL_BYTE_OFFSET, 0);
-			tree.addToTree(srcAccessors_indexViews + SRC_LABEL_COMP_TYPE, SRC_X3DOM_USHORT);
-			tree.addToTree(srcAccessors_indexViews + SRC_LABEL_COUNT, fCount * 3);
-
-			std::string srcBufferChunks_indexBufferChunk = SRC_LABEL_BUFFER_CHUNKS + "." + indexBufferChunk + ".";
-			size_t facesBufferLength = fCount * 3 * sizeof(*faceBuf.data()); //3 shorts for face index
-
-			tree.addToTree(srcBufferChunks_indexBufferChunk + SRC_LABEL_BYTE_OFFSET, facesWritePosition);
-			tree.addToTree(srcBufferChunks_indexBufferChunk + SRC_LABEL_BYTE_LENGTH, facesBufferLength);
+			size_t idMapBufferLength = idMapBuf[subMeshIdx].size() * sizeof(*idMapBuf[subMeshIdx].data());
 
-			facesWritePosition += facesBufferLength;
+			bufferChunks.startObject(idMapBufferChunk);
+			bufferChunks.addMember(SRC_LABEL_BYTE_OFFSET, idMapWritePosition);
+			bufferChunks.addMember(SRC_LABEL_BYTE_LENGTH, idMapBufferLength);
+			bufferChunks.endObject();
 
-			std::string srcBufferViews_indexBufferView = SRC_LABEL_BUFF_VIEWS + "." + indexBufferView + ".";
+			idMapWritePosition += idMapBufferLength;
 
-			std::vector<std::string> chunksArray = { indexBufferChunk };
-			tree.addToTree(srcBufferViews_indexBufferView + SRC_LABEL_CHUNKS, chunksArray);
+			bufferViews.startObject(idMapBufferView);
+			bufferViews.addMember(SRC_LABEL_CHUNKS, std::vector<std::string>({ idMapBufferChunk }));
+			bufferViews.endObject();
 
-			tree.addToTree(srcMesh_MeshID + SRC_LABEL_INDICIES, indexView);
-			tree.addToTree(srcMesh_MeshID + SRC_LABEL_PRIMITIVE, SRC_X3DOM_TRIANGLE);
+			meshes.addMember(SRC_LABEL_ID, idMapAttributeView);
 		}
 
-		if (idMapBuf.size() && idMapBuf[subMeshIdx].size())
+		if (uvs.size())
 		{
-			std::string srcAccessors_AttrViews_idMapAttributeView = srcAccessors_AttributeViews + "." + idMapAttributeView + ".";
-
-			tree.addToTree(srcAccessors_AttrViews_idMapAttributeView + SRC_LABEL_BUFFVIEW, idMapBufferView);
-			tree.addToTree(srcAccessors_AttrViews_idMapAttributeView + SRC_LABEL_BYTE_OFFSET, 0);
-			tree.addToTree(srcAccessors_AttrViews_idMapAttributeView + SRC_LABEL_BYTE_STRIDE, 4);
-			tree.addToTree(srcAccessors_AttrViews_idMapAttributeView + SRC_LABEL_COMP_TYPE, SRC_X3DOM_FLOAT);
-			tree.addToTree(srcAccessors_AttrViews_idMapAttributeView + SRC_LABEL_TYPE, SRC_SCALAR);
-			tree.addToTree(srcAccessors_AttrViews_idMapAttributeView + SRC_LABEL_COUNT, vCount);
-
-			std::vector<uint32_t> offsetArr = { 0 };
-			std::vector<uint32_t> scaleArr = { 1 };
-			tree.addToTree(srcAccessors_AttrViews_idMapAttributeView + SRC_LABEL_DECODE_OFFSET, offsetArr);
-			tree.addToTree(srcAccessors_AttrViews_idMapAttributeView + SRC_LABEL_DECODE_SCALE, scaleArr);
-
-			std::string srcBufferChunks_idMapBufferChunks = SRC_LABEL_BUFFER_CHUNKS + "." + idMapBufferChunk + ".";
-			size_t idMapBufferLength = idMapBuf[subMeshIdx].size() * sizeof(*idMapBuf[subMeshIdx].data());
+			// UV coordinates
+			attributeViews.startObject(uvAttributeView);
+			attributeViews.addMember(SRC_LABEL_BUFFVIEW, uvBufferView);
+			attributeViews.addMember(SRC_LABEL_BYTE_OFFSET, 0);
+			attributeViews.addMember(SRC_LABEL_BYTE_STRIDE, uvStride);
+			attributeViews.addMember(SRC_LABEL_COMP_TYPE, quantise ? SRC_X3DOM_USHORT : SRC_X3DOM_FLOAT);
+			attributeViews.addMember(SRC_LABEL_TYPE, SRC_VECTOR_2D);
+			attributeViews.addMember(SRC_LABEL_COUNT, vCount);
+			if (quantise)
+			{
+				const repo::lib::RepoVector2D &min = uvMin[subMeshIdx];
+				const repo::lib::RepoVector2D &scale = uvScale[subMeshIdx];
+				attributeViews.addMember(SRC_LABEL_DECODE_OFFSET, std::vector<float>({ min.x / scale.x, min.y / scale.y }));
+				attributeViews.addMember(SRC_LABEL_DECODE_SCALE, std::vector<float>({ scale.x, scale.y }));
+			}
+			else
+			{
+				attributeViews.addMember(SRC_LABEL_DECODE_OFFSET, std::vector<uint32_t>({ 0, 0 }));
+				attributeViews.addMember(SRC_LABEL_DECODE_SCALE, std::vector<uint32_t>({ 1, 1 }));
+			}
+			attributeViews.endObject();
 
-			tree.addToTree(srcBufferChunks_idMapBufferChunks + SRC_LABEL_BYTE_OFFSET, idMapWritePosition);
-			tree.addToTree(srcBufferChunks_idMapBufferChunks + SRC_LABEL_BYTE_LENGTH, idMapBufferLength);
+			size_t uvBufferLength = vCount * uvStride;
 
-			idMapWritePosition += idMapBufferLength;
+			bufferChunks.startObject(uvBufferChunk);
+			bufferChunks.addMember(SRC_LABEL_BYTE_OFFSET, uvWritePosition);
+			bufferChunks.addMember(SRC_LABEL_BYTE_LENGTH, uvBufferLength);
+			bufferChunks.endObject();
 
-			std::string srcBufferViews_idMapBufferView = SRC_LABEL_BUFF_VIEWS + "." + idMapBufferView + ".";
+			uvWritePosition += uvBufferLength;
 
-			std::vector<std::string> chunksArray = { idMapBufferChunk };
-			tree.addToTree(srcBufferViews_idMapBufferView + SRC_LABEL_CHUNKS, chunksArray);
+			bufferViews.startObject(uvBufferView);
+			bufferViews.addMember(SRC_LABEL_CHUNKS, std::vector<std::string>({ uvBufferChunk }));
+			bufferViews.endObject();
 
-			tree.addToTree(srcMesh_MeshID + SRC_LABEL_ATTRS + "." + SRC_LABEL_ID, idMapAttributeView);
+			meshes.addMember(SRC_LABEL_TEX_COORD, uvAttributeView);
 		}
+		meshes.endObject();
 
-		if (uvs.size())
+		// Index View
+		if (faceBuf.size())
 		{
-			// UV coordinates
-			std::string srcAccessors_AttrViews_uvAttrView = srcAccessors_AttributeViews + "." + uvAttributeView + ".";
-			tree.addToTree(srcAccessors_AttrViews_uvAttrView + SRC_LABEL_BUFFVIEW, uvBufferView);
-			tree.addToTree(srcAccessors_AttrViews_uvAttrView + SRC_LABEL_BYTE_OFFSET, 0);
-			tree.addToTree(srcAccessors_AttrViews_uvAttrView + SRC_LABEL_BYTE_STRIDE, 8);
-			tree.addToTree(srcAccessors_AttrViews_uvAttrView + SRC_LABEL_COMP_TYPE, SRC_X3DOM_FLOAT);
-			tree.addToTree(srcAccessors_AttrViews_uvAttrView + SRC_LABEL_TYPE, SRC_VECTOR_2D);
-			tree.addToTree(srcAccessors_AttrViews_uvAttrView + SRC_LABEL_COUNT, vCount);
-
-			std::vector<uint32_t> offsetArr = { 0, 0 };
-			std::vector<uint32_t> scaleArr = { 1, 1 };
-			tree.addToTree(srcAccessors_AttrViews_uvAttrView + SRC_LABEL_DECODE_OFFSET, offsetArr);
-			tree.addToTree(srcAccessors_AttrViews_uvAttrView + SRC_LABEL_DECODE_SCALE, scaleArr);
+			indexViews.startObject(indexView);
+			indexViews.addMember(SRC_LABEL_BUFFVIEW, indexBufferView);
+			indexViews.addMember(SRC_LABEL_BYTE_OFFSET, 0);
+			indexViews.addMember(SRC_LABEL_COMP_TYPE, SRC_X3DOM_USHORT);
+			indexViews.addMember(SRC_LABEL_COUNT, fCount * 3);
+			indexViews.endObject();
 
-			std::string srcBufferChunks_uvBufferChunks = SRC_LABEL_BUFFER_CHUNKS + "." + uvBufferChunk + ".";
-			size_t uvBufferLength = vCount * sizeof(*uvs.data());
-
-			tree.addToTree(srcBufferChunks_uvBufferChunks + SRC_LABEL_BYTE_OFFSET, uvWritePosition);
-			tree.addToTree(srcBufferChunks_uvBufferChunks + SRC_LABEL_BYTE_LENGTH, uvBufferLength);
+			size_t facesBufferLength = fCount * 3 * sizeof(*faceBuf.data()); //3 shorts for face index
 
-			uvWritePosition += uvBufferLength;
+			bufferChunks.startObject(indexBufferChunk);
+			bufferChunks.addMember(SRC_LABEL_BYTE_OFFSET, facesWritePosition);
+			bufferChunks.addMember(SRC_LABEL_BYTE_LENGTH, facesBufferLength);
+			bufferChunks.endObject();
 
-			std::string srcBufferViews_uvBufferView = SRC_LABEL_BUFF_VIEWS + "." + uvBufferView + ".";
+			facesWritePosition += facesBufferLength;
 
-			std::vector<std::string> chunksArray = { uvBufferChunk };
-			tree.addToTree(srcBufferViews_uvBufferView + SRC_LABEL_CHUNKS, chunksArray);
+			bufferViews.startObject(indexBufferView);
+			bufferViews.addMember(SRC_LABEL_CHUNKS, std::vector<std::string>({ indexBufferChunk }));
+			bufferViews.endObject();
 
-			tree.addToTree(srcMesh_MeshID + SRC_LABEL_ATTRS + "." + SRC_LABEL_TEX_COORD, uvAttributeView);
+			meshes.addMember(SRC_LABEL_INDICIES, indexView);
+			meshes.addMember(SRC_LABEL_PRIMITIVE, SRC_X3DOM_TRIANGLE);
 		}
+		meshes.endObject();
 	}//for (size_t subMeshIdx = 0; subMeshIdx < nSubMeshes; ++subMeshIdx)
 
 	repoTrace << "Generating output buffers for " << idx;
@@ -601,13 +793,13 @@ bool SRCModelExport::addMeshToExport(
 		}
 	}
 
-	size_t bufferSize = vertices.size() * sizeof(*vertices.data())
-		+ normals.size() * sizeof(*normals.data())
+	size_t bufferSize = vertexByteSize
+		+ normalByteSize
 		+ faceBuf.size() * sizeof(*faceBuf.data())
 		+ idMapBufFull.size() * sizeof(*idMapBufFull.data())
-		+ uvs.size() *sizeof(*uvs.data());
+		+ uvByteSize;
 
-	std::vector<uint8_t> dataBuffer;
+	std::vector<uint8_t> &dataBuffer = file.data;
 	dataBuffer.resize(bufferSize);
 
 	size_t bufferPtr = 0;
@@ -615,8 +807,8 @@ bool SRCModelExport::addMeshToExport(
 	// Output vertices
 	if (vertices.size())
 	{
-		size_t byteSize = vertices.size() * sizeof(*vertices.data());
-		memcpy(&dataBuffer[bufferPtr], vertices.data(), byteSize);
+		size_t byteSize = vertexByteSize;
+		memcpy(&dataBuffer[bufferPtr], vertexData, byteSize);
 		bufferPtr += byteSize;
 
 		repoTrace << "Written Vertices: byte Size " << byteSize << " bufferPtr is " << bufferPtr;
@@ -625,8 +817,8 @@ bool SRCModelExport::addMeshToExport(
 	// Output normals
 	if (normals.size())
 	{
-		size_t byteSize = normals.size() * sizeof(*normals.data());
-		memcpy(&dataBuffer[bufferPtr], normals.data(), byteSize);
+		size_t byteSize = normalByteSize;
+		memcpy(&dataBuffer[bufferPtr], normalData, byteSize);
 		bufferPtr += byteSize;
 		repoTrace << "Written normals: byte Size " << byteSize << " bufferPtr is " << bufferPtr;
 	}
@@ -649,16 +841,36 @@ bool SRCModelExport::addMeshToExport(
 	}
 
 	if (uvs.size()) {
-		size_t byteSize = uvs.size() * sizeof(*uvs.data());
-		memcpy(&dataBuffer[bufferPtr], uvs.data(), byteSize);
+		size_t byteSize = uvByteSize;
+		memcpy(&dataBuffer[bufferPtr], uvData, byteSize);
 		bufferPtr += byteSize;
 		repoTrace << "Written UVs: byte Size " << byteSize << " bufferPtr is " << bufferPtr;
 	}
 
-	std::string fname = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/" + meshId + fileExt;
-
-	trees[fname] = tree;
-	fullDataBuffer[fname] = dataBuffer;
+	file.fileName = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/" + meshId + fileExt;
+
+	attributeViews.endObject();
+	indexViews.endObject();
+	bufferChunks.endObject();
+	bufferViews.endObject();
+	meshes.endObject();
+
+	repo::lib::JSONWriter &tree = file.header;
+	tree = repo::lib::JSONWriter();
+	tree.startObject();
+	tree.startObject(SRC_LABEL_ACCESSORS);
+	tree.addKey(SRC_LABEL_ACCESSORS_ATTR_VIEWS);
+	tree.addRaw(attributeViews.getString());
+	tree.addKey(SRC_LABEL_INDEX_VIEWS);
+	tree.addRaw(indexViews.getString());
+	tree.endObject();
+	tree.addKey(SRC_LABEL_BUFFER_CHUNKS);
+	tree.addRaw(bufferChunks.getString());
+	tree.addKey(SRC_LABEL_BUFF_VIEWS);
+	tree.addRaw(bufferViews.getString());
+	tree.addKey(SRC_LABEL_MESHES);
+	tree.addRaw(meshes.getString());
+	tree.endObject();
 
 	return true;
 }
\ No newline at end of file
@@ -24,7 +24,7 @@
 #include <string>
 
 #include "repo_model_export_web.h"
-#include "../../../lib/repo_property_tree.h"
+#include "../../../lib/repo_json_writer.h"
 #include "../../../core/model/collection/repo_scene.h"
 #include "../../../core/model/bson/repo_node_mesh.h"
 
@@ -37,8 +37,13 @@ namespace repo{
 				/**
 				* Default Constructor, export model with default settings
 				* @param scene repo scene to convert
+				* @param options export options
+				* @param sink if given, files are handed over to it as soon as they are complete
 				*/
-				SRCModelExport(const repo::core::model::RepoScene *scene);
+				SRCModelExport(
+					const repo::core::model::RepoScene *scene,
+					const WebExportOptions             &options = WebExportOptions(),
+					WebExportSink                      *sink = nullptr);
 
 				/**
 				* Default Destructor
@@ -52,9 +57,32 @@ namespace repo{
 				*/
 				repo_web_buffers_t getAllFilesExportedAsBuffer() const;
 
+			protected:
+				/**
+				* Hand the SRC files over to a sink
+				* @param target destination of the files
+				* @return returns true if the sink accepted every file
+				*/
+				bool exportGeoFilesToSink(WebExportSink &target);
+
 			private:
 				std::unordered_map<std::string, std::vector<uint8_t>> fullDataBuffer;
 
+				/**
+				* SRC file of a mesh, generated on its own and added to the export afterwards
+				*/
+				struct src_mesh_file_t
+				{
+					std::string fileName;
+					repo::lib::JSONWriter header;
+					std::vector<uint8_t> data;
+					//how the mappings are split, for the JSON mapping of multipart meshes
+					std::unordered_map<repo::lib::RepoUUID, std::vector<uint32_t>, repo::lib::RepoUUIDHasher> splitMapping;
+					bool isMultipart;
+
+					src_mesh_file_t() : isMultipart(false) {}
+				};
+
 				/**
 				* Convert a Mesh Node into src format
 				* @param mesh the mesh to convert
@@ -62,14 +90,29 @@ namespace repo{
 				* @param faceBuf face buffer with only the face indices
 				* @param idMapBuf idMapping for each sub meshes
 				* @param fileExt file extension required for this SRC file (*.src/.src.mpc/.src?<query>)
+				* @param file SRC file to write the header and the data into
 				*/
 				bool addMeshToExport(
 					const repo::core::model::MeshNode &mesh,
 					const size_t &idx,
 					const std::vector<uint16_t> &faceBuf,
 					const std::vector<std::vector<float>>  &idMapBuf,
-					const std::string                      &fileExt
-					);
+					const std::string                      &fileExt,
+					src_mesh_file_t                        &file
+					) const;
+
+				/**
+				* Split a mesh for SRC and convert it into its own file
+				* Does not touch the export, so meshes can be converted concurrently
+				* @param node the mesh to convert
+				* @param idx index of the mesh within the export
+				* @param file SRC file of the mesh (output)
+				* @return returns true upon success
+				*/
+				bool generateMeshFile(
+					const repo::core::model::RepoNode *node,
+					const size_t                      &idx,
+					src_mesh_file_t                   &file) const;
 
 				/**
 				* Generate JSON mapping for multipart meshes
@@ -23,13 +23,15 @@
 #include "../../../lib/repo_log.h"
 #include "../../../core/model/bson/repo_bson_factory.h"
 
-#include <boost/filesystem.hpp>
-
 using namespace repo::manipulator::modelconvertor;
 
 WebModelExport::WebModelExport(
-	const repo::core::model::RepoScene *scene
-	) : AbstractModelExport(scene)
+	const repo::core::model::RepoScene *scene,
+	const WebExportOptions             &options,
+	WebExportSink                      *sink
+	) : AbstractModelExport(scene),
+	options(options),
+	sink(sink)
 {
 	//We don't cache reference scenes
 	if (convertSuccess = scene && !scene->getAllReferences(repo::core::model::RepoScene::GraphType::DEFAULT).size())
@@ -59,41 +61,30 @@ bool WebModelExport::exportToFile(
 {
 	if (!convertSuccess) return convertSuccess;
 
-	const repo_web_buffers_t buffers = getAllFilesExportedAsBuffer();
-
-	boost::filesystem::path boostPath(filePath);
-
-	for (const auto &buff : buffers.geoFiles)
+	WebFileSink fileSink(filePath);
+	bool success;
+	if (options.packFiles)
 	{
-		std::string fname = sanitizeFileName(buff.first);
-		boostPath /= fname;
-		FILE* fp = fopen(boostPath.string().c_str(), "wb");
-		if (fp)
-		{
-			fwrite(buff.second.data(), sizeof(*buff.second.data()), buff.second.size(), fp);
-			fclose(fp);
-		}
-		else
-		{
-			repoError << "Failed to open file for writing: " << fname;
-		}
+		WebPackedSink packedSink(fileSink, "web.pack", "web.pack.json");
+		success = exportToSink(packedSink) && packedSink.finish();
 	}
+	else
+		success = exportToSink(fileSink);
+	return fileSink.finish() && success;
+}
+
+bool WebModelExport::exportToSink(WebExportSink &target)
+{
+	if (!convertSuccess) return convertSuccess;
 
-	for (const auto &buff : buffers.jsonFiles)
+	bool success = exportGeoFilesToSink(target);
+	for (const auto &treePair : jsonTrees)
 	{
-		std::string fname = sanitizeFileName(buff.first);
-		boostPath /= fname;
-		FILE* fp = fopen(boostPath.string().c_str(), "wb");
-		if (fp)
-		{
-			fwrite(buff.second.data(), sizeof(*buff.second.data()), buff.second.size(), fp);
-			fclose(fp);
-		}
-		else
-		{
-			repoError << "Failed to open file for writing: " << fname;
-		}
+		success &= target.addFile(WebFileType::JSON, treePair.first, treePair.second.getBuffer());
 	}
+	jsonTrees.clear();
+
+	return success;
 }
 
 std::unordered_map<std::string, std::vector<uint8_t>> WebModelExport::getJSONFilesAsBuffer() const
@@ -102,13 +93,7 @@ std::unordered_map<std::string, std::vector<uint8_t>> WebModelExport::getJSONFil
 
 	for (const auto &treePair : jsonTrees)
 	{
-		std::stringstream ss;
-		treePair.second.write_json(ss);
-		std::string jsonStr = ss.str();
-
-		fileBuffers[treePair.first] = std::vector<uint8_t>();
-		fileBuffers[treePair.first].resize(jsonStr.size());
-		memcpy(fileBuffers[treePair.first].data(), jsonStr.c_str(), jsonStr.size());
+		fileBuffers[treePair.first] = treePair.second.getBuffer();
 	}
 
 	return fileBuffers;
@@ -116,15 +101,5 @@ std::unordered_map<std::string, std::vector<uint8_t>> WebModelExport::getJSONFil
 
 std::string WebModelExport::getSupportedFormats()
 {
-	return ".src, .gltf";
+	return ".src, .gltf, .glb";
 }
-
-std::string WebModelExport::sanitizeFileName(
-	const std::string &name) const
-{
-	std::string res = name;
-	std::replace(res.begin(), res.end(), '\\', '_');
-	std::replace(res.begin(), res.end(), '/', '_');
-
-	return res;
-}
\ No newline at end of file
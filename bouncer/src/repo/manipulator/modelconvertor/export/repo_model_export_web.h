@@ -24,14 +24,56 @@
 #include <string>
 
 #include "repo_model_export_abstract.h"
-#include "../../../lib/repo_property_tree.h"
+#include "repo_model_export_web_sink.h"
+#include "../../../lib/repo_json_writer.h"
 #include "../../../lib/datastructure/repo_structs.h"
 #include "../../../core/model/collection/repo_scene.h"
 
 namespace repo{
 	namespace manipulator{
 		namespace modelconvertor{
-			enum class WebExportType { GLTF, SRC };
+			enum class WebExportType { GLTF, SRC, GLB };
+
+			/**
+			* Options of the web exports, the defaults give the original encoding
+			*/
+			struct WebExportOptions
+			{
+				/**
+				* Store positions and UVs as 16 bit integers relative to the bounding
+				* box of each sub mesh and normals as 8 bit integers, instead of floats.
+				* Supported by the SRC and GLB exports (KHR_mesh_quantization)
+				*/
+				bool quantiseAttributes;
+
+				/**
+				* Reorder the faces of every sub mesh for the post-transform vertex
+				* cache (within each level of detail) and its vertices in order of use.
+				* Supported by the glTF and GLB exports
+				*/
+				bool optimiseVertexCache;
+
+				/**
+				* Write 32 bit indices and keep every mesh whole, instead of splitting
+				* meshes at 65535 vertices. Clients need 32 bit index support
+				* (WebGL 2 or OES_element_index_uint). Supported by the GLB export,
+				* the glTF and SRC exports fail if it is set
+				*/
+				bool useUInt32Indices;
+
+				/**
+				* Pack every file into a single container along with a manifest of
+				* the offset and length of each file, so they can be served as byte
+				* ranges of one object (see WebPackedSink). Supported by all exports.
+				* The container is only complete at the end of the export, so it is
+				* held in memory and uploaded afterwards, instead of each file being
+				* uploaded concurrently as soon as it is generated
+				*/
+				bool packFiles;
+
+				WebExportOptions() : quantiseAttributes(false), optimiseVertexCache(false), useUInt32Indices(false),
+					packFiles(false) {}
+			};
 
 			class WebModelExport : public AbstractModelExport
 			{
@@ -39,8 +81,14 @@ namespace repo{
 				/**
 				* Default Constructor, export model with default settings
 				* @param scene repo scene to convert
+				* @param options export options
+				* @param sink if given, files are handed over to it as soon as
+				*        they are complete instead of being kept by the exporter
 				*/
-				WebModelExport(const repo::core::model::RepoScene *scene);
+				WebModelExport(
+					const repo::core::model::RepoScene *scene,
+					const WebExportOptions             &options = WebExportOptions(),
+					WebExportSink                      *sink = nullptr);
 
 				/**
 				* Default Destructor
@@ -55,6 +103,14 @@ namespace repo{
 				virtual bool exportToFile(
 					const std::string &filePath);
 
+				/**
+				* Hand every file the exporter still holds over to a sink
+				* The files are moved out of the exporter
+				* @param target destination of the files
+				* @return returns true if the sink accepted every file
+				*/
+				bool exportToSink(WebExportSink &target);
+
 				/**
 				* Export all necessary files as buffers
 				* @return returns a repo_src_export_t containing all files needed for this
@@ -85,13 +141,18 @@ namespace repo{
 
 			protected:
 				bool convertSuccess;
+				const WebExportOptions options;
+				WebExportSink *sink;
 				repo::core::model::RepoScene::GraphType gType;
-				std::unordered_map<std::string, repo::lib::PropertyTree> trees;
-				std::unordered_map<std::string, repo::lib::PropertyTree> jsonTrees;
+				std::unordered_map<std::string, repo::lib::JSONWriter> trees;
+				std::unordered_map<std::string, repo::lib::JSONWriter> jsonTrees;
 
-			private:
-				std::string sanitizeFileName(
-					const std::string &name) const;
+				/**
+				* Hand the geometry files the exporter still holds over to a sink
+				* @param target destination of the files
+				* @return returns true if the sink accepted every file
+				*/
+				virtual bool exportGeoFilesToSink(WebExportSink &target) = 0;
 			};
 		} //namespace modelconvertor
 	} //namespace manipulator
@@ -0,0 +1,315 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "repo_model_export_web_sink.h"
+#include "../../../lib/repo_log.h"
+#include "../../../lib/repo_json_writer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <boost/filesystem.hpp>
+
+using namespace repo::manipulator::modelconvertor;
+
+static const uint32_t PACK_MAGIC = 0x4B415052; //"RPAK"
+static const uint32_t PACK_VERSION = 2;
+static const size_t PACK_HEADER_SIZE = 2 * sizeof(uint32_t) + sizeof(uint64_t);
+static const size_t PACK_INDEX_ENTRY_SIZE = 2 * sizeof(uint64_t);
+static const size_t PACK_TRAILER_SIZE = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+static const size_t PACK_ALIGNMENT = 8;
+
+static size_t alignPackOffset(const size_t &offset)
+{
+	return (offset + PACK_ALIGNMENT - 1) & ~(PACK_ALIGNMENT - 1);
+}
+
+template <typename T>
+static void writeLittleEndian(uint8_t *dest, T value)
+{
+	for (size_t i = 0; i < sizeof(T); ++i, value >>= 8)
+		dest[i] = (uint8_t)(value & 0xFF);
+}
+
+bool WebExportSink::addFile(
+	const WebFileType          &type,
+	const std::string          &fileName,
+	std::vector<uint8_t>       &&data)
+{
+	if (type == WebFileType::GEOMETRY)
+		++nGeoFiles;
+	else
+		++nJSONFiles;
+	return storeFile(type, fileName, std::move(data));
+}
+
+bool WebBufferSink::storeFile(
+	const WebFileType          &type,
+	const std::string          &fileName,
+	std::vector<uint8_t>       &&data)
+{
+	auto &files = type == WebFileType::GEOMETRY ? buffers.geoFiles : buffers.jsonFiles;
+	files[fileName] = std::move(data);
+	return true;
+}
+
+bool WebFileSink::storeFile(
+	const WebFileType          &type,
+	const std::string          &fileName,
+	std::vector<uint8_t>       &&data)
+{
+	std::string sanitizedName = fileName;
+	std::replace(sanitizedName.begin(), sanitizedName.end(), '\\', '_');
+	std::replace(sanitizedName.begin(), sanitizedName.end(), '/', '_');
+
+	const boost::filesystem::path filePath = boost::filesystem::path(directory) / sanitizedName;
+	FILE* fp = fopen(filePath.string().c_str(), "wb");
+	if (!fp)
+	{
+		repoError << "Failed to open file for writing: " << filePath.string();
+		return false;
+	}
+
+	const bool success = fwrite(data.data(), sizeof(*data.data()), data.size(), fp) == data.size();
+	fclose(fp);
+	if (!success)
+		repoError << "Failed to write file: " << filePath.string();
+	return success;
+}
+
+WebPackedSink::WebPackedSink(
+	WebExportSink      &target,
+	const std::string  &containerName,
+	const std::string  &manifestName)
+	: target(target),
+	containerName(containerName),
+	manifestName(manifestName),
+	finished(false)
+{
+}
+
+bool WebPackedSink::storeFile(
+	const WebFileType          &type,
+	const std::string          &fileName,
+	std::vector<uint8_t>       &&data)
+{
+	if (finished)
+	{
+		repoError << "Failed to add file  (" << fileName << "): the container " << containerName << " is already packed.";
+		return false;
+	}
+
+	if (container.empty())
+	{
+		container.resize(PACK_HEADER_SIZE, 0);
+		writeLittleEndian(&container[0], PACK_MAGIC);
+		writeLittleEndian(&container[4], PACK_VERSION);
+	}
+
+	//The file only lives in the container from now on
+	const size_t offset = alignPackOffset(container.size());
+	container.resize(offset, 0);
+	container.insert(container.end(), data.begin(), data.end());
+	files.push_back({ type, fileName, offset, data.size() });
+	std::vector<uint8_t>().swap(data);
+	return true;
+}
+
+bool WebPackedSink::finish()
+{
+	if (finished || files.empty())
+	{
+		finished = true;
+		return true;
+	}
+	finished = true;
+
+	const size_t indexOffset = alignPackOffset(container.size());
+	const size_t containerSize = indexOffset + files.size() * PACK_INDEX_ENTRY_SIZE + PACK_TRAILER_SIZE;
+	container.resize(containerSize, 0);
+
+	uint8_t *trailer = &container[containerSize - PACK_TRAILER_SIZE];
+	writeLittleEndian(trailer, (uint64_t)indexOffset);
+	writeLittleEndian(trailer + sizeof(uint64_t), (uint32_t)files.size());
+	writeLittleEndian(trailer + sizeof(uint64_t) + sizeof(uint32_t), PACK_MAGIC);
+
+	repo::lib::JSONWriter manifest;
+	manifest.startObject();
+	manifest.addMember("version", PACK_VERSION);
+	manifest.addMember("container", containerName);
+	manifest.addMember("length", containerSize);
+	manifest.startArray("files");
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		const auto &file = files[i];
+		uint8_t *entry = &container[indexOffset + i * PACK_INDEX_ENTRY_SIZE];
+		writeLittleEndian(entry, (uint64_t)file.offset);
+		writeLittleEndian(entry + sizeof(uint64_t), (uint64_t)file.length);
+
+		manifest.startObject();
+		manifest.addMember("name", file.fileName);
+		manifest.addMember("type", file.type == WebFileType::GEOMETRY ? "geometry" : "json");
+		manifest.addMember("offset", file.offset);
+		manifest.addMember("length", file.length);
+		manifest.endObject();
+	}
+	manifest.endArray();
+	manifest.endObject();
+
+	repoTrace << "Packed " << files.size() << " file(s) into " << containerName << " (" << containerSize << " bytes)";
+	files.clear();
+
+	bool success = target.addFile(WebFileType::GEOMETRY, containerName, std::move(container));
+	std::vector<uint8_t>().swap(container);
+	success &= target.addFile(WebFileType::JSON, manifestName, manifest.getBuffer());
+	return success;
+}
+
+WebDatabaseSink::WebDatabaseSink(
+	repo::core::handler::AbstractDatabaseHandler *handler,
+	const std::string                            &database,
+	const std::string                            &geoCollection,
+	const std::string                            &jsonCollection,
+	const size_t                                 &maxPendingBytes,
+	const uint32_t                               &maxUploaders)
+	: handler(handler),
+	database(database),
+	geoCollection(geoCollection),
+	jsonCollection(jsonCollection),
+	maxPendingBytes(maxPendingBytes),
+	pendingBytes(0),
+	finished(false),
+	success(handler != nullptr),
+	uploadStarted(false),
+	nUploadedFiles(0),
+	uploadedBytes(0)
+{
+	if (handler)
+	{
+		//Every upload holds a connection from the handler's pool for its duration
+		const uint32_t nUploaders = std::max(1u, std::min(maxUploaders, handler->connectionLimit()));
+		repoTrace << "Uploading web buffers with " << nUploaders << " connection(s)";
+		for (uint32_t i = 0; i < nUploaders; ++i)
+			uploaders.emplace_back(&WebDatabaseSink::uploadPendingFiles, this);
+	}
+	else
+		repoError << "Cannot upload web buffers: null pointer to database handler!";
+}
+
+WebDatabaseSink::~WebDatabaseSink()
+{
+	finish();
+}
+
+bool WebDatabaseSink::finish()
+{
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		finished = true;
+	}
+	fileAdded.notify_all();
+
+	if (uploaders.size())
+	{
+		const auto finishStart = std::chrono::steady_clock::now();
+		for (auto &uploader : uploaders)
+			uploader.join();
+
+		reportThroughput(uploaders.size(), uploadStarted && lastUploadEnd > finishStart ?
+			lastUploadEnd - finishStart : std::chrono::steady_clock::duration::zero());
+		uploaders.clear();
+	}
+	return success;
+}
+
+void WebDatabaseSink::reportThroughput(
+	const size_t                              &nUploaders,
+	const std::chrono::steady_clock::duration &tail) const
+{
+	if (!nUploadedFiles)
+		return;
+
+	const double seconds = std::chrono::duration<double>(lastUploadEnd - firstUploadStart).count();
+	const double megabytes = uploadedBytes / (1024. * 1024.);
+	repoInfo << "Uploaded " << nUploadedFiles << " web buffer file(s) (" << megabytes << "MB) in "
+		<< seconds << "s using " << nUploaders << " connection(s): "
+		<< (seconds > 0 ? megabytes / seconds : megabytes) << "MB/s, "
+		<< std::chrono::duration<double>(tail).count() << "s of which after the export finished";
+}
+
+bool WebDatabaseSink::storeFile(
+	const WebFileType          &type,
+	const std::string          &fileName,
+	std::vector<uint8_t>       &&data)
+{
+	boost::mutex::scoped_lock lock(mutex);
+	//A file bigger than the budget is still accepted once nothing else is pending
+	while (success && !finished && pendingFiles.size() && pendingBytes + data.size() > maxPendingBytes)
+		fileUploaded.wait(lock);
+
+	if (!success || finished)
+	{
+		repoError << "Failed to add file  (" << fileName << "): the upload has "
+			<< (finished ? "already finished." : "failed.");
+		return false;
+	}
+
+	pendingBytes += data.size();
+	pendingFiles.push_back({ type, fileName, std::move(data) });
+	lock.unlock();
+	fileAdded.notify_one();
+	return true;
+}
+
+void WebDatabaseSink::uploadPendingFiles()
+{
+	boost::mutex::scoped_lock lock(mutex);
+	while (true)
+	{
+		while (!finished && pendingFiles.empty())
+			fileAdded.wait(lock);
+		if (pendingFiles.empty())
+			break;
+
+		pending_file_t file = std::move(pendingFiles.front());
+		pendingFiles.pop_front();
+		if (!uploadStarted)
+		{
+			uploadStarted = true;
+			firstUploadStart = std::chrono::steady_clock::now();
+		}
+		lock.unlock();
+
+		std::string errMsg;
+		const std::string &collection = file.type == WebFileType::GEOMETRY ? geoCollection : jsonCollection;
+		const bool uploaded = handler->insertRawFile(database, collection, file.fileName, file.data, errMsg);
+		if (uploaded)
+			repoInfo << "File (" << file.fileName << ") added successfully.";
+		else
+			repoError << "Failed to add file  (" << file.fileName << "): " << errMsg;
+
+		lock.lock();
+		pendingBytes -= file.data.size();
+		success &= uploaded;
+		if (uploaded)
+		{
+			++nUploadedFiles;
+			uploadedBytes += file.data.size();
+		}
+		lastUploadEnd = std::chrono::steady_clock::now();
+		fileUploaded.notify_all();
+	}
+}
@@ -0,0 +1,281 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+* Destinations of the files generated by the web exports.
+* Files are handed over as soon as the exporter is done with them, so the
+* whole export never has to be held in memory at once.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "../../../core/handler/repo_database_handler_abstract.h"
+#include "../../../lib/datastructure/repo_structs.h"
+
+namespace repo{
+	namespace manipulator{
+		namespace modelconvertor{
+			enum class WebFileType { GEOMETRY, JSON };
+
+			class WebExportSink
+			{
+			public:
+				WebExportSink() : nGeoFiles(0), nJSONFiles(0) {}
+
+				virtual ~WebExportSink() {}
+
+				/**
+				* Hand a finished file over to the sink
+				* @param type type of the file
+				* @param fileName name of the file
+				* @param data content of the file, moved into the sink
+				* @return returns false if the file could not be stored
+				*/
+				bool addFile(
+					const WebFileType          &type,
+					const std::string          &fileName,
+					std::vector<uint8_t>       &&data);
+
+				/**
+				* Wait for every file handed over to be stored
+				* @return returns true if every file was stored successfully
+				*/
+				virtual bool finish() { return true; }
+
+				/**
+				* Get the number of files of a type handed over so far
+				* @param type type of the files
+				* @return returns the number of files
+				*/
+				size_t getFileCount(const WebFileType &type) const
+				{
+					return type == WebFileType::GEOMETRY ? nGeoFiles : nJSONFiles;
+				}
+
+			protected:
+				/**
+				* Store a file, called by addFile()
+				* @param type type of the file
+				* @param fileName name of the file
+				* @param data content of the file, owned by the sink from now on
+				* @return returns false if the file could not be stored
+				*/
+				virtual bool storeFile(
+					const WebFileType          &type,
+					const std::string          &fileName,
+					std::vector<uint8_t>       &&data) = 0;
+
+			private:
+				size_t nGeoFiles, nJSONFiles;
+			};
+
+			/**
+			* Keep the files in memory
+			*/
+			class WebBufferSink : public WebExportSink
+			{
+			public:
+				/**
+				* @param buffers buffers to add the files into
+				*/
+				WebBufferSink(repo_web_buffers_t &buffers) : buffers(buffers) {}
+
+			protected:
+				bool storeFile(
+					const WebFileType          &type,
+					const std::string          &fileName,
+					std::vector<uint8_t>       &&data);
+
+			private:
+				repo_web_buffers_t &buffers;
+			};
+
+			/**
+			* Write the files into a directory, path separators within the file
+			* names are replaced by underscores
+			*/
+			class WebFileSink : public WebExportSink
+			{
+			public:
+				/**
+				* @param directory directory to write the files into
+				*/
+				WebFileSink(const std::string &directory) : directory(directory) {}
+
+			protected:
+				bool storeFile(
+					const WebFileType          &type,
+					const std::string          &fileName,
+					std::vector<uint8_t>       &&data);
+
+			private:
+				const std::string directory;
+			};
+
+			/**
+			* Pack every file into a single container, handed over to another sink
+			* by finish() along with a JSON manifest of the files it holds.
+			* The container is built in memory: files are appended to it as they are
+			* added (the caller's buffer is released straight away), but nothing
+			* reaches the target before finish(). Packing therefore disables
+			* streaming: the whole export is held in memory at once and a
+			* WebDatabaseSink target uploads a single object, on a single connection,
+			* once the export is done.
+			* The index follows the files in a trailer, so each file can be served
+			* as a byte range of one object:
+			*   header: uint32 magic ("RPAK"), uint32 version, uint64 reserved
+			*   the files, each starting 8 bytes aligned
+			*   index (8 bytes aligned): file count x { uint64 offset, uint64 length }
+			*   trailer: uint64 index offset, uint32 file count, uint32 magic ("RPAK")
+			* Offsets are from the start of the container and all values are little
+			* endian. The manifest lists the files in index order with their name,
+			* type, offset and length.
+			*/
+			class WebPackedSink : public WebExportSink
+			{
+			public:
+				/**
+				* @param target sink to hand the container and the manifest over to
+				* @param containerName file name of the container
+				* @param manifestName file name of the manifest
+				*/
+				WebPackedSink(
+					WebExportSink      &target,
+					const std::string  &containerName,
+					const std::string  &manifestName);
+
+				/**
+				* Write the index and hand the container and the manifest over
+				* to the target sink. Does nothing if no file was added
+				* Files cannot be added once this is called
+				* @return returns true if the target accepted both files
+				*/
+				bool finish();
+
+			protected:
+				bool storeFile(
+					const WebFileType          &type,
+					const std::string          &fileName,
+					std::vector<uint8_t>       &&data);
+
+			private:
+				struct packed_file_t
+				{
+					WebFileType type;
+					std::string fileName;
+					size_t offset, length;
+				};
+
+				WebExportSink &target;
+				const std::string containerName, manifestName;
+				std::vector<uint8_t> container;
+				std::vector<packed_file_t> files;
+				bool finished;
+			};
+
+			/**
+			* Upload the files into the database (GridFS) from background threads,
+			* so uploads overlap with the generation of the next files.
+			* One uploader is started per connection of the handler, up to maxUploaders.
+			* addFile() blocks while more than maxPendingBytes are waiting to be uploaded
+			*/
+			class WebDatabaseSink : public WebExportSink
+			{
+			public:
+				/**
+				* @param handler database handler to upload with
+				* @param database database to upload into
+				* @param geoCollection collection of the geometry files
+				* @param jsonCollection collection of the JSON files
+				* @param maxPendingBytes maximum size of the files waiting to be uploaded
+				* @param maxUploaders maximum number of concurrent uploads
+				*/
+				WebDatabaseSink(
+					repo::core::handler::AbstractDatabaseHandler *handler,
+					const std::string                            &database,
+					const std::string                            &geoCollection,
+					const std::string                            &jsonCollection,
+					const size_t                                 &maxPendingBytes = 256 * 1024 * 1024,
+					const uint32_t                               &maxUploaders = 8);
+
+				/**
+				* Waits for the pending uploads
+				*/
+				~WebDatabaseSink();
+
+				/**
+				* Wait for every pending upload and report the upload throughput
+				* @return returns true if every file was uploaded successfully
+				*/
+				bool finish();
+
+			protected:
+				bool storeFile(
+					const WebFileType          &type,
+					const std::string          &fileName,
+					std::vector<uint8_t>       &&data);
+
+			private:
+				struct pending_file_t
+				{
+					WebFileType type;
+					std::string fileName;
+					std::vector<uint8_t> data;
+				};
+
+				/**
+				* Upload the pending files until finish() is called
+				* Run by every uploader thread
+				*/
+				void uploadPendingFiles();
+
+				/**
+				* Log the number of files uploaded and the aggregate throughput
+				* @param nUploaders number of concurrent uploaders
+				* @param tail time spent uploading once finish() was called
+				*/
+				void reportThroughput(
+					const size_t                              &nUploaders,
+					const std::chrono::steady_clock::duration &tail) const;
+
+				repo::core::handler::AbstractDatabaseHandler *handler;
+				const std::string database, geoCollection, jsonCollection;
+				const size_t maxPendingBytes;
+
+				std::deque<pending_file_t> pendingFiles;
+				size_t pendingBytes;
+				bool finished, success;
+				boost::mutex mutex;
+				boost::condition_variable fileAdded, fileUploaded;
+				std::vector<boost::thread> uploaders;
+
+				//statistics, from the start of the first upload to the end of the last one
+				bool uploadStarted;
+				size_t nUploadedFiles, uploadedBytes;
+				std::chrono::steady_clock::time_point firstUploadStart, lastUploadEnd;
+			};
+		} //namespace modelconvertor
+	} //namespace manipulator
+} //namespace repo
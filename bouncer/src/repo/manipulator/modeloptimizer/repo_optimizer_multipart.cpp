@@ -20,8 +20,12 @@
 */
 
 #include "repo_optimizer_multipart.h"
+#include <algorithm>
+#include <boost/thread.hpp>
 #include "../../core/model/bson/repo_bson_factory.h"
 #include "../../core/model/bson/repo_bson_builder.h"
+#include "../../lib/repo_parallel.h"
+#include "../../lib/datastructure/repo_mesh_weld.h"
 
 using namespace repo::manipulator::modeloptimizer;
 
@@ -29,8 +33,112 @@ auto defaultGraph = repo::core::model::RepoScene::GraphType::DEFAULT;
 
 static const size_t  REPO_MP_MAX_FACE_COUNT = 500000;
 
-MultipartOptimizer::MultipartOptimizer() :
-AbstractOptimizer()
+/**
+* Expand the bounding box to include the given point
+* @param point point to include
+* @param bbox bounding box to expand ({min, max}, initialised if empty)
+*/
+static void expandBoundingBox(
+	const repo::lib::RepoVector3D        &point,
+	std::vector<repo::lib::RepoVector3D> &bbox)
+{
+	if (bbox.size() < 2)
+	{
+		bbox = { point, point };
+		return;
+	}
+	bbox[0].x = std::min(bbox[0].x, point.x);
+	bbox[0].y = std::min(bbox[0].y, point.y);
+	bbox[0].z = std::min(bbox[0].z, point.z);
+	bbox[1].x = std::max(bbox[1].x, point.x);
+	bbox[1].y = std::max(bbox[1].y, point.y);
+	bbox[1].z = std::max(bbox[1].z, point.z);
+}
+
+/**
+* Expand the bounding box to include the given box once transformed
+* @param box box to transform ({min, max})
+* @param mat transformation to apply to the box
+* @param bbox bounding box to expand ({min, max}, initialised if empty)
+*/
+static void expandBoundingBox(
+	const std::vector<repo::lib::RepoVector3D> &box,
+	const repo::lib::RepoMatrix                &mat,
+	std::vector<repo::lib::RepoVector3D>       &bbox)
+{
+	for (uint32_t corner = 0; corner < 8; ++corner)
+	{
+		repo::lib::RepoVector3D point(
+			box[corner & 1].x, box[(corner >> 1) & 1].y, box[(corner >> 2) & 1].z);
+		expandBoundingBox(mat * point, bbox);
+	}
+}
+
+/**
+* Hash the given bytes (FNV-1a)
+* @param data bytes to hash
+* @param size number of bytes
+* @param hash hash to continue from
+* @return returns the updated hash
+*/
+static uint64_t hashBytes(const void *data, const size_t &size, uint64_t hash)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+* Spread the lower 21 bits of the value so there are 2 zero bits between each of them
+*/
+static uint64_t spreadBits(uint64_t value)
+{
+	value &= 0x1fffff;
+	value = (value | value << 32) & 0x1f00000000ffffULL;
+	value = (value | value << 16) & 0x1f0000ff0000ffULL;
+	value = (value | value << 8) & 0x100f00f00f00f00fULL;
+	value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+	value = (value | value << 2) & 0x1249249249249249ULL;
+	return value;
+}
+
+uint64_t MultipartOptimizer::getMortonCode(
+	const repo::lib::RepoVector3D              &point,
+	const std::vector<repo::lib::RepoVector3D> &bbox)
+{
+	const float maxCoord = (1 << 21) - 1;
+	auto quantise = [&maxCoord](const float &value, const float &min, const float &max) -> uint64_t
+	{
+		const float range = max - min;
+		if (range <= 0) return 0;
+		const float normalised = std::min(std::max((value - min) / range, 0.f), 1.f);
+		return (uint64_t)(normalised * maxCoord);
+	};
+
+	return spreadBits(quantise(point.x, bbox[0].x, bbox[1].x))
+		| spreadBits(quantise(point.y, bbox[0].y, bbox[1].y)) << 1
+		| spreadBits(quantise(point.z, bbox[0].z, bbox[1].z)) << 2;
+}
+
+MultipartOptimizer::MultipartOptimizer(
+	const uint32_t &nThreads,
+	const size_t   &maxVertices) :
+AbstractOptimizer(),
+nThreads(nThreads),
+maxVertices(maxVertices),
+weld(false),
+weldPositionTolerance(0),
+weldNormalTolerance(0),
+weldUVTolerance(0),
+instancing(false),
+minInstances(2),
+incremental(false),
+textureMerging(false),
+memoryBudget(0)
 {
 }
 
@@ -38,6 +146,53 @@ MultipartOptimizer::~MultipartOptimizer()
 {
 }
 
+void MultipartOptimizer::setVertexWelding(
+	const bool  &enable,
+	const float &positionTolerance,
+	const float &normalTolerance,
+	const float &uvTolerance)
+{
+	weld = enable;
+	weldPositionTolerance = positionTolerance;
+	weldNormalTolerance = normalTolerance;
+	weldUVTolerance = uvTolerance;
+}
+
+void MultipartOptimizer::setInstancing(
+	const bool     &enable,
+	const uint32_t &minInstances)
+{
+	instancing = enable;
+	this->minInstances = std::max(minInstances, (uint32_t)2);
+}
+
+void MultipartOptimizer::setTextureMerging(
+	const bool &enable)
+{
+	textureMerging = enable;
+}
+
+void MultipartOptimizer::setMemoryBudget(
+	const size_t &budget,
+	const std::function<bool(const repo::core::model::MeshNode&)> &flush)
+{
+	if (budget && !flush)
+	{
+		repoError << "Cannot set a memory budget without a function to flush the supermeshes with";
+		return;
+	}
+	memoryBudget = budget;
+	flushMesh = flush;
+}
+
+void MultipartOptimizer::setIncremental(
+	const std::vector<repo::lib::RepoUUID> &changedNodes)
+{
+	incremental = true;
+	this->changedNodes.clear();
+	this->changedNodes.insert(changedNodes.begin(), changedNodes.end());
+}
+
 bool MultipartOptimizer::apply(repo::core::model::RepoScene *scene)
 {
 	bool success = false;
@@ -53,28 +208,39 @@ bool MultipartOptimizer::apply(repo::core::model::RepoScene *scene)
 		return false;
 	}
 
+	PreviousStash previous;
 	if (scene->hasRoot(repo::core::model::RepoScene::GraphType::OPTIMIZED))
 	{
+		if (incremental)
+		{
+			//Keep a copy of the supermeshes and materials before the stash is cleared,
+			//instanced geometry (not directly under the root) is always regenerated
+			previous.rootID = scene->getRoot(repo::core::model::RepoScene::GraphType::OPTIMIZED)->getSharedID();
+			for (const auto &node : scene->getAllMeshes(repo::core::model::RepoScene::GraphType::OPTIMIZED))
+			{
+				const auto parents = node->getParentIDs();
+				//stubs have no buffers to reuse
+				auto mesh = (repo::core::model::MeshNode*)node;
+				if (parents.size() == 1 && parents[0] == previous.rootID && !mesh->isStub())
+					previous.meshes.push_back(*mesh);
+			}
+			for (const auto &node : scene->getAllMaterials(repo::core::model::RepoScene::GraphType::OPTIMIZED))
+			{
+				previous.materials[node->getUniqueID()] = *(repo::core::model::MaterialNode*)node;
+			}
+		}
 		repoInfo << "The scene already has a stash graph, removing...";
 		scene->clearStash();
 	}
 
-	return generateMultipartScene(scene);
+	return generateMultipartScene(scene, previous);
 }
-#ifdef REPO_MP_TEXTURE_WORK_AROUND
-bool MultipartOptimizer::collectMeshData(
+bool MultipartOptimizer::collectMeshInstances(
 	const repo::core::model::RepoScene        *scene,
 	const repo::core::model::RepoNode         *node,
-	const std::set<repo::lib::RepoUUID>                  &meshGroup,
-	repo::lib::RepoMatrix                        &mat,
-	std::vector<std::vector<repo::lib::RepoVector3D>>                &vertices,
-	std::vector<std::vector<repo::lib::RepoVector3D>>               &normals,
-	std::vector<std::vector<repo_face_t>>                &faces,
-	std::vector<std::vector<std::vector<repo::lib::RepoVector2D>>> &uvChannels,
-	std::vector<std::vector<repo_color4d_t>>               &colors,
-	std::vector<std::vector<repo_mesh_mapping_t>>          &meshMapping,
-	std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>                 &matIDMap
-	)
+	const repo::lib::RepoMatrix               &mat,
+	std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> &meshInstances,
+	std::vector<repo::lib::RepoUUID>          &walkOrder)
 {
 	bool success = false;
 	if (success = scene && node)
@@ -84,114 +250,146 @@ bool MultipartOptimizer::collectMeshData(
 		case repo::core::model::NodeType::TRANSFORMATION:
 		{
 			auto trans = (repo::core::model::TransformationNode *) node;
-			mat = mat * trans->getTransMatrix(false);
+			const repo::lib::RepoMatrix childMat = mat * trans->getTransMatrix(false);
 			auto children = scene->getChildrenAsNodes(defaultGraph, trans->getSharedID());
 			for (const auto &child : children)
 			{
-				auto childMat = mat; //We don't want actually want to update the matrix with our children's transformation
-				success &= collectMeshData(scene, child, meshGroup, childMat, vertices,
-					normals, faces, uvChannels, colors, meshMapping, matIDMap);
+				success &= collectMeshInstances(scene, child, childMat, meshInstances, walkOrder);
 			}
 			break;
 		}
 
 		case repo::core::model::NodeType::MESH:
 		{
-			repo::lib::RepoUUID meshUniqueID = node->getUniqueID();
-			if (meshGroup.find(meshUniqueID) != meshGroup.end())
+			meshInstances[node->getUniqueID()].push_back(
+				std::make_pair((const repo::core::model::MeshNode *) node, mat));
+			walkOrder.push_back(node->getUniqueID());
+			break;
+		}
+		}
+	}
+	else
+	{
+		repoError << "Scene or node is null!";
+	}
+
+	return success;
+}
+
+#ifdef REPO_MP_TEXTURE_WORK_AROUND
+bool MultipartOptimizer::collectMeshData(
+	const repo::core::model::RepoScene        *scene,
+	const MeshInstances                       &meshGroup,
+	std::vector<std::vector<repo::lib::RepoVector3D>>                &vertices,
+	std::vector<std::vector<repo::lib::RepoVector3D>>               &normals,
+	std::vector<std::vector<repo_face_t>>                &faces,
+	std::vector<std::vector<std::vector<repo::lib::RepoVector2D>>> &uvChannels,
+	std::vector<std::vector<repo_color4d_t>>               &colors,
+	std::vector<std::vector<repo_mesh_mapping_t>>          &meshMapping,
+	const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDMap
+	)
+{
+	bool success = false;
+	if (success = scene != nullptr)
+	{
+		for (const auto &meshInstance : meshGroup)
+		{
+			auto mesh = meshInstance.first;
+			repo::lib::RepoUUID meshUniqueID = mesh->getUniqueID();
+
+			repo::core::model::MeshNode transformedMesh = mesh->cloneAndApplyTransformation(meshInstance.second);
+			//this node is in the grouping, add it into the data buffers
+			repo_mesh_mapping_t meshMap;
+			auto matIt = matIDMap.find(getMaterialID(scene, mesh));
+			if (matIt == matIDMap.end())
 			{
-				auto mesh = (repo::core::model::MeshNode *) node;
+				repoError << "Material of mesh " << meshUniqueID << " has not been assigned a new ID!";
+				success = false;
+				continue;
+			}
+			meshMap.material_id = matIt->second;
+			meshMap.mesh_id = meshUniqueID;
+			auto bbox = transformedMesh.getBoundingBox();
+			if (bbox.size() >= 2)
+			{
+				meshMap.min = bbox[0];
+				meshMap.max = bbox[1];
+			}
 
-				repo::core::model::MeshNode transformedMesh = mesh->cloneAndApplyTransformation(mat);
-				//this node is in the grouping, add it into the data buffers
-				repo_mesh_mapping_t meshMap;
-				repo::lib::RepoUUID matID = getMaterialID(scene, &transformedMesh);
-				repo::lib::RepoUUID newMatID;
-				if (matIDMap.find(matID) == matIDMap.end())
-				{
-					newMatID = repo::lib::RepoUUID::createUUID();
-					matIDMap[matID] = newMatID;
-				}
-				else
-					newMatID = matIDMap[matID];
-				meshMap.material_id = newMatID;
-				meshMap.mesh_id = meshUniqueID;
-				auto bbox = transformedMesh.getBoundingBox();
-				if (bbox.size() >= 2)
-				{
-					meshMap.min = bbox[0];
-					meshMap.max = bbox[1];
-				}
+			std::vector<repo::lib::RepoVector3D> submVertices = transformedMesh.getVertices();
+			std::vector<repo::lib::RepoVector3D> submNormals = transformedMesh.getNormals();
+			std::vector<repo_face_t>   submFaces = transformedMesh.getFaces();
+			std::vector<repo_color4d_t> submColors = transformedMesh.getColors();
+			std::vector<std::vector<repo::lib::RepoVector2D>> submUVs = transformedMesh.getUVChannelsSeparated();
 
-				std::vector<repo::lib::RepoVector3D> submVertices = transformedMesh.getVertices();
-				std::vector<repo::lib::RepoVector3D> submNormals = transformedMesh.getNormals();
-				std::vector<repo_face_t>   submFaces = transformedMesh.getFaces();
-				std::vector<repo_color4d_t> submColors = transformedMesh.getColors();
-				std::vector<std::vector<repo::lib::RepoVector2D>> submUVs = transformedMesh.getUVChannelsSeparated();
+			if (weld)
+			{
+				repo::lib::weldVertices(submVertices, submNormals, submUVs, submColors, submFaces,
+					weldPositionTolerance, weldNormalTolerance, weldUVTolerance);
+			}
 
-				if (success = submVertices.size() && submFaces.size())
+			if (submVertices.size() && submFaces.size())
+			{
+				vertices.push_back(std::vector<repo::lib::RepoVector3D>());
+				normals.push_back(std::vector<repo::lib::RepoVector3D>());
+				colors.push_back(std::vector<repo_color4d_t>());
+				uvChannels.push_back(std::vector<std::vector<repo::lib::RepoVector2D>>());
+				faces.push_back(std::vector<repo_face_t>());
+				meshMapping.push_back(std::vector<repo_mesh_mapping_t>());
+
+				meshMap.vertFrom = vertices.back().size();
+				meshMap.vertTo = meshMap.vertFrom + submVertices.size();
+				meshMap.triFrom = faces.back().size();
+				meshMap.triTo = faces.back().size() + submFaces.size();
+
+				meshMapping.back().push_back(meshMap);
+
+				vertices.back().insert(vertices.back().end(), submVertices.begin(), submVertices.end());
+				for (const auto face : submFaces)
 				{
-					vertices.push_back(std::vector<repo::lib::RepoVector3D>());
-					normals.push_back(std::vector<repo::lib::RepoVector3D>());
-					colors.push_back(std::vector<repo_color4d_t>());
-					uvChannels.push_back(std::vector<std::vector<repo::lib::RepoVector2D>>());
-					faces.push_back(std::vector<repo_face_t>());
-					meshMapping.push_back(std::vector<repo_mesh_mapping_t>());
-
-					meshMap.vertFrom = vertices.back().size();
-					meshMap.vertTo = meshMap.vertFrom + submVertices.size();
-					meshMap.triFrom = faces.back().size();
-					meshMap.triTo = faces.back().size() + submFaces.size();
-
-					meshMapping.back().push_back(meshMap);
-
-					vertices.back().insert(vertices.back().end(), submVertices.begin(), submVertices.end());
-					for (const auto face : submFaces)
+					repo_face_t offsetFace;
+					for (const auto idx : face)
 					{
-						repo_face_t offsetFace;
-						for (const auto idx : face)
-						{
-							offsetFace.push_back(meshMap.vertFrom + idx);
-						}
-						faces.back().push_back(offsetFace);
+						offsetFace.push_back(meshMap.vertFrom + idx);
 					}
+					faces.back().push_back(offsetFace);
+				}
 
-					if (submNormals.size())
-						normals.back().insert(normals.back().end(), submNormals.begin(), submNormals.end());
-					if (submColors.size())
-						colors.back().insert(colors.back().end(), submColors.begin(), submColors.end());
+				if (submNormals.size())
+					normals.back().insert(normals.back().end(), submNormals.begin(), submNormals.end());
+				if (submColors.size())
+					colors.back().insert(colors.back().end(), submColors.begin(), submColors.end());
 
-					if (uvChannels.back().size() == 0 && submUVs.size() != 0)
-					{
-						//initialise uvChannels
-						uvChannels.back().resize(submUVs.size());
-					}
+				if (uvChannels.back().size() == 0 && submUVs.size() != 0)
+				{
+					//initialise uvChannels
+					uvChannels.back().resize(submUVs.size());
+				}
 
-					if (success = uvChannels.back().size() == submUVs.size())
-					{
-						for (uint32_t i = 0; i < submUVs.size(); ++i)
-						{
-							uvChannels.back()[i].insert(uvChannels.back()[i].end(), submUVs[i].begin(), submUVs[i].end());
-						}
-					}
-					else
+				if (uvChannels.back().size() == submUVs.size())
+				{
+					for (uint32_t i = 0; i < submUVs.size(); ++i)
 					{
-						//This shouldn't happen, if it does, then it means the mFormat isn't set correctly
-						repoError << "Unexpected transformedMesh format mismatch occured!";
+						uvChannels.back()[i].insert(uvChannels.back()[i].end(), submUVs[i].begin(), submUVs[i].end());
 					}
 				}
 				else
 				{
-					repoError << "Failed merging meshes: Vertices or faces cannot be null!";
+					//This shouldn't happen, if it does, then it means the mFormat isn't set correctly
+					repoError << "Unexpected transformedMesh format mismatch occured!";
+					success = false;
 				}
 			}
-			break;
-		}
+			else
+			{
+				repoError << "Failed merging meshes: Vertices or faces cannot be null!";
+				success = false;
+			}
 		}
 	}
 	else
 	{
-		repoError << "Scene or node is null!";
+		repoError << "Scene is null!";
 	}
 
 	return success;
@@ -200,138 +398,205 @@ bool MultipartOptimizer::collectMeshData(
 
 bool MultipartOptimizer::collectMeshData(
 	const repo::core::model::RepoScene        *scene,
-	const repo::core::model::RepoNode         *node,
-	const std::set<repo::lib::RepoUUID>                  &meshGroup,
-	repo::lib::RepoMatrix                       &mat,
+	const MeshInstances                       &meshGroup,
 	std::vector<repo::lib::RepoVector3D>                &vertices,
 	std::vector<repo::lib::RepoVector3D>                &normals,
 	std::vector<repo_face_t>                  &faces,
 	std::vector<std::vector<repo::lib::RepoVector2D>> &uvChannels,
 	std::vector<repo_color4d_t>               &colors,
 	std::vector<repo_mesh_mapping_t>          &meshMapping,
-	std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>    &matIDMap
+	const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDMap
 	)
 {
 	bool success = false;
-	if (success = scene && node)
+	if (success = scene != nullptr)
 	{
-		switch (node->getTypeAsEnum())
-		{
-		case repo::core::model::NodeType::TRANSFORMATION:
+		for (const auto &meshInstance : meshGroup)
 		{
-			auto trans = (repo::core::model::TransformationNode *) node;
-			mat = mat * trans->getTransMatrix(false);
-			auto children = scene->getChildrenAsNodes(defaultGraph, trans->getSharedID());
-			for (const auto &child : children)
+			auto mesh = meshInstance.first;
+			repo::lib::RepoUUID meshUniqueID = mesh->getUniqueID();
+
+			repo::core::model::MeshNode transformedMesh = mesh->cloneAndApplyTransformation(meshInstance.second);
+			//this node is in the grouping, add it into the data buffers
+			repo_mesh_mapping_t meshMap;
+			auto matIt = matIDMap.find(getMaterialID(scene, mesh));
+			if (matIt == matIDMap.end())
 			{
-				auto childMat = mat; //We don't want actually want to update the matrix with our children's transformation
-				success &= collectMeshData(scene, child, meshGroup, childMat,
-					vertices, normals, faces, uvChannels, colors, meshMapping, matIDMap);
+				repoError << "Material of mesh " << meshUniqueID << " has not been assigned a new ID!";
+				success = false;
+				continue;
 			}
-			break;
-		}
-
-		case repo::core::model::NodeType::MESH:
-		{
-			repo::lib::RepoUUID meshUniqueID = node->getUniqueID();
-			if (meshGroup.find(meshUniqueID) != meshGroup.end())
+			meshMap.material_id = matIt->second;
+			meshMap.mesh_id = meshUniqueID;
+			auto bbox = transformedMesh.getBoundingBox();
+			if (bbox.size() >= 2)
 			{
-				auto mesh = (repo::core::model::MeshNode *) node;
+				meshMap.min = bbox[0];
+				meshMap.max = bbox[1];
+			}
 
-				repo::core::model::MeshNode transformedMesh = mesh->cloneAndApplyTransformation(mat);
-				//this node is in the grouping, add it into the data buffers
-				repo_mesh_mapping_t meshMap;
-				repo::lib::RepoUUID matID = getMaterialID(scene, mesh);
-				repo::lib::RepoUUID newMatID;
+			std::vector<repo::lib::RepoVector3D> submVertices = transformedMesh.getVertices();
+			std::vector<repo::lib::RepoVector3D> submNormals = transformedMesh.getNormals();
+			std::vector<repo_face_t>   submFaces = transformedMesh.getFaces();
+			std::vector<repo_color4d_t> submColors = transformedMesh.getColors();
+			std::vector<std::vector<repo::lib::RepoVector2D>> submUVs = transformedMesh.getUVChannelsSeparated();
 
-				if (matIDMap.find(matID) == matIDMap.end())
-				{
-					newMatID = repo::lib::RepoUUID::createUUID();
-					matIDMap[matID] = newMatID;
-				}
-				else
-					newMatID = matIDMap[matID];
-				meshMap.material_id = newMatID;
-				meshMap.mesh_id = meshUniqueID;
-				auto bbox = transformedMesh.getBoundingBox();
-				if (bbox.size() >= 2)
-				{
-					meshMap.min = bbox[0];
-					meshMap.max = bbox[1];
-				}
+			if (!submVertices.size() || !submFaces.size())
+			{
+				repoError << "Failed merging meshes: Vertices or faces cannot be null!";
+				success = false;
+				continue;
+			}
+
+			if (weld)
+			{
+				repo::lib::weldVertices(submVertices, submNormals, submUVs, submColors, submFaces,
+					weldPositionTolerance, weldNormalTolerance, weldUVTolerance);
+			}
 
-				std::vector<repo::lib::RepoVector3D> submVertices = transformedMesh.getVertices();
-				std::vector<repo::lib::RepoVector3D> submNormals = transformedMesh.getNormals();
-				std::vector<repo_face_t>   submFaces = transformedMesh.getFaces();
-				std::vector<repo_color4d_t> submColors = transformedMesh.getColors();
-				std::vector<std::vector<repo::lib::RepoVector2D>> submUVs = transformedMesh.getUVChannelsSeparated();
+			if (submVertices.size() > maxVertices)
+			{
+				//Split the mesh once here so every mesh mapping fits within the vertex budget
+				//and the exporters don't need to split it again
+				success &= splitMeshData(meshMap, submVertices, submNormals, submFaces, submColors, submUVs,
+					vertices, normals, faces, uvChannels, colors, meshMapping);
+				continue;
+			}
 
-				if (success = submVertices.size() && submFaces.size())
-				{
-					meshMap.vertFrom = vertices.size();
-					meshMap.vertTo = meshMap.vertFrom + submVertices.size();
-					meshMap.triFrom = faces.size();
-					meshMap.triTo = faces.size() + submFaces.size();
+			meshMap.vertFrom = vertices.size();
+			meshMap.vertTo = meshMap.vertFrom + submVertices.size();
+			meshMap.triFrom = faces.size();
+			meshMap.triTo = faces.size() + submFaces.size();
 
-					meshMapping.push_back(meshMap);
+			meshMapping.push_back(meshMap);
 
-					vertices.insert(vertices.end(), submVertices.begin(), submVertices.end());
-					for (const auto face : submFaces)
-					{
-						repo_face_t offsetFace;
-						for (const auto idx : face)
-						{
-							offsetFace.push_back(meshMap.vertFrom + idx);
-						}
-						faces.push_back(offsetFace);
-					}
+			vertices.insert(vertices.end(), submVertices.begin(), submVertices.end());
+			for (const auto face : submFaces)
+			{
+				repo_face_t offsetFace;
+				for (const auto idx : face)
+				{
+					offsetFace.push_back(meshMap.vertFrom + idx);
+				}
+				faces.push_back(offsetFace);
+			}
 
-					if (submNormals.size())
-						normals.insert(normals.end(), submNormals.begin(), submNormals.end());
-					if (submColors.size())
-						colors.insert(colors.end(), submColors.begin(), submColors.end());
+			if (submNormals.size())
+				normals.insert(normals.end(), submNormals.begin(), submNormals.end());
+			if (submColors.size())
+				colors.insert(colors.end(), submColors.begin(), submColors.end());
 
-					if (uvChannels.size() == 0 && submUVs.size() != 0)
-					{
-						//initialise uvChannels
-						uvChannels.resize(submUVs.size());
-					}
+			if (uvChannels.size() == 0 && submUVs.size() != 0)
+			{
+				//initialise uvChannels
+				uvChannels.resize(submUVs.size());
+			}
 
-					if (success = uvChannels.size() == submUVs.size())
-					{
-						for (uint32_t i = 0; i < submUVs.size(); ++i)
-						{
-							uvChannels[i].insert(uvChannels[i].end(), submUVs[i].begin(), submUVs[i].end());
-						}
-					}
-					else
-					{
-						//This shouldn't happen, if it does, then it means the mFormat isn't set correctly
-						repoError << "Unexpected transformedMesh format mismatch occured!";
-					}
-				}
-				else
+			if (uvChannels.size() == submUVs.size())
+			{
+				for (uint32_t i = 0; i < submUVs.size(); ++i)
 				{
-					repoError << "Failed merging meshes: Vertices or faces cannot be null!";
+					uvChannels[i].insert(uvChannels[i].end(), submUVs[i].begin(), submUVs[i].end());
 				}
 			}
-			break;
-		}
+			else
+			{
+				//This shouldn't happen, if it does, then it means the mFormat isn't set correctly
+				repoError << "Unexpected transformedMesh format mismatch occured!";
+				success = false;
+			}
 		}
 	}
 	else
 	{
-		repoError << "Scene or node is null!";
+		repoError << "Scene is null!";
 	}
 
 	return success;
 }
 
+bool MultipartOptimizer::splitMeshData(
+	const repo_mesh_mapping_t                               &meshMap,
+	const std::vector<repo::lib::RepoVector3D>              &submVertices,
+	const std::vector<repo::lib::RepoVector3D>              &submNormals,
+	const std::vector<repo_face_t>                          &submFaces,
+	const std::vector<repo_color4d_t>                       &submColors,
+	const std::vector<std::vector<repo::lib::RepoVector2D>> &submUVs,
+	std::vector<repo::lib::RepoVector3D>                    &vertices,
+	std::vector<repo::lib::RepoVector3D>                    &normals,
+	std::vector<repo_face_t>                                &faces,
+	std::vector<std::vector<repo::lib::RepoVector2D>>       &uvChannels,
+	std::vector<repo_color4d_t>                             &colors,
+	std::vector<repo_mesh_mapping_t>                        &meshMapping)
+{
+	if (uvChannels.size() == 0 && submUVs.size() != 0)
+	{
+		//initialise uvChannels
+		uvChannels.resize(submUVs.size());
+	}
+
+	if (uvChannels.size() != submUVs.size())
+	{
+		//This shouldn't happen, if it does, then it means the mFormat isn't set correctly
+		repoError << "Unexpected transformedMesh format mismatch occured!";
+		return false;
+	}
+
+	repoTrace << meshMap.mesh_id << " exceeds the maximum amount of vertices (" << maxVertices << "), splitting...";
+
+	//Faces are added in order, a new sub mesh is started whenever the next face may not fit
+	std::unordered_map<uint32_t, uint32_t> reIndexMap;
+	for (const auto &face : submFaces)
+	{
+		if (face.empty()) continue;
+		if (reIndexMap.empty() || meshMapping.back().vertTo - meshMapping.back().vertFrom + face.size() > maxVertices)
+		{
+			reIndexMap.clear();
+			meshMapping.push_back(meshMap);
+			meshMapping.back().vertFrom = meshMapping.back().vertTo = vertices.size();
+			meshMapping.back().triFrom = meshMapping.back().triTo = faces.size();
+			meshMapping.back().min = meshMapping.back().max = submVertices[face[0]];
+		}
+
+		auto &subMeshMap = meshMapping.back();
+		repo_face_t newFace;
+		for (const auto &idx : face)
+		{
+			auto it = reIndexMap.find(idx);
+			if (it == reIndexMap.end())
+			{
+				it = reIndexMap.insert(std::make_pair(idx, (uint32_t)vertices.size())).first;
+				const auto &vertex = submVertices[idx];
+				vertices.push_back(vertex);
+				if (submNormals.size())
+					normals.push_back(submNormals[idx]);
+				if (submColors.size())
+					colors.push_back(submColors[idx]);
+				for (uint32_t i = 0; i < submUVs.size(); ++i)
+					uvChannels[i].push_back(submUVs[i][idx]);
+
+				subMeshMap.min.x = std::min(subMeshMap.min.x, vertex.x);
+				subMeshMap.min.y = std::min(subMeshMap.min.y, vertex.y);
+				subMeshMap.min.z = std::min(subMeshMap.min.z, vertex.z);
+				subMeshMap.max.x = std::max(subMeshMap.max.x, vertex.x);
+				subMeshMap.max.y = std::max(subMeshMap.max.y, vertex.y);
+				subMeshMap.max.z = std::max(subMeshMap.max.z, vertex.z);
+				++subMeshMap.vertTo;
+			}
+			newFace.push_back(it->second);
+		}
+		faces.push_back(newFace);
+		++subMeshMap.triTo;
+	}
+
+	return true;
+}
+
 #ifdef REPO_MP_TEXTURE_WORK_AROUND
 std::vector<repo::core::model::MeshNode*> MultipartOptimizer::createSuperMesh(
 	const repo::core::model::RepoScene      *scene,
-	const std::set<repo::lib::RepoUUID>                &meshGroup,
-	std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>  &matIDs,
+	const MeshInstances                     &meshGroup,
+	const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs,
 	const bool                              &texture)
 {
 	std::vector<std::vector<repo::lib::RepoVector3D>> vertices, normals;
@@ -341,9 +606,7 @@ std::vector<repo::core::model::MeshNode*> MultipartOptimizer::createSuperMesh(
 	std::vector<std::vector<repo_mesh_mapping_t>> meshMapping;
 
 	std::vector<repo::core::model::MeshNode*> resultMeshes;
-	repo::lib::RepoMatrix startMat;
-
-	bool success = collectMeshData(scene, scene->getRoot(defaultGraph), meshGroup, startMat,
+	bool success = collectMeshData(scene, meshGroup,
 		vertices, normals, faces, uvChannels, colors, meshMapping, matIDs);
 
 	if (success && meshMapping.size())
@@ -394,8 +657,8 @@ std::vector<repo::core::model::MeshNode*> MultipartOptimizer::createSuperMesh(
 repo::core::model::MeshNode* MultipartOptimizer::createSuperMesh
 (
 const repo::core::model::RepoScene *scene,
-const std::set<repo::lib::RepoUUID>           &meshGroup,
-std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>  &matIDs)
+const MeshInstances                &meshGroup,
+const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs)
 {
 	std::vector<repo::lib::RepoVector3D> vertices, normals;
 	std::vector<repo_face_t> faces;
@@ -406,9 +669,7 @@ std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUID
 	repo::core::model::MeshNode* resultMesh = nullptr;
 
 	std::vector<repo::core::model::MeshNode*> resultMeshes;
-	repo::lib::RepoMatrix startMat;
-
-	bool success = collectMeshData(scene, scene->getRoot(defaultGraph), meshGroup, startMat,
+	bool success = collectMeshData(scene, meshGroup,
 		vertices, normals, faces, uvChannels, colors, meshMapping, matIDs);
 
 	if (success && meshMapping.size())
@@ -453,7 +714,9 @@ std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUID
 	return resultMesh;
 }
 
-bool MultipartOptimizer::generateMultipartScene(repo::core::model::RepoScene *scene)
+bool MultipartOptimizer::generateMultipartScene(
+	repo::core::model::RepoScene *scene,
+	const PreviousStash          &previous)
 {
 	bool success = false;
 
@@ -462,48 +725,195 @@ bool MultipartOptimizer::generateMultipartScene(repo::core::model::RepoScene *sc
 	{
 		std::unordered_map<uint32_t, std::vector<std::set<repo::lib::RepoUUID>>> transparentMeshes, normalMeshes;
 		std::unordered_map<uint32_t, std::unordered_map<repo::lib::RepoUUID, std::vector<std::set<repo::lib::RepoUUID>>, repo::lib::RepoUUIDHasher>> texturedMeshes;
+
+		//Walk the scene graph once to work out the world matrices of every mesh
+		std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> meshInstances;
+		std::vector<repo::lib::RepoUUID> walkOrder;
+		repo::lib::RepoMatrix startMat;
+		success = collectMeshInstances(scene, scene->getRoot(defaultGraph), startMat, meshInstances, walkOrder);
+		classifyMeshes(scene, meshInstances);
+
+		std::unordered_map<repo::lib::RepoUUID, repo::core::model::RepoNode*, repo::lib::RepoUUIDHasher> matNodes;
+		std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> matIDs;
+
+		//Supermeshes of the previous stash graph that are still up to date are kept as they are
+		std::vector<repo::core::model::MeshNode*> reusedMeshes;
+		if (previous.meshes.size())
+		{
+			reusedMeshes = reuseSuperMeshes(scene, previous, meshInstances, matIDs, matNodes);
+			repoInfo << "Reusing " << reusedMeshes.size() << " of " << previous.meshes.size() << " supermeshes of the previous stash graph";
+		}
+
+		//Geometry repeated often enough is kept out of the supermeshes and stored once
+		std::vector<MeshInstances> instancedGeometry;
+		if (instancing)
+		{
+			findInstancedGeometry(scene, meshInstances, instancedGeometry);
+		}
+
 		//Sort the meshes into 3 different grouping
-		sortMeshes(scene, meshes, normalMeshes, transparentMeshes, texturedMeshes);
+		sortMeshes(scene, meshInstances, normalMeshes, transparentMeshes, texturedMeshes);
 
 		repo::core::model::RepoNodeSet mergedMeshes, materials, trans, textures, dummy;
 
 		auto rootNode = new repo::core::model::TransformationNode(repo::core::model::RepoBSONFactory::makeTransformationNode());
+		if (reusedMeshes.size())
+		{
+			//Reused supermeshes are kept as they are, they still refer to the previous root
+			repo::core::model::RepoBSONBuilder builder;
+			builder.append(REPO_NODE_LABEL_SHARED_ID, previous.rootID);
+			auto changeBSON = builder.obj();
+			auto sharedRoot = rootNode->cloneAndAddFields(&changeBSON, false);
+			rootNode->swap(sharedRoot);
+		}
 		trans.insert(rootNode);
 		repo::lib::RepoUUID rootID = rootNode->getSharedID();
 
-		std::unordered_map<repo::lib::RepoUUID, repo::core::model::RepoNode*, repo::lib::RepoUUIDHasher> matNodes;
-		std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> matIDs;
-
-		for (const auto &groupings : normalMeshes)
+		//Give every grouping an index, in the order they are processed
+		std::vector<const std::set<repo::lib::RepoUUID>*> groupings;
+		for (const auto &formatGroupings : normalMeshes)
 		{
-			for (const auto grouping : groupings.second)
+			for (const auto &grouping : formatGroupings.second)
+				groupings.push_back(&grouping);
+		}
+		for (const auto &formatGroupings : transparentMeshes)
+		{
+			for (const auto &grouping : formatGroupings.second)
+				groupings.push_back(&grouping);
+		}
+		const size_t nUntexturedGroups = groupings.size();
+		for (const auto &textureMeshMap : texturedMeshes)
+		{
+			for (const auto &formatGroupings : textureMeshMap.second)
 			{
-				success &= processMeshGroup(scene, grouping, rootID, mergedMeshes, matNodes, matIDs);
+				for (const auto &grouping : formatGroupings.second)
+					groupings.push_back(&grouping);
 			}
 		}
-		for (const auto &groupings : transparentMeshes)
+
+		//Fill the buckets in traversal order (not in the order of the groupings,
+		//which are sorted by ID) so the supermesh layout follows the scene graph
+		std::unordered_map<repo::lib::RepoUUID, size_t, repo::lib::RepoUUIDHasher> meshToGroup;
+		for (size_t i = 0; i < groupings.size(); ++i)
 		{
-			for (const auto grouping : groupings.second)
+			for (const auto &meshID : *groupings[i])
+				meshToGroup[meshID] = i;
+		}
+
+		std::vector<MeshInstances> buckets(groupings.size());
+		std::unordered_map<repo::lib::RepoUUID, size_t, repo::lib::RepoUUIDHasher> nextInstance;
+		for (const auto &meshID : walkOrder)
+		{
+			auto groupIt = meshToGroup.find(meshID);
+			auto instIt = meshInstances.find(meshID);
+			if (groupIt != meshToGroup.end() && instIt != meshInstances.end())
 			{
-				success &= processMeshGroup(scene, grouping, rootID, mergedMeshes, matNodes, matIDs);
+				auto &instanceIdx = nextInstance[meshID];
+				buckets[groupIt->second].push_back(instIt->second[instanceIdx++]);
 			}
 		}
 
-		//textured meshes
-		for (const auto &textureMeshMap : texturedMeshes)
+		//Material IDs are assigned up front (in group order), the supermeshes
+		//can then be built independently of each other
+		assignMaterialIDs(scene, buckets, matIDs);
+		assignMaterialIDs(scene, instancedGeometry, matIDs);
+
+		//Link the supermeshes and materials in group order so the result does not depend on the number of threads
+		std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> newToOrigMatIDs;
+		for (const auto &matID : matIDs)
+		{
+			newToOrigMatIDs[matID.second] = matID.first;
+		}
+
+		//With a memory budget only a window of groups is built ahead of the last one
+		//linked, and the supermeshes linked so far are flushed out once they exceed
+		//the budget. A stub takes the place of a flushed supermesh so the stash graph stays whole
+		const size_t window = memoryBudget ? std::max(nThreads, (uint32_t)1) : buckets.size();
+		std::vector<repo::core::model::MeshNode*> unflushed;
+		size_t unflushedSize = 0, nFlushed = 0;
+		auto linkSuperMeshes = [&](const std::vector<repo::core::model::MeshNode*> &sMeshes)
 		{
-			for (const auto &groupings : textureMeshMap.second)
+			success &= processMeshGroup(scene, sMeshes, { rootID }, mergedMeshes, matNodes, newToOrigMatIDs);
+			if (!memoryBudget) return;
+
+			for (const auto &sMesh : sMeshes)
 			{
-				for (const auto grouping : groupings.second)
+				unflushed.push_back(sMesh);
+				unflushedSize += sMesh->objsize();
+			}
+
+			if (unflushedSize > memoryBudget)
+			{
+				for (const auto &sMesh : unflushed)
 				{
-#ifdef REPO_MP_TEXTURE_WORK_AROUND
+					success &= flushMesh(*sMesh);
+					auto stub = sMesh->cloneAsStub();
+					sMesh->swap(stub);
+				}
+				nFlushed += unflushed.size();
+				unflushed.clear();
+				unflushedSize = 0;
+			}
+		};
+
+		//Groups are built by one set of workers, whichever finishes the next group
+		//to link links every group ready in order
+		std::vector<std::vector<repo::core::model::MeshNode*>> superMeshes(buckets.size());
+		std::vector<bool> built(buckets.size(), false);
+		size_t nextToLink = 0;
+		boost::mutex linkMutex;
+		boost::condition_variable linked;
+		repo::lib::parallelFor(buckets.size(), [&](const size_t &i)
+		{
+			{
+				//Indices are handed out in order, so the groups before i are already taken
+				boost::mutex::scoped_lock lock(linkMutex);
+				while (i >= nextToLink + window)
+					linked.wait(lock);
+			}
 
-					success &= processMeshGroup(scene, grouping, rootID, mergedMeshes, matNodes, matIDs, true);
-#else
-					success &= processMeshGroup(scene, grouping, rootID, mergedMeshes, matNodes, matIDs);
+			std::vector<repo::core::model::MeshNode*> sMeshes;
+#ifdef REPO_MP_TEXTURE_WORK_AROUND
+			if (i >= nUntexturedGroups && !textureMerging)
+			{
+				sMeshes = createSuperMesh(scene, buckets[i], matIDs, true);
+			}
+			else
 #endif
-				}
+			if (auto sMesh = createSuperMesh(scene, buckets[i], matIDs))
+			{
+				sMeshes.push_back(sMesh);
+			}
+
+			boost::mutex::scoped_lock lock(linkMutex);
+			superMeshes[i].swap(sMeshes);
+			built[i] = true;
+			if (i != nextToLink)
+				return;
+
+			for (; nextToLink < buckets.size() && built[nextToLink]; ++nextToLink)
+			{
+				linkSuperMeshes(superMeshes[nextToLink]);
+				superMeshes[nextToLink].clear();
 			}
+			linked.notify_all();
+		}, nThreads);
+
+		//Reused supermeshes are already committed, they are never flushed
+		mergedMeshes.insert(reusedMeshes.begin(), reusedMeshes.end());
+
+		if (nFlushed)
+		{
+			repoInfo << nFlushed << " supermeshes flushed out of memory";
+		}
+
+		for (const auto &instances : instancedGeometry)
+		{
+			std::vector<repo::lib::RepoUUID> instanceIDs;
+			std::vector<repo::core::model::MeshNode*> sMeshes;
+			if (auto sMesh = createInstancedMesh(scene, instances, matIDs, rootID, trans, instanceIDs))
+				sMeshes.push_back(sMesh);
+			success &= processMeshGroup(scene, sMeshes, instanceIDs, mergedMeshes, matNodes, newToOrigMatIDs);
 		}
 
 		if (success)
@@ -539,74 +949,113 @@ bool MultipartOptimizer::generateMultipartScene(repo::core::model::RepoScene *sc
 	return success;
 }
 
-repo::lib::RepoUUID MultipartOptimizer::getMaterialID(
+void MultipartOptimizer::classifyMeshes(
 	const repo::core::model::RepoScene *scene,
-	const repo::core::model::MeshNode  *mesh
-	)
+	const std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> &meshInstances)
 {
-	repo::lib::RepoUUID matID = repo::lib::RepoUUID(REPO_HISTORY_MASTER_BRANCH);
-	const auto mat = scene->getChildrenNodesFiltered(defaultGraph, mesh->getSharedID(), repo::core::model::NodeType::MATERIAL);
-	if (mat.size())
+	meshClasses.clear();
+	meshClasses.reserve(meshInstances.size());
+	std::unordered_map<repo::lib::RepoUUID, MeshClassification, repo::lib::RepoUUIDHasher> materialClasses;
+	for (const auto &meshInstance : meshInstances)
 	{
-		matID = mat[0]->getUniqueID();
+		if (meshInstance.second.empty()) continue;
+		meshClasses[meshInstance.first] = classifyMesh(scene, meshInstance.second.front().first, materialClasses);
 	}
-
-	return matID;
 }
 
-bool MultipartOptimizer::hasTexture(
+MultipartOptimizer::MeshClassification MultipartOptimizer::classifyMesh(
 	const repo::core::model::RepoScene *scene,
 	const repo::core::model::MeshNode  *mesh,
-	repo::lib::RepoUUID                           &texID)
+	std::unordered_map<repo::lib::RepoUUID, MeshClassification, repo::lib::RepoUUIDHasher> &materialClasses) const
 {
-	bool hasText = false;
+	MeshClassification meshClass;
+	meshClass.matID = repo::lib::RepoUUID(REPO_HISTORY_MASTER_BRANCH);
+	meshClass.textured = false;
+	meshClass.transparent = false;
+	meshClass.mFormat = mesh->getMFormat();
+
 	const auto mat = scene->getChildrenNodesFiltered(defaultGraph, mesh->getSharedID(), repo::core::model::NodeType::MATERIAL);
 	if (mat.size())
 	{
-		const auto texture = scene->getChildrenNodesFiltered(defaultGraph, mat[0]->getSharedID(), repo::core::model::NodeType::TEXTURE);
-		if (hasText = texture.size())
+		meshClass.matID = mat[0]->getUniqueID();
+		auto matIt = materialClasses.find(meshClass.matID);
+		if (matIt == materialClasses.end())
 		{
-			texID = texture[0]->getSharedID();
+			const auto texture = scene->getChildrenNodesFiltered(defaultGraph, mat[0]->getSharedID(), repo::core::model::NodeType::TEXTURE);
+			if (meshClass.textured = texture.size())
+			{
+				meshClass.texID = texture[0]->getSharedID();
+			}
+
+			const repo::core::model::MaterialNode* matNode = (repo::core::model::MaterialNode*)mat[0];
+			meshClass.transparent = matNode->getMaterialStruct().opacity != 1;
+			materialClasses[meshClass.matID] = meshClass;
+		}
+		else
+		{
+			meshClass.texID = matIt->second.texID;
+			meshClass.textured = matIt->second.textured;
+			meshClass.transparent = matIt->second.transparent;
 		}
 	}
 
-	return hasText;
+	return meshClass;
+}
+
+MultipartOptimizer::MeshClassification MultipartOptimizer::getClassification(
+	const repo::core::model::RepoScene *scene,
+	const repo::core::model::MeshNode  *mesh) const
+{
+	auto it = meshClasses.find(mesh->getUniqueID());
+	if (it != meshClasses.end())
+		return it->second;
+
+	std::unordered_map<repo::lib::RepoUUID, MeshClassification, repo::lib::RepoUUIDHasher> materialClasses;
+	return classifyMesh(scene, mesh, materialClasses);
+}
+
+repo::lib::RepoUUID MultipartOptimizer::getMaterialID(
+	const repo::core::model::RepoScene *scene,
+	const repo::core::model::MeshNode  *mesh
+	)
+{
+	return getClassification(scene, mesh).matID;
+}
+
+bool MultipartOptimizer::hasTexture(
+	const repo::core::model::RepoScene *scene,
+	const repo::core::model::MeshNode  *mesh,
+	repo::lib::RepoUUID                           &texID)
+{
+	const auto meshClass = getClassification(scene, mesh);
+	if (meshClass.textured)
+		texID = meshClass.texID;
+
+	return meshClass.textured;
 }
 
 bool MultipartOptimizer::isTransparent(
 	const repo::core::model::RepoScene *scene,
 	const repo::core::model::MeshNode  *mesh)
 {
-	bool isTransparent = false;
-	const auto mat = scene->getChildrenNodesFiltered(defaultGraph, mesh->getSharedID(), repo::core::model::NodeType::MATERIAL);
-	if (mat.size())
-	{
-		const repo::core::model::MaterialNode* matNode = (repo::core::model::MaterialNode*)mat[0];
-		const auto matStruct = matNode->getMaterialStruct();
-		isTransparent = matStruct.opacity != 1;
-	}
-
-	return isTransparent;
+	return getClassification(scene, mesh).transparent;
 }
 
-#ifdef REPO_MP_TEXTURE_WORK_AROUND
 bool MultipartOptimizer::processMeshGroup(
 	const repo::core::model::RepoScene                                        *scene,
-	const  std::set<repo::lib::RepoUUID>                                                  &meshes,
-	const repo::lib::RepoUUID                                                             &rootID,
+	const std::vector<repo::core::model::MeshNode*>                           &sMeshes,
+	const std::vector<repo::lib::RepoUUID>                                    &parentIDs,
 	repo::core::model::RepoNodeSet                                             &mergedMeshes,
 	std::unordered_map<repo::lib::RepoUUID, repo::core::model::RepoNode*, repo::lib::RepoUUIDHasher> &matNodes,
-	std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>                      &matIDs,
-	const bool																   &texture
+	const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>  &newToOrigMatIDs
 	)
 {
 	bool success = false;
-	auto sMeshes = createSuperMesh(scene, meshes, matIDs, texture);
 	if (success = sMeshes.size())
 	{
 		for (auto &sMesh : sMeshes)
 		{
-			auto sMeshWithParent = sMesh->cloneAndAddParent({ rootID });
+			auto sMeshWithParent = sMesh->cloneAndAddParent(parentIDs);
 			sMesh->swap(sMeshWithParent);
 			mergedMeshes.insert(sMesh);
 
@@ -617,31 +1066,25 @@ bool MultipartOptimizer::processMeshGroup(
 				currentMats.insert(map.material_id);
 			}
 
-			/**
-			* FIXME: since there's multiple sMeshes, we need to make sure we only process the ones
-			* that are within the current sMesh. This is really inefficient to loop through all the matIDs
-			* but it will do for now. To do it properly we need a bi-directional map to find the original matID base
-			* on the new one
-			* This should all go away once we have proper texture support
-			*/
-			for (const auto matID : matIDs)
+			for (const auto &matID : currentMats)
 			{
-				//Skip the material if it's not used in the current supermesh
-				if (currentMats.find(matID.second) == currentMats.end()) continue;
-
-				auto matIt = matNodes.find(matID.second);
+				auto matIt = matNodes.find(matID);
 				if (matIt == matNodes.end())
 				{
 					//This material hasn't beenn copied yet.
 					//clone and wipe the parent entries, insert new parents
-					auto matNode = scene->getNodeByUniqueID(defaultGraph, matID.first);
-					repo::core::model::RepoNode clonedMat = repo::core::model::RepoNode(matNode->removeField(REPO_NODE_LABEL_PARENTS));
-					repo::core::model::RepoBSONBuilder builder;
-					builder.append(REPO_NODE_LABEL_ID, matID.second);
-					auto changeBSON = builder.obj();
-					clonedMat = clonedMat.cloneAndAddFields(&changeBSON, false);
-					clonedMat = clonedMat.cloneAndAddParent({ sMeshSharedID });
-					matNodes[matID.second] = new repo::core::model::MaterialNode(clonedMat);
+					auto origIt = newToOrigMatIDs.find(matID);
+					auto matNode = origIt == newToOrigMatIDs.end() ? nullptr : scene->getNodeByUniqueID(defaultGraph, origIt->second);
+					if (matNode)
+					{
+						repo::core::model::RepoNode clonedMat = repo::core::model::RepoNode(matNode->removeField(REPO_NODE_LABEL_PARENTS));
+						repo::core::model::RepoBSONBuilder builder;
+						builder.append(REPO_NODE_LABEL_ID, matID);
+						auto changeBSON = builder.obj();
+						clonedMat = clonedMat.cloneAndAddFields(&changeBSON, false);
+						clonedMat = clonedMat.cloneAndAddParent({ sMeshSharedID });
+						matNodes[matID] = new repo::core::model::MaterialNode(clonedMat);
+					}
 				}
 				else
 				{
@@ -658,164 +1101,529 @@ bool MultipartOptimizer::processMeshGroup(
 	}
 	return success;
 }
-#endif
 
-bool MultipartOptimizer::processMeshGroup(
-	const repo::core::model::RepoScene                                        *scene,
-	const  std::set<repo::lib::RepoUUID>                                                  &meshes,
-	const repo::lib::RepoUUID                                                             &rootID,
-	repo::core::model::RepoNodeSet                                             &mergedMeshes,
-	std::unordered_map<repo::lib::RepoUUID, repo::core::model::RepoNode*, repo::lib::RepoUUIDHasher> &matNodes,
-	std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>                     &matIDs
-	)
+void MultipartOptimizer::findChangedMeshes(
+	const repo::core::model::RepoScene *scene,
+	const repo::core::model::RepoNode  *node,
+	const bool                         &ancestorChanged,
+	std::unordered_set<repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &changedMeshes)
 {
-	bool success = false;
-	auto sMesh = createSuperMesh(scene, meshes, matIDs);
-	if (success = sMesh)
+	if (!node) return;
+
+	const bool changed = ancestorChanged || changedNodes.find(node->getSharedID()) != changedNodes.end();
+	switch (node->getTypeAsEnum())
+	{
+	case repo::core::model::NodeType::TRANSFORMATION:
 	{
-		auto sMeshWithParent = sMesh->cloneAndAddParent({ rootID });
-		sMesh->swap(sMeshWithParent);
-		mergedMeshes.insert(sMesh);
+		for (const auto &child : scene->getChildrenAsNodes(defaultGraph, node->getSharedID()))
+		{
+			findChangedMeshes(scene, child, changed, changedMeshes);
+		}
+		break;
+	}
+
+	case repo::core::model::NodeType::MESH:
+	{
+		bool materialChanged = false;
+		const auto mat = scene->getChildrenNodesFiltered(defaultGraph, node->getSharedID(), repo::core::model::NodeType::MATERIAL);
+		if (mat.size())
+		{
+			materialChanged = changedNodes.find(mat[0]->getSharedID()) != changedNodes.end();
+			for (const auto &texture : scene->getChildrenNodesFiltered(defaultGraph, mat[0]->getSharedID(), repo::core::model::NodeType::TEXTURE))
+			{
+				materialChanged |= changedNodes.find(texture->getSharedID()) != changedNodes.end();
+			}
+		}
+
+		if (changed || materialChanged)
+			changedMeshes.insert(node->getUniqueID());
+		break;
+	}
+	}
+}
+
+std::vector<repo::core::model::MeshNode*> MultipartOptimizer::reuseSuperMeshes(
+	const repo::core::model::RepoScene *scene,
+	const PreviousStash                &previous,
+	std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> &meshInstances,
+	std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs,
+	std::unordered_map<repo::lib::RepoUUID, repo::core::model::RepoNode*, repo::lib::RepoUUIDHasher> &matNodes)
+{
+	const auto &previousMeshes = previous.meshes;
+
+	//Modified nodes get a new unique ID, so a mesh that is still in the scene
+	//under the same unique ID has the same geometry. Changes to its ancestors
+	//and material are picked up from the changed nodes.
+	std::unordered_set<repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> changedMeshes;
+	findChangedMeshes(scene, scene->getRoot(defaultGraph), false, changedMeshes);
+
+	std::vector<std::vector<repo_mesh_mapping_t>> mappings(previousMeshes.size());
+	std::unordered_set<repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> outdated;
+	for (size_t i = 0; i < previousMeshes.size(); ++i)
+	{
+		mappings[i] = previousMeshes[i].getMeshMapping();
+		for (const auto &mapping : mappings[i])
+		{
+			if (meshInstances.find(mapping.mesh_id) == meshInstances.end()
+				|| changedMeshes.find(mapping.mesh_id) != changedMeshes.end())
+				outdated.insert(mapping.mesh_id);
+		}
+	}
+
+	//A mesh split across supermeshes can only be reused if all of them are,
+	//keep discarding supermeshes until no more meshes become outdated
+	std::vector<bool> reusable(previousMeshes.size(), true);
+	bool updated = true;
+	while (updated)
+	{
+		updated = false;
+		for (size_t i = 0; i < previousMeshes.size(); ++i)
+		{
+			if (!reusable[i]) continue;
+			for (const auto &mapping : mappings[i])
+			{
+				if (outdated.find(mapping.mesh_id) != outdated.end())
+				{
+					reusable[i] = false;
+					break;
+				}
+			}
+
+			if (!reusable[i])
+			{
+				for (const auto &mapping : mappings[i])
+				{
+					updated |= outdated.insert(mapping.mesh_id).second;
+				}
+			}
+		}
+	}
+
+	//Reused supermeshes are kept as they are, so the material copies they refer
+	//to are kept too. Other supermeshes using the same materials share these copies
+	std::vector<repo::core::model::MeshNode*> reusedMeshes;
+	std::unordered_map<repo::lib::RepoUUID, std::vector<repo::lib::RepoUUID>, repo::lib::RepoUUIDHasher> matParents;
+	for (size_t i = 0; i < previousMeshes.size(); ++i)
+	{
+		if (!reusable[i]) continue;
+		reusedMeshes.push_back(new repo::core::model::MeshNode(previousMeshes[i]));
 
-		repo::lib::RepoUUID sMeshSharedID = sMesh->getSharedID();
 		std::set<repo::lib::RepoUUID> currentMats;
-		for (const auto &map : sMesh->getMeshMapping())
+		for (const auto &mapping : mappings[i])
 		{
-			currentMats.insert(map.material_id);
+			auto instIt = meshInstances.find(mapping.mesh_id);
+			if (instIt != meshInstances.end())
+			{
+				matIDs[getMaterialID(scene, instIt->second.front().first)] = mapping.material_id;
+				meshInstances.erase(instIt);
+			}
+			currentMats.insert(mapping.material_id);
 		}
 
-		/**
-		* FIXME: since there's multiple sMeshes, we need to make sure we only process the ones
-		* that are within the current sMesh. This is really inefficient to loop through all the matIDs
-		* but it will do for now. To do it properly we need a bi-directional map to find the original matID base
-		* on the new one
-		* This should all go away once we have proper texture support
-		*/
-		for (const auto matID : matIDs)
+		for (const auto &matID : currentMats)
+		{
+			matParents[matID].push_back(previousMeshes[i].getSharedID());
+		}
+	}
+
+	//Parents of the copies that are not reused are dropped
+	//(meshes without a material refer to an ID with no copy)
+	for (const auto &matParent : matParents)
+	{
+		auto matIt = previous.materials.find(matParent.first);
+		if (matIt == previous.materials.end()) continue;
+
+		repo::core::model::RepoBSONBuilder builder;
+		builder.appendArray(REPO_NODE_LABEL_PARENTS, matParent.second);
+		auto changeBSON = builder.obj();
+		matNodes[matParent.first] = new repo::core::model::MaterialNode(matIt->second.cloneAndAddFields(&changeBSON, false));
+	}
+
+	return reusedMeshes;
+}
+
+void MultipartOptimizer::findInstancedGeometry(
+	const repo::core::model::RepoScene                                        *scene,
+	std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> &meshInstances,
+	std::vector<MeshInstances>                                                 &instancedGeometry)
+{
+	//Meshes with identical local geometry and material
+	struct GeometryClass
+	{
+		std::vector<repo::lib::RepoVector3D> vertices, normals;
+		std::vector<repo_face_t> faces;
+		std::vector<std::vector<repo::lib::RepoVector2D>> uvChannels;
+		repo::lib::RepoUUID matID;
+		std::vector<repo::lib::RepoUUID> meshIDs;
+		size_t nInstances;
+	};
+
+	//Go through the meshes in a fixed order so the result is deterministic
+	std::vector<repo::lib::RepoUUID> meshIDs;
+	meshIDs.reserve(meshInstances.size());
+	for (const auto &meshInstance : meshInstances)
+	{
+		meshIDs.push_back(meshInstance.first);
+	}
+	std::sort(meshIDs.begin(), meshIDs.end());
+
+	//Group the meshes on what can be read without decoding their buffers
+	//(counts, format, bounding box and material). Only meshes sharing all of
+	//it with another mesh can be duplicates, so only those are decoded
+	std::unordered_map<uint64_t, std::vector<repo::lib::RepoUUID>> candidateGroups;
+	std::vector<uint64_t> groupOrder;
+	for (const auto &meshID : meshIDs)
+	{
+		auto mesh = meshInstances[meshID].front().first;
+
+		//Only plain geometry that doesn't need to be split is instanced
+		repo::lib::RepoUUID texID;
+		const uint32_t nVertices = mesh->getNumVertices();
+		const uint32_t nFaces = mesh->getNumFaces();
+		const uint32_t mFormat = mesh->getMFormat();
+		const uint32_t colourBit = 1 << 3;
+		if (!nVertices || nVertices > maxVertices || !nFaces
+			|| (mFormat & colourBit) || hasTexture(scene, mesh, texID))
+			continue;
+
+		const auto bbox = mesh->getBoundingBox();
+		const size_t matHash = getMaterialID(scene, mesh).getHash();
+
+		uint64_t hash = 14695981039346656037ULL;
+		hash = hashBytes(&nVertices, sizeof(nVertices), hash);
+		hash = hashBytes(&nFaces, sizeof(nFaces), hash);
+		hash = hashBytes(&mFormat, sizeof(mFormat), hash);
+		hash = hashBytes(bbox.data(), bbox.size() * sizeof(*bbox.data()), hash);
+		hash = hashBytes(&matHash, sizeof(matHash), hash);
+
+		auto &group = candidateGroups[hash];
+		if (group.empty())
+			groupOrder.push_back(hash);
+		group.push_back(meshID);
+	}
+
+	std::vector<GeometryClass> classes;
+	for (const auto &groupHash : groupOrder)
+	{
+		const auto &group = candidateGroups[groupHash];
+		if (group.size() == 1)
 		{
-			//Skip the material if it's not used in the current supermesh
-			if (currentMats.find(matID.second) == currentMats.end()) continue;
+			//Nothing to compare against, the mesh is only repeated by its own instances
+			GeometryClass geometry;
+			geometry.meshIDs.push_back(group.front());
+			geometry.nInstances = meshInstances[group.front()].size();
+			classes.push_back(std::move(geometry));
+			continue;
+		}
 
-			auto matIt = matNodes.find(matID.second);
-			if (matIt == matNodes.end())
+		const size_t firstClass = classes.size();
+		std::unordered_map<uint64_t, std::vector<size_t>> classesByHash;
+		for (const auto &meshID : group)
+		{
+			const auto &instances = meshInstances[meshID];
+			auto mesh = instances.front().first;
+
+			GeometryClass geometry;
+			geometry.vertices = mesh->getVertices();
+			geometry.normals = mesh->getNormals();
+			geometry.faces = mesh->getFaces();
+			geometry.uvChannels = mesh->getUVChannelsSeparated();
+			geometry.matID = getMaterialID(scene, mesh);
+
+			uint64_t hash = 14695981039346656037ULL;
+			hash = hashBytes(geometry.vertices.data(), geometry.vertices.size() * sizeof(*geometry.vertices.data()), hash);
+			hash = hashBytes(geometry.normals.data(), geometry.normals.size() * sizeof(*geometry.normals.data()), hash);
+			for (const auto &face : geometry.faces)
+				hash = hashBytes(face.data(), face.size() * sizeof(*face.data()), hash);
+			for (const auto &channel : geometry.uvChannels)
+				hash = hashBytes(channel.data(), channel.size() * sizeof(*channel.data()), hash);
+
+			auto &candidates = classesByHash[hash];
+			bool found = false;
+			for (const auto &classIdx : candidates)
 			{
-				//This material hasn't beenn copied yet.
-				//clone and wipe the parent entries, insert new parents
-				auto matNode = scene->getNodeByUniqueID(defaultGraph, matID.first);
-				if (matNode)
+				auto &existing = classes[classIdx];
+				if (existing.matID == geometry.matID && existing.vertices == geometry.vertices
+					&& existing.faces == geometry.faces && existing.normals == geometry.normals
+					&& existing.uvChannels == geometry.uvChannels)
 				{
-					repo::core::model::RepoNode clonedMat = repo::core::model::RepoNode(matNode->removeField(REPO_NODE_LABEL_PARENTS));
-					repo::core::model::RepoBSONBuilder builder;
-					builder.append(REPO_NODE_LABEL_ID, matID.second);
-					auto changeBSON = builder.obj();
-					clonedMat = clonedMat.cloneAndAddFields(&changeBSON, false);
-					clonedMat = clonedMat.cloneAndAddParent({ sMeshSharedID });
-					matNodes[matID.second] = new repo::core::model::MaterialNode(clonedMat);
+					existing.meshIDs.push_back(meshID);
+					existing.nInstances += instances.size();
+					found = true;
+					break;
 				}
 			}
-			else
+
+			if (!found)
 			{
-				//created by another superMesh (set should have no duplicate so it shouldn't be from this mesh)
-				auto addedParentMat = matIt->second->cloneAndAddParent({ sMeshSharedID });
-				matIt->second->swap(addedParentMat);
+				geometry.meshIDs.push_back(meshID);
+				geometry.nInstances = instances.size();
+				candidates.push_back(classes.size());
+				classes.push_back(std::move(geometry));
 			}
 		}
+
+		//The decoded buffers are not needed past the comparison
+		for (size_t i = firstClass; i < classes.size(); ++i)
+		{
+			std::vector<repo::lib::RepoVector3D>().swap(classes[i].vertices);
+			std::vector<repo::lib::RepoVector3D>().swap(classes[i].normals);
+			std::vector<repo_face_t>().swap(classes[i].faces);
+			std::vector<std::vector<repo::lib::RepoVector2D>>().swap(classes[i].uvChannels);
+		}
 	}
-	else
+
+	size_t nInstancedMeshes = 0;
+	for (const auto &geometry : classes)
 	{
-		repoError << "Failed to create super mesh (nullptr returned)";
+		if (geometry.nInstances < minInstances) continue;
+
+		instancedGeometry.resize(instancedGeometry.size() + 1);
+		for (const auto &meshID : geometry.meshIDs)
+		{
+			auto meshIt = meshInstances.find(meshID);
+			instancedGeometry.back().insert(instancedGeometry.back().end(), meshIt->second.begin(), meshIt->second.end());
+			meshInstances.erase(meshIt);
+		}
+		nInstancedMeshes += geometry.nInstances;
+	}
+
+	repoInfo << nInstancedMeshes << " mesh instances share " << instancedGeometry.size() << " geometries";
+}
+
+repo::core::model::MeshNode* MultipartOptimizer::createInstancedMesh(
+	const repo::core::model::RepoScene                                        *scene,
+	const MeshInstances                                                        &instances,
+	const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs,
+	const repo::lib::RepoUUID                                                  &rootID,
+	repo::core::model::RepoNodeSet                                             &trans,
+	std::vector<repo::lib::RepoUUID>                                           &instanceIDs)
+{
+	auto mesh = instances.front().first;
+	auto matIt = matIDs.find(getMaterialID(scene, mesh));
+	if (matIt == matIDs.end())
+	{
+		repoError << "Material of mesh " << mesh->getUniqueID() << " has not been assigned a new ID!";
+		return nullptr;
+	}
+
+	auto faces = mesh->getFaces();
+	auto vertices = mesh->getVertices();
+	auto bbox = mesh->getBoundingBox();
+	if (bbox.size() < 2)
+	{
+		repoError << "Mesh " << mesh->getUniqueID() << " has no bounding box!";
+		return nullptr;
+	}
+
+	//Every instance gets its own transformation, and a mesh mapping with
+	//the ID of the original mesh and its bounding box in world space
+	std::vector<repo_mesh_mapping_t> meshMapping;
+	for (const auto &instance : instances)
+	{
+		const repo::lib::RepoUUID meshID = instance.first->getUniqueID();
+		auto transNode = new repo::core::model::TransformationNode(
+			repo::core::model::RepoBSONFactory::makeTransformationNode(instance.second, meshID.toString(), { rootID }));
+		trans.insert(transNode);
+		instanceIDs.push_back(transNode->getSharedID());
+
+		std::vector<repo::lib::RepoVector3D> worldBBox;
+		expandBoundingBox(bbox, instance.second, worldBBox);
+
+		repo_mesh_mapping_t meshMap;
+		meshMap.mesh_id = meshID;
+		meshMap.material_id = matIt->second;
+		meshMap.min = worldBBox[0];
+		meshMap.max = worldBBox[1];
+		meshMap.vertFrom = 0;
+		meshMap.vertTo = vertices.size();
+		meshMap.triFrom = 0;
+		meshMap.triTo = faces.size();
+		meshMapping.push_back(meshMap);
+	}
+
+	std::vector < std::vector<float> > outline;
+	outline.push_back({ bbox[0].x, bbox[0].y });
+	outline.push_back({ bbox[1].x, bbox[0].y });
+	outline.push_back({ bbox[1].x, bbox[1].y });
+	outline.push_back({ bbox[0].x, bbox[1].y });
+
+	std::vector<std::vector<float>> bboxVec = { { bbox[0].x, bbox[0].y, bbox[0].z }, { bbox[1].x, bbox[1].y, bbox[1].z } };
+
+	repo::core::model::MeshNode instancedMesh = repo::core::model::RepoBSONFactory::makeMeshNode(
+		vertices, faces, mesh->getNormals(), bboxVec, mesh->getUVChannelsSeparated(), std::vector<repo_color4d_t>(), outline);
+	return new repo::core::model::MeshNode(instancedMesh.cloneAndUpdateMeshMapping(meshMapping, true));
+}
+
+void MultipartOptimizer::assignMaterialIDs(
+	const repo::core::model::RepoScene                                        *scene,
+	const std::vector<MeshInstances>                                           &buckets,
+	std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs)
+{
+	for (const auto &bucket : buckets)
+	{
+		for (const auto &meshInstance : bucket)
+		{
+			repo::lib::RepoUUID matID = getMaterialID(scene, meshInstance.first);
+			if (matIDs.find(matID) == matIDs.end())
+			{
+				matIDs[matID] = repo::lib::RepoUUID::createUUID();
+			}
+		}
 	}
-	return success;
 }
 
 void MultipartOptimizer::sortMeshes(
 	const repo::core::model::RepoScene                                      *scene,
-	const repo::core::model::RepoNodeSet                                    &meshes,
+	const std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> &meshInstances,
 	std::unordered_map<uint32_t, std::vector<std::set<repo::lib::RepoUUID>>>						&normalMeshes,
 	std::unordered_map<uint32_t, std::vector<std::set<repo::lib::RepoUUID>>>						&transparentMeshes,
 	std::unordered_map < uint32_t, std::unordered_map < repo::lib::RepoUUID,
 	std::vector<std::set<repo::lib::RepoUUID>>, repo::lib::RepoUUIDHasher >> &texturedMeshes)
 {
-	std::unordered_map<uint32_t, size_t> normalFCount, transparentFCount;
-	std::unordered_map<uint32_t, std::unordered_map<repo::lib::RepoUUID, size_t, repo::lib::RepoUUIDHasher> > texturedFCount;
-
-	for (const auto &node : meshes)
+	std::unordered_map<uint32_t, size_t> normalFCount, transparentFCount, normalVCount, transparentVCount;
+	std::unordered_map<uint32_t, std::unordered_map<repo::lib::RepoUUID, size_t, repo::lib::RepoUUIDHasher> > texturedFCount, texturedVCount;
+
+	//Work out the world bounding box of every mesh (all instances included)
+	std::vector<std::pair<const MeshInstances*, std::vector<repo::lib::RepoVector3D>>> candidates;
+	candidates.reserve(meshInstances.size());
+	std::vector<repo::lib::RepoVector3D> sceneBBox;
+	for (const auto &meshInstance : meshInstances)
 	{
-		auto mesh = (repo::core::model::MeshNode*) node;
-		if (!mesh->getVertices().size() || !mesh->getFaces().size())
+		if (meshInstance.second.empty()) continue;
+		auto mesh = meshInstance.second.front().first;
+		if (!mesh->getNumVertices() || !mesh->getNumFaces())
 		{
 			repoWarning << "mesh " << mesh->getUniqueID() << " has no vertices/faces, skipping...";
 			continue;
 		}
+
+		std::vector<repo::lib::RepoVector3D> worldBBox;
+		auto bbox = mesh->getBoundingBox();
+		if (bbox.size() >= 2)
+		{
+			for (const auto &instance : meshInstance.second)
+			{
+				expandBoundingBox(bbox, instance.second, worldBBox);
+			}
+			expandBoundingBox(worldBBox[0], sceneBBox);
+			expandBoundingBox(worldBBox[1], sceneBBox);
+		}
+		candidates.push_back(std::make_pair(&meshInstance.second, worldBBox));
+	}
+
+	//Fill the groups in Morton order of the bounding box centres, so the meshes
+	//of a supermesh are close to each other
+	std::vector<std::pair<uint64_t, size_t>> order;
+	order.reserve(candidates.size());
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		const auto &worldBBox = candidates[i].second;
+		uint64_t code = 0;
+		if (worldBBox.size() >= 2)
+		{
+			repo::lib::RepoVector3D centre(
+				(worldBBox[0].x + worldBBox[1].x) / 2.f,
+				(worldBBox[0].y + worldBBox[1].y) / 2.f,
+				(worldBBox[0].z + worldBBox[1].z) / 2.f);
+			code = getMortonCode(centre, sceneBBox);
+		}
+		order.push_back(std::make_pair(code, i));
+	}
+	std::sort(order.begin(), order.end(),
+		[&candidates](const std::pair<uint64_t, size_t> &a, const std::pair<uint64_t, size_t> &b)
+	{
+		return a.first < b.first
+			|| (a.first == b.first
+			&& candidates[a.second].first->front().first->getUniqueID() < candidates[b.second].first->front().first->getUniqueID());
+	});
+
+	for (const auto &entry : order)
+	{
+		auto instances = candidates[entry.second].first;
+		auto mesh = instances->front().first;
+		//Every instance of the mesh is merged into the supermesh
+		const size_t faceCount = mesh->getNumFaces() * instances->size();
+		const size_t vertexCount = mesh->getNumVertices() * instances->size();
 		/**
 		* 1 - figure out it's mFormat (what buffers does it have)
 		* 2 - check if it has texture
 		* 3 - if not, check if it is transparent
 		*/
-		uint32_t mFormat = mesh->getMFormat();
-
-		repo::lib::RepoUUID texID;
-		if (hasTexture(scene, mesh, texID))
+		const auto meshClass = getClassification(scene, mesh);
+		const uint32_t mFormat = meshClass.mFormat;
+		const repo::lib::RepoUUID &texID = meshClass.texID;
+		if (meshClass.textured)
 		{
 			auto it = texturedMeshes.find(mFormat);
 			if (it == texturedMeshes.end())
 			{
 				texturedMeshes[mFormat] = std::unordered_map<repo::lib::RepoUUID, std::vector<std::set<repo::lib::RepoUUID>>, repo::lib::RepoUUIDHasher>();
 				texturedFCount[mFormat] = std::unordered_map<repo::lib::RepoUUID, size_t, repo::lib::RepoUUIDHasher>();
+				texturedVCount[mFormat] = std::unordered_map<repo::lib::RepoUUID, size_t, repo::lib::RepoUUIDHasher>();
 			}
 			auto it2 = texturedMeshes[mFormat].find(texID);
 #ifdef REPO_MP_TEXTURE_WORK_AROUND
 			//TODO: Texture meshes are kept as separate meshes to workaround the shortcomings of the current multipart
 			//implementation. This needs to be removed and the server needs to support multipart models with textures
-
-			if (it2 == texturedMeshes[mFormat].end())
+			if (!textureMerging)
 			{
-				texturedMeshes[mFormat][texID] = std::vector<std::set<repo::lib::RepoUUID>>();
+				if (it2 == texturedMeshes[mFormat].end())
+				{
+					texturedMeshes[mFormat][texID] = std::vector<std::set<repo::lib::RepoUUID>>();
+				}
+				std::set<repo::lib::RepoUUID> singleMeshSet;
+				singleMeshSet.insert(mesh->getUniqueID());
+				texturedMeshes[mFormat][texID].push_back(singleMeshSet);
+				continue;
 			}
-			std::set<repo::lib::RepoUUID> singleMeshSet;
-			singleMeshSet.insert(mesh->getUniqueID());
-			texturedMeshes[mFormat][texID].push_back(singleMeshSet);
-
-#else
+#endif
+			//Meshes sharing a texture share their uv space, they are merged like untextured meshes
 			if (it2 == texturedMeshes[mFormat].end())
 			{
 				texturedMeshes[mFormat][texID] = std::vector<std::set<repo::lib::RepoUUID>>();
 				texturedMeshes[mFormat][texID].push_back(std::set<repo::lib::RepoUUID>());
 				texturedFCount[mFormat][texID] = 0;
+				texturedVCount[mFormat][texID] = 0;
 			}
-			size_t faceCount = mesh->getFaces().size();
-			if (texturedFCount[mFormat][texID] + faceCount > REPO_MP_MAX_FACE_COUNT)
+			if (texturedFCount[mFormat][texID] && (texturedFCount[mFormat][texID] + faceCount > REPO_MP_MAX_FACE_COUNT
+				|| texturedVCount[mFormat][texID] + vertexCount > maxVertices))
 			{
-				//Exceed max face count, create another grouping entry for this format
+				//Exceed max face/vertex count, create another grouping entry for this format
 				texturedMeshes[mFormat][texID].push_back(std::set<repo::lib::RepoUUID>());
 				texturedFCount[mFormat][texID] = 0;
+				texturedVCount[mFormat][texID] = 0;
 			}
 			texturedMeshes[mFormat][texID].back().insert(mesh->getUniqueID());
-			texturedFCount[mFormat][texID] += mesh->getFaces().size();
-#endif
+			texturedFCount[mFormat][texID] += faceCount;
+			texturedVCount[mFormat][texID] += vertexCount;
 			}
 		else
 		{
 			//no texture, check if it is transparent
-			const bool istransParentMesh = isTransparent(scene, mesh);
+			const bool istransParentMesh = meshClass.transparent;
 			auto &meshMap = istransParentMesh ? transparentMeshes : normalMeshes;
 			auto &meshFCount = istransParentMesh ? transparentFCount : normalFCount;
+			auto &meshVCount = istransParentMesh ? transparentVCount : normalVCount;
 			auto it = meshMap.find(mFormat);
 			if (it == meshMap.end())
 			{
 				meshMap[mFormat] = std::vector<std::set<repo::lib::RepoUUID>>();
 				meshMap[mFormat].push_back(std::set<repo::lib::RepoUUID>());
 				meshFCount[mFormat] = 0;
+				meshVCount[mFormat] = 0;
 			}
-			size_t faceCount = mesh->getFaces().size();
-			if (meshFCount[mFormat] && meshFCount[mFormat] + faceCount > REPO_MP_MAX_FACE_COUNT)
+			if (meshFCount[mFormat] && (meshFCount[mFormat] + faceCount > REPO_MP_MAX_FACE_COUNT
+				|| meshVCount[mFormat] + vertexCount > maxVertices))
 			{
-				//Exceed max face count, create another grouping entry for this format
+				//Exceed max face/vertex count, create another grouping entry for this format
 				meshMap[mFormat].push_back(std::set<repo::lib::RepoUUID>());
 				meshFCount[mFormat] = 0;
+				meshVCount[mFormat] = 0;
 			}
 			meshMap[mFormat].back().insert(mesh->getUniqueID());
-			meshFCount[mFormat] += mesh->getFaces().size();
+			meshFCount[mFormat] += faceCount;
+			meshVCount[mFormat] += vertexCount;
 		}
 		}
 	}
\ No newline at end of file
@@ -23,20 +23,48 @@
 
 #include "repo_optimizer_abstract.h"
 #include "../../core/model/collection/repo_scene.h"
+#include "../../core/model/bson/repo_node_material.h"
 #include "../../core/model/bson/repo_node_mesh.h"
 
+#include <functional>
+#include <unordered_set>
+
 #define REPO_MP_TEXTURE_WORK_AROUND
+#define REPO_MP_MAX_VERTEX_COUNT 65535
 
 namespace repo {
 	namespace manipulator {
 		namespace modeloptimizer {
 			class MultipartOptimizer : AbstractOptimizer
 			{
+				//Meshes of a group with their world transformation
+				typedef std::vector<std::pair<const repo::core::model::MeshNode*, repo::lib::RepoMatrix>> MeshInstances;
+				//Nodes of the stash graph that an incremental update may keep
+				struct PreviousStash
+				{
+					repo::lib::RepoUUID rootID; //shared ID of the root
+					std::vector<repo::core::model::MeshNode> meshes; //supermeshes directly under the root
+					std::unordered_map<repo::lib::RepoUUID, repo::core::model::MaterialNode, repo::lib::RepoUUIDHasher> materials; //by unique ID
+				};
+				//Material properties of a mesh that decide which group it goes into
+				struct MeshClassification
+				{
+					repo::lib::RepoUUID matID; //unique ID of the material
+					repo::lib::RepoUUID texID; //shared ID of the texture (if textured)
+					bool textured;
+					bool transparent;
+					uint32_t mFormat;
+				};
 			public:
 				/**
 				* Default constructor
+				* @param nThreads number of threads to build the supermeshes with
+				* @param maxVertices maximum number of vertices within a supermesh (or a single mesh mapping
+				*        if a mesh is too big on its own), this should match the limit of the exporters
 				*/
-				MultipartOptimizer();
+				MultipartOptimizer(
+					const uint32_t &nThreads = 1,
+					const size_t   &maxVertices = REPO_MP_MAX_VERTEX_COUNT);
 
 				/**
 				* Default deconstructor
@@ -50,76 +78,321 @@ namespace repo {
 				*/
 				bool apply(repo::core::model::RepoScene *scene);
 
+				/**
+				* Merge duplicated vertices of every mesh before it is added
+				* into a supermesh. Disabled by default.
+				* The face ranges of each mesh within the supermesh are preserved
+				* @param enable true to enable vertex welding
+				* @param positionTolerance maximum difference between positions (0 = exact)
+				* @param normalTolerance maximum difference between normals (0 = exact)
+				* @param uvTolerance maximum difference between uvs (0 = exact)
+				*/
+				void setVertexWelding(
+					const bool  &enable,
+					const float &positionTolerance = 0,
+					const float &normalTolerance = 0,
+					const float &uvTolerance = 0);
+
+				/**
+				* Keep geometry that is repeated across the scene out of the
+				* supermeshes. Such geometry is stored once in the stash graph,
+				* under one transformation per instance (named after the
+				* original mesh ID). Disabled by default.
+				* NOTE: exporters must honour the transformations of the stash graph
+				* @param enable true to enable instancing
+				* @param minInstances minimum number of instances (at least 2)
+				*/
+				void setInstancing(
+					const bool     &enable,
+					const uint32_t &minInstances = 2);
+
+				/**
+				* Merge textured meshes sharing the same texture into supermeshes,
+				* the same way untextured meshes are. Disabled by default: with
+				* REPO_MP_TEXTURE_WORK_AROUND every textured mesh is kept as a
+				* separate supermesh, as SRC viewers do not support textured multipart meshes.
+				* @param enable true to merge textured meshes
+				*/
+				void setTextureMerging(
+					const bool &enable);
+
+				/**
+				* Bound the memory held by the supermeshes while the stash graph is
+				* generated. Only a few groups (one per thread) are built ahead of the
+				* last one linked, and once the supermeshes linked so far exceed the
+				* budget they are handed to flush (one at a time), then their
+				* buffers are released: the stash graph keeps a stub of each of them
+				* (see MeshNode::cloneAsStub()) with its IDs, parents and mesh mapping.
+				* flush is expected to store them alongside the stash graph (e.g. commit
+				* them into the stash collection), stubs are skipped upon commit and
+				* the stash must be reloaded before its buffers can be exported
+				* @param budget memory budget in bytes (0 = unbounded, the default)
+				* @param flush function storing a supermesh, returns true upon success
+				*/
+				void setMemoryBudget(
+					const size_t &budget,
+					const std::function<bool(const repo::core::model::MeshNode&)> &flush);
+
+				/**
+				* Regenerate the stash graph incrementally, reusing the supermeshes of
+				* the stash graph currently loaded within the scene (i.e. the stash of
+				* the revision the changes were made on). A supermesh is reused if none
+				* of its meshes were changed, removed, or affected by a change of their
+				* ancestors or material. All other meshes are grouped as usual.
+				* Reused supermeshes, and the material copies they refer to, are kept
+				* as they are (same IDs, parents and buffers) under a root with the same
+				* shared ID, so the stash documents and web files of the previous
+				* revision can be referenced rather than copied.
+				* Instanced geometry is always regenerated.
+				* @param changedNodes shared IDs of the nodes added, modified or removed
+				*        since the loaded stash graph was generated
+				*/
+				void setIncremental(
+					const std::vector<repo::lib::RepoUUID> &changedNodes);
+
+				/**
+				* Get the Morton code (Z order) of a point within the given bounding box.
+				* Each coordinate is quantised to 21 bits, points outside the box are clamped to it
+				* @param point point to encode
+				* @param bbox bounding box the point is in ({min, max})
+				* @return returns a 63 bit Morton code
+				*/
+				static uint64_t getMortonCode(
+					const repo::lib::RepoVector3D              &point,
+					const std::vector<repo::lib::RepoVector3D> &bbox);
+
 			private:
 				/**
-				* A Recursive call to traverse down the scene graph,
-				* collect all the mesh data that is within meshGroup
+				* Traverse down the scene graph once, computing the world
+				* matrix of every instance of every mesh
 				* @param scene scene to traverse
 				* @param node current node
-				* @param meshGroup the group of meshes to look for
-				* @param matrix matrix to transform the vertices
+				* @param mat world matrix of the current node's parent
+				* @param meshInstances instances of each mesh (by unique ID), in traversal order
+				* @param walkOrder unique ID of the mesh of every instance, in traversal order
+				* @return returns true upon success
+				*/
+				bool collectMeshInstances(
+					const repo::core::model::RepoScene        *scene,
+					const repo::core::model::RepoNode         *node,
+					const repo::lib::RepoMatrix               &mat,
+					std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> &meshInstances,
+					std::vector<repo::lib::RepoUUID>          &walkOrder);
+
+				/**
+				* Collect all the mesh data of the mesh instances within meshGroup,
+				* transformed into world space
+				* @param scene scene the meshes belong to
+				* @param meshGroup the mesh instances to collect
 				* @param vertices vertices collected
 				* @param normals normals collected
 				* @param faces faces collected
 				* @param uvChannels uvChannels collected
 				* @param colors colors collected
 				* @param meshMapping meshMapping for this superMesh
+				* @param matIDMap mapping of original material IDs to the new ones
 				*/
 #ifdef REPO_MP_TEXTURE_WORK_AROUND
 				bool collectMeshData(
 					const repo::core::model::RepoScene        *scene,
-					const repo::core::model::RepoNode         *node,
-					const std::set<repo::lib::RepoUUID>                  &meshGroup,
-					repo::lib::RepoMatrix                        &mat,
+					const MeshInstances                       &meshGroup,
 					std::vector<std::vector<repo::lib::RepoVector3D>>                &vertices,
 					std::vector<std::vector<repo::lib::RepoVector3D>>               &normals,
 					std::vector<std::vector<repo_face_t>>                &faces,
 					std::vector<std::vector<std::vector<repo::lib::RepoVector2D>>> &uvChannels,
 					std::vector<std::vector<repo_color4d_t>>               &colors,
 					std::vector<std::vector<repo_mesh_mapping_t>>          &meshMapping,
-					std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>    &matIDMap
+					const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDMap
 					);
 #endif
 				bool collectMeshData(
 					const repo::core::model::RepoScene        *scene,
-					const repo::core::model::RepoNode         *node,
-					const std::set<repo::lib::RepoUUID>                  &meshGroup,
-					repo::lib::RepoMatrix                        &mat,
+					const MeshInstances                       &meshGroup,
 					std::vector<repo::lib::RepoVector3D>                &vertices,
 					std::vector<repo::lib::RepoVector3D>                &normals,
 					std::vector<repo_face_t>                  &faces,
 					std::vector<std::vector<repo::lib::RepoVector2D>> &uvChannels,
 					std::vector<repo_color4d_t>               &colors,
 					std::vector<repo_mesh_mapping_t>          &meshMapping,
-					std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>    &matIDMap
+					const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDMap
 					);
 
+				/**
+				* Split the data of a mesh that exceeds the vertex budget into multiple
+				* mesh mappings that fit within it, and append them to the supermesh buffers
+				* @param meshMap mesh mapping of the mesh (ids and material)
+				* @param submVertices vertices of the mesh
+				* @param submNormals normals of the mesh
+				* @param submFaces faces of the mesh
+				* @param submColors colors of the mesh
+				* @param submUVs uv channels of the mesh
+				* @param vertices vertices collected
+				* @param normals normals collected
+				* @param faces faces collected
+				* @param uvChannels uvChannels collected
+				* @param colors colors collected
+				* @param meshMapping meshMapping for this superMesh
+				* @return returns true upon success
+				*/
+				bool splitMeshData(
+					const repo_mesh_mapping_t                               &meshMap,
+					const std::vector<repo::lib::RepoVector3D>              &submVertices,
+					const std::vector<repo::lib::RepoVector3D>              &submNormals,
+					const std::vector<repo_face_t>                          &submFaces,
+					const std::vector<repo_color4d_t>                       &submColors,
+					const std::vector<std::vector<repo::lib::RepoVector2D>> &submUVs,
+					std::vector<repo::lib::RepoVector3D>                    &vertices,
+					std::vector<repo::lib::RepoVector3D>                    &normals,
+					std::vector<repo_face_t>                                &faces,
+					std::vector<std::vector<repo::lib::RepoVector2D>>       &uvChannels,
+					std::vector<repo_color4d_t>                             &colors,
+					std::vector<repo_mesh_mapping_t>                        &meshMapping);
+
 				/**
 				* Merge all meshes within the mesh group and generate a
 				* super mesh.
 				* @param scene where the meshes are
-				* @param meshGroup contains all the meshes to c merge
-				* @param matIDs the unique IDs f materials required by this mesh
+				* @param meshGroup contains all the mesh instances to merge
+				* @param matIDs mapping of original material IDs to the new ones
 				* @return returns a pointer to a newly created merged mesh
 				*/
 #ifdef REPO_MP_TEXTURE_WORK_AROUND
 				std::vector<repo::core::model::MeshNode*>createSuperMesh(
 					const repo::core::model::RepoScene *scene,
-					const std::set<repo::lib::RepoUUID>           &meshGroup,
-					std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs,
+					const MeshInstances                &meshGroup,
+					const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs,
 					const bool                         &texture);
 #endif
 				repo::core::model::MeshNode* createSuperMesh(
 					const repo::core::model::RepoScene *scene,
-					const std::set<repo::lib::RepoUUID>           &meshGroup,
+					const MeshInstances                &meshGroup,
+					const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs);
+
+				/**
+				* Give every material used within the buckets a new unique ID.
+				* IDs are assigned in bucket order so the mapping does not
+				* depend on how the supermeshes are scheduled afterwards
+				* @param scene scene the meshes belong to
+				* @param buckets mesh instances of each group
+				* @param matIDs mapping of original material IDs to the new ones
+				*/
+				void assignMaterialIDs(
+					const repo::core::model::RepoScene *scene,
+					const std::vector<MeshInstances>   &buckets,
 					std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs);
 
+				/**
+				* Find meshes with identical local geometry and material, and remove the
+				* ones with enough instances from meshInstances. Textured meshes,
+				* meshes with vertex colours and meshes above the vertex budget are skipped.
+				* Only meshes with the same counts, bounding box and material as another
+				* mesh have their buffers decoded and compared
+				* @param scene scene the meshes belong to
+				* @param meshInstances instances of each mesh (by unique ID)
+				* @param instancedGeometry instances of every repeated geometry
+				*/
+				void findInstancedGeometry(
+					const repo::core::model::RepoScene *scene,
+					std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> &meshInstances,
+					std::vector<MeshInstances>         &instancedGeometry);
+
+				/**
+				* Create a mesh in local space to be shared by all the given instances,
+				* and a transformation under the root for each instance.
+				* The mesh mapping has one entry per instance, with the world bounding box
+				* of the instance and the full range of the mesh
+				* @param scene scene the meshes belong to
+				* @param instances instances sharing the geometry
+				* @param matIDs mapping of original material IDs to the new ones
+				* @param rootID shared ID of the root node
+				* @param trans add the new transformations into this set
+				* @param instanceIDs shared IDs of the new transformations
+				* @return returns a pointer to a newly created mesh (nullptr upon failure)
+				*/
+				repo::core::model::MeshNode* createInstancedMesh(
+					const repo::core::model::RepoScene *scene,
+					const MeshInstances                &instances,
+					const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs,
+					const repo::lib::RepoUUID          &rootID,
+					repo::core::model::RepoNodeSet     &trans,
+					std::vector<repo::lib::RepoUUID>   &instanceIDs);
+
+				/**
+				* Find the meshes (by unique ID) affected by the changed nodes, that is
+				* meshes that changed themselves, or whose ancestors, material or
+				* texture changed
+				* @param scene scene to traverse
+				* @param node current node
+				* @param ancestorChanged true if an ancestor of the node changed
+				* @param changedMeshes affected meshes
+				*/
+				void findChangedMeshes(
+					const repo::core::model::RepoScene *scene,
+					const repo::core::model::RepoNode  *node,
+					const bool                         &ancestorChanged,
+					std::unordered_set<repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &changedMeshes);
+
+				/**
+				* Pick the supermeshes of the previous stash graph that are still up to date.
+				* They are kept as they are, their meshes are removed from meshInstances
+				* and the material copies they refer to are kept for the new stash graph
+				* (matIDs maps the original materials onto them)
+				* @param scene scene the meshes belong to
+				* @param previous nodes of the previous stash graph
+				* @param meshInstances instances of each mesh (by unique ID)
+				* @param matIDs mapping of original material IDs to the new ones
+				* @param matNodes material copies of the new stash graph (by unique ID)
+				* @return returns the supermeshes to reuse (same IDs as before)
+				*/
+				std::vector<repo::core::model::MeshNode*> reuseSuperMeshes(
+					const repo::core::model::RepoScene *scene,
+					const PreviousStash                &previous,
+					std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> &meshInstances,
+					std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &matIDs,
+					std::unordered_map<repo::lib::RepoUUID, repo::core::model::RepoNode*, repo::lib::RepoUUIDHasher> &matNodes);
+
 				/**
 				* Generate the multipart scene
 				* @param scene scene to base on, this will also be modified to store the stash graph
+				* @param previous nodes of the previous stash graph that may be reused
 				* @return returns true upon success
 				*/
-				bool generateMultipartScene(repo::core::model::RepoScene *scene);
+				bool generateMultipartScene(
+					repo::core::model::RepoScene *scene,
+					const PreviousStash          &previous);
+
+				/**
+				* Classify every mesh in one pass, so the material of each mesh is
+				* only looked up once, and shared materials are only decoded once
+				* @param scene scene the meshes belong to
+				* @param meshInstances instances of each mesh (by unique ID)
+				*/
+				void classifyMeshes(
+					const repo::core::model::RepoScene *scene,
+					const std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> &meshInstances);
+
+				/**
+				* Work out the classification of a mesh
+				* @param scene scene the mesh belongs to
+				* @param mesh mesh to classify
+				* @param materialClasses classifications of the materials seen so far (by unique ID)
+				* @return returns the classification of the mesh
+				*/
+				MeshClassification classifyMesh(
+					const repo::core::model::RepoScene *scene,
+					const repo::core::model::MeshNode  *mesh,
+					std::unordered_map<repo::lib::RepoUUID, MeshClassification, repo::lib::RepoUUIDHasher> &materialClasses) const;
+
+				/**
+				* Get the classification of a mesh, from the table built by
+				* classifyMeshes if the mesh is in it
+				* @param scene scene the mesh belongs to
+				* @param mesh mesh in question
+				* @return returns the classification of the mesh
+				*/
+				MeshClassification getClassification(
+					const repo::core::model::RepoScene *scene,
+					const repo::core::model::MeshNode  *mesh) const;
 
 				/**
 				* Get child's material id from a mesh
@@ -155,46 +428,54 @@ namespace repo {
 					const repo::core::model::MeshNode  *mesh);
 
 				/**
-				* Process a mesh grouping, great a merged mesh base on the information
+				* Process the supermeshes of a mesh grouping, linking them to their parents
+				* and to copies of the materials they use
 				* @param scene as reference
-				* @param meshes mesh groupings
-				* @param mergedMeshes add newly created meshes into this set
+				* @param sMeshes supermeshes created for the grouping
+				* @param parentIDs shared IDs of the parents of the supermeshes
+				* @param mergedMeshes add the supermeshes into this set
 				* @param matNodes contains already processed materials
+				* @param newToOrigMatIDs mapping of new material IDs to the original ones
+				* @return returns true upon success
 				*/
-#ifdef REPO_MP_TEXTURE_WORK_AROUND
-				bool processMeshGroup(
-					const repo::core::model::RepoScene                                         *scene,
-					const std::set<repo::lib::RepoUUID>							                       & meshes,
-					const repo::lib::RepoUUID                                                             &rootID,
-					repo::core::model::RepoNodeSet                                             &mergedMeshes,
-					std::unordered_map<repo::lib::RepoUUID, repo::core::model::RepoNode*, repo::lib::RepoUUIDHasher> &matNodes,
-					std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>                     &matIDs,
-					const bool                                                                 &texture
-					);
-#endif
 				bool processMeshGroup(
 					const repo::core::model::RepoScene                                         *scene,
-					const std::set<repo::lib::RepoUUID>							                       & meshes,
-					const repo::lib::RepoUUID                                                             &rootID,
+					const std::vector<repo::core::model::MeshNode*>                            &sMeshes,
+					const std::vector<repo::lib::RepoUUID>                                     &parentIDs,
 					repo::core::model::RepoNodeSet                                             &mergedMeshes,
 					std::unordered_map<repo::lib::RepoUUID, repo::core::model::RepoNode*, repo::lib::RepoUUIDHasher> &matNodes,
-					std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher>                    &matIDs);
+					const std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> &newToOrigMatIDs);
 
 				/**
-				* Sort the given RepoNodeSet of meshes for multipart merging
+				* Sort the given meshes for multipart merging. Meshes are added to
+				* the groups in Morton order of their world bounding box centre so
+				* each group covers a compact region of the model
 				* @param scene             scene as reference
-				* @param meshes            meshes to sort
+				* @param meshInstances     instances of the meshes to sort
 				* @param normalMeshes      container to store normal meshes
 				* @param transparentMeshes container to store (semi)transparent meshes
 				* @param texturedMeshes    container to store textured meshes
 				*/
 				void sortMeshes(
 					const repo::core::model::RepoScene                                      *scene,
-					const repo::core::model::RepoNodeSet                                    &meshes,
+					const std::unordered_map<repo::lib::RepoUUID, MeshInstances, repo::lib::RepoUUIDHasher> &meshInstances,
 					std::unordered_map<uint32_t, std::vector<std::set<repo::lib::RepoUUID>>>			&normalMeshes,
 					std::unordered_map<uint32_t, std::vector<std::set<repo::lib::RepoUUID>>>			&transparentMeshes,
 					std::unordered_map < uint32_t, std::unordered_map < repo::lib::RepoUUID,
 					std::vector<std::set<repo::lib::RepoUUID>>, repo::lib::RepoUUIDHasher >> &texturedMeshes);
+
+				const uint32_t nThreads;
+				const size_t maxVertices;
+				bool weld;
+				float weldPositionTolerance, weldNormalTolerance, weldUVTolerance;
+				bool instancing;
+				uint32_t minInstances;
+				bool incremental;
+				bool textureMerging;
+				size_t memoryBudget;
+				std::function<bool(const repo::core::model::MeshNode&)> flushMesh;
+				std::unordered_map<repo::lib::RepoUUID, MeshClassification, repo::lib::RepoUUIDHasher> meshClasses;
+				std::unordered_set<repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> changedNodes;
 			};
 		}
 	}
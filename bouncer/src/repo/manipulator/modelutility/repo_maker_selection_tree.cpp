@@ -31,7 +31,8 @@ SelectionTreeMaker::SelectionTreeMaker(
 {
 }
 
-repo::lib::PropertyTree SelectionTreeMaker::generatePTree(
+void SelectionTreeMaker::generatePTree(
+	repo::lib::JSONWriter                        &writer,
 	const repo::core::model::RepoNode            *currentNode,
 	std::unordered_map < std::string,
 	std::pair < std::string, std::string >> &idMaps,
@@ -39,7 +40,7 @@ repo::lib::PropertyTree SelectionTreeMaker::generatePTree(
 	bool                                         &hiddenOnDefault,
 	std::vector<std::string>                     &hiddenNode) const
 {
-	repo::lib::PropertyTree tree;
+	writer.startObject();
 	if (currentNode)
 	{
 		std::string idString = currentNode->getUniqueID().toString();
@@ -47,7 +48,6 @@ repo::lib::PropertyTree SelectionTreeMaker::generatePTree(
 		std::string childPath = currentPath.empty() ? idString : currentPath + "__" + idString;
 
 		auto children = scene->getChildrenAsNodes(repo::core::model::RepoScene::GraphType::DEFAULT, sharedID);
-		std::vector<repo::lib::PropertyTree> childrenTrees;
 
 		std::vector<repo::core::model::RepoNode*> childrenTypes[2];
 		for (const auto &child : children)
@@ -59,7 +59,7 @@ repo::lib::PropertyTree SelectionTreeMaker::generatePTree(
 				childrenTypes[1].push_back(child);
 		}
 
-		bool hasHiddenChildren = false;
+		std::vector<repo::core::model::RepoNode*> treeChildren;
 		for (const auto childrenSet : childrenTypes)
 		{
 			for (const auto &child : childrenSet)
@@ -72,11 +72,7 @@ repo::lib::PropertyTree SelectionTreeMaker::generatePTree(
 					case repo::core::model::NodeType::TRANSFORMATION:
 					case repo::core::model::NodeType::CAMERA:
 					case repo::core::model::NodeType::REFERENCE:
-					{
-						bool hiddenChild = false;
-						childrenTrees.push_back(generatePTree(child, idMaps, childPath, hiddenChild, hiddenNode));
-						hasHiddenChildren = hasHiddenChildren || hiddenChild;
-					}
+						treeChildren.push_back(child);
 					}
 				}
 				else
@@ -86,6 +82,7 @@ repo::lib::PropertyTree SelectionTreeMaker::generatePTree(
 				}
 			}
 		}
+
 		std::string name = currentNode->getName();
 		if (repo::core::model::NodeType::REFERENCE == currentNode->getTypeAsEnum())
 		{
@@ -96,29 +93,42 @@ repo::lib::PropertyTree SelectionTreeMaker::generatePTree(
 			}
 		}
 
-		tree.addToTree("account", scene->getDatabaseName());
-		tree.addToTree("project", scene->getProjectName());
+		writer.addMember("account", scene->getDatabaseName());
+		writer.addMember("project", scene->getProjectName());
 		if (!name.empty())
-			tree.addToTree("name", name);
-		tree.addToTree("path", childPath);
-		tree.addToTree("_id", idString);
-		tree.addToTree("shared_id", sharedID.toString());
-		tree.addToTree("children", childrenTrees);
+			writer.addMember("name", name);
+		writer.addMember("path", childPath);
+		writer.addMember("_id", idString);
+		writer.addMember("shared_id", sharedID.toString());
+
+		//children are written straight into the document, the visibility state is only known afterwards
+		bool hasHiddenChildren = false;
+		if (treeChildren.size())
+		{
+			writer.startArray("children");
+			for (const auto &child : treeChildren)
+			{
+				bool hiddenChild = false;
+				generatePTree(writer, child, idMaps, childPath, hiddenChild, hiddenNode);
+				hasHiddenChildren = hasHiddenChildren || hiddenChild;
+			}
+			writer.endArray();
+		}
 
 		if (name.find(IFC_TYPE_SPACE_LABEL) != std::string::npos
 			&& currentNode->getTypeAsEnum() == repo::core::model::NodeType::MESH)
 		{
-			tree.addToTree(REPO_LABEL_VISIBILITY_STATE, REPO_VISIBILITY_STATE_HIDDEN);
+			writer.addMember(REPO_LABEL_VISIBILITY_STATE, REPO_VISIBILITY_STATE_HIDDEN);
 			hiddenOnDefault = true;
 			hiddenNode.push_back(idString);
 		}
 		else if (hiddenOnDefault = hiddenOnDefault || hasHiddenChildren)
 		{
-			tree.addToTree(REPO_LABEL_VISIBILITY_STATE, REPO_VISIBILITY_STATE_HALF_HIDDEN);
+			writer.addMember(REPO_LABEL_VISIBILITY_STATE, REPO_VISIBILITY_STATE_HALF_HIDDEN);
 		}
 		else
 		{
-			tree.addToTree(REPO_LABEL_VISIBILITY_STATE, REPO_VISIBILITY_STATE_SHOW);
+			writer.addMember(REPO_LABEL_VISIBILITY_STATE, REPO_VISIBILITY_STATE_SHOW);
 		}
 
 		idMaps[idString] = { name, childPath };
@@ -128,60 +138,61 @@ repo::lib::PropertyTree SelectionTreeMaker::generatePTree(
 		repoDebug << "Null pointer at generatePTree, current path : " << currentPath;
 		repoError << "Unexpected error at selection tree generation, the tree may not be complete.";
 	}
-
-	return tree;
+	writer.endObject();
 }
 
 std::map<std::string, std::vector<uint8_t>> SelectionTreeMaker::getSelectionTreeAsBuffer() const
 {
-	auto trees = getSelectionTreeAsPropertyTree();
+	auto trees = getSelectionTreeAsJSON();
 	std::map<std::string, std::vector<uint8_t>> buffer;
 	for (const auto &tree : trees)
 	{
-		std::stringstream ss;
-		tree.second.write_json(ss);
-		std::string jsonString = ss.str();
-		if (!jsonString.empty())
+		if (tree.second.isComplete())
 		{
-			size_t byteLength = jsonString.size() * sizeof(*jsonString.data());
-			buffer[tree.first] = std::vector<uint8_t>();
-			buffer[tree.first].resize(byteLength);
-			memcpy(buffer[tree.first].data(), jsonString.data(), byteLength);
+			buffer[tree.first] = tree.second.getBuffer();
 		}
 		else
 		{
-			repoError << "Failed to write selection tree into the buffer: JSON string is empty.";
+			repoError << "Failed to write selection tree into the buffer: JSON document is incomplete.";
 		}
 	}
 
 	return buffer;
 }
 
-std::map<std::string, repo::lib::PropertyTree>  SelectionTreeMaker::getSelectionTreeAsPropertyTree() const
+std::map<std::string, repo::lib::JSONWriter>  SelectionTreeMaker::getSelectionTreeAsJSON() const
 {
-	std::map<std::string, repo::lib::PropertyTree> trees;
+	std::map<std::string, repo::lib::JSONWriter> trees;
 
 	repo::core::model::RepoNode *root;
 	if (scene && (root = scene->getRoot(repo::core::model::RepoScene::GraphType::DEFAULT)))
 	{
 		std::unordered_map< std::string, std::pair<std::string, std::string>> map;
 		std::vector<std::string> hiddenNodes;
-		bool dummy;
-		repo::lib::PropertyTree tree, settingsTree;
-		tree.mergeSubTree("nodes", generatePTree(root, map, "", dummy, hiddenNodes));
-		for (const auto pair : map)
-		{
-			//if there's an entry in maps it must have an entry in paths
-			tree.addToTree("idToName." + pair.first, pair.second.first);
-			tree.addToTree("idToPath." + pair.first, pair.second.second);
-		}
-
-		trees["fulltree.json"] = tree;
+		bool dummy = false;
+		repo::lib::JSONWriter &tree = trees["fulltree.json"];
+		tree.startObject();
+		tree.addKey("nodes");
+		generatePTree(tree, root, map, "", dummy, hiddenNodes);
+
+		//if there's an entry in maps it must have an entry in paths
+		tree.startObject("idToName");
+		for (const auto &pair : map)
+			tree.addMember(pair.first, pair.second.first);
+		tree.endObject();
+
+		tree.startObject("idToPath");
+		for (const auto &pair : map)
+			tree.addMember(pair.first, pair.second.second);
+		tree.endObject();
+		tree.endObject();
 
 		if (hiddenNodes.size())
 		{
-			settingsTree.addToTree("hiddenNodes", hiddenNodes);
-			trees["modelProperties.json"] = settingsTree;
+			repo::lib::JSONWriter &settingsTree = trees["modelProperties.json"];
+			settingsTree.startObject();
+			settingsTree.addMember("hiddenNodes", hiddenNodes);
+			settingsTree.endObject();
 		}
 	}
 	else
@@ -16,7 +16,7 @@
 */
 #pragma once
 #include "../../core/model/collection/repo_scene.h"
-#include "../../lib/repo_property_tree.h"
+#include "../../lib/repo_json_writer.h"
 
 namespace repo{
 	namespace manipulator{
@@ -34,12 +34,12 @@ namespace repo{
 				~SelectionTreeMaker();
 
 				/**
-				* Construct and return the selection tree as a Property Tree
-				* The method will return an empty tree if the scene is null
+				* Construct and return the selection tree as JSON documents
+				* The method will return an empty map if the scene is null
 				* or the default graph is not loaded.
-				* @return returns the selection tree as a property tree
+				* @return returns the selection tree files, by file name
 				*/
-				std::map<std::string, repo::lib::PropertyTree> getSelectionTreeAsPropertyTree() const;
+				std::map<std::string, repo::lib::JSONWriter> getSelectionTreeAsJSON() const;
 
 				/**
 				* Construct and return the selection tree as a Property Tree As a buffer
@@ -53,14 +53,16 @@ namespace repo{
 				const repo::core::model::RepoScene *scene;
 
 				/**
-				* Recurse function to generate property tree for a specific node
+				* Recurse function to write the tree of a specific node
+				* @param writer writer to write the node into
 				* @param currentNode node to parse
 				* @param idMap a map of pairs of id to name mapping (to insert)
 				* @param currentPath the current path that leads to this node.
 				* @param hiddenOnDefault (return value) shows if the subtree has hidden nodes
 				* @param hiddenNode A list of vector of nodes that are hidden by default
 				*/
-				repo::lib::PropertyTree generatePTree(
+				void generatePTree(
+					repo::lib::JSONWriter                        &writer,
 					const repo::core::model::RepoNode            *currentNode,
 					std::unordered_map < std::string,
 					std::pair < std::string, std::string >> &idMaps,
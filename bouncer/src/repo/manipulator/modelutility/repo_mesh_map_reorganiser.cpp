@@ -205,7 +205,9 @@ bool MeshMapReorganiser::performSplitting()
 	{
 		if (++count % tenths == 0)
 			repoTrace << "Progress: " << (count / tenths) << "0%";
-		splitMap[currentSubMesh.mesh_id] = std::vector < uint32_t >();
+		//The optimizer may have split a large mesh into several consecutive mappings
+		//with the same mesh ID, keep the sub meshes of the earlier ones
+		auto &meshSplits = splitMap[currentSubMesh.mesh_id];
 
 		auto currentMeshVFrom = currentSubMesh.vertFrom;
 		auto currentMeshVTo = currentSubMesh.vertTo;
@@ -287,7 +289,8 @@ bool MeshMapReorganiser::performSplitting()
 			totalVertexCount += currentMeshNumVertices;
 			totalFaceCount += currentMeshNumFaces;
 
-			splitMap[currentSubMesh.mesh_id].push_back(newMappings.size() - 1);
+			if (meshSplits.empty() || meshSplits.back() != newMappings.size() - 1)
+				meshSplits.push_back(newMappings.size() - 1);
 			completeLastMatMapEntry(totalVertexCount, totalFaceCount);
 		}
 
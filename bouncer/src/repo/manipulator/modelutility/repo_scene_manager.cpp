@@ -18,13 +18,95 @@
 
 #include "../../core/model/bson/repo_bson_builder.h"
 #include "../modeloptimizer/repo_optimizer_multipart.h"
+#include "../modelconvertor/export/repo_model_export_glb.h"
 #include "../modelconvertor/export/repo_model_export_gltf.h"
 #include "../modelconvertor/export/repo_model_export_src.h"
 #include "../modeloptimizer/repo_optimizer_multipart.h"
 #include "../modelutility/repo_maker_selection_tree.h"
+#include "../../lib/repo_parallel.h"
+
+#include <algorithm>
+#include <memory>
 
 using namespace repo::manipulator::modelutility;
 
+/**
+* Remove the stash documents of the scene's revision. Documents shared
+* with the stash of other revisions are kept for them
+* @param scene scene of the revision
+* @param handler database handler
+* @param errMsg error message if this failed
+* @return returns true upon success
+*/
+static bool dropRevisionStash(
+	const repo::core::model::RepoScene           *scene,
+	repo::core::handler::AbstractDatabaseHandler *handler,
+	std::string                                  &errMsg)
+{
+	const repo::lib::RepoUUID rev = scene->getRevisionID();
+	const std::string database = scene->getDatabaseName();
+	const std::string collection = scene->getProjectName() + "." + scene->getStashExtension();
+
+	//Shared documents hold an array of revisions, take this one out of it
+	repo::core::model::RepoBSONBuilder existsBuilder;
+	existsBuilder.append("$exists", true);
+	repo::core::model::RepoBSONBuilder sharedBuilder;
+	sharedBuilder.append(REPO_NODE_STASH_REF, rev);
+	sharedBuilder.append(std::string(REPO_NODE_STASH_REF) + ".1", existsBuilder.obj());
+
+	bool success = true;
+	for (const auto &doc : handler->findAllByCriteria(database, collection, sharedBuilder.obj()))
+	{
+		auto revs = doc.getUUIDFieldArray(REPO_NODE_STASH_REF);
+		revs.erase(std::remove(revs.begin(), revs.end(), rev), revs.end());
+
+		repo::core::model::RepoBSONBuilder updateBuilder;
+		updateBuilder.append(REPO_NODE_LABEL_ID, doc.getUUIDField(REPO_NODE_LABEL_ID));
+		updateBuilder.appendArray(REPO_NODE_STASH_REF, revs);
+		success &= handler->upsertDocument(database, collection, updateBuilder.obj(), false, errMsg);
+	}
+
+	//What is left only belongs to this revision
+	repo::core::model::RepoBSONBuilder builder;
+	builder.append(REPO_NODE_STASH_REF, rev);
+	return handler->dropDocuments(builder.obj(), database, collection, errMsg) && success;
+}
+
+/**
+* Check if the stash graph of the scene holds supermeshes which were
+* flushed out of memory as it was generated (see MeshNode::isStub())
+* @param scene scene to check
+* @return returns true if any of the stash meshes is a stub
+*/
+static bool hasStashStubs(
+	const repo::core::model::RepoScene *scene)
+{
+	for (const auto &node : scene->getAllMeshes(repo::core::model::RepoScene::GraphType::OPTIMIZED))
+	{
+		if (((const repo::core::model::MeshNode*)node)->isStub())
+			return true;
+	}
+	return false;
+}
+
+/**
+* Count the supermeshes of the stash graph shared with the stash of an
+* earlier revision, their web files were exported with that revision
+* @param scene scene to check
+* @return returns the number of shared stash meshes
+*/
+static size_t countSharedStashMeshes(
+	const repo::core::model::RepoScene *scene)
+{
+	size_t count = 0;
+	for (const auto &node : scene->getAllMeshes(repo::core::model::RepoScene::GraphType::OPTIMIZED))
+	{
+		if (scene->isSharedStashNode(node))
+			++count;
+	}
+	return count;
+}
+
 repo::core::model::RepoScene* SceneManager::fetchScene(
 	repo::core::handler::AbstractDatabaseHandler *handler,
 	const std::string                             &database,
@@ -156,7 +238,9 @@ void SceneManager::fetchScene(
 
 bool SceneManager::generateStashGraph(
 	repo::core::model::RepoScene              *scene,
-	repo::core::handler::AbstractDatabaseHandler *handler
+	repo::core::handler::AbstractDatabaseHandler *handler,
+	const std::vector<repo::lib::RepoUUID>       &changedNodes,
+	const StashGraphOptions                      &options
 	)
 {
 	bool success = false;
@@ -170,9 +254,58 @@ bool SceneManager::generateStashGraph(
 			scene->updateRevisionStatus(handler, repo::core::model::RevisionNode::UploadStatus::GEN_REPO_STASH);
 		}
 
-		removeStashGraph(scene, handler);
-		repoInfo << "Generating stash graph...";
-		repo::manipulator::modeloptimizer::MultipartOptimizer mpOpt;
+		repo::manipulator::modeloptimizer::MultipartOptimizer mpOpt(repo::lib::getDefaultThreadCount());
+		//Only exact duplicates are merged, this does not alter the geometry
+		mpOpt.setVertexWelding(options.weldVertices);
+		mpOpt.setInstancing(options.instancing, options.minInstances);
+		mpOpt.setTextureMerging(options.mergeTextures);
+
+		if (changedNodes.size() && scene->hasRoot(repo::core::model::RepoScene::GraphType::OPTIMIZED))
+		{
+			//The loaded stash graph is needed by the optimiser, it is replaced once done
+			repoInfo << "Updating stash graph (" << changedNodes.size() << " nodes changed)...";
+			mpOpt.setIncremental(changedNodes);
+			if (toCommit)
+			{
+				std::string errMsg;
+				dropRevisionStash(scene, handler, errMsg);
+			}
+		}
+		else
+		{
+			removeStashGraph(scene, handler);
+			repoInfo << "Generating stash graph...";
+		}
+
+		//Supermeshes committed as they are built, and their big files
+		size_t nFlushed = 0;
+		std::vector<std::string> flushedFiles;
+		const std::string database = scene->getDatabaseName();
+		const std::string collection = scene->getProjectName() + "." + scene->getStashExtension();
+		if (options.memoryBudget && toCommit)
+		{
+			//Supermeshes over the budget are committed as they are built
+			repo::core::model::RepoBSONBuilder builder;
+			builder.append(REPO_NODE_STASH_REF, scene->getRevisionID());
+			const repo::core::model::RepoBSON revID = builder.obj();
+			mpOpt.setMemoryBudget(options.memoryBudget, [=, &nFlushed, &flushedFiles](const repo::core::model::MeshNode &mesh)
+			{
+				std::string errMsg;
+				//rev id is added as the node is serialised, as with commitStash
+				auto doc = mesh.cloneAndShrink(handler->documentSizeLimit(), revID);
+				++nFlushed;
+				for (const auto &file : doc.getFilesMapping())
+					flushedFiles.push_back(file.second.first);
+
+				if (!handler->insertDocument(database, collection, doc, errMsg))
+				{
+					repoError << "Failed to commit supermesh " << mesh.getUniqueID() << ": " << errMsg;
+					return false;
+				}
+				return true;
+			});
+		}
+
 		if (success = mpOpt.apply(scene))
 		{
 			if (toCommit)
@@ -190,6 +323,20 @@ bool SceneManager::generateStashGraph(
 		{
 			repoError << "Failed to generate stash graph";
 		}
+
+		//An incomplete stash would leave the supermeshes flushed so far behind, remove them
+		if (!success && nFlushed)
+		{
+			repoInfo << "Removing the " << nFlushed << " supermeshes committed before the failure...";
+			std::string errMsg;
+			if (!dropRevisionStash(scene, handler, errMsg))
+				repoError << "Failed to remove the stash documents: " << errMsg;
+			for (const auto &file : flushedFiles)
+			{
+				if (!handler->dropRawFile(database, collection, file, errMsg))
+					repoError << "Failed to remove " << file << ": " << errMsg;
+			}
+		}
 	}
 	else
 	{
@@ -203,74 +350,120 @@ bool SceneManager::generateWebViewBuffers(
 	repo::core::model::RepoScene                 *scene,
 	const repo::manipulator::modelconvertor::WebExportType          &exType,
 	repo_web_buffers_t                           &resultBuffers,
-	repo::core::handler::AbstractDatabaseHandler *handler)
+	repo::core::handler::AbstractDatabaseHandler *handler,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
 {
 	bool success = false;
 	if (success = (scene&& scene->isRevisioned()))
 	{
-		bool toCommit = handler;
-		if (toCommit)
+		if (handler && hasStashStubs(scene))
+		{
+			//The buffers of flushed supermeshes only live in the database now
+			repoInfo << "Reloading the stash graph to retrieve the supermeshes flushed out of memory...";
+			std::string errMsg;
+			scene->clearStash();
+			if (!scene->loadStash(handler, errMsg))
+			{
+				repoError << "Failed to reload the stash graph: " << errMsg;
+				return false;
+			}
+		}
+
+		if (handler)
+		{
+			//Files are uploaded as they are generated, they are not kept in resultBuffers
+			resultBuffers = repo_web_buffers_t();
 			scene->updateRevisionStatus(handler, repo::core::model::RevisionNode::UploadStatus::GEN_WEB_STASH);
 
-		std::string geoStashExt;
-		std::string jsonStashExt = scene->getJSONExtension();
+			//GLB containers are glTF, they live alongside the glTF stash files
+			std::string geoStashExt = exType == repo::manipulator::modelconvertor::WebExportType::SRC ?
+				scene->getSRCExtension() : scene->getGLTFExtension();
+			repo::manipulator::modelconvertor::WebDatabaseSink sink(handler, scene->getDatabaseName(),
+				scene->getProjectName() + "." + geoStashExt, scene->getProjectName() + "." + scene->getJSONExtension());
+			success = generateWebViewBuffers(scene, exType, sink, options);
+
+			//The sink has finished by now: the revision is only flagged complete once every upload is done
+			if (success)
+				scene->updateRevisionStatus(handler, repo::core::model::RevisionNode::UploadStatus::COMPLETE);
+		}
+		else
+		{
+			repo::manipulator::modelconvertor::WebBufferSink sink(resultBuffers);
+			success = generateWebViewBuffers(scene, exType, sink, options);
+		}
+	}
+	else
+	{
+		repoError << "Failed to generate web buffers: scene is empty or not revisioned!";
+	}
+
+	return success;
+}
+
+bool SceneManager::generateWebViewBuffers(
+	repo::core::model::RepoScene                 *scene,
+	const repo::manipulator::modelconvertor::WebExportType          &exType,
+	repo::manipulator::modelconvertor::WebExportSink                &sink,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
+{
+	bool success = false;
+	if (success = (scene&& scene->isRevisioned()))
+	{
+		if (hasStashStubs(scene))
+		{
+			repoError << "Failed to generate web buffers: the stash graph holds supermeshes flushed out of memory, reload it from the database first";
+			return false;
+		}
+
+		//Files of a packed export are collected into a single container per revision,
+		//in memory: the sink only receives it once the export is done
+		std::unique_ptr<repo::manipulator::modelconvertor::WebPackedSink> packedSink;
+		if (options.packFiles)
+		{
+			std::string containerName = "/" + scene->getDatabaseName() + "/" + scene->getProjectName() + "/revision/"
+				+ scene->getRevisionID().toString() + "/web." + getWebExportTypeName(exType) + ".pack";
+			packedSink.reset(new repo::manipulator::modelconvertor::WebPackedSink(sink, containerName, containerName + ".json"));
+		}
+		repo::manipulator::modelconvertor::WebExportSink &target = packedSink ? *packedSink : sink;
 
 		switch (exType)
 		{
 		case repo::manipulator::modelconvertor::WebExportType::GLTF:
-			geoStashExt = scene->getGLTFExtension();
-			resultBuffers = generateGLTFBuffer(scene);
+		{
+			repo::manipulator::modelconvertor::GLTFModelExport gltfExport(scene, options, &target);
+			if (!(success = gltfExport.isOk() && gltfExport.exportToSink(target)))
+				repoError << "Export to GLTF failed.";
 			break;
+		}
 		case repo::manipulator::modelconvertor::WebExportType::SRC:
-			geoStashExt = scene->getSRCExtension();
-			resultBuffers = generateSRCBuffer(scene);
+		{
+			repo::manipulator::modelconvertor::SRCModelExport srcExport(scene, options, &target);
+			if (!(success = srcExport.isOk() && srcExport.exportToSink(target)))
+				repoError << "Export to SRC failed.";
 			break;
+		}
+		case repo::manipulator::modelconvertor::WebExportType::GLB:
+		{
+			repo::manipulator::modelconvertor::GLBModelExport glbExport(scene, options, &target);
+			if (!(success = glbExport.isOk() && glbExport.exportToSink(target)))
+				repoError << "Export to GLB failed.";
+			break;
+		}
 		default:
 			repoError << "Unknown export type with enum:  " << (uint16_t)exType;
 			return false;
 		}
 
-		if (success = resultBuffers.geoFiles.size())
-		{
-			if (toCommit)
-			{
-				//Upload the files
-				for (const auto &bufferPair : resultBuffers.geoFiles)
-				{
-					std::string errMsg;
-					if (success &= handler->insertRawFile(scene->getDatabaseName(), scene->getProjectName() + "." + geoStashExt, bufferPair.first, bufferPair.second,
-						errMsg))
-					{
-						repoInfo << "File (" << bufferPair.first << ") added successfully.";
-					}
-					else
-					{
-						repoError << "Failed to add file  (" << bufferPair.first << "): " << errMsg;
-					}
-				}
+		//An incomplete container is not handed over
+		if (packedSink && success)
+			success = packedSink->finish();
 
-				for (const auto &bufferPair : resultBuffers.jsonFiles)
-				{
-					std::string databaseName = scene->getDatabaseName();
-					std::string projectName = scene->getProjectName();
-					std::string errMsg;
-					std::string fileName = bufferPair.first;
-					if (success &= handler->insertRawFile(scene->getDatabaseName(), scene->getProjectName() + "." + jsonStashExt, fileName, bufferPair.second,
-						errMsg))
-					{
-						repoInfo << "File (" << fileName << ") added successfully.";
-					}
-					else
-					{
-						repoError << "Failed to add file  (" << fileName << "): " << errMsg;
-					}
-				}
+		//Wait for the files still being stored even if the export failed
+		success = sink.finish() && success;
 
-				if (success)
-					scene->updateRevisionStatus(handler, repo::core::model::RevisionNode::UploadStatus::COMPLETE);
-			}
-		}
-		else
+		//Nothing new to export is fine if every supermesh is reused from an earlier revision
+		if (success && !(success = target.getFileCount(repo::manipulator::modelconvertor::WebFileType::GEOMETRY)
+			|| countSharedStashMeshes(scene)))
 		{
 			repoError << "Failed to generate web buffers: no geometry file generated";
 		}
@@ -283,20 +476,20 @@ bool SceneManager::generateWebViewBuffers(
 	return success;
 }
 
-repo_web_buffers_t SceneManager::generateGLTFBuffer(
-	repo::core::model::RepoScene *scene)
+std::string SceneManager::getWebExportTypeName(
+	const repo::manipulator::modelconvertor::WebExportType &exType)
 {
-	repo_web_buffers_t result;
-	repo::manipulator::modelconvertor::GLTFModelExport gltfExport(scene);
-	if (gltfExport.isOk())
+	switch (exType)
 	{
-		repoTrace << "Conversion succeed.. exporting as buffer..";
-		result = gltfExport.getAllFilesExportedAsBuffer();
+	case repo::manipulator::modelconvertor::WebExportType::GLTF:
+		return "gltf";
+	case repo::manipulator::modelconvertor::WebExportType::SRC:
+		return "src";
+	case repo::manipulator::modelconvertor::WebExportType::GLB:
+		return "glb";
+	default:
+		return "unknown";
 	}
-	else
-		repoError << "Export to GLTF failed.";
-
-	return result;
 }
 
 bool SceneManager::generateAndCommitSelectionTree(
@@ -348,22 +541,6 @@ bool SceneManager::generateAndCommitSelectionTree(
 	return success;
 }
 
-repo_web_buffers_t SceneManager::generateSRCBuffer(
-	repo::core::model::RepoScene *scene)
-{
-	repo_web_buffers_t result;
-	repo::manipulator::modelconvertor::SRCModelExport srcExport(scene);
-	if (srcExport.isOk())
-	{
-		repoTrace << "Conversion succeed.. exporting as buffer..";
-		result = srcExport.getAllFilesExportedAsBuffer();
-	}
-	else
-		repoError << "Export to SRC failed.";
-
-	return result;
-}
-
 bool SceneManager::removeStashGraph(
 	repo::core::model::RepoScene                 *scene,
 	repo::core::handler::AbstractDatabaseHandler *handler
@@ -376,10 +553,7 @@ bool SceneManager::removeStashGraph(
 		if (scene->isRevisioned())
 		{
 			std::string errMsg;
-
-			repo::core::model::RepoBSONBuilder builder;
-			builder.append(REPO_NODE_STASH_REF, scene->getRevisionID());
-			success = handler->dropDocuments(builder.obj(), scene->getDatabaseName(), scene->getProjectName() + "." + scene->getStashExtension(), errMsg);
+			success = dropRevisionStash(scene, handler, errMsg);
 		}
 	}
 	else
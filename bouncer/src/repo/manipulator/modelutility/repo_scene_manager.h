@@ -22,6 +22,51 @@
 namespace repo{
 	namespace manipulator{
 		namespace modelutility{
+			/**
+			* Options of the stash graph generation, the defaults give the original stash graph
+			*/
+			struct StashGraphOptions
+			{
+				/**
+				* Merge exactly duplicated vertices of every mesh as it is added into
+				* a supermesh. The geometry is unchanged but the vertex buffers are not
+				* (see MultipartOptimizer::setVertexWelding)
+				*/
+				bool weldVertices;
+
+				/**
+				* Share one mesh between all the instances of a repeated geometry,
+				* placed by a transformation per instance within the stash graph.
+				* Only the glTF and GLB exports support instanced stash graphs
+				* (see MultipartOptimizer::setInstancing)
+				*/
+				bool instancing;
+
+				/**
+				* Minimum number of instances for a geometry to be instanced
+				*/
+				uint32_t minInstances;
+
+				/**
+				* Merge textured meshes sharing a texture into supermeshes, instead of
+				* one supermesh per textured mesh. The SRC viewers do not support
+				* textured supermeshes, this is meant for the glTF and GLB exports
+				* (see MultipartOptimizer::setTextureMerging)
+				*/
+				bool mergeTextures;
+
+				/**
+				* Memory budget (in bytes) for the supermeshes while the stash graph is
+				* generated and committed (0 = unbounded). Supermeshes beyond the budget
+				* are committed straight away and their buffers released, the stash graph
+				* keeps a stub of them (see MeshNode::isStub). Only applies when the
+				* stash graph is committed
+				*/
+				size_t memoryBudget;
+
+				StashGraphOptions() : weldVertices(false), instancing(false), minInstances(2), mergeTextures(false), memoryBudget(0) {}
+			};
+
 			class SceneManager
 			{
 			public:
@@ -84,29 +129,66 @@ namespace repo{
 				* into the given scene
 				* If a databasehandler is given and the scene is revisioned,
 				* it will commit the stash to database
+				* If changedNodes is not empty and the scene has a stash graph loaded
+				* (i.e. the stash of the revision the changes were made on), the stash
+				* graph is updated incrementally: supermeshes unaffected by the changes
+				* are reused instead of being rebuilt
 				* @param scene scene to generate stash graph for
 				* @param handler hander to the database
+				* @param changedNodes shared IDs of the nodes added, modified or removed
+				*        since the loaded stash graph was generated
+				* @param options stash graph options
 				* @return returns true upon success
 				*/
 				bool generateStashGraph(
 					repo::core::model::RepoScene                 *scene,
-					repo::core::handler::AbstractDatabaseHandler *handler = nullptr
+					repo::core::handler::AbstractDatabaseHandler *handler = nullptr,
+					const std::vector<repo::lib::RepoUUID>       &changedNodes = std::vector<repo::lib::RepoUUID>(),
+					const StashGraphOptions                      &options = StashGraphOptions()
 					);
 
 				/**
 				* Generate a `exType` encoding for the given scene
-				* if a database handler is provided, it will also commit the
-				* buffers into the database
+				* if a database handler is provided, the files are uploaded into
+				* the database as they are generated and resultBuffers is cleared:
+				* it never holds any file in that case
 				* This requires the repo stash to have been generated already
 				* @param scene the scene to generate the src encoding from
 				* @param exType the type of export it is
-				* @return returns repo_web_buffers upon success
+				* @param resultBuffers files generated if there is no handler,
+				*        cleared (and left empty) if a handler is given
+				* @param handler handler to the database to commit the files into
+				* @param options export options
+				* @return returns true upon success
 				*/
 				bool generateWebViewBuffers(
 					repo::core::model::RepoScene                 *scene,
 					const repo::manipulator::modelconvertor::WebExportType          &exType,
 					repo_web_buffers_t                           &resultBuffers,
-					repo::core::handler::AbstractDatabaseHandler *handler = nullptr);
+					repo::core::handler::AbstractDatabaseHandler *handler = nullptr,
+					const repo::manipulator::modelconvertor::WebExportOptions &options =
+					repo::manipulator::modelconvertor::WebExportOptions());
+
+				/**
+				* Generate a `exType` encoding for the given scene, handing
+				* every file over to the sink as soon as it is complete
+				* If options.packFiles is set, the sink receives a single container
+				* ("/<database>/<project>/revision/<revision>/web.<type>.pack") and
+				* its manifest (same name followed by ".json") instead, once every
+				* file is generated (the container is built in memory)
+				* This requires the repo stash to have been generated already
+				* @param scene the scene to generate the encoding from
+				* @param exType the type of export it is
+				* @param sink destination of the files
+				* @param options export options
+				* @return returns true if the files were generated and stored
+				*/
+				bool generateWebViewBuffers(
+					repo::core::model::RepoScene                                *scene,
+					const repo::manipulator::modelconvertor::WebExportType      &exType,
+					repo::manipulator::modelconvertor::WebExportSink            &sink,
+					const repo::manipulator::modelconvertor::WebExportOptions   &options =
+					repo::manipulator::modelconvertor::WebExportOptions());
 
 				/**
 				* Remove stash graph entry for the given scene
@@ -122,22 +204,12 @@ namespace repo{
 
 			private:
 				/**
-				* Generate a gltf encoding in the form of a buffer for the given scene
-				* This requires the stash to have been generated already
-				* @param scene the scene to generate the gltf encoding from
-				* @return returns a buffer in the form of a byte vector mapped to its filename
-				*/
-				repo_web_buffers_t generateGLTFBuffer(
-					repo::core::model::RepoScene *scene);
-
-				/**
-				* Generate a SRC encoding in the form of a buffer for the given scene
-				* This requires the stash to have been generated already
-				* @param scene the scene to generate the src encoding from
-				* @return returns a buffer in the form of a byte vector mapped to its filename
+				* Get the name of an export type, as used within file names
+				* @param exType the type of export
+				* @return returns the name of the export type
 				*/
-				repo_web_buffers_t generateSRCBuffer(
-					repo::core::model::RepoScene *scene);
+				static std::string getWebExportTypeName(
+					const repo::manipulator::modelconvertor::WebExportType &exType);
 			};
 		}
 	}
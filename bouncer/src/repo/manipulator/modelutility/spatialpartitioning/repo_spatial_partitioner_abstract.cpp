@@ -33,42 +33,42 @@ AbstractSpatialPartitioner::~AbstractSpatialPartitioner()
 {
 }
 
-repo::lib::PropertyTree AbstractSpatialPartitioner::generatePropertyTreeForPartitioning()
+void AbstractSpatialPartitioner::generateJSONForPartitioning(
+	repo::lib::JSONWriter &writer)
 {
-	return generatePropertyTreeForPartitioningInternal(partitionScene());
+	generateJSONForPartitioningInternal(writer, partitionScene());
 }
 
-repo::lib::PropertyTree AbstractSpatialPartitioner::generatePropertyTreeForPartitioningInternal(
+void AbstractSpatialPartitioner::generateJSONForPartitioningInternal(
+	repo::lib::JSONWriter                           &writer,
 	const std::shared_ptr<repo_partitioning_tree_t> &spTree) const
 {
-	repo::lib::PropertyTree tree;
-
+	writer.startObject();
 	if (spTree)
 	{
 		if (repo::PartitioningTreeType::LEAF_NODE == spTree->type)
 		{
-			repo::lib::PropertyTree meshesTree;
-
+			writer.startObject("meshes");
 			for (const auto &mesh : spTree->meshes)
 			{
-				std::string idString = mesh.id.toString();
-				repo::lib::PropertyTree childTree;
-				childTree.addToTree("min", mesh.min);
-				childTree.addToTree("max", mesh.max);
-				meshesTree.mergeSubTree(idString, childTree);
+				writer.startObject(mesh.id.toString());
+				writer.addMember("min", mesh.min);
+				writer.addMember("max", mesh.max);
+				writer.endObject();
 			}
-
-			tree.mergeSubTree("meshes", meshesTree);
+			writer.endObject();
 		}
 		else
 		{
 			std::string axisStr = repo::PartitioningTreeType::PARTITION_X == spTree->type ? "X"
 				: (repo::PartitioningTreeType::PARTITION_Y == spTree->type ? "Y" : "Z");
-			tree.addToTree("axis", axisStr);
-			tree.addToTree("value", spTree->pValue);
-			tree.mergeSubTree("left", generatePropertyTreeForPartitioningInternal(spTree->left));
-			tree.mergeSubTree("right", generatePropertyTreeForPartitioningInternal(spTree->right));
+			writer.addMember("axis", axisStr);
+			writer.addMember("value", spTree->pValue);
+			writer.addKey("left");
+			generateJSONForPartitioningInternal(writer, spTree->left);
+			writer.addKey("right");
+			generateJSONForPartitioningInternal(writer, spTree->right);
 		}
 	}
-	return tree;
+	writer.endObject();
 }
\ No newline at end of file
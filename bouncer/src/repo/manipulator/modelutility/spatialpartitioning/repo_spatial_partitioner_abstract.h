@@ -17,7 +17,7 @@
 
 #pragma once
 
-#include "../../../lib/repo_property_tree.h"
+#include "../../../lib/repo_json_writer.h"
 #include "../../../lib/datastructure/repo_structs.h"
 #include "../../../core/model/collection/repo_scene.h"
 
@@ -47,18 +47,24 @@ namespace repo{
 					partitionScene() = 0;
 
 				/**
-				* Generate a property tree representing the repo_partitioning_tree_t from partitionScene()
-				* @return returns the spatial partitioning information as a property tree
+				* Generate a JSON document representing the repo_partitioning_tree_t from partitionScene()
+				* @param writer writer to write the document into
 				*/
-				virtual repo::lib::PropertyTree
-					generatePropertyTreeForPartitioning();
+				virtual void
+					generateJSONForPartitioning(repo::lib::JSONWriter &writer);
 
 			protected:
 				const repo::core::model::RepoScene            *scene;
 				const uint32_t                                maxDepth;
 				const repo::core::model::RepoScene::GraphType gType;
 
-				repo::lib::PropertyTree generatePropertyTreeForPartitioningInternal(
+				/**
+				* Write a (sub) partitioning tree as a JSON object
+				* @param writer writer to write into
+				* @param spTree partitioning tree to write
+				*/
+				void generateJSONForPartitioningInternal(
+					repo::lib::JSONWriter                           &writer,
 					const std::shared_ptr<repo_partitioning_tree_t> &spTree) const;
 			};
 		}
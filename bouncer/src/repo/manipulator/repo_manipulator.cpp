@@ -192,6 +192,18 @@ bool RepoManipulator::commitScene(
 		repoError << "Failed to commit scene : database name or project name is empty!";
 	}
 
+	//The stash loaded with a revision belongs to it, if the scene was modified
+	//since, the stash needs updating. Changes are cleared once committed.
+	std::vector<repo::lib::RepoUUID> changedNodes;
+	if (scene && scene->isRevisioned() && scene->hasRoot(repo::core::model::RepoScene::GraphType::OPTIMIZED))
+	{
+		changedNodes = scene->getAddedNodesID();
+		auto modified = scene->getModifiedNodesID();
+		auto removed = scene->getRemovedNodesID();
+		changedNodes.insert(changedNodes.end(), modified.begin(), modified.end());
+		changedNodes.insert(changedNodes.end(), removed.begin(), removed.end());
+	}
+
 	if (handler && scene && scene->commit(handler, msg, projOwner, desc, tag))
 	{
 		repoInfo << "Scene successfully committed to the database";
@@ -201,6 +213,11 @@ bool RepoManipulator::commitScene(
 				repoInfo << "Optimised scene not found. Attempt to generate...";
 				success = generateAndCommitStashGraph(databaseAd, cred, scene);
 			}
+			else if (changedNodes.size())
+			{
+				repoInfo << "Optimised scene is out of date. Attempt to update...";
+				success = generateAndCommitStashGraph(databaseAd, cred, scene, changedNodes);
+			}
 			else if (success = scene->commitStash(handler, msg))
 			{
 				repoInfo << "Commited scene stash successfully.";
@@ -458,21 +475,34 @@ repo::core::model::RepoUser RepoManipulator::findUser(
 bool RepoManipulator::generateAndCommitGLTFBuffer(
 	const std::string                             &databaseAd,
 	const repo::core::model::RepoBSON	          *cred,
-	repo::core::model::RepoScene                  *scene)
+	repo::core::model::RepoScene                  *scene,
+	const modelconvertor::WebExportOptions &options)
 {
 	repo_web_buffers_t buffers;
 	return generateAndCommitWebViewBuffer(databaseAd, cred, scene,
-		buffers, modelconvertor::WebExportType::GLTF);
+		buffers, modelconvertor::WebExportType::GLTF, options);
 }
 
 bool RepoManipulator::generateAndCommitSRCBuffer(
 	const std::string                             &databaseAd,
 	const repo::core::model::RepoBSON	          *cred,
-	repo::core::model::RepoScene                  *scene)
+	repo::core::model::RepoScene                  *scene,
+	const modelconvertor::WebExportOptions &options)
+{
+	repo_web_buffers_t buffers;
+	return generateAndCommitWebViewBuffer(databaseAd, cred, scene,
+		buffers, modelconvertor::WebExportType::SRC, options);
+}
+
+bool RepoManipulator::generateAndCommitGLBBuffer(
+	const std::string                             &databaseAd,
+	const repo::core::model::RepoBSON	          *cred,
+	repo::core::model::RepoScene                  *scene,
+	const modelconvertor::WebExportOptions &options)
 {
 	repo_web_buffers_t buffers;
 	return generateAndCommitWebViewBuffer(databaseAd, cred, scene,
-		buffers, modelconvertor::WebExportType::SRC);
+		buffers, modelconvertor::WebExportType::GLB, options);
 }
 
 bool RepoManipulator::generateAndCommitSelectionTree(
@@ -500,23 +530,26 @@ bool RepoManipulator::removeStashGraphFromDatabase(
 }
 
 bool RepoManipulator::generateStashGraph(
-	repo::core::model::RepoScene              *scene
+	repo::core::model::RepoScene              *scene,
+	const modelutility::StashGraphOptions     &options
 	)
 {
 	modelutility::SceneManager SceneManager;
-	return SceneManager.generateStashGraph(scene, nullptr);
+	return SceneManager.generateStashGraph(scene, nullptr, std::vector<repo::lib::RepoUUID>(), options);
 }
 
 bool RepoManipulator::generateAndCommitStashGraph(
 	const std::string                         &databaseAd,
 	const repo::core::model::RepoBSON         *cred,
-	repo::core::model::RepoScene              *scene
+	repo::core::model::RepoScene              *scene,
+	const std::vector<repo::lib::RepoUUID>    &changedNodes,
+	const modelutility::StashGraphOptions     &options
 	)
 {
 	repo::core::handler::AbstractDatabaseHandler* handler =
 		repo::core::handler::MongoDatabaseHandler::getHandler(databaseAd);
 	modelutility::SceneManager SceneManager;
-	return SceneManager.generateStashGraph(scene, handler);
+	return SceneManager.generateStashGraph(scene, handler, changedNodes, options);
 }
 
 bool RepoManipulator::generateAndCommitWebViewBuffer(
@@ -524,29 +557,42 @@ bool RepoManipulator::generateAndCommitWebViewBuffer(
 	const repo::core::model::RepoBSON	          *cred,
 	repo::core::model::RepoScene                  *scene,
 	repo_web_buffers_t                            &buffers,
-	const modelconvertor::WebExportType           &exType)
+	const modelconvertor::WebExportType           &exType,
+	const modelconvertor::WebExportOptions        &options)
 {
 	repo::core::handler::AbstractDatabaseHandler* handler =
 		repo::core::handler::MongoDatabaseHandler::getHandler(databaseAd);
 	modelutility::SceneManager SceneManager;
-	return SceneManager.generateWebViewBuffers(scene, exType, buffers, handler);
+	return SceneManager.generateWebViewBuffers(scene, exType, buffers, handler, options);
 }
 
 repo_web_buffers_t RepoManipulator::generateGLTFBuffer(
-	repo::core::model::RepoScene *scene)
+	repo::core::model::RepoScene *scene,
+	const modelconvertor::WebExportOptions &options)
 {
 	repo_web_buffers_t buffers;
 	modelutility::SceneManager SceneManager;
-	SceneManager.generateWebViewBuffers(scene, modelconvertor::WebExportType::GLTF, buffers, nullptr);
+	SceneManager.generateWebViewBuffers(scene, modelconvertor::WebExportType::GLTF, buffers, nullptr, options);
 	return buffers;
 }
 
 repo_web_buffers_t RepoManipulator::generateSRCBuffer(
-	repo::core::model::RepoScene *scene)
+	repo::core::model::RepoScene *scene,
+	const modelconvertor::WebExportOptions &options)
+{
+	repo_web_buffers_t buffers;
+	modelutility::SceneManager SceneManager;
+	SceneManager.generateWebViewBuffers(scene, modelconvertor::WebExportType::SRC, buffers, nullptr, options);
+	return buffers;
+}
+
+repo_web_buffers_t RepoManipulator::generateGLBBuffer(
+	repo::core::model::RepoScene *scene,
+	const modelconvertor::WebExportOptions &options)
 {
 	repo_web_buffers_t buffers;
 	modelutility::SceneManager SceneManager;
-	SceneManager.generateWebViewBuffers(scene, modelconvertor::WebExportType::SRC, buffers, nullptr);
+	SceneManager.generateWebViewBuffers(scene, modelconvertor::WebExportType::GLB, buffers, nullptr, options);
 	return buffers;
 }
 
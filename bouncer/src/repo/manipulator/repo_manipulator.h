@@ -31,6 +31,7 @@
 #include "diff/repo_diff_abstract.h"
 #include "modelconvertor/export/repo_model_export_web.h"
 #include "modelconvertor/import/repo_model_import_config.h"
+#include "modelutility/repo_scene_manager.h"
 #include "modelutility/spatialpartitioning/repo_spatial_partitioner_abstract.h"
 
 namespace repo{
@@ -304,15 +305,21 @@ namespace repo{
 			* Generate and commit stash graph (multipart viewing graph)
 			* The generated graph will be added into the scene provided
 			* also commited to the database/project set within the scene
+			* If changedNodes is given, the stash graph loaded within the scene
+			* is updated incrementally instead of being regenerated
 			* @param databaseAd mongo database address:port
 			* @param cred user credentials in bson form
 			* @param scene scene to optimise
+			* @param changedNodes shared IDs of the nodes changed since the stash was generated
+			* @param options stash graph options
 			* @param return true upon success
 			*/
 			bool generateAndCommitStashGraph(
 				const std::string                         &databaseAd,
 				const repo::core::model::RepoBSON         *cred,
-				repo::core::model::RepoScene* scene
+				repo::core::model::RepoScene* scene,
+				const std::vector<repo::lib::RepoUUID>    &changedNodes = std::vector<repo::lib::RepoUUID>(),
+				const modelutility::StashGraphOptions     &options = modelutility::StashGraphOptions()
 				);
 
 			/**
@@ -321,8 +328,10 @@ namespace repo{
 			* @param databaseAd database address:portdatabase
 			* @param cred user credentials in bson form
 			* @param scene the scene to generate the src encoding from
-			* @param buffers buffers that are geneated and commited
+			* @param options export options
+			* @param buffers left empty, the files are uploaded as they are generated
 			* @param exType the type of export it is
+			* @param options export options
 			* @return returns true upon success
 			*/
 			bool generateAndCommitWebViewBuffer(
@@ -330,7 +339,8 @@ namespace repo{
 				const repo::core::model::RepoBSON	          *cred,
 				repo::core::model::RepoScene                  *scene,
 				repo_web_buffers_t                            &buffers,
-				const modelconvertor::WebExportType           &exType);
+				const modelconvertor::WebExportType           &exType,
+				const modelconvertor::WebExportOptions        &options = modelconvertor::WebExportOptions());
 
 			/**
 			* Generate and commit a GLTF encoding for the given scene
@@ -338,13 +348,16 @@ namespace repo{
 			* @param databaseAd database address:portdatabase
 			* @param cred user credentials in bson form
 			* @param scene the scene to generate the gltf encoding from
+			* @param options export options
 			* @return returns true upon success
 			*/
 
 			bool generateAndCommitGLTFBuffer(
 				const std::string                             &databaseAd,
 				const repo::core::model::RepoBSON	          *cred,
-				repo::core::model::RepoScene                  *scene);
+				repo::core::model::RepoScene                  *scene,
+				const modelconvertor::WebExportOptions &options =
+				modelconvertor::WebExportOptions());
 
 			/**
 			* Generate and commit a SRC encoding for the given scene
@@ -352,39 +365,78 @@ namespace repo{
 			* @param databaseAd database address:portdatabase
 			* @param cred user credentials in bson form
 			* @param scene the scene to generate the src encoding from
+			* @param options export options
 			* @return returns true upon success
 			*/
 			bool generateAndCommitSRCBuffer(
 				const std::string                             &databaseAd,
 				const repo::core::model::RepoBSON	          *cred,
-				repo::core::model::RepoScene                  *scene);
+				repo::core::model::RepoScene                  *scene,
+				const modelconvertor::WebExportOptions &options =
+				modelconvertor::WebExportOptions());
+
+			/**
+			* Generate and commit a GLB (binary glTF) encoding for the given scene
+			* This requires the stash to have been generated already
+			* @param databaseAd database address:portdatabase
+			* @param cred user credentials in bson form
+			* @param scene the scene to generate the glb encoding from
+			* @param options export options
+			* @return returns true upon success
+			*/
+			bool generateAndCommitGLBBuffer(
+				const std::string                             &databaseAd,
+				const repo::core::model::RepoBSON	          *cred,
+				repo::core::model::RepoScene                  *scene,
+				const modelconvertor::WebExportOptions &options =
+				modelconvertor::WebExportOptions());
 
 			/**
 			* Generate a gltf encoding in the form of a buffer for the given scene
 			* This requires the stash to have been generated already
 			* @param scene the scene to generate the gltf encoding from
+			* @param options export options
 			* @return returns a buffer in the form of a byte vector mapped to its filename
 			*/
 			repo_web_buffers_t generateGLTFBuffer(
-				repo::core::model::RepoScene *scene);
+				repo::core::model::RepoScene *scene,
+				const modelconvertor::WebExportOptions &options =
+				modelconvertor::WebExportOptions());
 
 			/**
 			* Generate a SRC encoding in the form of a buffer for the given scene
 			* This requires the stash to have been generated already
 			* @param scene the scene to generate the src encoding from
+			* @param options export options
 			* @return returns a buffer in the form of a byte vector mapped to its filename
 			*/
 			repo_web_buffers_t generateSRCBuffer(
-				repo::core::model::RepoScene *scene);
+				repo::core::model::RepoScene *scene,
+				const modelconvertor::WebExportOptions &options =
+				modelconvertor::WebExportOptions());
+
+			/**
+			* Generate a GLB (binary glTF) encoding in the form of a buffer for the given scene
+			* This requires the stash to have been generated already
+			* @param scene the scene to generate the glb encoding from
+			* @param options export options
+			* @return returns a buffer in the form of a byte vector mapped to its filename
+			*/
+			repo_web_buffers_t generateGLBBuffer(
+				repo::core::model::RepoScene *scene,
+				const modelconvertor::WebExportOptions &options =
+				modelconvertor::WebExportOptions());
 
 			/**
 			* Generate a stash graph for the given scene and populate it
 			* into the given scene
 			* @param scene scene to generate stash graph for
+			* @param options stash graph options
 			* @return returns true upon success
 			*/
 			bool generateStashGraph(
-				repo::core::model::RepoScene              *scene
+				repo::core::model::RepoScene              *scene,
+				const modelutility::StashGraphOptions     &options = modelutility::StashGraphOptions()
 				);
 			/**
 			* Retrieve documents from a specified collection
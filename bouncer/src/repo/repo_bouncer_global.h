@@ -32,6 +32,17 @@
 #   define REPO_API_EXPORT REPO_DECL_IMPORT
 #endif
 
+//------------------------------------------------------------------------------
+//Visual Studio 2013 does not support constexpr or thread_local
+//NOTE: __declspec(thread) only works on POD types with constant initialisers
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#   define REPO_CONSTEXPR
+#   define REPO_THREAD_LOCAL __declspec(thread)
+#else
+#   define REPO_CONSTEXPR constexpr
+#   define REPO_THREAD_LOCAL thread_local
+#endif
+
 //------------------------------------------------------------------------------
 #define BOUNCER_VMAJOR 1
 #define BOUNCER_VMINOR "7.4"
@@ -179,10 +179,11 @@ bool RepoController::generateAndCommitSelectionTree(
 
 bool RepoController::generateAndCommitStashGraph(
 	const RepoController::RepoToken              *token,
-	repo::core::model::RepoScene* scene
+	repo::core::model::RepoScene* scene,
+	const repo::manipulator::modelutility::StashGraphOptions &options
 	)
 {
-	return impl->generateAndCommitStashGraph(token, scene);
+	return impl->generateAndCommitStashGraph(token, scene, options);
 }
 
 std::vector < repo::core::model::RepoBSON >
@@ -426,28 +427,47 @@ repo::core::model::RepoScene* RepoController::createFederatedScene(
 
 bool RepoController::generateAndCommitGLTFBuffer(
 	const RepoController::RepoToken    *token,
-	repo::core::model::RepoScene *scene)
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
 {
-	return impl->generateAndCommitGLTFBuffer(token, scene);
+	return impl->generateAndCommitGLTFBuffer(token, scene, options);
 }
 
 bool RepoController::generateAndCommitSRCBuffer(
 	const RepoController::RepoToken    *token,
-	repo::core::model::RepoScene *scene)
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
+{
+	return impl->generateAndCommitSRCBuffer(token, scene, options);
+}
+
+bool RepoController::generateAndCommitGLBBuffer(
+	const RepoController::RepoToken    *token,
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
 {
-	return impl->generateAndCommitSRCBuffer(token, scene);
+	return impl->generateAndCommitGLBBuffer(token, scene, options);
 }
 
 repo_web_buffers_t RepoController::generateGLTFBuffer(
-	repo::core::model::RepoScene *scene)
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
 {
-	return impl->generateGLTFBuffer(scene);
+	return impl->generateGLTFBuffer(scene, options);
 }
 
 repo_web_buffers_t RepoController::generateSRCBuffer(
-	repo::core::model::RepoScene *scene)
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
+{
+	return impl->generateSRCBuffer(scene, options);
+}
+
+repo_web_buffers_t RepoController::generateGLBBuffer(
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
 {
-	return impl->generateSRCBuffer(scene);
+	return impl->generateGLBBuffer(scene, options);
 }
 
 std::list<std::string> RepoController::getAdminDatabaseRoles(const RepoController::RepoToken *token)
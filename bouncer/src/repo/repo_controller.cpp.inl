@@ -710,31 +710,54 @@ public:
 	* This requires the stash to have been generated already
 	* @param token token for authentication
 	* @param scene the scene to generate the gltf encoding from
+	* @param options export options
 	* @return returns true upon success
 	*/
 	bool generateAndCommitGLTFBuffer(
 		const RepoToken                               *token,
-		repo::core::model::RepoScene            *scene);
+		repo::core::model::RepoScene            *scene,
+		const repo::manipulator::modelconvertor::WebExportOptions &options =
+		repo::manipulator::modelconvertor::WebExportOptions());
 
 	/**
 	* Generate and commit a SRC encoding for the given scene
 	* This requires the stash to have been generated already
 	* @param token token for authentication
 	* @param scene the scene to generate the src encoding from
+	* @param options export options
 	* @return returns true upon success
 	*/
 	bool generateAndCommitSRCBuffer(
 		const RepoToken                               *token,
-		repo::core::model::RepoScene            *scene);
+		repo::core::model::RepoScene            *scene,
+		const repo::manipulator::modelconvertor::WebExportOptions &options =
+		repo::manipulator::modelconvertor::WebExportOptions());
+
+	/**
+	* Generate and commit a GLB (binary glTF) encoding for the given scene
+	* This requires the stash to have been generated already
+	* @param token token for authentication
+	* @param scene the scene to generate the glb encoding from
+	* @param options export options
+	* @return returns true upon success
+	*/
+	bool generateAndCommitGLBBuffer(
+		const RepoToken                               *token,
+		repo::core::model::RepoScene            *scene,
+		const repo::manipulator::modelconvertor::WebExportOptions &options =
+		repo::manipulator::modelconvertor::WebExportOptions());
 
 	/**
 	* Generate a GLTF encoding in the form of a buffer for the given scene
 	* This requires the stash to have been generated already
 	* @param scene the scene to generate the gltf encoding from
+	* @param options export options
 	* @return returns a buffer in the form of a byte vector
 	*/
 	repo_web_buffers_t generateGLTFBuffer(
-		repo::core::model::RepoScene *scene);
+		repo::core::model::RepoScene *scene,
+		const repo::manipulator::modelconvertor::WebExportOptions &options =
+		repo::manipulator::modelconvertor::WebExportOptions());
 
 	/**
 	* Generate and commit a selection tree for the given scene
@@ -750,10 +773,25 @@ public:
 	* Generate a SRC encoding in the form of a buffer for the given scene
 	* This requires the stash to have been generated already
 	* @param scene the scene to generate the src encoding from
+	* @param options export options
 	* @return returns a buffer in the form of a byte vector
 	*/
 	repo_web_buffers_t generateSRCBuffer(
-		repo::core::model::RepoScene *scene);
+		repo::core::model::RepoScene *scene,
+		const repo::manipulator::modelconvertor::WebExportOptions &options =
+		repo::manipulator::modelconvertor::WebExportOptions());
+
+	/**
+	* Generate a GLB (binary glTF) encoding in the form of a buffer for the given scene
+	* This requires the stash to have been generated already
+	* @param scene the scene to generate the glb encoding from
+	* @param options export options
+	* @return returns a buffer in the form of a byte vector
+	*/
+	repo_web_buffers_t generateGLBBuffer(
+		repo::core::model::RepoScene *scene,
+		const repo::manipulator::modelconvertor::WebExportOptions &options =
+		repo::manipulator::modelconvertor::WebExportOptions());
 
 	/**
 	* Get a string of supported file formats for file export
@@ -811,11 +849,14 @@ public:
 	* also commited to the database/project set within the scene
 	* @param token database token
 	* @param scene scene to optimise
+	* @param options stash graph options
 	* @param return true upon success
 	*/
 	bool generateAndCommitStashGraph(
 		const RepoToken              *token,
-		repo::core::model::RepoScene* scene
+		repo::core::model::RepoScene* scene,
+		const repo::manipulator::modelutility::StashGraphOptions &options =
+		repo::manipulator::modelutility::StashGraphOptions()
 		);
 
 	/**
@@ -356,7 +356,8 @@ bool RepoController::_RepoControllerImpl::generateAndCommitSelectionTree(
 
 bool RepoController::_RepoControllerImpl::generateAndCommitStashGraph(
 	const RepoController::RepoToken              *token,
-	repo::core::model::RepoScene* scene
+	repo::core::model::RepoScene* scene,
+	const repo::manipulator::modelutility::StashGraphOptions &options
 	)
 {
 	bool success = false;
@@ -375,7 +376,7 @@ bool RepoController::_RepoControllerImpl::generateAndCommitStashGraph(
 		}
 
 		success = worker->generateAndCommitStashGraph(token->databaseAd, token->getCredentials(),
-			scene);
+			scene, std::vector<repo::lib::RepoUUID>(), options);
 
 		workerPool.push(worker);
 	}
@@ -883,13 +884,14 @@ repo::core::model::RepoScene* RepoController::_RepoControllerImpl::createFederat
 
 bool RepoController::_RepoControllerImpl::generateAndCommitGLTFBuffer(
 	const RepoController::RepoToken                    *token,
-	repo::core::model::RepoScene *scene)
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
 {
 	bool success;
 	if (success = token && scene)
 	{
 		manipulator::RepoManipulator* worker = workerPool.pop();
-		success = worker->generateAndCommitGLTFBuffer(token->databaseAd, token->getCredentials(), scene);
+		success = worker->generateAndCommitGLTFBuffer(token->databaseAd, token->getCredentials(), scene, options);
 		workerPool.push(worker);
 	}
 	else
@@ -901,13 +903,14 @@ bool RepoController::_RepoControllerImpl::generateAndCommitGLTFBuffer(
 
 bool RepoController::_RepoControllerImpl::generateAndCommitSRCBuffer(
 	const RepoController::RepoToken                    *token,
-	repo::core::model::RepoScene *scene)
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
 {
 	bool success;
 	if (success = token && scene)
 	{
 		manipulator::RepoManipulator* worker = workerPool.pop();
-		success = worker->generateAndCommitSRCBuffer(token->databaseAd, token->getCredentials(), scene);
+		success = worker->generateAndCommitSRCBuffer(token->databaseAd, token->getCredentials(), scene, options);
 		workerPool.push(worker);
 	}
 	else
@@ -917,14 +920,34 @@ bool RepoController::_RepoControllerImpl::generateAndCommitSRCBuffer(
 	return success;
 }
 
+bool RepoController::_RepoControllerImpl::generateAndCommitGLBBuffer(
+	const RepoController::RepoToken                    *token,
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
+{
+	bool success;
+	if (success = token && scene)
+	{
+		manipulator::RepoManipulator* worker = workerPool.pop();
+		success = worker->generateAndCommitGLBBuffer(token->databaseAd, token->getCredentials(), scene, options);
+		workerPool.push(worker);
+	}
+	else
+	{
+		repoError << "Failed to generate GLB Buffer.";
+	}
+	return success;
+}
+
 repo_web_buffers_t RepoController::_RepoControllerImpl::generateGLTFBuffer(
-	repo::core::model::RepoScene *scene)
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
 {
 	repo_web_buffers_t buffer;
 	if (scene)
 	{
 		manipulator::RepoManipulator* worker = workerPool.pop();
-		buffer = worker->generateGLTFBuffer(scene);
+		buffer = worker->generateGLTFBuffer(scene, options);
 		workerPool.push(worker);
 	}
 	else
@@ -935,13 +958,14 @@ repo_web_buffers_t RepoController::_RepoControllerImpl::generateGLTFBuffer(
 }
 
 repo_web_buffers_t RepoController::_RepoControllerImpl::generateSRCBuffer(
-	repo::core::model::RepoScene *scene)
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
 {
 	repo_web_buffers_t buffer;
 	if (scene)
 	{
 		manipulator::RepoManipulator* worker = workerPool.pop();
-		buffer = worker->generateSRCBuffer(scene);
+		buffer = worker->generateSRCBuffer(scene, options);
 		workerPool.push(worker);
 	}
 	else
@@ -951,6 +975,24 @@ repo_web_buffers_t RepoController::_RepoControllerImpl::generateSRCBuffer(
 	return buffer;
 }
 
+repo_web_buffers_t RepoController::_RepoControllerImpl::generateGLBBuffer(
+	repo::core::model::RepoScene *scene,
+	const repo::manipulator::modelconvertor::WebExportOptions &options)
+{
+	repo_web_buffers_t buffer;
+	if (scene)
+	{
+		manipulator::RepoManipulator* worker = workerPool.pop();
+		buffer = worker->generateGLBBuffer(scene, options);
+		workerPool.push(worker);
+	}
+	else
+	{
+		repoError << "Failed to generate GLB Buffer.";
+	}
+	return buffer;
+}
+
 std::list<std::string> RepoController::_RepoControllerImpl::getAdminDatabaseRoles(const RepoController::RepoToken *token)
 {
 	std::list<std::string> roles;
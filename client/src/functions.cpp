@@ -41,7 +41,7 @@ std::string helpInfo()
 {
 	std::stringstream ss;
 
-	ss << cmdGenStash << "\tGenerate Stash for a project. (args: database project [repo|gltf|src|tree])\n";
+	ss << cmdGenStash << "\tGenerate Stash for a project. (args: database project [repo|gltf|glb|src|tree] [configfile])\n";
 	ss << cmdGetFile << "\t\tGet original file for the latest revision of the project (args: database project dir)\n";
 	ss << cmdImportFile << "\t\tImport file to database. (args: {file database project [dxrotate] [owner] [configfile]} or {-f parameterFile} )\n";
 	ss << cmdCreateFed << "\t\tGenerate a federation. (args: fedDetails [owner])\n";
@@ -294,6 +294,43 @@ int32_t generateFederation(
 	return success ? REPOERR_OK : REPOERR_FED_GEN_FAIL;
 }
 
+/**
+* Read the stash generation and web export settings from a json file
+* e.g. { "stash" : { "weldVertices" : true }, "web" : { "quantiseAttributes" : true } }
+* (stash.memoryBudget is given in bytes)
+* Settings missing from the file keep their default values
+* @param configFile path to the json file
+* @param stashOptions stash graph options to fill in
+* @param webOptions web export options to fill in
+* @return returns true upon success
+*/
+static bool readStashSettings(
+	const std::string                                   &configFile,
+	repo::manipulator::modelutility::StashGraphOptions  &stashOptions,
+	repo::manipulator::modelconvertor::WebExportOptions &webOptions)
+{
+	boost::property_tree::ptree jsonTree;
+	try{
+		boost::property_tree::read_json(configFile, jsonTree);
+		stashOptions.weldVertices = jsonTree.get<bool>("stash.weldVertices", stashOptions.weldVertices);
+		stashOptions.instancing = jsonTree.get<bool>("stash.instancing", stashOptions.instancing);
+		stashOptions.minInstances = jsonTree.get<uint32_t>("stash.minInstances", stashOptions.minInstances);
+		stashOptions.mergeTextures = jsonTree.get<bool>("stash.mergeTextures", stashOptions.mergeTextures);
+		stashOptions.memoryBudget = jsonTree.get<size_t>("stash.memoryBudget", stashOptions.memoryBudget);
+
+		webOptions.quantiseAttributes = jsonTree.get<bool>("web.quantiseAttributes", webOptions.quantiseAttributes);
+		webOptions.optimiseVertexCache = jsonTree.get<bool>("web.optimiseVertexCache", webOptions.optimiseVertexCache);
+		webOptions.useUInt32Indices = jsonTree.get<bool>("web.useUInt32Indices", webOptions.useUInt32Indices);
+		webOptions.packFiles = jsonTree.get<bool>("web.packFiles", webOptions.packFiles);
+	}
+	catch (std::exception &e)
+	{
+		repoLogError("Failed to read stash settings from " + configFile + ": " + std::string(e.what()));
+		return false;
+	}
+	return true;
+}
+
 int32_t generateStash(
 	repo::RepoController       *controller,
 	const repo::RepoController::RepoToken      *token,
@@ -306,7 +343,7 @@ int32_t generateStash(
 	if (command.nArgcs < 3)
 	{
 		repoLogError("Number of arguments mismatch! " + cmdGenStash
-			+ " requires 3 arguments:database project [repo|gltf|src|tree]");
+			+ " requires 3 arguments:database project [repo|gltf|glb|src|tree]");
 		return REPOERR_INVALID_ARG;
 	}
 
@@ -314,12 +351,19 @@ int32_t generateStash(
 	std::string project = command.args[1];
 	std::string type = command.args[2];
 
-	if (!(type == "repo" || type == "gltf" || type == "src" || type == "tree"))
+	if (!(type == "repo" || type == "gltf" || type == "glb" || type == "src" || type == "tree"))
 	{
 		repoLogError("Unknown stash type: " + type);
 		return REPOERR_INVALID_ARG;
 	}
 
+	repo::manipulator::modelutility::StashGraphOptions stashOptions;
+	repo::manipulator::modelconvertor::WebExportOptions webOptions;
+	if (command.nArgcs > 3 && !readStashSettings(command.args[3], stashOptions, webOptions))
+	{
+		return REPOERR_INVALID_ARG;
+	}
+
 	auto scene = controller->fetchScene(token, dbName, project);
 	if (!scene)
 	{
@@ -330,15 +374,19 @@ int32_t generateStash(
 
 	if (type == "repo")
 	{
-		success = controller->generateAndCommitStashGraph(token, scene);
+		success = controller->generateAndCommitStashGraph(token, scene, stashOptions);
 	}
 	else if (type == "gltf")
 	{
-		success = controller->generateAndCommitGLTFBuffer(token, scene);
+		success = controller->generateAndCommitGLTFBuffer(token, scene, webOptions);
+	}
+	else if (type == "glb")
+	{
+		success = controller->generateAndCommitGLBBuffer(token, scene, webOptions);
 	}
 	else if (type == "src")
 	{
-		success = controller->generateAndCommitSRCBuffer(token, scene);
+		success = controller->generateAndCommitSRCBuffer(token, scene, webOptions);
 	}
 	else if (type == "tree")
 	{
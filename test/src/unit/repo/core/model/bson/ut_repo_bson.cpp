@@ -87,6 +87,30 @@ TEST(RepoBSONTest, GetBinaryAsVectorEmbedded)
 	EXPECT_FALSE(bson.getBinaryFieldAsVector("doesn'tExist", out));
 }
 
+TEST(RepoBSONTest, GetBinaryFieldByteSize)
+{
+	mongo::BSONObjBuilder builder;
+
+	std::vector < uint8_t > in(100);
+
+	builder << "stringTest" << "hello";
+	builder << "numTest" << 1.35;
+	builder.appendBinData("binDataTest", in.size(), mongo::BinDataGeneral, &in[0]);
+
+	RepoBSON bson(builder);
+
+	EXPECT_EQ(in.size(), bson.getBinaryFieldByteSize("binDataTest"));
+	EXPECT_EQ(0, bson.getBinaryFieldByteSize("numTest"));
+	EXPECT_EQ(0, bson.getBinaryFieldByteSize("stringTest"));
+	EXPECT_EQ(0, bson.getBinaryFieldByteSize("doesn'tExist"));
+
+	std::unordered_map<std::string, std::pair<std::string, std::vector<uint8_t>>> map;
+	map["binDataTest"] = std::pair<std::string, std::vector<uint8_t>>("testingfile", std::vector<uint8_t>(50));
+	RepoBSON referenced(BSON("binDataTest" << "testingfile"), map);
+	EXPECT_EQ(50, referenced.getBinaryFieldByteSize("binDataTest"));
+	EXPECT_EQ(0, referenced.getBinaryFieldByteSize("testingfile"));
+}
+
 TEST(RepoBSONTest, GetBinaryAsVectorReferenced)
 {
 	mongo::BSONObjBuilder builder;
@@ -398,6 +422,93 @@ TEST(RepoBSONTest, CloneAndShrink)
 	}
 }
 
+TEST(RepoBSONTest, CloneAndShrinkWithLimit)
+{
+	mongo::BSONObjBuilder builder;
+	std::vector < uint8_t > small(100, 1), big(1000, 2), out;
+
+	builder << "stringTest" << "hello";
+	builder.appendBinData("smallBin", small.size(), mongo::BinDataGeneral, small.data());
+	builder.appendBinData("bigBin", big.size(), mongo::BinDataGeneral, big.data());
+
+	RepoBSON binBson(builder.obj());
+	RepoBSON extra(BSON("extraField" << 5));
+
+	//Fits, nothing should be moved out
+	RepoBSON fits = binBson.cloneAndShrink(binBson.objsize() * 2);
+	EXPECT_EQ(binBson, fits);
+	EXPECT_EQ(0, fits.getFilesMapping().size());
+
+	RepoBSON fitsWithExtra = binBson.cloneAndShrink(binBson.objsize() * 2, extra);
+	EXPECT_EQ(0, fitsWithExtra.getFilesMapping().size());
+	EXPECT_EQ(5, fitsWithExtra.getField("extraField").Int());
+	EXPECT_TRUE(fitsWithExtra.hasField("smallBin"));
+	EXPECT_TRUE(fitsWithExtra.hasField("bigBin"));
+	EXPECT_EQ("hello", fitsWithExtra.getStringField("stringTest"));
+
+	//Doesn't fit, every binary should be moved out
+	RepoBSON shrunk = binBson.cloneAndShrink(binBson.objsize() - 500, extra);
+	EXPECT_LE(shrunk.objsize(), binBson.objsize() - 500);
+	EXPECT_EQ(5, shrunk.getField("extraField").Int());
+	EXPECT_FALSE(shrunk.hasField("smallBin"));
+	EXPECT_FALSE(shrunk.hasField("bigBin"));
+	EXPECT_TRUE(shrunk.hasField(REPO_LABEL_OVERSIZED_FILES));
+	EXPECT_EQ(2, shrunk.getFilesMapping().size());
+
+	EXPECT_TRUE(shrunk.getBinaryFieldAsVector("bigBin", out));
+	EXPECT_EQ(big, out);
+	EXPECT_TRUE(shrunk.getBinaryFieldAsVector("smallBin", out));
+	EXPECT_EQ(small, out);
+
+	//Extra fields should replace existing ones
+	RepoBSON replaced = binBson.cloneAndShrink(binBson.objsize() * 2, RepoBSON(BSON("stringTest" << "bye")));
+	EXPECT_EQ("bye", replaced.getStringField("stringTest"));
+	EXPECT_EQ(binBson.nFields(), replaced.nFields());
+}
+
+TEST(RepoBSONTest, CloneAndShrinkLayout)
+{
+	mongo::BSONObjBuilder builder;
+	std::vector < uint8_t > bin(1000, 3);
+
+	builder << "stringTest" << "hello";
+	builder.appendBinData("binA", bin.size(), mongo::BinDataGeneral, bin.data());
+	builder << "numTest" << 1.35;
+	builder.appendBinData("binB", bin.size(), mongo::BinDataGeneral, bin.data());
+
+	RepoBSON binBson(builder.obj());
+	RepoBSON extra(BSON("extraField" << 5));
+
+	//The committed document should be laid out as adding the fields then shrinking it
+	RepoBSON withExtra = binBson.cloneAndAddFields(&extra);
+	RepoBSON expected = withExtra.cloneAndShrink();
+	RepoBSON shrunk = binBson.cloneAndShrink(binBson.objsize(), extra);
+
+	auto fieldNames = [](const RepoBSON &bson)
+	{
+		std::vector<std::string> names;
+		mongo::BSONObjIterator it(bson);
+		while (it.more())
+			names.push_back(it.next().fieldName());
+		return names;
+	};
+
+	auto expectedFields = fieldNames(expected);
+	auto shrunkFields = fieldNames(shrunk);
+	ASSERT_EQ(4, shrunkFields.size());
+	EXPECT_EQ(expectedFields, shrunkFields);
+	EXPECT_EQ(REPO_LABEL_OVERSIZED_FILES, shrunkFields[0]);
+	EXPECT_EQ("extraField", shrunkFields[1]);
+	EXPECT_EQ(expected.getObjectField(REPO_LABEL_OVERSIZED_FILES).nFields(),
+		shrunk.getObjectField(REPO_LABEL_OVERSIZED_FILES).nFields());
+	EXPECT_EQ(expected.getFilesMapping().size(), shrunk.getFilesMapping().size());
+
+	//Same when it fits: the extra fields go first, nothing is moved out
+	RepoBSON fits = binBson.cloneAndShrink(binBson.objsize() + extra.objsize(), extra);
+	EXPECT_EQ(withExtra, fits);
+	EXPECT_EQ(0, fits.getFilesMapping().size());
+}
+
 TEST(RepoBSONTest, GetBigBinary)
 {
 	std::vector < uint8_t > in, out;
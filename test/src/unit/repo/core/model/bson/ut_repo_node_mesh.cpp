@@ -370,4 +370,96 @@ TEST(MeshNodeTest, Getters)
 		bboxInVect.push_back({ bbox[i][0], bbox[i][1], bbox[i][2] });
 	}
 	EXPECT_TRUE(compareStdVectors(retBbox, bboxInVect));
-}
\ No newline at end of file
+}
+
+TEST(MeshNodeTest, GetNumVerticesAndFaces)
+{
+	MeshNode empty;
+	EXPECT_EQ(0, empty.getNumVertices());
+	EXPECT_EQ(0, empty.getNumFaces());
+
+	std::vector<repo::lib::RepoVector3D> v, emptyV;
+	std::vector<repo_face_t> f;
+	std::vector<std::vector<float>> bbox;
+	std::vector<std::vector<repo::lib::RepoVector2D>> emptyUV;
+	std::vector<repo_color4d_t> emptyCol;
+
+	for (int i = 0; i < 10; ++i)
+		v.push_back({ rand() / 100.0f, rand() / 100.0f, rand() / 100.0f });
+	for (int i = 0; i < 5; ++i)
+		f.push_back({ (uint32_t)i, (uint32_t)i + 1, (uint32_t)i + 2 });
+	//faces do not have to be triangles
+	f.push_back({ 1, 2 });
+	f.push_back({ 1, 2, 3, 4 });
+
+	auto mesh = RepoBSONFactory::makeMeshNode(v, f, emptyV, bbox, emptyUV, emptyCol);
+	EXPECT_TRUE(mesh.hasField(REPO_NODE_MESH_LABEL_VERTICES_COUNT));
+	EXPECT_TRUE(mesh.hasField(REPO_NODE_MESH_LABEL_FACES_COUNT));
+	EXPECT_EQ(v.size(), mesh.getNumVertices());
+	EXPECT_EQ(f.size(), mesh.getNumFaces());
+
+	//Nodes created before the counts were stored
+	MeshNode legacy(mesh.removeField(REPO_NODE_MESH_LABEL_VERTICES_COUNT).removeField(REPO_NODE_MESH_LABEL_FACES_COUNT));
+	EXPECT_FALSE(legacy.hasField(REPO_NODE_MESH_LABEL_VERTICES_COUNT));
+	EXPECT_FALSE(legacy.hasField(REPO_NODE_MESH_LABEL_FACES_COUNT));
+	EXPECT_EQ(v.size(), legacy.getNumVertices());
+	EXPECT_EQ(f.size(), legacy.getNumFaces());
+}
+
+TEST(MeshNodeTest, CloneAsStub)
+{
+	MeshNode empty;
+	EXPECT_FALSE(empty.isStub());
+	EXPECT_TRUE(empty.cloneAsStub().isStub());
+
+	std::vector<repo::lib::RepoVector3D> v, n;
+	std::vector<repo_face_t> f;
+	std::vector<std::vector<float>> bbox = { { 0, 0, 0 }, { 1, 1, 1 } };
+	std::vector<std::vector<repo::lib::RepoVector2D>> uv(1);
+	std::vector<repo_color4d_t> col;
+
+	for (int i = 0; i < 10; ++i)
+	{
+		v.push_back({ rand() / 100.0f, rand() / 100.0f, rand() / 100.0f });
+		n.push_back({ 0, 0, 1 });
+		uv[0].push_back({ rand() / 100.0f, rand() / 100.0f });
+		col.push_back({ 1, 0, 0, 1 });
+	}
+	for (int i = 0; i < 5; ++i)
+		f.push_back({ (uint32_t)i, (uint32_t)i + 1, (uint32_t)i + 2 });
+
+	repo_mesh_mapping_t map;
+	map.min = { 0, 0, 0 };
+	map.max = { 1, 1, 1 };
+	map.mesh_id = repo::lib::RepoUUID::createUUID();
+	map.material_id = repo::lib::RepoUUID::createUUID();
+	map.vertFrom = 0;
+	map.vertTo = v.size();
+	map.triFrom = 0;
+	map.triTo = f.size();
+
+	MeshNode mesh = RepoBSONFactory::makeMeshNode(v, f, n, bbox, uv, col).cloneAndUpdateMeshMapping({ map });
+	mesh = mesh.cloneAndAddParent(repo::lib::RepoUUID::createUUID());
+	EXPECT_FALSE(mesh.isStub());
+
+	auto stub = mesh.cloneAsStub();
+	EXPECT_TRUE(stub.isStub());
+	EXPECT_EQ(mesh.getUniqueID(), stub.getUniqueID());
+	EXPECT_EQ(mesh.getSharedID(), stub.getSharedID());
+	EXPECT_EQ(mesh.getParentIDs(), stub.getParentIDs());
+	EXPECT_EQ(mesh.getBoundingBox(), stub.getBoundingBox());
+	EXPECT_EQ(v.size(), stub.getNumVertices());
+	EXPECT_EQ(f.size(), stub.getNumFaces());
+	ASSERT_EQ(1, stub.getMeshMapping().size());
+	EXPECT_EQ(map.mesh_id, stub.getMeshMapping()[0].mesh_id);
+
+	EXPECT_EQ(0, stub.getVertices().size());
+	EXPECT_EQ(0, stub.getFaces().size());
+	EXPECT_EQ(0, stub.getNormals().size());
+	EXPECT_EQ(0, stub.getUVChannels().size());
+	EXPECT_EQ(0, stub.getColors().size());
+	EXPECT_FALSE(stub.hasOversizeFiles());
+
+	//the original keeps its buffers
+	EXPECT_EQ(v.size(), mesh.getVertices().size());
+}
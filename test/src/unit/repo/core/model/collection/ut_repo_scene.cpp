@@ -19,6 +19,7 @@
 
 #include <gtest/gtest.h>
 
+#include <repo/core/model/bson/repo_bson_builder.h>
 #include <repo/core/model/bson/repo_node_mesh.h>
 #include <repo/core/model/bson/repo_node_texture.h>
 #include <repo/core/model/bson/repo_node_transformation.h>
@@ -352,6 +353,92 @@ TEST(RepoSceneTest, CommitStash)
 	EXPECT_TRUE(scene2.commitStash(getHandler(), errMsg));
 }
 
+TEST(RepoSceneTest, IsSharedStashNode)
+{
+	RepoScene scene;
+	const repo::lib::RepoUUID rev = repo::lib::RepoUUID::createUUID();
+	const repo::lib::RepoUUID otherRev = repo::lib::RepoUUID::createUUID();
+	scene.setRevision(rev);
+
+	auto makeStashNode = [](const std::vector<repo::lib::RepoUUID> &revs)
+	{
+		RepoBSONBuilder builder;
+		if (revs.size() == 1)
+			builder.append(REPO_NODE_STASH_REF, revs[0]);
+		else if (revs.size())
+			builder.appendArray(REPO_NODE_STASH_REF, revs);
+		builder.appendElements(makeRandomNode());
+		return RepoNode(builder.obj());
+	};
+
+	//Not committed yet, or committed with this revision only
+	RepoNode newNode = makeStashNode({});
+	RepoNode ownNode = makeStashNode({ rev });
+	EXPECT_FALSE(scene.isSharedStashNode(&newNode));
+	EXPECT_FALSE(scene.isSharedStashNode(&ownNode));
+
+	//Kept from the stash of another revision
+	RepoNode keptNode = makeStashNode({ otherRev });
+	RepoNode sharedNode = makeStashNode({ otherRev, rev });
+	EXPECT_TRUE(scene.isSharedStashNode(&keptNode));
+	EXPECT_TRUE(scene.isSharedStashNode(&sharedNode));
+}
+
+TEST(RepoSceneTest, LoadAndShareBaselineStash)
+{
+	std::string errMsg;
+	RepoNodeSet transNodes, meshNodes, empty;
+	auto root = new TransformationNode(makeRandomNode(getRandomString(rand() % 10 + 1)));
+	transNodes.insert(root);
+	meshNodes.insert(new MeshNode(makeRandomNode(root->getSharedID())));
+
+	RepoScene scene(std::vector<std::string>(), empty, meshNodes, empty, empty, empty, transNodes);
+	scene.setDatabaseAndProjectName("stashCommit", "baselineStash");
+	ASSERT_TRUE(scene.commit(getHandler(), errMsg, "blah"));
+	const repo::lib::RepoUUID rev = scene.getRevisionID();
+	const std::string collection = "baselineStash." + scene.getStashExtension();
+
+	//Stash documents written before they could be shared hold a single revision
+	RepoBSONBuilder revBuilder;
+	revBuilder.append(REPO_NODE_STASH_REF, rev);
+	RepoBSON revID = revBuilder.obj();
+	RepoNode stashRoot = RepoNode(makeRandomNode()).cloneAndAddFields(&revID, false);
+	RepoNode stashMesh = RepoNode(makeRandomNode(stashRoot.getSharedID())).cloneAndAddFields(&revID, false);
+	ASSERT_TRUE(getHandler()->insertDocument("stashCommit", collection, stashRoot, errMsg));
+	ASSERT_TRUE(getHandler()->insertDocument("stashCommit", collection, stashMesh, errMsg));
+
+	RepoScene loaded("stashCommit", "baselineStash");
+	loaded.setRevision(rev);
+	ASSERT_TRUE(loaded.loadStash(getHandler(), errMsg));
+	ASSERT_TRUE(loaded.hasRoot(RepoScene::GraphType::OPTIMIZED));
+	auto stashMeshes = loaded.getAllMeshes(RepoScene::GraphType::OPTIMIZED);
+	ASSERT_EQ(1, stashMeshes.size());
+	EXPECT_FALSE(loaded.isSharedStashNode(*stashMeshes.begin()));
+
+	//Kept by the stash of the next revision, the documents now hold both revisions
+	ASSERT_TRUE(scene.commit(getHandler(), errMsg, "blah"));
+	const repo::lib::RepoUUID nextRev = scene.getRevisionID();
+	ASSERT_NE(rev, nextRev);
+
+	RepoNodeSet stashTrans, stashMeshCopies;
+	stashTrans.insert(new TransformationNode(*loaded.getRoot(RepoScene::GraphType::OPTIMIZED)));
+	stashMeshCopies.insert(new MeshNode(*(MeshNode*)*stashMeshes.begin()));
+	scene.addStashGraph(empty, stashMeshCopies, empty, empty, stashTrans);
+	for (const auto &node : scene.getAllMeshes(RepoScene::GraphType::OPTIMIZED))
+		EXPECT_TRUE(scene.isSharedStashNode(node));
+	ASSERT_TRUE(scene.commitStash(getHandler(), errMsg));
+
+	for (const auto &revision : { rev, nextRev })
+	{
+		RepoBSONBuilder critBuilder;
+		critBuilder.append(REPO_NODE_STASH_REF, revision);
+		auto docs = getHandler()->findAllByCriteria("stashCommit", collection, critBuilder.obj());
+		EXPECT_EQ(2, docs.size());
+		for (const auto &doc : docs)
+			EXPECT_EQ(ElementType::ARRAY, doc.getField(REPO_NODE_STASH_REF).type());
+	}
+}
+
 TEST(RepoSceneTest, GetSetDatabaseProjectName)
 {
 	RepoScene scene;
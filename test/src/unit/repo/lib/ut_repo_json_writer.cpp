@@ -0,0 +1,186 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <clocale>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <repo/lib/repo_json_writer.h>
+#include <gtest/gtest.h>
+
+using namespace repo::lib;
+
+TEST(RepoJSONWriterTest, ConstructorTest)
+{
+	JSONWriter writer;
+	EXPECT_TRUE(writer.isEmpty());
+	EXPECT_FALSE(writer.isComplete());
+	EXPECT_TRUE(writer.getString().empty());
+}
+
+TEST(RepoJSONWriterTest, ObjectTest)
+{
+	JSONWriter writer;
+	writer.startObject();
+	writer.addMember("string", "value");
+	writer.addMember("int", -3);
+	writer.addMember("uint", (uint32_t)5123);
+	writer.addMember("size", (size_t)1024);
+	writer.addMember("bool", true);
+	writer.addMember("float", 0.5f);
+	writer.addMember("double", 1.25);
+	writer.addKey("null");
+	writer.addNull();
+	writer.startObject("child");
+	writer.endObject();
+	writer.startArray("array");
+	writer.endArray();
+	writer.endObject();
+
+	EXPECT_TRUE(writer.isComplete());
+	EXPECT_EQ("{\"string\":\"value\",\"int\":-3,\"uint\":5123,\"size\":1024,\"bool\":true,"
+		"\"float\":0.5,\"double\":1.25,\"null\":null,\"child\":{},\"array\":[]}", writer.getString());
+
+	auto buffer = writer.getBuffer();
+	EXPECT_EQ(writer.getString(), std::string(buffer.begin(), buffer.end()));
+}
+
+TEST(RepoJSONWriterTest, ArrayTest)
+{
+	JSONWriter writer;
+	writer.startArray();
+	writer.addValue(std::vector<float>({ 1.0f, 2.5f, -3.0f }));
+	writer.addValue(std::vector<uint16_t>({ 0, 65535 }));
+	writer.addValue(std::vector<std::string>({ "a", "b" }));
+	writer.startObject();
+	writer.addMember("nested", std::vector<int>());
+	writer.endObject();
+	writer.addValue(false);
+	writer.endArray();
+
+	EXPECT_TRUE(writer.isComplete());
+	EXPECT_EQ("[[1,2.5,-3],[0,65535],[\"a\",\"b\"],{\"nested\":[]},false]", writer.getString());
+}
+
+TEST(RepoJSONWriterTest, RawTest)
+{
+	JSONWriter section;
+	section.startObject();
+	section.addMember("a", 1);
+	section.endObject();
+
+	JSONWriter writer;
+	writer.startObject();
+	writer.addKey("section");
+	writer.addRaw(section.getString());
+	writer.addKey("empty");
+	writer.addRaw("");
+	writer.endObject();
+
+	EXPECT_EQ("{\"section\":{\"a\":1},\"empty\":null}", writer.getString());
+}
+
+TEST(RepoJSONWriterTest, MisuseTest)
+{
+	//Invalid calls are reported and ignored, the document stays valid
+	JSONWriter writer;
+	writer.startObject();
+	writer.addValue(1);
+	writer.endArray();
+	writer.addKey("a");
+	writer.addKey("b");
+	writer.endObject();
+	writer.addValue(2);
+	writer.endObject();
+	writer.addValue(3);
+
+	EXPECT_TRUE(writer.isComplete());
+	EXPECT_EQ("{\"a\":2}", writer.getString());
+
+	JSONWriter incomplete;
+	incomplete.startArray();
+	incomplete.startObject();
+	EXPECT_FALSE(incomplete.isComplete());
+	EXPECT_FALSE(incomplete.isEmpty());
+}
+
+TEST(RepoJSONWriterTest, EscapeTest)
+{
+	EXPECT_EQ("", JSONWriter::escape(""));
+	EXPECT_EQ("plain/text", JSONWriter::escape("plain/text"));
+	EXPECT_EQ("\\\"quoted\\\" \\\\ back", JSONWriter::escape("\"quoted\" \\ back"));
+	EXPECT_EQ("\\n\\r\\t\\b\\f", JSONWriter::escape("\n\r\t\b\f"));
+	EXPECT_EQ("\\u0001\\u001f", JSONWriter::escape(std::string("\x01\x1f")));
+
+	JSONWriter writer;
+	writer.startObject();
+	writer.addMember("na\"me", "line\nbreak");
+	writer.endObject();
+	EXPECT_EQ("{\"na\\\"me\":\"line\\nbreak\"}", writer.getString());
+}
+
+TEST(RepoJSONWriterTest, FormatNumberLocaleTest)
+{
+	//Numbers are written with a '.' whatever the numeric locale
+	const std::string previous = setlocale(LC_NUMERIC, nullptr);
+	bool commaLocale = false;
+	for (const char *name : { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "German_Germany.1252" })
+	{
+		if (setlocale(LC_NUMERIC, name))
+		{
+			commaLocale = true;
+			break;
+		}
+	}
+
+	if (commaLocale)
+	{
+		EXPECT_EQ("-0.25", JSONWriter::formatNumber(-0.25f));
+		EXPECT_EQ("0.1", JSONWriter::formatNumber(0.1f));
+		EXPECT_EQ("1.2345678901234567", JSONWriter::formatNumber(1.2345678901234567));
+
+		JSONWriter writer;
+		writer.startArray();
+		writer.addValue(1.5f);
+		writer.addValue(2.5);
+		writer.endArray();
+		EXPECT_EQ("[1.5,2.5]", writer.getString());
+	}
+	setlocale(LC_NUMERIC, previous.c_str());
+}
+
+TEST(RepoJSONWriterTest, FormatNumberTest)
+{
+	EXPECT_EQ("0", JSONWriter::formatNumber(0.0f));
+	EXPECT_EQ("1", JSONWriter::formatNumber(1.0f));
+	EXPECT_EQ("-0.25", JSONWriter::formatNumber(-0.25f));
+	EXPECT_EQ("0.1", JSONWriter::formatNumber(0.1f));
+	EXPECT_EQ("0.1", JSONWriter::formatNumber(0.1));
+	EXPECT_EQ("null", JSONWriter::formatNumber(std::numeric_limits<float>::quiet_NaN()));
+	EXPECT_EQ("null", JSONWriter::formatNumber(std::numeric_limits<float>::infinity()));
+	EXPECT_EQ("null", JSONWriter::formatNumber(-std::numeric_limits<double>::infinity()));
+
+	//Every value must read back exactly
+	for (const float value : { 3.14159265f, 1e-7f, 123456.789f, 16777217.0f, -9.87654e20f })
+	{
+		EXPECT_EQ(value, strtof(JSONWriter::formatNumber(value).c_str(), nullptr));
+	}
+	for (const double value : { 3.141592653589793, 1e-300, 0.1 + 0.2 })
+	{
+		EXPECT_EQ(value, strtod(JSONWriter::formatNumber(value).c_str(), nullptr));
+	}
+}
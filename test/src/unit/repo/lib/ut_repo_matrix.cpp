@@ -53,6 +53,29 @@ TEST(RepoMatrixTest, constructorTest)
 	RepoMatrix matrix4(sourceMat1), matrix5(sourceMat2);	
 }
 
+TEST(RepoMatrixTest, copyTest)
+{
+	RepoMatrix rand({ 2, 0.3f, 0.4f, 1.23f,
+		0.45f, 1, 0.488f, 12345,
+		0, 0, 3.5f, 0,
+		0, 0, 0, 1
+	});
+
+	RepoMatrix copied(rand);
+	EXPECT_EQ(rand, copied);
+
+	//Copies should carry the inverse over
+	auto inverse = rand.invert();
+	RepoMatrix copiedAfterInvert(rand), assigned;
+	assigned = rand;
+	EXPECT_EQ(inverse, copiedAfterInvert.invert());
+	EXPECT_EQ(inverse, assigned.invert());
+	EXPECT_EQ(inverse, copied.invert());
+
+	assigned = RepoMatrix();
+	EXPECT_TRUE(checkIsIdentity(assigned.invert()));
+}
+
 TEST(RepoMatrixTest, determinantTest)
 {
 	RepoMatrix id;
@@ -119,6 +142,55 @@ TEST(RepoMatrixTest, getDataTest)
 	EXPECT_TRUE(compareStdVectors(sourceMat2_, matrix5.getData()));
 }
 
+TEST(RepoMatrixTest, getRawDataTest)
+{
+	RepoMatrix id;
+	EXPECT_TRUE(compareStdVectors(id.getData(), std::vector<float>(id.getRawData().begin(), id.getRawData().end())));
+
+	std::vector<float> sourceMat;
+	for (int i = 0; i < 16; ++i)
+	{
+		sourceMat.push_back((rand() % 1000) / 1000.f);
+	}
+
+	RepoMatrix matrix(sourceMat);
+	auto raw = matrix.getRawData();
+	EXPECT_TRUE(compareStdVectors(sourceMat, std::vector<float>(raw.begin(), raw.end())));
+}
+
+TEST(RepoMatrixTest, identityDataTest)
+{
+	auto identity = RepoMatrix::identityData();
+	EXPECT_TRUE(checkIsIdentity(RepoMatrix(std::vector<float>(identity.begin(), identity.end()))));
+}
+
+TEST(RepoMatrixTest, isAffineTest)
+{
+	EXPECT_TRUE(RepoMatrix().isAffine());
+
+	RepoMatrix affine({ 2, 0.3f, 0.4f, 1.23f,
+		0.45f, 1, 0.488f, 12345,
+		0.5f, 0, 3.5f, 0,
+		0, 0, 0, 1
+	});
+
+	RepoMatrix notAffine({ 2, 0.3f, 0.4f, 1.23f,
+		0.45f, 1, 0.488f, 12345,
+		0.5f, 0, 3.5f, 0,
+		0, 4.56f, 0.0001f, 1
+	});
+
+	EXPECT_TRUE(affine.isAffine());
+	EXPECT_FALSE(notAffine.isAffine());
+	EXPECT_TRUE((affine * affine).isAffine());
+	EXPECT_FALSE((affine * notAffine).isAffine());
+	//The inverse is only flagged affine if its last row is exactly 0 0 0 1
+	auto inverseData = affine.invert().getData();
+	EXPECT_EQ(inverseData[12] == 0 && inverseData[13] == 0 && inverseData[14] == 0 && inverseData[15] == 1,
+		affine.invert().isAffine());
+	EXPECT_FALSE(affine.transpose().isAffine());
+}
+
 TEST(RepoMatrixTest, invertTest)
 {
 	RepoMatrix id;
@@ -137,6 +209,30 @@ TEST(RepoMatrixTest, invertTest)
 		0,	0,	0,	1 };
 	
 	EXPECT_TRUE(compareStdVectors(expectedRes, rand.invert().getData()));
+	//Second call is served from the cache
+	EXPECT_TRUE(compareStdVectors(expectedRes, rand.invert().getData()));
+}
+
+TEST(RepoMatrixTest, invertAffineLastRowTest)
+{
+	//The last row of the inverse is computed like the rest of the matrix, it is not rounded to 0 0 0 1
+	std::vector<float> data = { 2, 0.3f, 0.4f, 1.23f,
+		0.45f, 1, 0.488f, 12345,
+		0.5f, 0, 3.5f, 0,
+		0, 0, 0, 1 };
+	RepoMatrix affine(data);
+
+	float a1 = data[0], a2 = data[1], a3 = data[2];
+	float b1 = data[4], b2 = data[5], b3 = data[6];
+	float c1 = data[8], c2 = data[9], c3 = data[10];
+	const float inv_det = 1. / affine.determinant();
+	const float expected = inv_det * (a1 * (b2 * c3 - b3 * c2) + a2 * (b3 * c1 - b1 * c3) + a3 * (b1 * c2 - b2 * c1));
+
+	auto inverse = affine.invert().getData();
+	EXPECT_EQ(0, inverse[12]);
+	EXPECT_EQ(0, inverse[13]);
+	EXPECT_EQ(0, inverse[14]);
+	EXPECT_EQ(expected, inverse[15]);
 }
 
 TEST(RepoMatrixTest, isIdentityTest)
@@ -262,6 +358,26 @@ TEST(RepoMatrixTest, matMatTest)
 	2.78007888793945310f, 3.54223251342773440f, 46.30009841918945300f, 1464.85107421875000000f };
 
 	EXPECT_TRUE(compareStdVectors(expectedRes, resultRand.getData()));
+
+	//affine x affine should match the full multiplication
+	RepoMatrix affine({ 2, 0.3f, 0.4f, 1.23f,
+		0.45f, 1, 0.488f, 12345,
+		0.5f, 0, 3.5f, 0,
+		0, 0, 0, 1
+	});
+
+	auto affineRes = (affine * affine).getData();
+	auto affineData = affine.getData();
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			float expected = 0;
+			for (int k = 0; k < 4; ++k)
+				expected += affineData[i * 4 + k] * affineData[k * 4 + j];
+			EXPECT_EQ(expected, affineRes[i * 4 + j]);
+		}
+	}
 }
 
 TEST(RepoMatrixTest, eqOpTest)
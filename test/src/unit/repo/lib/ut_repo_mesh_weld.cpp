@@ -0,0 +1,121 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <repo/lib/datastructure/repo_mesh_weld.h>
+#include <gtest/gtest.h>
+
+using namespace repo::lib;
+
+TEST(RepoMeshWeldTest, exactWeldTest)
+{
+	//Two triangles of a quad as a triangle soup
+	std::vector<RepoVector3D> vertices = {
+		{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 },
+		{ 0, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+	std::vector<RepoVector3D> normals(6, RepoVector3D(0, 0, 1));
+	std::vector<std::vector<RepoVector2D>> uvs = { {
+		{ 0, 0 }, { 1, 0 }, { 1, 1 },
+		{ 0, 0 }, { 1, 1 }, { 0, 1 } } };
+	std::vector<repo_color4d_t> colors;
+	std::vector<repo_face_t> faces = { { 0, 1, 2 }, { 3, 4, 5 } };
+
+	EXPECT_EQ(2, weldVertices(vertices, normals, uvs, colors, faces));
+
+	ASSERT_EQ(4, vertices.size());
+	EXPECT_EQ(4, normals.size());
+	ASSERT_EQ(1, uvs.size());
+	EXPECT_EQ(4, uvs[0].size());
+	EXPECT_EQ(0, colors.size());
+
+	//First occurrences are kept, in order
+	EXPECT_EQ(RepoVector3D(0, 0, 0), vertices[0]);
+	EXPECT_EQ(RepoVector3D(1, 0, 0), vertices[1]);
+	EXPECT_EQ(RepoVector3D(1, 1, 0), vertices[2]);
+	EXPECT_EQ(RepoVector3D(0, 1, 0), vertices[3]);
+
+	ASSERT_EQ(2, faces.size());
+	EXPECT_EQ(repo_face_t({ 0, 1, 2 }), faces[0]);
+	EXPECT_EQ(repo_face_t({ 0, 2, 3 }), faces[1]);
+
+	//Nothing left to weld
+	EXPECT_EQ(0, weldVertices(vertices, normals, uvs, colors, faces));
+	EXPECT_EQ(4, vertices.size());
+}
+
+TEST(RepoMeshWeldTest, attributeMismatchTest)
+{
+	//Same position, but different normals/uvs/colors must not be merged
+	std::vector<RepoVector3D> vertices(4, RepoVector3D(1, 2, 3));
+	std::vector<RepoVector3D> normals = { { 0, 0, 1 }, { 0, 1, 0 }, { 0, 0, 1 }, { 0, 0, 1 } };
+	std::vector<std::vector<RepoVector2D>> uvs = { { { 0, 0 }, { 0, 0 }, { 0.5f, 0 }, { 0, 0 } } };
+	std::vector<repo_color4d_t> colors = { { 1, 0, 0, 1 }, { 1, 0, 0, 1 }, { 1, 0, 0, 1 }, { 0, 1, 0, 1 } };
+	std::vector<repo_face_t> faces = { { 0, 1, 2 }, { 1, 2, 3 } };
+
+	EXPECT_EQ(0, weldVertices(vertices, normals, uvs, colors, faces));
+	EXPECT_EQ(4, vertices.size());
+	EXPECT_EQ(repo_face_t({ 1, 2, 3 }), faces[1]);
+
+	//Within tolerance they are merged
+	EXPECT_EQ(2, weldVertices(vertices, normals, uvs, colors, faces, 0, 1.f, 0.5f));
+	EXPECT_EQ(2, vertices.size());
+	EXPECT_EQ(2, colors.size());
+	EXPECT_EQ(repo_face_t({ 0, 0, 0 }), faces[0]);
+	EXPECT_EQ(repo_face_t({ 0, 0, 1 }), faces[1]);
+}
+
+TEST(RepoMeshWeldTest, toleranceWeldTest)
+{
+	//Vertices close to each other, including across grid cell boundaries
+	std::vector<RepoVector3D> vertices = {
+		{ 0.0999f, 0, 0 }, { 0.1001f, 0, 0 }, { 5, 5, 5 }, { -0.0001f, 0, 0 }, { 0.0001f, 0, 0 }, { 5.2f, 5, 5 } };
+	std::vector<RepoVector3D> normals;
+	std::vector<std::vector<RepoVector2D>> uvs;
+	std::vector<repo_color4d_t> colors;
+	std::vector<repo_face_t> faces = { { 0, 1, 2 }, { 3, 4, 5 } };
+
+	EXPECT_EQ(0, weldVertices(vertices, normals, uvs, colors, faces));
+
+	EXPECT_EQ(2, weldVertices(vertices, normals, uvs, colors, faces, 0.001f));
+	ASSERT_EQ(4, vertices.size());
+	EXPECT_EQ(repo_face_t({ 0, 0, 1 }), faces[0]);
+	EXPECT_EQ(repo_face_t({ 2, 2, 3 }), faces[1]);
+}
+
+TEST(RepoMeshWeldTest, invalidInputTest)
+{
+	std::vector<RepoVector3D> vertices(3, RepoVector3D(1, 2, 3));
+	std::vector<RepoVector3D> normals(2);
+	std::vector<std::vector<RepoVector2D>> uvs;
+	std::vector<repo_color4d_t> colors;
+	std::vector<repo_face_t> faces = { { 0, 1, 2 } };
+
+	//normals don't match the vertices
+	EXPECT_EQ(0, weldVertices(vertices, normals, uvs, colors, faces));
+	EXPECT_EQ(3, vertices.size());
+
+	//face index out of range
+	normals.clear();
+	faces = { { 0, 1, 3 } };
+	EXPECT_EQ(0, weldVertices(vertices, normals, uvs, colors, faces));
+	EXPECT_EQ(3, vertices.size());
+	EXPECT_EQ(repo_face_t({ 0, 1, 3 }), faces[0]);
+
+	//empty mesh
+	vertices.clear();
+	faces.clear();
+	EXPECT_EQ(0, weldVertices(vertices, normals, uvs, colors, faces));
+}
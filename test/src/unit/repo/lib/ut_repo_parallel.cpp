@@ -0,0 +1,82 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <repo/lib/repo_parallel.h>
+#include <gtest/gtest.h>
+
+using namespace repo::lib;
+
+TEST(RepoParallelTest, getDefaultThreadCountTest)
+{
+	EXPECT_GE(getDefaultThreadCount(), 1);
+}
+
+TEST(RepoParallelTest, parallelForTest)
+{
+	//Every index should be visited exactly once, whatever the number of threads
+	for (const uint32_t nThreads : { 0u, 1u, 2u, 8u, 64u })
+	{
+		for (const size_t count : std::vector<size_t>({ 0, 1, 5, 1000 }))
+		{
+			std::vector<std::atomic<int>> visited(count);
+			for (auto &v : visited)
+				v = 0;
+
+			parallelFor(count, [&visited](const size_t &i) { ++visited[i]; }, nThreads);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				EXPECT_EQ(1, visited[i]);
+			}
+		}
+	}
+
+	std::atomic<size_t> sum(0);
+	parallelFor(100, [&sum](const size_t &i) { sum += i; });
+	EXPECT_EQ(4950, sum);
+}
+
+TEST(RepoParallelTest, nestedParallelForTest)
+{
+	//Inner loops run on the thread of the outer iteration
+	std::vector<std::atomic<int>> visited(64 * 16);
+	for (auto &v : visited)
+		v = 0;
+	std::atomic<int> foreignThreads(0);
+	parallelFor(64, [&](const size_t &i)
+	{
+		const auto outerThread = std::this_thread::get_id();
+		parallelFor(16, [&](const size_t &j)
+		{
+			if (std::this_thread::get_id() != outerThread)
+				++foreignThreads;
+			++visited[i * 16 + j];
+		}, 8);
+	}, 4);
+
+	EXPECT_EQ(0, foreignThreads);
+	for (const auto &v : visited)
+		EXPECT_EQ(1, v);
+
+	//The calling thread can run parallel loops again afterwards
+	std::atomic<size_t> sum(0);
+	parallelFor(100, [&sum](const size_t &i) { sum += i; }, 4);
+	EXPECT_EQ(4950, sum);
+}
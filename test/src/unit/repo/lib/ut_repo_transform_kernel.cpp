@@ -0,0 +1,121 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <repo/lib/datastructure/repo_transform_kernel.h>
+#include <gtest/gtest.h>
+
+using namespace repo::lib;
+
+static std::vector<RepoVector3D> randomVectors(const size_t &count)
+{
+	std::vector<RepoVector3D> vectors;
+	for (size_t i = 0; i < count; ++i)
+	{
+		vectors.push_back(RepoVector3D((rand() % 10000) / 100.f - 50.f,
+			(rand() % 10000) / 100.f - 50.f,
+			(rand() % 10000) / 100.f - 50.f));
+	}
+	return vectors;
+}
+
+static RepoMatrix sampleMatrix()
+{
+	return RepoMatrix({ 2, 0.3f, 0.4f, 1.23f,
+		0.45f, 1, 0.488f, 12345,
+		0.5f, 0, 3.5f, 0,
+		0, 0, 0, 1
+	});
+}
+
+TEST(RepoTransformKernelTest, transformPositionsTest)
+{
+	RepoMatrix mat = sampleMatrix();
+
+	//Odd sizes to cover the vectorised body and the remainder
+	for (const size_t count : { 1, 7, 8, 9, 100, 1027 })
+	{
+		auto positions = randomVectors(count);
+		std::vector<RepoVector3D> results(count);
+		RepoVector3D bboxMin, bboxMax;
+
+		transformPositions(mat, positions.data(), count, results.data(), bboxMin, bboxMax);
+
+		RepoVector3D expectedMin = mat * positions[0], expectedMax = expectedMin;
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto expected = mat * positions[i];
+			EXPECT_EQ(expected.x, results[i].x);
+			EXPECT_EQ(expected.y, results[i].y);
+			EXPECT_EQ(expected.z, results[i].z);
+
+			expectedMin.x = std::min(expectedMin.x, expected.x);
+			expectedMin.y = std::min(expectedMin.y, expected.y);
+			expectedMin.z = std::min(expectedMin.z, expected.z);
+			expectedMax.x = std::max(expectedMax.x, expected.x);
+			expectedMax.y = std::max(expectedMax.y, expected.y);
+			expectedMax.z = std::max(expectedMax.z, expected.z);
+		}
+
+		EXPECT_EQ(expectedMin, bboxMin);
+		EXPECT_EQ(expectedMax, bboxMax);
+	}
+
+	//in place transformation
+	auto positions = randomVectors(33);
+	auto original = positions;
+	RepoVector3D bboxMin, bboxMax;
+	transformPositions(mat, positions.data(), positions.size(), positions.data(), bboxMin, bboxMax);
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		EXPECT_EQ(mat * original[i], positions[i]);
+	}
+
+	//Nothing to transform, bounding box should be untouched
+	RepoVector3D untouchedMin(1, 2, 3), untouchedMax(4, 5, 6);
+	transformPositions(mat, nullptr, 0, nullptr, untouchedMin, untouchedMax);
+	EXPECT_EQ(RepoVector3D(1, 2, 3), untouchedMin);
+	EXPECT_EQ(RepoVector3D(4, 5, 6), untouchedMax);
+}
+
+TEST(RepoTransformKernelTest, transformNormalsTest)
+{
+	RepoMatrix normalMat = getNormalMatrix(sampleMatrix());
+	auto data = normalMat.getData();
+	EXPECT_EQ(0, data[3]);
+	EXPECT_EQ(0, data[7]);
+	EXPECT_EQ(0, data[11]);
+
+	for (const size_t count : { 1, 7, 8, 9, 100, 1027 })
+	{
+		auto normals = randomVectors(count);
+		//include a zero length normal, it should stay as it is
+		normals[count / 2] = RepoVector3D(0, 0, 0);
+		std::vector<RepoVector3D> results(count);
+
+		transformNormals(normalMat, normals.data(), count, results.data());
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto expected = normalMat * normals[i];
+			expected.normalize();
+			EXPECT_EQ(expected.x, results[i].x);
+			EXPECT_EQ(expected.y, results[i].y);
+			EXPECT_EQ(expected.z, results[i].z);
+		}
+	}
+}
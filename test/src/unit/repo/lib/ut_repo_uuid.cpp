@@ -17,6 +17,8 @@
 
 #include <cstdlib>
 #include <sstream>
+#include <thread>
+#include <unordered_set>
 #include <repo/lib/datastructure/repo_uuid.h>
 #include <gtest/gtest.h>
 
@@ -45,6 +47,53 @@ TEST(RepoUUIDTest, constructorTest)
 	RepoUUID fromAnotherRepoUUID(generatedID);
 }
 
+TEST(RepoUUIDTest, createUUIDTest)
+{
+	auto id = RepoUUID::createUUID();
+	auto data = id.data();
+	//version 4, RFC 4122 variant
+	EXPECT_EQ(0x40, data[6] & 0xF0);
+	EXPECT_EQ(0x80, data[8] & 0xC0);
+	EXPECT_EQ(boost::uuids::uuid::version_random_number_based, id.getInternalID().version());
+
+	//Generate from multiple threads at once, they should all be unique
+	const int nThreads = 8, nIDs = 10000;
+	std::vector<std::vector<RepoUUID>> generated(nThreads);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < nThreads; ++i)
+	{
+		threads.push_back(std::thread([&generated, i, nIDs]()
+		{
+			for (int j = 0; j < nIDs; ++j)
+				generated[i].push_back(RepoUUID::createUUID());
+		}));
+	}
+
+	for (auto &thread : threads)
+		thread.join();
+
+	std::unordered_set<RepoUUID, RepoUUIDHasher> uniqueIDs;
+	for (const auto &ids : generated)
+		uniqueIDs.insert(ids.begin(), ids.end());
+	EXPECT_EQ(nThreads * nIDs, uniqueIDs.size());
+}
+
+TEST(RepoUUIDTest, fromStringTest)
+{
+	std::string idString = "1a2b3c4d-5e6f-4a8b-9cad-bef012345678";
+	RepoUUID fromString(idString);
+	EXPECT_EQ(idString, fromString.toString());
+
+	EXPECT_EQ(fromString, RepoUUID("{" + idString + "}"));
+	EXPECT_EQ(fromString, RepoUUID("1A2B3C4D-5E6F-4A8B-9CAD-BEF012345678"));
+	EXPECT_EQ(fromString, RepoUUID("1a2b3c4d5e6f4a8b9cadbef012345678"));
+
+	//Not a UUID, should be hashed consistently
+	RepoUUID notUUID("1a2b3c4d-5e6f-4a8b-9cad-bef01234567z");
+	EXPECT_NE(fromString, notUUID);
+	EXPECT_EQ(notUUID, RepoUUID("1a2b3c4d-5e6f-4a8b-9cad-bef01234567z"));
+}
+
 TEST(RepoUUIDTest, dataTest)
 {
 	boost::uuids::uuid id = gen();
@@ -0,0 +1,151 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <repo/lib/datastructure/repo_vertex_cache.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+
+using namespace repo::lib;
+
+//A grid of quads, with its triangles shuffled
+static std::vector<uint16_t> shuffledGrid(const uint16_t &size, size_t &vertexCount)
+{
+	std::vector<std::array<uint16_t, 3>> triangles;
+	for (uint16_t y = 0; y < size; ++y)
+	{
+		for (uint16_t x = 0; x < size; ++x)
+		{
+			uint16_t v = y * (size + 1) + x;
+			triangles.push_back({ { v, (uint16_t)(v + 1), (uint16_t)(v + size + 1) } });
+			triangles.push_back({ { (uint16_t)(v + 1), (uint16_t)(v + size + 2), (uint16_t)(v + size + 1) } });
+		}
+	}
+
+	//Deterministic shuffle
+	for (size_t i = 0; i < triangles.size(); ++i)
+		std::swap(triangles[i], triangles[(i * 7919 + 13) % triangles.size()]);
+
+	std::vector<uint16_t> indices;
+	for (const auto &tri : triangles)
+		indices.insert(indices.end(), tri.begin(), tri.end());
+	vertexCount = (size + 1) * (size + 1);
+	return indices;
+}
+
+//Number of vertices transformed per triangle through a FIFO cache
+static float getACMR(const std::vector<uint16_t> &indices, const size_t &cacheSize)
+{
+	std::deque<uint16_t> cache;
+	size_t misses = 0;
+	for (const auto &index : indices)
+	{
+		if (std::find(cache.begin(), cache.end(), index) == cache.end())
+		{
+			++misses;
+			cache.push_back(index);
+			if (cache.size() > cacheSize)
+				cache.pop_front();
+		}
+	}
+	return (float)misses / (indices.size() / 3);
+}
+
+//Triangles as rotation independent keys, sorted
+static std::vector<std::array<uint16_t, 3>> getTriangles(const std::vector<uint16_t> &indices)
+{
+	std::vector<std::array<uint16_t, 3>> triangles;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		std::array<uint16_t, 3> tri = { { indices[i], indices[i + 1], indices[i + 2] } };
+		std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+		triangles.push_back(tri);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+TEST(RepoVertexCacheTest, optimiseVertexCacheTest)
+{
+	EXPECT_TRUE(optimiseVertexCache((uint16_t*)nullptr, 0, 0));
+
+	size_t vertexCount;
+	auto indices = shuffledGrid(40, vertexCount);
+	auto original = indices;
+
+	EXPECT_TRUE(optimiseVertexCache(indices.data(), indices.size(), vertexCount, 32));
+
+	//Same triangles, same winding
+	EXPECT_EQ(getTriangles(original), getTriangles(indices));
+	EXPECT_LT(getACMR(indices, 16), getACMR(original, 16));
+	EXPECT_LT(getACMR(indices, 16), 1.0f);
+
+	//Out of range indices are refused and left as they are
+	std::vector<uint16_t> invalid = { 0, 1, 2, 2, 1, 5 };
+	auto invalidCopy = invalid;
+	EXPECT_FALSE(optimiseVertexCache(invalid.data(), invalid.size(), 5));
+	EXPECT_EQ(invalidCopy, invalid);
+
+	//Degenerate triangles are kept
+	std::vector<uint16_t> degenerate = { 0, 0, 1, 1, 2, 3, 3, 3, 3, 0, 1, 2 };
+	auto degenerateCopy = degenerate;
+	EXPECT_TRUE(optimiseVertexCache(degenerate.data(), degenerate.size(), 4));
+	EXPECT_EQ(getTriangles(degenerateCopy), getTriangles(degenerate));
+}
+
+TEST(RepoVertexCacheTest, optimiseVertexFetchTest)
+{
+	std::vector<uint16_t> indices = { 4, 2, 0, 2, 4, 5 };
+	std::vector<int> attributes = { 10, 11, 12, 13, 14, 15 };
+	std::vector<int> original;
+	for (const auto &index : indices)
+		original.push_back(attributes[index]);
+
+	auto newToOld = optimiseVertexFetch(indices.data(), indices.size(), attributes.size());
+	EXPECT_EQ(std::vector<uint16_t>({ 0, 1, 2, 1, 0, 3 }), indices);
+	//Unused vertices go last, in their original order
+	EXPECT_EQ(std::vector<uint32_t>({ 4, 2, 0, 5, 1, 3 }), newToOld);
+
+	//Remapping the attributes keeps what every index points to
+	attributes.insert(attributes.begin(), { 0, 0 });
+	remapVertexAttributes(attributes, 2, newToOld);
+	for (size_t i = 0; i < indices.size(); ++i)
+		EXPECT_EQ(original[i], attributes[2 + indices[i]]);
+	EXPECT_EQ(0, attributes[0]);
+
+	std::vector<uint16_t> invalid = { 0, 1, 6 };
+	EXPECT_TRUE(optimiseVertexFetch(invalid.data(), invalid.size(), 6).empty());
+	EXPECT_EQ(std::vector<uint16_t>({ 0, 1, 6 }), invalid);
+}
+
+TEST(RepoVertexCacheTest, uint32IndicesTest)
+{
+	size_t vertexCount;
+	auto indices = shuffledGrid(20, vertexCount);
+	std::vector<uint32_t> indices32(indices.begin(), indices.end());
+
+	//Both index types give the same ordering
+	EXPECT_TRUE(optimiseVertexCache(indices.data(), indices.size(), vertexCount));
+	EXPECT_TRUE(optimiseVertexCache(indices32.data(), indices32.size(), vertexCount));
+	EXPECT_EQ(std::vector<uint32_t>(indices.begin(), indices.end()), indices32);
+
+	EXPECT_EQ(optimiseVertexFetch(indices.data(), indices.size(), vertexCount),
+		optimiseVertexFetch(indices32.data(), indices32.size(), vertexCount));
+	EXPECT_EQ(std::vector<uint32_t>(indices.begin(), indices.end()), indices32);
+}
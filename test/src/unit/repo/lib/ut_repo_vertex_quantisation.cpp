@@ -0,0 +1,97 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <repo/lib/datastructure/repo_vertex_quantisation.h>
+#include <gtest/gtest.h>
+
+using namespace repo::lib;
+
+TEST(RepoVertexQuantisationTest, quantisePositionsTest)
+{
+	RepoVector3D min, scale;
+	EXPECT_TRUE(quantisePositions(nullptr, 0, false, min, scale).empty());
+
+	std::vector<RepoVector3D> positions = {
+		{ -1, 10, 5 }, { 3, 12, 5 }, { 0.5f, 11.25f, 5 } };
+	auto quantised = quantisePositions(positions.data(), positions.size(), false, min, scale);
+	ASSERT_EQ(positions.size() * 4, quantised.size());
+
+	EXPECT_EQ(-1, min.x);
+	EXPECT_EQ(10, min.y);
+	EXPECT_EQ(5, min.z);
+	//flat axis keeps a scale of 1
+	EXPECT_EQ(1, scale.z);
+
+	EXPECT_EQ(0, quantised[0]);
+	EXPECT_EQ(0, quantised[1]);
+	EXPECT_EQ(65535, quantised[4]);
+	EXPECT_EQ(65535, quantised[5]);
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		EXPECT_EQ(0, quantised[i * 4 + 2]);
+		EXPECT_EQ(0, quantised[i * 4 + 3]);
+		EXPECT_NEAR(positions[i].x, quantised[i * 4] * scale.x + min.x, scale.x);
+		EXPECT_NEAR(positions[i].y, quantised[i * 4 + 1] * scale.y + min.y, scale.y);
+		EXPECT_NEAR(positions[i].z, quantised[i * 4 + 2] * scale.z + min.z, 1e-6);
+	}
+
+	//uniform scale uses the largest extent on every axis
+	quantised = quantisePositions(positions.data(), positions.size(), true, min, scale);
+	EXPECT_EQ(scale.x, scale.y);
+	EXPECT_EQ(scale.x, scale.z);
+	EXPECT_EQ(65535, quantised[4]);
+	EXPECT_NEAR(32768, quantised[5], 1);
+	EXPECT_NEAR(12, quantised[5] * scale.y + min.y, scale.y);
+}
+
+TEST(RepoVertexQuantisationTest, quantiseNormalsTest)
+{
+	EXPECT_TRUE(quantiseNormals(nullptr, 0).empty());
+
+	std::vector<RepoVector3D> normals = { { 0, 0, 1 }, { -1, 0, 0 }, { 0.6f, -0.8f, 0 } };
+	auto quantised = quantiseNormals(normals.data(), normals.size());
+	ASSERT_EQ(normals.size() * 4, quantised.size());
+
+	EXPECT_EQ(std::vector<int8_t>({ 0, 0, 127, 0, -127, 0, 0, 0, 76, -102, 0, 0 }), quantised);
+}
+
+TEST(RepoVertexQuantisationTest, quantiseUVsTest)
+{
+	RepoVector2D min, scale;
+	EXPECT_TRUE(quantiseUVs(nullptr, 0, min, scale).empty());
+
+	std::vector<RepoVector2D> uvs = { { -2, 0.5f }, { 2, 0.5f }, { 0, 0.5f } };
+	auto quantised = quantiseUVs(uvs.data(), uvs.size(), min, scale);
+	ASSERT_EQ(uvs.size() * 2, quantised.size());
+	EXPECT_EQ(-2, min.x);
+	EXPECT_EQ(1, scale.y);
+	for (size_t i = 0; i < uvs.size(); ++i)
+	{
+		EXPECT_NEAR(uvs[i].x, quantised[i * 2] * scale.x + min.x, scale.x);
+		EXPECT_EQ(0, quantised[i * 2 + 1]);
+	}
+
+	//UVs outside of [0, 1] cannot be normalised
+	EXPECT_TRUE(quantiseUVs(uvs.data(), uvs.size(), min, scale, true).empty());
+
+	uvs = { { 0, 1 }, { 0.25f, 0.5f } };
+	quantised = quantiseUVs(uvs.data(), uvs.size(), min, scale, true);
+	ASSERT_EQ(uvs.size() * 2, quantised.size());
+	EXPECT_EQ(0, min.x);
+	EXPECT_EQ(0, min.y);
+	EXPECT_EQ(std::vector<uint16_t>({ 0, 65535, 16384, 32768 }), quantised);
+}
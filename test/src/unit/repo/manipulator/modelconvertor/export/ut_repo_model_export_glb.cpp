@@ -0,0 +1,300 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <sstream>
+
+#include <gtest/gtest.h>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <repo/core/model/bson/repo_bson_factory.h>
+#include <repo/core/model/collection/repo_scene.h>
+#include <repo/manipulator/modelconvertor/export/repo_model_export_glb.h>
+#include <repo/manipulator/modeloptimizer/repo_optimizer_multipart.h>
+
+using namespace repo::core::model;
+using namespace repo::manipulator::modelconvertor;
+
+static uint32_t readUInt32(
+	const std::vector<uint8_t> &buffer,
+	const size_t               &offset)
+{
+	uint32_t value;
+	memcpy(&value, buffer.data() + offset, sizeof(value));
+	return value;
+}
+
+/**
+* Check the header and chunks of a GLB container, and extract the chunks
+*/
+static void readContainer(
+	const std::vector<uint8_t> &container,
+	std::string                &json,
+	std::vector<uint8_t>       &bin)
+{
+	ASSERT_GE(container.size(), 20);
+	EXPECT_EQ(0x46546C67, readUInt32(container, 0)); //"glTF"
+	EXPECT_EQ(2, readUInt32(container, 4));
+	EXPECT_EQ(container.size(), readUInt32(container, 8));
+	EXPECT_EQ(0, container.size() % 4);
+
+	const uint32_t jsonLength = readUInt32(container, 12);
+	EXPECT_EQ(0x4E4F534A, readUInt32(container, 16)); //"JSON"
+	EXPECT_EQ(0, jsonLength % 4);
+	ASSERT_LE(20 + jsonLength, container.size());
+	json.assign((const char*)container.data() + 20, jsonLength);
+
+	size_t offset = 20 + jsonLength;
+	if (offset < container.size())
+	{
+		ASSERT_LE(offset + 8, container.size());
+		const uint32_t binLength = readUInt32(container, offset);
+		EXPECT_EQ(0x004E4942, readUInt32(container, offset + 4)); //"BIN\0"
+		EXPECT_EQ(0, binLength % 4);
+		offset += 8;
+		ASSERT_EQ(container.size(), offset + binLength);
+		bin.assign(container.begin() + offset, container.end());
+	}
+}
+
+static size_t getComponentSize(
+	const uint32_t &componentType)
+{
+	switch (componentType)
+	{
+	case 5120: //BYTE
+	case 5121: //UNSIGNED_BYTE
+		return 1;
+	case 5122: //SHORT
+	case 5123: //UNSIGNED_SHORT
+		return 2;
+	default: //UNSIGNED_INT, FLOAT
+		return 4;
+	}
+}
+
+static size_t getComponentCount(
+	const std::string &type)
+{
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	if (type == "MAT4") return 16;
+	return 1;
+}
+
+/**
+* Check the buffer views and accessors of a GLB container lie within its BIN chunk
+*/
+static void checkLayout(
+	const std::vector<uint8_t> &container)
+{
+	std::string json;
+	std::vector<uint8_t> bin;
+	readContainer(container, json, bin);
+
+	boost::property_tree::ptree tree;
+	std::stringstream stream(json);
+	boost::property_tree::read_json(stream, tree);
+
+	//The buffer refers to the BIN chunk, which is padded to 4 bytes
+	auto buffers = tree.get_child("buffers");
+	ASSERT_EQ(1, buffers.size());
+	const size_t bufferLength = buffers.front().second.get<size_t>("byteLength");
+	EXPECT_LE(bufferLength, bin.size());
+	EXPECT_LT(bin.size() - bufferLength, 4);
+
+	std::vector<std::pair<size_t, size_t>> views;
+	std::vector<size_t> strides;
+	for (const auto &view : tree.get_child("bufferViews"))
+	{
+		const size_t offset = view.second.get<size_t>("byteOffset", 0);
+		const size_t length = view.second.get<size_t>("byteLength");
+		EXPECT_EQ(0, view.second.get<uint32_t>("buffer"));
+		EXPECT_EQ(0, offset % 4);
+		EXPECT_LE(offset + length, bufferLength);
+		views.push_back({ offset, length });
+		strides.push_back(view.second.get<size_t>("byteStride", 0));
+	}
+
+	auto accessors = tree.get_child("accessors");
+	EXPECT_TRUE(accessors.size());
+	for (const auto &accessor : accessors)
+	{
+		const uint32_t viewIdx = accessor.second.get<uint32_t>("bufferView");
+		ASSERT_LT(viewIdx, views.size());
+		const size_t offset = accessor.second.get<size_t>("byteOffset", 0);
+		const size_t count = accessor.second.get<size_t>("count");
+		const size_t componentSize = getComponentSize(accessor.second.get<uint32_t>("componentType"));
+		const size_t elementSize = componentSize * getComponentCount(accessor.second.get<std::string>("type"));
+		const size_t stride = strides[viewIdx] ? strides[viewIdx] : elementSize;
+
+		EXPECT_EQ(0, offset % componentSize);
+		EXPECT_EQ(0, (views[viewIdx].first + offset) % componentSize);
+		EXPECT_LE(elementSize, stride);
+		ASSERT_TRUE(count);
+		EXPECT_LE(offset + stride * (count - 1) + elementSize, views[viewIdx].second);
+	}
+}
+
+/**
+* Stash graph of a few quads, with and without UVs
+*/
+static RepoScene* makeStashScene()
+{
+	RepoNodeSet trans, meshes, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	for (int i = 0; i < 5; ++i)
+	{
+		const float x = i * 2.f;
+		std::vector<repo::lib::RepoVector3D> vertices = {
+			{ x, 0, 0 }, { x + 1, 0, 0 }, { x + 1, 1, 0 }, { x, 1, 0 } };
+		std::vector<repo::lib::RepoVector3D> normals(4, { 0, 0, 1 });
+		std::vector<repo_face_t> faces = { { 0, 1, 2 }, { 0, 2, 3 } };
+		std::vector<std::vector<float>> bbox = { { x, 0, 0 }, { x + 1, 1, 0 } };
+		std::vector<std::vector<repo::lib::RepoVector2D>> uvs;
+		if (i % 2)
+			uvs.push_back({ { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } });
+
+		auto mesh = RepoBSONFactory::makeMeshNode(vertices, faces, normals, bbox, uvs);
+		meshes.insert(new MeshNode(mesh.cloneAndAddParent(root->getSharedID())));
+	}
+
+	auto scene = new RepoScene(std::vector<std::string>(), empty, meshes, empty, empty, empty, trans);
+	repo::manipulator::modeloptimizer::MultipartOptimizer opt;
+	opt.apply(scene);
+	return scene;
+}
+
+TEST(GLBModelExport, PackContainer)
+{
+	//7 bytes of JSON and 5 bytes of binary data, both padded to 8
+	const std::string json = "{\"a\":1}";
+	const std::vector<uint8_t> bin = { 1, 2, 3, 4, 5 };
+	auto container = GLBModelExport::packContainer(json, bin);
+	EXPECT_EQ(12 + 8 + 8 + 8 + 8, container.size());
+
+	std::string readJSON;
+	std::vector<uint8_t> readBin;
+	readContainer(container, readJSON, readBin);
+	EXPECT_EQ(json + " ", readJSON);
+	EXPECT_EQ(std::vector<uint8_t>({ 1, 2, 3, 4, 5, 0, 0, 0 }), readBin);
+
+	//The BIN chunk is left out without binary data
+	container = GLBModelExport::packContainer(json, std::vector<uint8_t>());
+	EXPECT_EQ(12 + 8 + 8, container.size());
+	readBin.clear();
+	readContainer(container, readJSON, readBin);
+	EXPECT_EQ(json + " ", readJSON);
+	EXPECT_TRUE(readBin.empty());
+}
+
+TEST(GLBModelExport, ContainerLayout)
+{
+	auto scene = makeStashScene();
+	ASSERT_TRUE(scene->hasRoot(RepoScene::GraphType::OPTIMIZED));
+
+	//Quantised attributes mix 8, 16 and 32 bit components within the BIN chunk
+	std::vector<WebExportOptions> allOptions(4);
+	allOptions[1].quantiseAttributes = true;
+	allOptions[2].optimiseVertexCache = true;
+	allOptions[3].useUInt32Indices = true;
+	for (const auto &options : allOptions)
+	{
+		GLBModelExport exporter(scene, options);
+		ASSERT_TRUE(exporter.isOk());
+		auto buffers = exporter.getAllFilesExportedAsBuffer();
+		ASSERT_EQ(1, buffers.geoFiles.size());
+		checkLayout(buffers.geoFiles.begin()->second);
+	}
+
+	delete scene;
+}
+
+TEST(GLBModelExport, LODOffsetsOfLargeSubMesh)
+{
+	//A 150x150 grid: 22500 vertices fit 16 bit indices, 44402 faces (133206 indices) do not fit 16 bit offsets
+	const uint32_t dim = 150;
+	std::vector<repo::lib::RepoVector3D> vertices;
+	std::vector<repo_face_t> faces;
+	for (uint32_t y = 0; y < dim; ++y)
+	{
+		for (uint32_t x = 0; x < dim; ++x)
+		{
+			vertices.push_back({ (float)x, (float)y, (float)((x * 7 + y * 3) % 5) });
+			if (x + 1 < dim && y + 1 < dim)
+			{
+				const uint32_t i = x + y * dim;
+				faces.push_back({ i, i + 1, i + dim + 1 });
+				faces.push_back({ i, i + dim + 1, i + dim });
+			}
+		}
+	}
+	std::vector<std::vector<float>> bbox = { { 0, 0, 0 }, { dim - 1.f, dim - 1.f, 4 } };
+
+	RepoNodeSet trans, meshes, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	auto mesh = RepoBSONFactory::makeMeshNode(vertices, faces, std::vector<repo::lib::RepoVector3D>(), bbox);
+	meshes.insert(new MeshNode(mesh.cloneAndAddParent(root->getSharedID())));
+
+	RepoScene scene(std::vector<std::string>(), empty, meshes, empty, empty, empty, trans);
+	repo::manipulator::modeloptimizer::MultipartOptimizer opt;
+	ASSERT_TRUE(opt.apply(&scene));
+
+	for (const bool optimiseVertexCache : { false, true })
+	{
+		WebExportOptions options;
+		options.optimiseVertexCache = optimiseVertexCache;
+		GLBModelExport exporter(&scene, options);
+		ASSERT_TRUE(exporter.isOk());
+		auto buffers = exporter.getAllFilesExportedAsBuffer();
+		ASSERT_EQ(1, buffers.geoFiles.size());
+
+		std::string json;
+		std::vector<uint8_t> bin;
+		readContainer(buffers.geoFiles.begin()->second, json, bin);
+		boost::property_tree::ptree tree;
+		std::stringstream stream(json);
+		boost::property_tree::read_json(stream, tree);
+
+		//The LOD offsets of the face accessor grow up to its last index, past 65535
+		size_t nLODAccessors = 0;
+		for (const auto &accessor : tree.get_child("accessors"))
+		{
+			auto lods = accessor.second.get_child_optional("extras.lodRef");
+			if (!lods)
+				continue;
+
+			++nLODAccessors;
+			const size_t count = accessor.second.get<size_t>("count");
+			EXPECT_EQ(faces.size() * 3, count);
+			size_t previous = 0;
+			for (const auto &lod : *lods)
+			{
+				const size_t offset = lod.second.get_value<size_t>();
+				EXPECT_LE(previous, offset);
+				EXPECT_LE(offset, count);
+				previous = offset;
+			}
+			EXPECT_EQ(count, previous);
+		}
+		EXPECT_EQ(1, nLODAccessors);
+	}
+}
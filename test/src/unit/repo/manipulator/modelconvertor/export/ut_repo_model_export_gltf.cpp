@@ -0,0 +1,316 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <regex>
+#include <sstream>
+
+#include <gtest/gtest.h>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <repo/core/model/bson/repo_bson_factory.h>
+#include <repo/core/model/collection/repo_scene.h>
+#include <repo/manipulator/modelconvertor/export/repo_model_export_gltf.h>
+#include <repo/manipulator/modeloptimizer/repo_optimizer_multipart.h>
+
+using namespace repo::core::model;
+using namespace repo::manipulator::modelconvertor;
+
+/**
+* Create a 1x1 quad (2 triangles) on the xy plane
+*/
+static MeshNode makeQuad(
+	const float &x = 0)
+{
+	std::vector<repo::lib::RepoVector3D> vertices = {
+		{ x, 0, 0 }, { x + 1, 0, 0 }, { x + 1, 1, 0 }, { x, 1, 0 } };
+	std::vector<repo::lib::RepoVector3D> normals(4, { 0, 0, 1 });
+	std::vector<repo_face_t> faces = { { 0, 1, 2 }, { 0, 2, 3 } };
+	std::vector<std::vector<float>> bbox = { { x, 0, 0 }, { x + 1, 1, 0 } };
+
+	return RepoBSONFactory::makeMeshNode(vertices, faces, normals, bbox);
+}
+
+static repo::lib::RepoMatrix makeTranslation(
+	const float &x,
+	const float &y,
+	const float &z)
+{
+	return repo::lib::RepoMatrix(std::vector<float>({
+		1, 0, 0, x,
+		0, 1, 0, y,
+		0, 0, 1, z,
+		0, 0, 0, 1 }));
+}
+
+/**
+* Add a copy of the node under the given parents into the node set
+*/
+template <class T>
+static T* addNode(
+	RepoNodeSet                            &nodes,
+	const T                                &node,
+	const std::vector<repo::lib::RepoUUID> &parents)
+{
+	auto added = new T(node.cloneAndAddParent(parents));
+	nodes.insert(added);
+	return added;
+}
+
+/**
+* Parse the glTF document of an export (there is only one for these scenes)
+*/
+static boost::property_tree::ptree readDocument(
+	const repo_web_buffers_t &buffers)
+{
+	boost::property_tree::ptree tree;
+	for (const auto &file : buffers.geoFiles)
+	{
+		const std::string &name = file.first;
+		if (name.size() > 4 && name.substr(name.size() - 4) == ".bin")
+			continue;
+
+		std::stringstream stream(std::string(file.second.begin(), file.second.end()));
+		boost::property_tree::read_json(stream, tree);
+	}
+	return tree;
+}
+
+TEST(GLTFModelExport, InstancedMeshListsEveryInstance)
+{
+	//3 instances of the same quad (one of them a mesh under 2 transformations)
+	//and a quad with different geometry
+	RepoNodeSet trans, meshes, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	const auto rootID = root->getSharedID();
+	auto t1 = addNode(trans, RepoBSONFactory::makeTransformationNode(makeTranslation(10, 0, 0)), { rootID });
+	auto t2 = addNode(trans, RepoBSONFactory::makeTransformationNode(makeTranslation(0, 10, 0)), { rootID });
+	auto copy1 = addNode(meshes, makeQuad(), { rootID });
+	auto copy2 = addNode(meshes, makeQuad(), { t1->getSharedID(), t2->getSharedID() });
+	addNode(meshes, makeQuad(5), { rootID });
+
+	RepoScene scene(std::vector<std::string>(), empty, meshes, empty, empty, empty, trans);
+	repo::manipulator::modeloptimizer::MultipartOptimizer opt;
+	opt.setInstancing(true, 3);
+	ASSERT_TRUE(opt.apply(&scene));
+
+	GLTFModelExport exporter(&scene);
+	ASSERT_TRUE(exporter.isOk());
+	auto tree = readDocument(exporter.getAllFilesExportedAsBuffer());
+
+	//The instanced mesh is exported once, its primitive refers to every instance
+	std::vector<std::string> refIDs;
+	for (const auto &mesh : tree.get_child("meshes"))
+	{
+		for (const auto &primitive : mesh.second.get_child("primitives"))
+		{
+			auto extras = primitive.second.get_child_optional("extras.refID");
+			if (!extras)
+				continue;
+
+			EXPECT_TRUE(refIDs.empty());
+			for (const auto &refID : *extras)
+				refIDs.push_back(refID.second.get_value<std::string>());
+		}
+	}
+
+	std::vector<std::string> expected = {
+		copy1->getUniqueID().toString(), copy2->getUniqueID().toString(), copy2->getUniqueID().toString() };
+	std::sort(expected.begin(), expected.end());
+	std::sort(refIDs.begin(), refIDs.end());
+	EXPECT_EQ(expected, refIDs);
+}
+
+TEST(GLTFModelExport, AccessorsGoldenOutput)
+{
+	//A quad with a material, the bounding box is not exact in binary
+	RepoNodeSet trans, meshes, materials, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	auto mesh = addNode(meshes, makeQuad(0.1f), { root->getSharedID() });
+
+	repo_material_t matStruct;
+	matStruct.diffuse = { 0.1f, 0.2f, 0.3f };
+	matStruct.opacity = 1;
+	matStruct.shininess = std::numeric_limits<float>::quiet_NaN();
+	matStruct.shininessStrength = std::numeric_limits<float>::quiet_NaN();
+	matStruct.isWireframe = false;
+	matStruct.isTwoSided = false;
+	addNode(materials, RepoBSONFactory::makeMaterialNode(matStruct), { mesh->getSharedID() });
+
+	RepoScene scene(std::vector<std::string>(), empty, meshes, materials, empty, empty, trans);
+	repo::manipulator::modeloptimizer::MultipartOptimizer opt;
+	ASSERT_TRUE(opt.apply(&scene));
+
+	GLTFModelExport exporter(&scene);
+	ASSERT_TRUE(exporter.isOk());
+	std::string document;
+	for (const auto &file : exporter.getAllFilesExportedAsBuffer().geoFiles)
+	{
+		const std::string &name = file.first;
+		if (name.size() <= 4 || name.substr(name.size() - 4) != ".bin")
+			document.assign(file.second.begin(), file.second.end());
+	}
+
+	//Accessor names are made of UUIDs, compare what follows them as written
+	static const std::regex accessor("\"componentType\":[0-9]+,\"count\":[0-9]+,\"min\":\\[[^\\]]*\\],\"max\":\\[[^\\]]*\\],\"type\":\"[A-Z0-9]+\"");
+	std::vector<std::string> accessors;
+	for (std::sregex_iterator it(document.begin(), document.end(), accessor), end; it != end; ++it)
+		accessors.push_back(it->str());
+
+	//indices, normals, positions and the id map of the only sub mesh
+	std::vector<std::string> expected = {
+		"\"componentType\":5123,\"count\":6,\"min\":[0],\"max\":[3],\"type\":\"SCALAR\"",
+		"\"componentType\":5126,\"count\":4,\"min\":[0,0,1],\"max\":[0,0,1],\"type\":\"VEC3\"",
+		"\"componentType\":5126,\"count\":4,\"min\":[0.1,0,0],\"max\":[1.1,1,0],\"type\":\"VEC3\"",
+		"\"componentType\":5126,\"count\":4,\"min\":[0],\"max\":[0],\"type\":\"SCALAR\"" };
+	std::sort(accessors.begin(), accessors.end());
+	EXPECT_EQ(expected, accessors);
+}
+
+/**
+* Face reordering of the original glTF export (16 bit indices, lodLimit 15),
+* only a flat axis quantises to 0 where it divided 0 by 0
+*/
+static std::vector<uint16_t> baselineReorderFaces(
+	const std::vector<uint16_t>                &faces,
+	const std::vector<repo::lib::RepoVector3D> &vertices,
+	const repo_mesh_mapping_t                  &mapping,
+	std::vector<uint32_t>                      &lods)
+{
+	const uint32_t maxBits = 16;
+	const float maxQuant = pow(2, maxBits) - 1;
+
+	const repo::lib::RepoVector3D *vRaw = &vertices[mapping.vertFrom];
+	const uint16_t *fRaw = &faces[mapping.triFrom * 3];
+
+	const size_t vCount = mapping.vertTo - mapping.vertFrom;
+	const size_t fCount = mapping.triTo - mapping.triFrom;
+
+	std::vector<bool> validFaces(fCount, false);
+	std::vector<uint16_t> reOrderedFaces;
+
+	repo::lib::RepoVector3D bboxMin = mapping.min;
+	repo::lib::RepoVector3D bboxSize = { mapping.max.x - bboxMin.x, mapping.max.y - bboxMin.y, mapping.max.z - bboxMin.z };
+	auto quantise = [&](const float &value, const float &min, const float &size) -> uint32_t
+	{
+		return size ? floorf(((value - min) / size) * maxQuant + 0.5) : 0;
+	};
+
+	std::vector<uint32_t> quantIndex(vCount);
+	for (uint32_t lod = 0; lod < maxBits; ++lod)
+	{
+		uint32_t dim = pow(2, (maxBits - lod));
+		uint32_t shift = maxBits - 15;
+
+		for (size_t vertId = 0; vertId < vCount; ++vertId)
+		{
+			uint32_t vertX = (quantise(vRaw[vertId].x, bboxMin.x, bboxSize.x) >> shift) << shift;
+			uint32_t vertY = (quantise(vRaw[vertId].y, bboxMin.y, bboxSize.y) >> shift) << shift;
+			uint32_t vertZ = (quantise(vRaw[vertId].z, bboxMin.z, bboxSize.z) >> shift) << shift;
+			quantIndex[vertId] = vertX + vertY * dim + vertZ * dim * dim;
+		}
+
+		for (size_t triIdx = 0; triIdx < fCount; ++triIdx)
+		{
+			size_t startIdx = triIdx * 3;
+			if (!validFaces[triIdx])
+			{
+				uint32_t currQuantX = quantIndex[fRaw[startIdx]];
+				uint32_t currQuantY = quantIndex[fRaw[startIdx + 1]];
+				uint32_t currQuantZ = quantIndex[fRaw[startIdx + 2]];
+
+				if ((currQuantX != currQuantY && currQuantY != currQuantZ) || lod == maxBits - 1)
+				{
+					reOrderedFaces.push_back(fRaw[startIdx]);
+					reOrderedFaces.push_back(fRaw[startIdx + 1]);
+					reOrderedFaces.push_back(fRaw[startIdx + 2]);
+					validFaces[triIdx] = true;
+				}
+			}
+		}
+
+		lods.push_back(reOrderedFaces.size());
+
+		if (reOrderedFaces.size() == fCount * 3)
+			break;
+	}
+
+	return reOrderedFaces;
+}
+
+/**
+* Create a grid of size x size quads, with a height given for each vertex,
+* and a vertex far away so the grid covers a few cells of the coarse levels of detail
+*/
+static void makeGrid(
+	const uint32_t                                  &size,
+	const std::function<float(const float &, const float &)> &height,
+	std::vector<repo::lib::RepoVector3D>            &vertices,
+	std::vector<uint16_t>                           &faces,
+	repo_mesh_mapping_t                             &mapping)
+{
+	for (uint32_t y = 0; y <= size; ++y)
+		for (uint32_t x = 0; x <= size; ++x)
+			vertices.push_back({ x * 0.37f, y * 0.53f, height(x * 0.37f, y * 0.53f) });
+	vertices.push_back({ 20000.0f, 30000.0f, height(0, 0) });
+
+	for (uint32_t y = 0; y < size; ++y)
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			uint16_t corner = y * (size + 1) + x;
+			faces.insert(faces.end(), { corner, (uint16_t)(corner + 1), (uint16_t)(corner + size + 2) });
+			faces.insert(faces.end(), { corner, (uint16_t)(corner + size + 2), (uint16_t)(corner + size + 1) });
+		}
+
+	mapping.vertFrom = 0;
+	mapping.vertTo = vertices.size();
+	mapping.triFrom = 0;
+	mapping.triTo = faces.size() / 3;
+	mapping.min = mapping.max = vertices[0];
+	for (const auto &vertex : vertices)
+	{
+		mapping.min = { std::min(mapping.min.x, vertex.x), std::min(mapping.min.y, vertex.y), std::min(mapping.min.z, vertex.z) };
+		mapping.max = { std::max(mapping.max.x, vertex.x), std::max(mapping.max.y, vertex.y), std::max(mapping.max.z, vertex.z) };
+	}
+}
+
+TEST(GLTFModelExport, ReorderFacesMatchesBaseline)
+{
+	std::vector<std::function<float(const float &, const float &)>> heights = {
+		[](const float &x, const float &y) { return std::sin(x * 1.3f) * std::cos(y * 0.7f) * 0.3f; },
+		[](const float &x, const float &y) { return 0.0f; } };
+
+	for (const auto &height : heights)
+	{
+		std::vector<repo::lib::RepoVector3D> vertices;
+		std::vector<uint16_t> faces;
+		repo_mesh_mapping_t mapping;
+		makeGrid(60, height, vertices, faces, mapping);
+
+		std::vector<uint32_t> lods, expectedLods;
+		auto reordered = GLTFModelExport::reorderFaces(faces, vertices, mapping, lods);
+		auto expected = baselineReorderFaces(faces, vertices, mapping, expectedLods);
+		EXPECT_EQ(expected, reordered);
+		EXPECT_EQ(expectedLods, lods);
+	}
+}
@@ -0,0 +1,98 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <limits>
+#include <regex>
+#include <string>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+#include <repo/core/model/bson/repo_bson_factory.h>
+#include <repo/core/model/collection/repo_scene.h>
+#include <repo/manipulator/modelconvertor/export/repo_model_export_src.h>
+#include <repo/manipulator/modeloptimizer/repo_optimizer_multipart.h>
+
+using namespace repo::core::model;
+using namespace repo::manipulator::modelconvertor;
+
+/**
+* Replace every UUID with <id#>, numbered in order of first appearance,
+* so documents of scenes built the same way can be compared as text
+*/
+static std::string normaliseIDs(const std::string &json)
+{
+	static const std::regex uuid("[0-9a-f]{8}-[0-9a-f]{4}-[0-9a-f]{4}-[0-9a-f]{4}-[0-9a-f]{12}");
+	std::unordered_map<std::string, std::string> ids;
+	std::string result;
+	auto last = json.cbegin();
+	for (std::sregex_iterator it(json.begin(), json.end(), uuid), end; it != end; ++it)
+	{
+		auto idIt = ids.find(it->str());
+		if (idIt == ids.end())
+			idIt = ids.insert({ it->str(), "<id" + std::to_string(ids.size() + 1) + ">" }).first;
+		result.append(last, (*it)[0].first);
+		result += idIt->second;
+		last = (*it)[0].second;
+	}
+	result.append(last, json.cend());
+	return result;
+}
+
+TEST(SRCModelExport, MappingFileGoldenOutput)
+{
+	//A quad with a material, the bounding box and colours are not exact in binary
+	RepoNodeSet trans, meshes, materials, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+
+	std::vector<repo::lib::RepoVector3D> vertices = {
+		{ 0.1f, 0, 0 }, { 1.1f, 0, 0 }, { 1.1f, 1, 0 }, { 0.1f, 1, 0 } };
+	std::vector<repo::lib::RepoVector3D> normals(4, { 0, 0, 1 });
+	std::vector<repo_face_t> faces = { { 0, 1, 2 }, { 0, 2, 3 } };
+	std::vector<std::vector<float>> bbox = { { 0.1f, 0, 0 }, { 1.1f, 1, 0 } };
+	auto mesh = new MeshNode(RepoBSONFactory::makeMeshNode(vertices, faces, normals, bbox)
+		.cloneAndAddParent(root->getSharedID()));
+	meshes.insert(mesh);
+
+	repo_material_t matStruct;
+	matStruct.diffuse = { 0.1f, 0.2f, 0.3f };
+	matStruct.opacity = 0.5f;
+	matStruct.shininess = 0.25f;
+	matStruct.shininessStrength = std::numeric_limits<float>::quiet_NaN();
+	matStruct.isWireframe = false;
+	matStruct.isTwoSided = false;
+	materials.insert(new MaterialNode(RepoBSONFactory::makeMaterialNode(matStruct)
+		.cloneAndAddParent(mesh->getSharedID())));
+
+	RepoScene scene(std::vector<std::string>(), empty, meshes, materials, empty, empty, trans);
+	repo::manipulator::modeloptimizer::MultipartOptimizer opt;
+	ASSERT_TRUE(opt.apply(&scene));
+
+	SRCModelExport exporter(&scene);
+	ASSERT_TRUE(exporter.isOk());
+	auto buffers = exporter.getAllFilesExportedAsBuffer();
+	ASSERT_EQ(1, buffers.jsonFiles.size());
+	const auto &mapping = buffers.jsonFiles.begin()->second;
+
+	//<id1> is the material of the supermesh, <id2> the quad and <id3> the supermesh
+	EXPECT_EQ(
+		"{\"numberOfIDs\":1,\"maxGeoCount\":1,"
+		"\"appearance\":[{\"name\":\"<id1>\",\"material\":{\"diffuseColor\":\"0.1 0.2 0.3\",\"shininess\":0.25,\"transparency\":0.5}}],"
+		"\"mapping\":[{\"name\":\"<id2>\",\"appearance\":\"<id1>\",\"min\":\"0.1 0 0\",\"max\":\"1.1 1 0\",\"usage\":[\"<id3>_0\"]}]}",
+		normaliseIDs(std::string(mapping.begin(), mapping.end())));
+}
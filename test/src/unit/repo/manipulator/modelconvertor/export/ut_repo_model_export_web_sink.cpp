@@ -0,0 +1,362 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <sstream>
+
+#include <gtest/gtest.h>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/thread.hpp>
+
+#include <repo/manipulator/modelconvertor/export/repo_model_export_web_sink.h>
+
+using namespace repo::manipulator::modelconvertor;
+
+template <typename T>
+static T readLittleEndian(
+	const std::vector<uint8_t> &buffer,
+	const size_t               &offset)
+{
+	T value = 0;
+	for (size_t i = 0; i < sizeof(T); ++i)
+		value |= (T)buffer[offset + i] << (8 * i);
+	return value;
+}
+
+static std::vector<uint8_t> makeFile(
+	const size_t  &size,
+	const uint8_t &seed)
+{
+	std::vector<uint8_t> file(size);
+	for (size_t i = 0; i < size; ++i)
+		file[i] = (uint8_t)(seed + i);
+	return file;
+}
+
+/**
+* Database handler which only stores raw files, in memory.
+* Uploads can be held until release() is called, to observe the uploads in progress
+*/
+class MockUploadHandler : public repo::core::handler::AbstractDatabaseHandler
+{
+public:
+	/**
+	* @param maxConnections number of connections the handler pretends to hold
+	* @param failingFile name of a file whose upload fails
+	*/
+	MockUploadHandler(
+		const uint32_t    &maxConnections,
+		const std::string &failingFile = std::string())
+		: AbstractDatabaseHandler(16 * 1024 * 1024, maxConnections),
+		failingFile(failingFile),
+		held(false),
+		nUploading(0),
+		maxUploading(0)
+	{}
+
+	/**
+	* Hold every upload until release() is called
+	*/
+	void hold()
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		held = true;
+	}
+
+	void release()
+	{
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			held = false;
+		}
+		changed.notify_all();
+	}
+
+	/**
+	* Wait for the given number of uploads to be in progress at once
+	* @return returns false if it did not happen within a few seconds
+	*/
+	bool waitForUploads(const uint32_t &count)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		return changed.wait_for(lock, boost::chrono::seconds(5), [&]() { return nUploading >= count; });
+	}
+
+	uint32_t getMaxUploading()
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		return maxUploading;
+	}
+
+	std::set<std::string> getFiles(const std::string &collection)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		return files[collection];
+	}
+
+	bool insertRawFile(
+		const std::string          &database,
+		const std::string          &collection,
+		const std::string          &fileName,
+		const std::vector<uint8_t> &bin,
+		std::string                &errMsg,
+		const std::string          &contentType)
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		maxUploading = std::max(maxUploading, ++nUploading);
+		changed.notify_all();
+		changed.wait(lock, [&]() { return !held; });
+		--nUploading;
+
+		if (fileName == failingFile)
+		{
+			errMsg = "mock failure";
+			return false;
+		}
+		files[collection].insert(fileName);
+		return true;
+	}
+
+	//Everything else is unused by the sink
+	uint64_t countItemsInCollection(const std::string &, const std::string &, std::string &) { return 0; }
+	std::vector<repo::core::model::RepoBSON> getAllFromCollectionTailable(const std::string &, const std::string &,
+		const uint64_t &, const uint32_t &, const std::list<std::string> &, const std::string &, const int &)
+	{
+		return std::vector<repo::core::model::RepoBSON>();
+	}
+	std::list<std::string> getCollections(const std::string &) { return std::list<std::string>(); }
+	repo::core::model::CollectionStats getCollectionStats(const std::string &, const std::string &, std::string &)
+	{
+		return repo::core::model::CollectionStats();
+	}
+	std::list<std::string> getDatabases(const bool &) { return std::list<std::string>(); }
+	std::map<std::string, std::list<std::string> > getDatabasesWithProjects(const std::list<std::string> &, const std::string &)
+	{
+		return std::map<std::string, std::list<std::string> >();
+	}
+	repo::core::model::DatabaseStats getDatabaseStats(const std::string &, std::string &)
+	{
+		return repo::core::model::DatabaseStats();
+	}
+	std::list<std::string> getProjects(const std::string &, const std::string &) { return std::list<std::string>(); }
+	std::list<std::string> getAdminDatabaseRoles() { return std::list<std::string>(); }
+	std::list<std::string> getStandardDatabaseRoles() { return std::list<std::string>(); }
+	void createCollection(const std::string &, const std::string &) {}
+	bool insertDocument(const std::string &, const std::string &, const repo::core::model::RepoBSON &, std::string &) { return false; }
+	bool insertRole(const repo::core::model::RepoRole &, std::string &) { return false; }
+	bool insertUser(const repo::core::model::RepoUser &, std::string &) { return false; }
+	bool upsertDocument(const std::string &, const std::string &, const repo::core::model::RepoBSON &, const bool &, std::string &) { return false; }
+	bool dropCollection(const std::string &, const std::string &, std::string &) { return false; }
+	bool dropDatabase(const std::string &, std::string &) { return false; }
+	bool dropDocument(const repo::core::model::RepoBSON, const std::string &, const std::string &, std::string &) { return false; }
+	bool dropDocuments(const repo::core::model::RepoBSON, const std::string &, const std::string &, std::string &) { return false; }
+	bool dropRawFile(const std::string &, const std::string &, const std::string &, std::string &) { return false; }
+	bool dropRole(const repo::core::model::RepoRole &, std::string &) { return false; }
+	bool dropUser(const repo::core::model::RepoUser &, std::string &) { return false; }
+	bool updateRole(const repo::core::model::RepoRole &, std::string &) { return false; }
+	bool updateUser(const repo::core::model::RepoUser &, std::string &) { return false; }
+	std::vector<repo::core::model::RepoBSON> findAllByCriteria(const std::string &, const std::string &, const repo::core::model::RepoBSON &)
+	{
+		return std::vector<repo::core::model::RepoBSON>();
+	}
+	repo::core::model::RepoBSON findOneByCriteria(const std::string &, const std::string &, const repo::core::model::RepoBSON &, const std::string &)
+	{
+		return repo::core::model::RepoBSON();
+	}
+	std::vector<repo::core::model::RepoBSON> findAllByUniqueIDs(const std::string &, const std::string &, const repo::core::model::RepoBSON &)
+	{
+		return std::vector<repo::core::model::RepoBSON>();
+	}
+	repo::core::model::RepoBSON findOneBySharedID(const std::string &, const std::string &, const repo::lib::RepoUUID &, const std::string &)
+	{
+		return repo::core::model::RepoBSON();
+	}
+	repo::core::model::RepoBSON findOneByUniqueID(const std::string &, const std::string &, const repo::lib::RepoUUID &)
+	{
+		return repo::core::model::RepoBSON();
+	}
+	std::vector<uint8_t> getRawFile(const std::string &, const std::string &, const std::string &) { return std::vector<uint8_t>(); }
+
+private:
+	const std::string failingFile;
+	boost::mutex mutex;
+	boost::condition_variable changed;
+	bool held;
+	uint32_t nUploading, maxUploading;
+	std::map<std::string, std::set<std::string>> files;
+};
+
+TEST(WebDatabaseSink, UploadsWithAtMostConnectionLimitUploaders)
+{
+	//The handler's connections cap the uploaders asked for, and the other way round
+	std::vector<std::pair<uint32_t, uint32_t>> limits = { { 3, 8 }, { 4, 2 } };
+	for (const auto &limit : limits)
+	{
+		const uint32_t expected = std::min(limit.first, limit.second);
+		MockUploadHandler handler(limit.first);
+		handler.hold();
+		WebDatabaseSink sink(&handler, "db", "geo", "json", 1024, limit.second);
+		for (uint8_t i = 0; i < 10; ++i)
+			EXPECT_TRUE(sink.addFile(WebFileType::GEOMETRY, std::to_string(i) + ".bin", makeFile(4, i)));
+
+		EXPECT_TRUE(handler.waitForUploads(expected));
+		//Give any extra uploader the time to show up
+		boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
+		EXPECT_EQ(expected, handler.getMaxUploading());
+
+		handler.release();
+		EXPECT_TRUE(sink.finish());
+		EXPECT_EQ(10, handler.getFiles("geo").size());
+		EXPECT_EQ(expected, handler.getMaxUploading());
+	}
+}
+
+TEST(WebDatabaseSink, BlocksAtMaxPendingBytes)
+{
+	MockUploadHandler handler(1);
+	handler.hold();
+	WebDatabaseSink sink(&handler, "db", "geo", "json", 10, 1);
+
+	//The file being uploaded counts as pending until its upload is done
+	EXPECT_TRUE(sink.addFile(WebFileType::GEOMETRY, "a.bin", makeFile(8, 0)));
+	ASSERT_TRUE(handler.waitForUploads(1));
+	EXPECT_TRUE(sink.addFile(WebFileType::JSON, "b.json", makeFile(2, 0)));
+
+	//10 bytes are pending, one more has to wait for an upload to finish
+	std::atomic<bool> added(false);
+	boost::thread producer([&]()
+	{
+		EXPECT_TRUE(sink.addFile(WebFileType::GEOMETRY, "c.bin", makeFile(1, 0)));
+		added = true;
+	});
+	boost::this_thread::sleep_for(boost::chrono::milliseconds(200));
+	EXPECT_FALSE(added.load());
+
+	handler.release();
+	producer.join();
+	EXPECT_TRUE(added.load());
+	EXPECT_TRUE(sink.finish());
+	EXPECT_EQ(std::set<std::string>({ "a.bin", "c.bin" }), handler.getFiles("geo"));
+	EXPECT_EQ(std::set<std::string>({ "b.json" }), handler.getFiles("json"));
+}
+
+TEST(WebDatabaseSink, ReportsFailedUpload)
+{
+	MockUploadHandler handler(2, "b.bin");
+	WebDatabaseSink sink(&handler, "db", "geo", "json");
+	EXPECT_TRUE(sink.addFile(WebFileType::GEOMETRY, "a.bin", makeFile(4, 0)));
+	EXPECT_TRUE(sink.addFile(WebFileType::GEOMETRY, "c.bin", makeFile(4, 0)));
+	EXPECT_TRUE(sink.addFile(WebFileType::GEOMETRY, "b.bin", makeFile(4, 0)));
+
+	//The other files are still uploaded, the sink reports the failure
+	EXPECT_FALSE(sink.finish());
+	EXPECT_EQ(std::set<std::string>({ "a.bin", "c.bin" }), handler.getFiles("geo"));
+	EXPECT_FALSE(sink.addFile(WebFileType::GEOMETRY, "d.bin", makeFile(4, 0)));
+}
+
+TEST(WebDatabaseSink, NullHandler)
+{
+	WebDatabaseSink sink(nullptr, "db", "geo", "json");
+	EXPECT_FALSE(sink.addFile(WebFileType::GEOMETRY, "a.bin", makeFile(4, 0)));
+	EXPECT_FALSE(sink.finish());
+}
+
+TEST(WebPackedSink, PacksFilesAsTheyAreAdded)
+{
+	repo_web_buffers_t buffers;
+	WebBufferSink bufferSink(buffers);
+	WebPackedSink packedSink(bufferSink, "web.pack", "web.pack.json");
+
+	//Sizes which are not multiples of the alignment
+	std::vector<std::pair<std::string, std::vector<uint8_t>>> files = {
+		{ "a.bin", makeFile(13, 1) },
+		{ "b.json", makeFile(5, 50) },
+		{ "c.bin", makeFile(64, 100) } };
+	for (const auto &file : files)
+	{
+		auto data = file.second;
+		const auto type = file.first.find(".json") == std::string::npos ? WebFileType::GEOMETRY : WebFileType::JSON;
+		EXPECT_TRUE(packedSink.addFile(type, file.first, std::move(data)));
+		//The sink does not keep a copy of the file
+		EXPECT_TRUE(data.empty());
+	}
+
+	//Nothing reaches the target before the container is finished
+	EXPECT_TRUE(buffers.geoFiles.empty());
+	EXPECT_TRUE(packedSink.finish());
+	EXPECT_FALSE(packedSink.addFile(WebFileType::GEOMETRY, "d.bin", makeFile(4, 0)));
+
+	ASSERT_EQ(1, buffers.geoFiles.size());
+	ASSERT_EQ(1, buffers.jsonFiles.size());
+	const auto &container = buffers.geoFiles["web.pack"];
+	const auto &manifestData = buffers.jsonFiles["web.pack.json"];
+
+	//Header
+	ASSERT_GE(container.size(), 32);
+	EXPECT_EQ(0x4B415052, readLittleEndian<uint32_t>(container, 0)); //"RPAK"
+	EXPECT_EQ(2, readLittleEndian<uint32_t>(container, 4));
+
+	//Trailer
+	const size_t trailer = container.size() - 16;
+	const uint64_t indexOffset = readLittleEndian<uint64_t>(container, trailer);
+	EXPECT_EQ(files.size(), readLittleEndian<uint32_t>(container, trailer + 8));
+	EXPECT_EQ(0x4B415052, readLittleEndian<uint32_t>(container, trailer + 12));
+	EXPECT_EQ(0, indexOffset % 8);
+	EXPECT_EQ(trailer, indexOffset + files.size() * 16);
+
+	boost::property_tree::ptree manifest;
+	std::stringstream stream(std::string(manifestData.begin(), manifestData.end()));
+	boost::property_tree::read_json(stream, manifest);
+	EXPECT_EQ(2, manifest.get<uint32_t>("version"));
+	EXPECT_EQ("web.pack", manifest.get<std::string>("container"));
+	EXPECT_EQ(container.size(), manifest.get<size_t>("length"));
+
+	//The index, the manifest and the packed data agree with each other
+	auto entries = manifest.get_child("files");
+	ASSERT_EQ(files.size(), entries.size());
+	size_t i = 0;
+	size_t previousEnd = 16;
+	for (const auto &entry : entries)
+	{
+		const size_t offset = entry.second.get<size_t>("offset");
+		const size_t length = entry.second.get<size_t>("length");
+		EXPECT_EQ(files[i].first, entry.second.get<std::string>("name"));
+		EXPECT_EQ(i == 1 ? "json" : "geometry", entry.second.get<std::string>("type"));
+		EXPECT_EQ(offset, readLittleEndian<uint64_t>(container, indexOffset + i * 16));
+		EXPECT_EQ(length, readLittleEndian<uint64_t>(container, indexOffset + i * 16 + 8));
+
+		EXPECT_EQ(0, offset % 8);
+		EXPECT_GE(offset, previousEnd);
+		ASSERT_LE(offset + length, indexOffset);
+		EXPECT_EQ(files[i].second, std::vector<uint8_t>(container.begin() + offset, container.begin() + offset + length));
+		previousEnd = offset + length;
+		++i;
+	}
+}
+
+TEST(WebPackedSink, EmptyContainer)
+{
+	repo_web_buffers_t buffers;
+	WebBufferSink bufferSink(buffers);
+	WebPackedSink packedSink(bufferSink, "web.pack", "web.pack.json");
+	EXPECT_TRUE(packedSink.finish());
+	EXPECT_TRUE(buffers.geoFiles.empty());
+	EXPECT_TRUE(buffers.jsonFiles.empty());
+}
@@ -0,0 +1,894 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include <repo/core/model/bson/repo_bson_factory.h>
+#include <repo/core/model/collection/repo_scene.h>
+#include <repo/manipulator/modeloptimizer/repo_optimizer_multipart.h>
+#include <repo/manipulator/modelutility/repo_mesh_map_reorganiser.h>
+
+using namespace repo::core::model;
+using namespace repo::manipulator::modeloptimizer;
+
+const static RepoScene::GraphType optimG = RepoScene::GraphType::OPTIMIZED;
+
+/**
+* Create a 1x1 quad (2 triangles) on the xy plane
+*/
+static MeshNode makeQuad(
+	const float &x = 0,
+	const float &y = 0,
+	const bool  &withUVs = false)
+{
+	std::vector<repo::lib::RepoVector3D> vertices = {
+		{ x, y, 0 }, { x + 1, y, 0 }, { x + 1, y + 1, 0 }, { x, y + 1, 0 } };
+	std::vector<repo_face_t> faces = { { 0, 1, 2 }, { 0, 2, 3 } };
+	std::vector<std::vector<float>> bbox = { { x, y, 0 }, { x + 1, y + 1, 0 } };
+	std::vector<std::vector<repo::lib::RepoVector2D>> uvs;
+	if (withUVs)
+		uvs.push_back({ { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } });
+
+	return RepoBSONFactory::makeMeshNode(vertices, faces, std::vector<repo::lib::RepoVector3D>(), bbox, uvs);
+}
+
+/**
+* Create a strip of quads along the x axis, sharing vertices between neighbours
+*/
+static MeshNode makeStrip(
+	const uint32_t &nQuads)
+{
+	std::vector<repo::lib::RepoVector3D> vertices;
+	std::vector<repo_face_t> faces;
+	for (uint32_t i = 0; i <= nQuads; ++i)
+	{
+		vertices.push_back({ (float)i, 0, 0 });
+		vertices.push_back({ (float)i, 1, 0 });
+		if (i)
+		{
+			faces.push_back({ 2 * i - 2, 2 * i, 2 * i + 1 });
+			faces.push_back({ 2 * i - 2, 2 * i + 1, 2 * i - 1 });
+		}
+	}
+	std::vector<std::vector<float>> bbox = { { 0, 0, 0 }, { (float)nQuads, 1, 0 } };
+
+	return RepoBSONFactory::makeMeshNode(vertices, faces, std::vector<repo::lib::RepoVector3D>(), bbox);
+}
+
+static repo::lib::RepoMatrix makeTranslation(
+	const float &x,
+	const float &y,
+	const float &z)
+{
+	return repo::lib::RepoMatrix(std::vector<float>({
+		1, 0, 0, x,
+		0, 1, 0, y,
+		0, 0, 1, z,
+		0, 0, 0, 1 }));
+}
+
+static repo_material_t makeMaterial(
+	const float &opacity = 1)
+{
+	repo_material_t mat;
+	mat.diffuse = { 1, 0, 0 };
+	mat.opacity = opacity;
+	mat.shininess = 0;
+	mat.shininessStrength = 0;
+	mat.isWireframe = false;
+	mat.isTwoSided = false;
+	return mat;
+}
+
+/**
+* Add a copy of the node under the given parents into the node set
+*/
+template <class T>
+static T* addNode(
+	RepoNodeSet                            &nodes,
+	const T                                &node,
+	const std::vector<repo::lib::RepoUUID> &parents)
+{
+	auto added = new T(node.cloneAndAddParent(parents));
+	nodes.insert(added);
+	return added;
+}
+
+/**
+* Scene with the given meshes directly under the root.
+* The nodes keep their IDs so the same scene can be built again
+*/
+static RepoScene* makeQuadScene(
+	const TransformationNode    &root,
+	const std::vector<MeshNode> &quads)
+{
+	RepoNodeSet trans, meshes, empty;
+	trans.insert(new TransformationNode(root));
+	for (const auto &quad : quads)
+		addNode(meshes, quad, { root.getSharedID() });
+
+	return new RepoScene(std::vector<std::string>(), empty, meshes, empty, empty, empty, trans);
+}
+
+static std::vector<MeshNode*> getSuperMeshes(
+	const RepoScene *scene)
+{
+	std::vector<MeshNode*> superMeshes;
+	for (const auto &node : scene->getAllMeshes(optimG))
+		superMeshes.push_back((MeshNode*)node);
+	return superMeshes;
+}
+
+/**
+* Mesh IDs within each supermesh, sorted so scenes can be compared
+*/
+static std::vector<std::vector<repo::lib::RepoUUID>> getGroupings(
+	const RepoScene *scene)
+{
+	std::vector<std::vector<repo::lib::RepoUUID>> groupings;
+	for (const auto &superMesh : getSuperMeshes(scene))
+	{
+		groupings.push_back(std::vector<repo::lib::RepoUUID>());
+		for (const auto &mapping : superMesh->getMeshMapping())
+			groupings.back().push_back(mapping.mesh_id);
+	}
+	std::sort(groupings.begin(), groupings.end());
+	return groupings;
+}
+
+/**
+* Supermesh containing the given mesh (nullptr if there is none)
+*/
+static MeshNode* findSuperMesh(
+	const RepoScene           *scene,
+	const repo::lib::RepoUUID &meshID)
+{
+	for (const auto &superMesh : getSuperMeshes(scene))
+	{
+		for (const auto &mapping : superMesh->getMeshMapping())
+		{
+			if (mapping.mesh_id == meshID)
+				return superMesh;
+		}
+	}
+	return nullptr;
+}
+
+TEST(MultipartOptimizer, ConstructorTest)
+{
+	MultipartOptimizer();
+	MultipartOptimizer(4, 1000);
+}
+
+TEST(MultipartOptimizer, DeconstructorTest)
+{
+	auto ptr = new MultipartOptimizer();
+	delete ptr;
+}
+
+TEST(MultipartOptimizer, ApplyOptimizationTest)
+{
+	auto opt = MultipartOptimizer();
+	RepoScene *empty = nullptr;
+	RepoScene *empty2 = new RepoScene();
+
+	EXPECT_FALSE(opt.apply(empty));
+	EXPECT_FALSE(opt.apply(empty2));
+	delete empty2;
+}
+
+TEST(MultipartOptimizer, GetMortonCode)
+{
+	std::vector<repo::lib::RepoVector3D> bbox = { { 0, 0, 0 }, { 1, 1, 1 } };
+	const uint64_t xBits = 0x1249249249249249ULL;
+
+	EXPECT_EQ(0, MultipartOptimizer::getMortonCode({ 0, 0, 0 }, bbox));
+	EXPECT_EQ(xBits, MultipartOptimizer::getMortonCode({ 1, 0, 0 }, bbox));
+	EXPECT_EQ(xBits << 1, MultipartOptimizer::getMortonCode({ 0, 1, 0 }, bbox));
+	EXPECT_EQ(xBits << 2, MultipartOptimizer::getMortonCode({ 0, 0, 1 }, bbox));
+	EXPECT_EQ(0x7FFFFFFFFFFFFFFFULL, MultipartOptimizer::getMortonCode({ 1, 1, 1 }, bbox));
+
+	//Points outside of the box are clamped
+	EXPECT_EQ(0, MultipartOptimizer::getMortonCode({ -5, -5, -5 }, bbox));
+	EXPECT_EQ(0x7FFFFFFFFFFFFFFFULL, MultipartOptimizer::getMortonCode({ 5, 5, 5 }, bbox));
+
+	//Flat dimensions do not contribute
+	std::vector<repo::lib::RepoVector3D> flat = { { 0, 0, 0 }, { 1, 0, 0 } };
+	EXPECT_EQ(xBits, MultipartOptimizer::getMortonCode({ 1, 7, 7 }, flat));
+
+	//Z order: every point of an octant comes before the next octant
+	EXPECT_LT(MultipartOptimizer::getMortonCode({ 0.1f, 0.1f, 0.1f }, bbox),
+		MultipartOptimizer::getMortonCode({ 0.4f, 0.4f, 0.4f }, bbox));
+	EXPECT_LT(MultipartOptimizer::getMortonCode({ 0.4f, 0.4f, 0.4f }, bbox),
+		MultipartOptimizer::getMortonCode({ 0.6f, 0.1f, 0.1f }, bbox));
+	EXPECT_LT(MultipartOptimizer::getMortonCode({ 0.9f, 0.1f, 0.1f }, bbox),
+		MultipartOptimizer::getMortonCode({ 0.1f, 0.6f, 0.1f }, bbox));
+}
+
+TEST(MultipartOptimizer, CollectsEveryInstance)
+{
+	//A mesh under 2 transformations is merged twice, once with each world matrix
+	RepoNodeSet trans, meshes, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	auto t1 = addNode(trans, RepoBSONFactory::makeTransformationNode(makeTranslation(10, 0, 0)), { root->getSharedID() });
+	auto t2 = addNode(trans, RepoBSONFactory::makeTransformationNode(makeTranslation(0, 10, 0)), { root->getSharedID() });
+	auto t3 = addNode(trans, RepoBSONFactory::makeTransformationNode(makeTranslation(0, 0, 10)), { t1->getSharedID() });
+	auto instanced = addNode(meshes, makeQuad(), { t2->getSharedID(), t3->getSharedID() });
+	auto single = addNode(meshes, makeQuad(), { root->getSharedID() });
+
+	RepoScene scene(std::vector<std::string>(), empty, meshes, empty, empty, empty, trans);
+	MultipartOptimizer opt;
+	ASSERT_TRUE(opt.apply(&scene));
+	ASSERT_TRUE(scene.hasRoot(optimG));
+
+	auto superMeshes = getSuperMeshes(&scene);
+	ASSERT_EQ(1, superMeshes.size());
+	EXPECT_EQ(12, superMeshes[0]->getNumVertices());
+	EXPECT_EQ(std::vector<repo::lib::RepoUUID>({ scene.getRoot(optimG)->getSharedID() }), superMeshes[0]->getParentIDs());
+
+	std::vector<repo::lib::RepoVector3D> instancedMins;
+	size_t nSingle = 0;
+	for (const auto &mapping : superMeshes[0]->getMeshMapping())
+	{
+		EXPECT_EQ(4, mapping.vertTo - mapping.vertFrom);
+		EXPECT_EQ(2, mapping.triTo - mapping.triFrom);
+		if (mapping.mesh_id == instanced->getUniqueID())
+			instancedMins.push_back(mapping.min);
+		else if (mapping.mesh_id == single->getUniqueID())
+			++nSingle;
+	}
+
+	EXPECT_EQ(1, nSingle);
+	ASSERT_EQ(2, instancedMins.size());
+	std::sort(instancedMins.begin(), instancedMins.end(),
+		[](const repo::lib::RepoVector3D &a, const repo::lib::RepoVector3D &b) { return a.x < b.x; });
+	//through t2
+	EXPECT_EQ(repo::lib::RepoVector3D(0, 10, 0), instancedMins[0]);
+	//through t1 then t3
+	EXPECT_EQ(repo::lib::RepoVector3D(10, 0, 10), instancedMins[1]);
+}
+
+TEST(MultipartOptimizer, ThreadCountDoesNotChangeResult)
+{
+	auto root = RepoBSONFactory::makeTransformationNode();
+	std::vector<MeshNode> quads;
+	for (int i = 0; i < 16; ++i)
+		quads.push_back(makeQuad(i * 3.f, (i % 4) * 5.f));
+
+	//4 vertices per quad, 2 quads per supermesh
+	auto scene1 = makeQuadScene(root, quads);
+	auto scene2 = makeQuadScene(root, quads);
+	MultipartOptimizer opt1(1, 8), opt2(4, 8);
+	ASSERT_TRUE(opt1.apply(scene1));
+	ASSERT_TRUE(opt2.apply(scene2));
+
+	auto groupings = getGroupings(scene1);
+	EXPECT_EQ(8, groupings.size());
+	EXPECT_EQ(groupings, getGroupings(scene2));
+	EXPECT_EQ(scene1->getAllMaterials(optimG).size(), scene2->getAllMaterials(optimG).size());
+
+	delete scene1;
+	delete scene2;
+}
+
+TEST(MultipartOptimizer, GroupsByMortonOrder)
+{
+	//Quads far apart on the x axis should not share a supermesh,
+	//whatever their IDs or the order they are added in
+	auto root = RepoBSONFactory::makeTransformationNode();
+	std::vector<MeshNode> quads = { makeQuad(0), makeQuad(100), makeQuad(1.5f), makeQuad(101.5f) };
+	auto scene = makeQuadScene(root, quads);
+	MultipartOptimizer opt(1, 8);
+	ASSERT_TRUE(opt.apply(scene));
+
+	std::vector<std::vector<repo::lib::RepoUUID>> expected = {
+		{ quads[0].getUniqueID(), quads[2].getUniqueID() },
+		{ quads[1].getUniqueID(), quads[3].getUniqueID() } };
+	for (auto &grouping : expected)
+		std::sort(grouping.begin(), grouping.end());
+	std::sort(expected.begin(), expected.end());
+
+	auto groupings = getGroupings(scene);
+	for (auto &grouping : groupings)
+		std::sort(grouping.begin(), grouping.end());
+	std::sort(groupings.begin(), groupings.end());
+	EXPECT_EQ(expected, groupings);
+
+	delete scene;
+}
+
+TEST(MultipartOptimizer, VertexBudget)
+{
+	auto root = RepoBSONFactory::makeTransformationNode();
+	std::vector<MeshNode> quads;
+	for (int i = 0; i < 5; ++i)
+		quads.push_back(makeQuad(i * 2.f));
+
+	//The face limit alone would put all of them in one supermesh
+	auto scene = makeQuadScene(root, quads);
+	MultipartOptimizer opt(1, 8);
+	ASSERT_TRUE(opt.apply(scene));
+
+	auto superMeshes = getSuperMeshes(scene);
+	EXPECT_EQ(3, superMeshes.size());
+	size_t nVertices = 0;
+	for (const auto &superMesh : superMeshes)
+	{
+		EXPECT_LE(superMesh->getNumVertices(), 8);
+		nVertices += superMesh->getNumVertices();
+	}
+	EXPECT_EQ(20, nVertices);
+
+	delete scene;
+
+	//Without a budget they all fit in one
+	scene = makeQuadScene(root, quads);
+	MultipartOptimizer defaultOpt;
+	ASSERT_TRUE(defaultOpt.apply(scene));
+	EXPECT_EQ(1, scene->getAllMeshes(optimG).size());
+	delete scene;
+}
+
+TEST(MultipartOptimizer, SplitsMeshesAboveVertexBudget)
+{
+	//26 vertices shared between 24 triangles
+	auto root = RepoBSONFactory::makeTransformationNode();
+	auto strip = makeStrip(12);
+	auto scene = makeQuadScene(root, { strip });
+	MultipartOptimizer opt(1, 8);
+	ASSERT_TRUE(opt.apply(scene));
+
+	auto superMeshes = getSuperMeshes(scene);
+	ASSERT_EQ(1, superMeshes.size());
+	auto mappings = superMeshes[0]->getMeshMapping();
+	auto vertices = superMeshes[0]->getVertices();
+	auto faces = superMeshes[0]->getFaces();
+	auto origVertices = strip.getVertices();
+	auto origFaces = strip.getFaces();
+	ASSERT_GT(mappings.size(), 1);
+	ASSERT_EQ(origFaces.size(), faces.size());
+
+	//Consecutive mappings of the same mesh, each within the budget,
+	//with every face referring to vertices of its own mapping
+	uint32_t vertFrom = 0, triFrom = 0;
+	for (const auto &mapping : mappings)
+	{
+		EXPECT_EQ(strip.getUniqueID(), mapping.mesh_id);
+		EXPECT_EQ(vertFrom, mapping.vertFrom);
+		EXPECT_EQ(triFrom, mapping.triFrom);
+		EXPECT_LE(mapping.vertTo - mapping.vertFrom, 8);
+		EXPECT_GT(mapping.triTo, mapping.triFrom);
+
+		for (uint32_t i = mapping.triFrom; i < mapping.triTo; ++i)
+		{
+			for (uint32_t j = 0; j < 3; ++j)
+			{
+				const auto idx = faces[i][j];
+				EXPECT_GE(idx, mapping.vertFrom);
+				EXPECT_LT(idx, mapping.vertTo);
+				//same triangles, in the same order
+				EXPECT_EQ(origVertices[origFaces[i][j]], vertices[idx]);
+				EXPECT_GE(vertices[idx].x, mapping.min.x);
+				EXPECT_LE(vertices[idx].x, mapping.max.x);
+			}
+		}
+		vertFrom = mapping.vertTo;
+		triFrom = mapping.triTo;
+	}
+	EXPECT_EQ(vertices.size(), vertFrom);
+	EXPECT_EQ(faces.size(), triFrom);
+
+	delete scene;
+}
+
+TEST(MultipartOptimizer, SplitMeshesKeepAllSubMeshesWhenReorganised)
+{
+	//The exporters reorganise the supermesh again, a mesh pre-split into
+	//several mappings with the same ID must be mapped to all of its sub meshes
+	auto root = RepoBSONFactory::makeTransformationNode();
+	auto strip = makeStrip(12);
+	auto scene = makeQuadScene(root, { strip });
+	MultipartOptimizer opt(1, 8);
+	ASSERT_TRUE(opt.apply(scene));
+
+	auto superMeshes = getSuperMeshes(scene);
+	ASSERT_EQ(1, superMeshes.size());
+
+	repo::manipulator::modelutility::MeshMapReorganiser reorganiser(superMeshes[0], 8);
+	const auto nSubMeshes = reorganiser.getMappingsPerSubMesh().size();
+	EXPECT_EQ(superMeshes[0]->getMeshMapping().size(), nSubMeshes);
+
+	auto splitMapping = reorganiser.getSplitMapping();
+	ASSERT_EQ(1, splitMapping.size());
+	std::vector<uint32_t> expected;
+	for (uint32_t i = 0; i < nSubMeshes; ++i)
+		expected.push_back(i);
+	EXPECT_EQ(expected, splitMapping[strip.getUniqueID()]);
+
+	delete scene;
+}
+
+TEST(MultipartOptimizer, ClassifiesMeshesByMaterial)
+{
+	RepoNodeSet trans, meshes, materials, textures, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	const auto rootID = root->getSharedID();
+
+	auto opaque1 = addNode(meshes, makeQuad(0), { rootID });
+	auto opaque2 = addNode(meshes, makeQuad(2), { rootID });
+	auto noMaterial = addNode(meshes, makeQuad(4), { rootID });
+	auto transparent = addNode(meshes, makeQuad(6), { rootID });
+	auto textured1 = addNode(meshes, makeQuad(8, 0, true), { rootID });
+	auto textured2 = addNode(meshes, makeQuad(10, 0, true), { rootID });
+
+	//Materials shared between meshes are only classified once, whichever mesh comes first
+	auto opaqueMat = addNode(materials, RepoBSONFactory::makeMaterialNode(makeMaterial()),
+		{ opaque1->getSharedID(), opaque2->getSharedID() });
+	auto transparentMat = addNode(materials, RepoBSONFactory::makeMaterialNode(makeMaterial(0.5f)),
+		{ transparent->getSharedID() });
+	auto texturedMat = addNode(materials, RepoBSONFactory::makeMaterialNode(makeMaterial()),
+		{ textured1->getSharedID(), textured2->getSharedID() });
+	const char texData[] = { 0, 0, 0, 0 };
+	addNode(textures, RepoBSONFactory::makeTextureNode("texture.png", texData, sizeof(texData), 1, 1),
+		{ texturedMat->getSharedID() });
+
+	RepoScene scene(std::vector<std::string>(), empty, meshes, materials, empty, textures, trans);
+	MultipartOptimizer opt;
+	ASSERT_TRUE(opt.apply(&scene));
+
+	//Opaque meshes (with or without a material) are merged, the transparent mesh is kept apart,
+	//and textured meshes are one per supermesh (REPO_MP_TEXTURE_WORK_AROUND)
+	std::vector<std::vector<repo::lib::RepoUUID>> expected = {
+		{ opaque1->getUniqueID(), opaque2->getUniqueID(), noMaterial->getUniqueID() },
+		{ transparent->getUniqueID() },
+		{ textured1->getUniqueID() },
+		{ textured2->getUniqueID() } };
+	for (auto &grouping : expected)
+		std::sort(grouping.begin(), grouping.end());
+	std::sort(expected.begin(), expected.end());
+
+	auto groupings = getGroupings(&scene);
+	for (auto &grouping : groupings)
+		std::sort(grouping.begin(), grouping.end());
+	std::sort(groupings.begin(), groupings.end());
+	EXPECT_EQ(expected, groupings);
+
+	//Each material is copied once into the stash graph, under every supermesh using it
+	EXPECT_EQ(3, scene.getAllMaterials(optimG).size());
+	EXPECT_EQ(1, scene.getAllTextures(optimG).size());
+	std::unordered_map<repo::lib::RepoUUID, repo::lib::RepoUUID, repo::lib::RepoUUIDHasher> stashMatIDs;
+	for (const auto &superMesh : getSuperMeshes(&scene))
+	{
+		for (const auto &mapping : superMesh->getMeshMapping())
+		{
+			stashMatIDs[mapping.mesh_id] = mapping.material_id;
+			if (mapping.mesh_id == noMaterial->getUniqueID())
+				continue;
+
+			auto mat = scene.getNodeByUniqueID(optimG, mapping.material_id);
+			ASSERT_TRUE(mat);
+			auto parents = mat->getParentIDs();
+			EXPECT_NE(parents.end(), std::find(parents.begin(), parents.end(), superMesh->getSharedID()));
+			EXPECT_EQ(mapping.mesh_id == transparent->getUniqueID() ? 0.5f : 1.f,
+				((MaterialNode*)mat)->getMaterialStruct().opacity);
+		}
+	}
+	EXPECT_EQ(stashMatIDs[opaque1->getUniqueID()], stashMatIDs[opaque2->getUniqueID()]);
+	EXPECT_EQ(stashMatIDs[textured1->getUniqueID()], stashMatIDs[textured2->getUniqueID()]);
+	EXPECT_NE(stashMatIDs[opaque1->getUniqueID()], stashMatIDs[noMaterial->getUniqueID()]);
+	EXPECT_NE(stashMatIDs[opaque1->getUniqueID()], stashMatIDs[transparent->getUniqueID()]);
+	EXPECT_NE(opaqueMat->getUniqueID(), stashMatIDs[opaque1->getUniqueID()]);
+	EXPECT_NE(transparentMat->getUniqueID(), stashMatIDs[transparent->getUniqueID()]);
+}
+
+TEST(MultipartOptimizer, InstancesDuplicatedGeometry)
+{
+	//3 copies of the same quad (as different meshes and as an instanced mesh)
+	//and a quad with different geometry
+	RepoNodeSet trans, meshes, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	const auto rootID = root->getSharedID();
+	auto t1 = addNode(trans, RepoBSONFactory::makeTransformationNode(makeTranslation(10, 0, 0)), { rootID });
+	auto t2 = addNode(trans, RepoBSONFactory::makeTransformationNode(makeTranslation(0, 10, 0)), { rootID });
+	auto copy1 = addNode(meshes, makeQuad(), { rootID });
+	auto copy2 = addNode(meshes, makeQuad(), { t1->getSharedID(), t2->getSharedID() });
+	auto other = addNode(meshes, makeQuad(5), { rootID });
+
+	RepoScene scene(std::vector<std::string>(), empty, meshes, empty, empty, empty, trans);
+	MultipartOptimizer opt;
+	opt.setInstancing(true, 3);
+	ASSERT_TRUE(opt.apply(&scene));
+
+	MeshNode *instancedMesh = nullptr, *superMesh = nullptr;
+	for (const auto &mesh : getSuperMeshes(&scene))
+	{
+		if (mesh->getParentIDs().size() > 1)
+			instancedMesh = mesh;
+		else
+			superMesh = mesh;
+	}
+	ASSERT_EQ(2, scene.getAllMeshes(optimG).size());
+	ASSERT_TRUE(instancedMesh);
+	ASSERT_TRUE(superMesh);
+
+	//The different quad is merged as usual
+	auto superMappings = superMesh->getMeshMapping();
+	ASSERT_EQ(1, superMappings.size());
+	EXPECT_EQ(other->getUniqueID(), superMappings[0].mesh_id);
+	EXPECT_EQ(std::vector<repo::lib::RepoUUID>({ scene.getRoot(optimG)->getSharedID() }), superMesh->getParentIDs());
+
+	//The geometry is stored once in local space, under a transformation per instance
+	EXPECT_EQ(4, instancedMesh->getNumVertices());
+	EXPECT_EQ(2, instancedMesh->getNumFaces());
+	EXPECT_EQ(copy1->getVertices(), instancedMesh->getVertices());
+	EXPECT_EQ(3, instancedMesh->getParentIDs().size());
+
+	std::vector<std::string> instanceNames;
+	for (const auto &parentID : instancedMesh->getParentIDs())
+	{
+		auto parent = scene.getNodeBySharedID(optimG, parentID);
+		ASSERT_TRUE(parent);
+		EXPECT_EQ(std::vector<repo::lib::RepoUUID>({ scene.getRoot(optimG)->getSharedID() }), parent->getParentIDs());
+		instanceNames.push_back(parent->getName());
+	}
+	std::sort(instanceNames.begin(), instanceNames.end());
+	std::vector<std::string> expectedNames = {
+		copy1->getUniqueID().toString(), copy2->getUniqueID().toString(), copy2->getUniqueID().toString() };
+	std::sort(expectedNames.begin(), expectedNames.end());
+	EXPECT_EQ(expectedNames, instanceNames);
+
+	//One mapping per instance, all of them over the full (overlapping) range
+	//of the mesh, with the bounding box of the instance in world space
+	auto mappings = instancedMesh->getMeshMapping();
+	ASSERT_EQ(3, mappings.size());
+	std::vector<repo::lib::RepoVector3D> mins;
+	for (const auto &mapping : mappings)
+	{
+		EXPECT_EQ(0, mapping.vertFrom);
+		EXPECT_EQ(4, mapping.vertTo);
+		EXPECT_EQ(0, mapping.triFrom);
+		EXPECT_EQ(2, mapping.triTo);
+		EXPECT_EQ(1, mapping.max.x - mapping.min.x);
+		EXPECT_EQ(1, mapping.max.y - mapping.min.y);
+		mins.push_back(mapping.min);
+		if (mapping.min == repo::lib::RepoVector3D(0, 0, 0))
+			EXPECT_EQ(copy1->getUniqueID(), mapping.mesh_id);
+		else
+			EXPECT_EQ(copy2->getUniqueID(), mapping.mesh_id);
+	}
+	std::sort(mins.begin(), mins.end(),
+		[](const repo::lib::RepoVector3D &a, const repo::lib::RepoVector3D &b) { return a.x + 2 * a.y < b.x + 2 * b.y; });
+	EXPECT_EQ(repo::lib::RepoVector3D(0, 0, 0), mins[0]);
+	EXPECT_EQ(repo::lib::RepoVector3D(10, 0, 0), mins[1]);
+	EXPECT_EQ(repo::lib::RepoVector3D(0, 10, 0), mins[2]);
+}
+
+TEST(MultipartOptimizer, InstancingThreshold)
+{
+	//Same as above, with fewer instances than needed
+	RepoNodeSet trans, meshes, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	const auto rootID = root->getSharedID();
+	auto t1 = addNode(trans, RepoBSONFactory::makeTransformationNode(makeTranslation(10, 0, 0)), { rootID });
+	addNode(meshes, makeQuad(), { rootID });
+	addNode(meshes, makeQuad(), { t1->getSharedID() });
+
+	RepoScene scene(std::vector<std::string>(), empty, meshes, empty, empty, empty, trans);
+	MultipartOptimizer opt;
+	opt.setInstancing(true, 3);
+	ASSERT_TRUE(opt.apply(&scene));
+
+	auto superMeshes = getSuperMeshes(&scene);
+	ASSERT_EQ(1, superMeshes.size());
+	EXPECT_EQ(1, superMeshes[0]->getParentIDs().size());
+	EXPECT_EQ(8, superMeshes[0]->getNumVertices());
+	EXPECT_EQ(2, superMeshes[0]->getMeshMapping().size());
+}
+
+TEST(MultipartOptimizer, DoesNotInstanceDifferentGeometry)
+{
+	//Same counts and bounding box, but not the same triangles
+	RepoNodeSet trans, meshes, materials, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	const auto rootID = root->getSharedID();
+
+	auto quad = makeQuad();
+	auto flipped = RepoBSONFactory::makeMeshNode(quad.getVertices(), { { 0, 2, 1 }, { 0, 3, 2 } },
+		std::vector<repo::lib::RepoVector3D>(), { { 0, 0, 0 }, { 1, 1, 0 } });
+	addNode(meshes, quad, { rootID });
+	addNode(meshes, flipped, { rootID });
+
+	//Same geometry, but not the same material
+	auto red = addNode(meshes, makeQuad(), { rootID });
+	auto transparent = addNode(meshes, makeQuad(), { rootID });
+	addNode(materials, RepoBSONFactory::makeMaterialNode(makeMaterial()), { red->getSharedID() });
+	addNode(materials, RepoBSONFactory::makeMaterialNode(makeMaterial(0.5f)), { transparent->getSharedID() });
+
+	RepoScene scene(std::vector<std::string>(), empty, meshes, materials, empty, empty, trans);
+	MultipartOptimizer opt;
+	opt.setInstancing(true, 2);
+	ASSERT_TRUE(opt.apply(&scene));
+
+	for (const auto &mesh : getSuperMeshes(&scene))
+		EXPECT_EQ(1, mesh->getParentIDs().size());
+}
+
+TEST(MultipartOptimizer, IncrementalUpdateReusesUnchangedSuperMeshes)
+{
+	//2 supermeshes far apart, one of them under its own transformation
+	RepoNodeSet trans, meshes, materials, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	const auto rootID = root->getSharedID();
+	auto far = addNode(trans, RepoBSONFactory::makeTransformationNode(makeTranslation(100, 0, 0)), { rootID });
+	auto near1 = addNode(meshes, makeQuad(0), { rootID });
+	auto near2 = addNode(meshes, makeQuad(1.5f), { rootID });
+	auto far1 = addNode(meshes, makeQuad(0), { far->getSharedID() });
+	auto far2 = addNode(meshes, makeQuad(1.5f), { far->getSharedID() });
+	auto mat = addNode(materials, RepoBSONFactory::makeMaterialNode(makeMaterial()),
+		{ near1->getSharedID(), far1->getSharedID() });
+
+	RepoScene scene(std::vector<std::string>(), empty, meshes, materials, empty, empty, trans);
+	MultipartOptimizer opt(1, 8);
+	ASSERT_TRUE(opt.apply(&scene));
+	ASSERT_EQ(2, scene.getAllMeshes(optimG).size());
+	const auto stashRootID = scene.getRoot(optimG)->getSharedID();
+	const auto nearID = findSuperMesh(&scene, near1->getUniqueID())->getUniqueID();
+	const auto farID = findSuperMesh(&scene, far1->getUniqueID())->getUniqueID();
+	const auto nearVertices = findSuperMesh(&scene, near1->getUniqueID())->getVertices();
+	ASSERT_EQ(1, scene.getAllMaterials(optimG).size());
+	const auto matCopyID = (*scene.getAllMaterials(optimG).begin())->getUniqueID();
+
+	//Moving the far transformation only rebuilds the supermesh under it,
+	//the other one is kept as it is, under a root with the same shared ID
+	MultipartOptimizer farOpt(1, 8);
+	farOpt.setIncremental({ far->getSharedID() });
+	ASSERT_TRUE(farOpt.apply(&scene));
+	ASSERT_EQ(2, scene.getAllMeshes(optimG).size());
+	EXPECT_EQ(stashRootID, scene.getRoot(optimG)->getSharedID());
+	auto nearMesh = findSuperMesh(&scene, near2->getUniqueID());
+	auto farMesh = findSuperMesh(&scene, far2->getUniqueID());
+	ASSERT_TRUE(nearMesh);
+	ASSERT_TRUE(farMesh);
+	EXPECT_EQ(nearID, nearMesh->getUniqueID());
+	EXPECT_EQ(nearVertices, nearMesh->getVertices());
+	EXPECT_NE(farID, farMesh->getUniqueID());
+	EXPECT_EQ(std::vector<repo::lib::RepoUUID>({ stashRootID }), nearMesh->getParentIDs());
+	EXPECT_EQ(std::vector<repo::lib::RepoUUID>({ stashRootID }), farMesh->getParentIDs());
+
+	//The material copy is kept too, shared by the reused and the rebuilt supermesh
+	ASSERT_EQ(1, scene.getAllMaterials(optimG).size());
+	auto matCopy = *scene.getAllMaterials(optimG).begin();
+	EXPECT_EQ(matCopyID, matCopy->getUniqueID());
+	auto matParents = matCopy->getParentIDs();
+	std::sort(matParents.begin(), matParents.end());
+	std::vector<repo::lib::RepoUUID> expectedParents = { nearMesh->getSharedID(), farMesh->getSharedID() };
+	std::sort(expectedParents.begin(), expectedParents.end());
+	EXPECT_EQ(expectedParents, matParents);
+	for (const auto &superMesh : { nearMesh, farMesh })
+	{
+		for (const auto &mapping : superMesh->getMeshMapping())
+		{
+			if (mapping.mesh_id == near1->getUniqueID() || mapping.mesh_id == far1->getUniqueID())
+			{
+				EXPECT_EQ(matCopyID, mapping.material_id);
+			}
+		}
+	}
+	const auto farRebuiltID = farMesh->getUniqueID();
+
+	//A changed material affects every mesh using it
+	MultipartOptimizer matOpt(1, 8);
+	matOpt.setIncremental({ mat->getSharedID() });
+	ASSERT_TRUE(matOpt.apply(&scene));
+	EXPECT_NE(nearID, findSuperMesh(&scene, near1->getUniqueID())->getUniqueID());
+	EXPECT_NE(farRebuiltID, findSuperMesh(&scene, far1->getUniqueID())->getUniqueID());
+	const auto nearRebuiltID = findSuperMesh(&scene, near1->getUniqueID())->getUniqueID();
+	const auto farRebuiltID2 = findSuperMesh(&scene, far1->getUniqueID())->getUniqueID();
+
+	//A changed mesh only affects itself (and its supermesh)
+	MultipartOptimizer meshOpt(1, 8);
+	meshOpt.setIncremental({ near2->getSharedID() });
+	ASSERT_TRUE(meshOpt.apply(&scene));
+	EXPECT_NE(nearRebuiltID, findSuperMesh(&scene, near1->getUniqueID())->getUniqueID());
+	EXPECT_EQ(farRebuiltID2, findSuperMesh(&scene, far1->getUniqueID())->getUniqueID());
+
+	//Without changes everything is kept, but a full regeneration rebuilds everything
+	const auto groupings = getGroupings(&scene);
+	std::vector<repo::lib::RepoUUID> ids;
+	for (const auto &superMesh : getSuperMeshes(&scene))
+		ids.push_back(superMesh->getUniqueID());
+	std::sort(ids.begin(), ids.end());
+
+	MultipartOptimizer noChangeOpt(1, 8);
+	noChangeOpt.setIncremental({});
+	ASSERT_TRUE(noChangeOpt.apply(&scene));
+	std::vector<repo::lib::RepoUUID> keptIDs;
+	for (const auto &superMesh : getSuperMeshes(&scene))
+		keptIDs.push_back(superMesh->getUniqueID());
+	std::sort(keptIDs.begin(), keptIDs.end());
+	EXPECT_EQ(ids, keptIDs);
+	EXPECT_EQ(groupings, getGroupings(&scene));
+
+	MultipartOptimizer fullOpt(1, 8);
+	ASSERT_TRUE(fullOpt.apply(&scene));
+	EXPECT_EQ(groupings, getGroupings(&scene));
+	for (const auto &superMesh : getSuperMeshes(&scene))
+		EXPECT_FALSE(std::binary_search(ids.begin(), ids.end(), superMesh->getUniqueID()));
+}
+
+TEST(MultipartOptimizer, IncrementalUpdateDropsRemovedMeshes)
+{
+	auto root = RepoBSONFactory::makeTransformationNode();
+	std::vector<MeshNode> quads = { makeQuad(0), makeQuad(1.5f), makeQuad(100), makeQuad(101.5f) };
+	auto scene = makeQuadScene(root, quads);
+	MultipartOptimizer opt(1, 8);
+	ASSERT_TRUE(opt.apply(scene));
+	const auto keptID = findSuperMesh(scene, quads[0].getUniqueID())->getUniqueID();
+
+	//The removed mesh is reported as changed and is no longer in the scene
+	scene->removeNode(RepoScene::GraphType::DEFAULT, quads[3].getSharedID());
+	MultipartOptimizer incOpt(1, 8);
+	incOpt.setIncremental({ quads[3].getSharedID() });
+	ASSERT_TRUE(incOpt.apply(scene));
+
+	EXPECT_EQ(keptID, findSuperMesh(scene, quads[0].getUniqueID())->getUniqueID());
+	EXPECT_FALSE(findSuperMesh(scene, quads[3].getUniqueID()));
+	auto rebuilt = findSuperMesh(scene, quads[2].getUniqueID());
+	ASSERT_TRUE(rebuilt);
+	EXPECT_EQ(1, rebuilt->getMeshMapping().size());
+
+	delete scene;
+}
+
+TEST(MultipartOptimizer, MergesMeshesSharingATexture)
+{
+	//The same nodes (with the same IDs) are used to build each scene
+	auto root = RepoBSONFactory::makeTransformationNode();
+	const auto rootID = root.getSharedID();
+	std::vector<MeshNode> quads = {
+		makeQuad(0, 0, true), makeQuad(2, 0, true), makeQuad(4, 0, true), makeQuad(6, 0, true) };
+	auto sharedMat = RepoBSONFactory::makeMaterialNode(makeMaterial());
+	auto otherMat = RepoBSONFactory::makeMaterialNode(makeMaterial());
+	const char texData[] = { 0, 0, 0, 0 };
+	auto sharedTex = RepoBSONFactory::makeTextureNode("shared.png", texData, sizeof(texData), 1, 1);
+	auto otherTex = RepoBSONFactory::makeTextureNode("other.png", texData, sizeof(texData), 1, 1);
+
+	auto makeScene = [&]()
+	{
+		RepoNodeSet trans, meshes, materials, textures, empty;
+		trans.insert(new TransformationNode(root));
+		for (const auto &quad : quads)
+			addNode(meshes, quad, { rootID });
+		addNode(materials, sharedMat, { quads[0].getSharedID(), quads[1].getSharedID(), quads[2].getSharedID() });
+		addNode(materials, otherMat, { quads[3].getSharedID() });
+		addNode(textures, sharedTex, { sharedMat.getSharedID() });
+		addNode(textures, otherTex, { otherMat.getSharedID() });
+		return new RepoScene(std::vector<std::string>(), empty, meshes, materials, empty, textures, trans);
+	};
+
+	//Merged within the vertex budget, never across textures
+	auto scene = makeScene();
+	MultipartOptimizer opt(1, 8);
+	opt.setTextureMerging(true);
+	ASSERT_TRUE(opt.apply(scene));
+
+	auto groupings = getGroupings(scene);
+	ASSERT_EQ(3, groupings.size());
+	std::vector<size_t> groupSizes;
+	for (const auto &grouping : groupings)
+	{
+		groupSizes.push_back(grouping.size());
+		if (std::find(grouping.begin(), grouping.end(), quads[3].getUniqueID()) != grouping.end())
+		{
+			EXPECT_EQ(1, grouping.size());
+		}
+	}
+	std::sort(groupSizes.begin(), groupSizes.end());
+	EXPECT_EQ(std::vector<size_t>({ 1, 1, 2 }), groupSizes);
+
+	//UVs are carried over unchanged, the meshes share the texture's uv space
+	auto quadUVs = quads[0].getUVChannelsSeparated()[0];
+	for (const auto &superMesh : getSuperMeshes(scene))
+	{
+		auto uvs = superMesh->getUVChannelsSeparated();
+		ASSERT_EQ(1, uvs.size());
+		ASSERT_EQ(superMesh->getNumVertices(), uvs[0].size());
+		for (const auto &mapping : superMesh->getMeshMapping())
+		{
+			for (uint32_t i = mapping.vertFrom; i < mapping.vertTo; ++i)
+				EXPECT_EQ(quadUVs[i - mapping.vertFrom], uvs[0][i]);
+		}
+	}
+	delete scene;
+
+	//Without texture merging every textured mesh is a supermesh on its own
+	scene = makeScene();
+	MultipartOptimizer separateOpt(1, 8);
+	ASSERT_TRUE(separateOpt.apply(scene));
+	EXPECT_EQ(4, scene->getAllMeshes(optimG).size());
+	delete scene;
+}
+
+TEST(MultipartOptimizer, MemoryBudgetKeepsStubsOfFlushedSuperMeshes)
+{
+	auto root = RepoBSONFactory::makeTransformationNode();
+	std::vector<MeshNode> quads;
+	for (int i = 0; i < 8; ++i)
+		quads.push_back(makeQuad(i * 3.f));
+
+	auto reference = makeQuadScene(root, quads);
+	MultipartOptimizer refOpt(1, 8);
+	ASSERT_TRUE(refOpt.apply(reference));
+
+	//Every batch goes over a 1 byte budget, so every supermesh is flushed
+	auto scene = makeQuadScene(root, quads);
+	std::vector<MeshNode> flushed;
+	MultipartOptimizer opt(1, 8);
+	opt.setMemoryBudget(1, [&](const MeshNode &mesh)
+	{
+		flushed.push_back(mesh);
+		return true;
+	});
+	ASSERT_TRUE(opt.apply(scene));
+
+	//The stash graph still holds every supermesh, as a stub
+	auto superMeshes = getSuperMeshes(scene);
+	EXPECT_EQ(4, flushed.size());
+	EXPECT_EQ(flushed.size(), superMeshes.size());
+	EXPECT_EQ(getGroupings(reference), getGroupings(scene));
+	auto rootID = scene->getRoot(optimG)->getSharedID();
+	for (const auto &superMesh : superMeshes)
+	{
+		EXPECT_TRUE(superMesh->isStub());
+		EXPECT_EQ(0, superMesh->getVertices().size());
+		EXPECT_EQ(0, superMesh->getFaces().size());
+		EXPECT_EQ(std::vector<repo::lib::RepoUUID>({ rootID }), superMesh->getParentIDs());
+	}
+
+	//The flushed supermeshes are whole, and are the ones the stubs stand for
+	for (const auto &mesh : flushed)
+	{
+		EXPECT_FALSE(mesh.isStub());
+		EXPECT_EQ(4 * mesh.getMeshMapping().size(), mesh.getVertices().size());
+		auto stub = scene->getNodeByUniqueID(optimG, mesh.getUniqueID());
+		ASSERT_TRUE(stub);
+		EXPECT_EQ(mesh.getSharedID(), stub->getSharedID());
+		EXPECT_EQ(mesh.getParentIDs(), stub->getParentIDs());
+	}
+
+	//Materials still refer to supermeshes within the stash graph
+	for (const auto &material : scene->getAllMaterials(optimG))
+	{
+		for (const auto &parent : material->getParentIDs())
+			EXPECT_TRUE(scene->getNodeBySharedID(optimG, parent));
+	}
+
+	//Without a budget nothing is flushed
+	for (const auto &superMesh : getSuperMeshes(reference))
+		EXPECT_FALSE(superMesh->isStub());
+
+	delete reference;
+	delete scene;
+}
@@ -0,0 +1,93 @@
+/**
+*  Copyright (C) 2016 3D Repo Ltd
+*
+*  This program is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Affero General Public License as
+*  published by the Free Software Foundation, either version 3 of the
+*  License, or (at your option) any later version.
+*
+*  This program is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Affero General Public License for more details.
+*
+*  You should have received a copy of the GNU Affero General Public License
+*  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <repo/core/model/bson/repo_bson_factory.h>
+#include <repo/core/model/collection/repo_scene.h>
+#include <repo/manipulator/modelutility/repo_scene_manager.h>
+
+#include "../../../repo_test_database_info.h"
+
+using namespace repo::core::model;
+using namespace repo::manipulator::modelutility;
+
+const static RepoScene::GraphType optimG = RepoScene::GraphType::OPTIMIZED;
+
+/**
+* Scene of a few quads directly under the root
+*/
+static RepoScene* makeQuadScene(
+	const std::string &database,
+	const std::string &project)
+{
+	RepoNodeSet trans, meshes, empty;
+	auto root = new TransformationNode(RepoBSONFactory::makeTransformationNode());
+	trans.insert(root);
+	for (int i = 0; i < 3; ++i)
+	{
+		const float x = i * 2.f;
+		std::vector<repo::lib::RepoVector3D> vertices = {
+			{ x, 0, 0 }, { x + 1, 0, 0 }, { x + 1, 1, 0 }, { x, 1, 0 } };
+		std::vector<repo::lib::RepoVector3D> normals(4, { 0, 0, 1 });
+		std::vector<repo_face_t> faces = { { 0, 1, 2 }, { 0, 2, 3 } };
+		std::vector<std::vector<float>> bbox = { { x, 0, 0 }, { x + 1, 1, 0 } };
+
+		auto mesh = RepoBSONFactory::makeMeshNode(vertices, faces, normals, bbox);
+		meshes.insert(new MeshNode(mesh.cloneAndAddParent(root->getSharedID())));
+	}
+
+	auto scene = new RepoScene(std::vector<std::string>(), empty, meshes, empty, empty, empty, trans);
+	scene->setDatabaseAndProjectName(database, project);
+	return scene;
+}
+
+TEST(SceneManager, WebBuffersOfUnchangedRevision)
+{
+	auto handler = getHandler();
+	auto scene = makeQuadScene("sceneManagerTest", "unchangedRevision");
+	std::string errMsg;
+	SceneManager manager;
+
+	ASSERT_TRUE(scene->commit(handler, errMsg, "me"));
+	ASSERT_TRUE(manager.generateStashGraph(scene, handler));
+	const repo::lib::RepoUUID rev = scene->getRevisionID();
+
+	repo_web_buffers_t buffers;
+	EXPECT_TRUE(manager.generateWebViewBuffers(scene, repo::manipulator::modelconvertor::WebExportType::SRC, buffers));
+	EXPECT_TRUE(buffers.geoFiles.size());
+
+	//Commit the same scene again: only metadata changed, every supermesh is kept
+	ASSERT_TRUE(scene->commit(handler, errMsg, "me"));
+	ASSERT_NE(rev, scene->getRevisionID());
+	ASSERT_TRUE(manager.generateStashGraph(scene, handler, { repo::lib::RepoUUID::createUUID() }));
+
+	auto stashMeshes = scene->getAllMeshes(optimG);
+	ASSERT_TRUE(stashMeshes.size());
+	for (const auto &mesh : stashMeshes)
+		EXPECT_TRUE(scene->isSharedStashNode(mesh));
+
+	//Nothing new to export, but the web buffers of the revision are complete
+	for (const auto &exType : { repo::manipulator::modelconvertor::WebExportType::SRC,
+		repo::manipulator::modelconvertor::WebExportType::GLTF })
+	{
+		repo_web_buffers_t sharedBuffers;
+		EXPECT_TRUE(manager.generateWebViewBuffers(scene, exType, sharedBuffers));
+	}
+
+	delete scene;
+}